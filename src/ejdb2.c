@@ -4,6 +4,10 @@
 
 static iwrc _jb_put_new_lw(JBCOLL jbc, JBL jbl, int64_t *id);
 
+static iwrc _jb_exec_list_visitor(struct _EJDB_EXEC *ctx, EJDB_DOC doc, int64_t *step);
+
+static iwrc _jb_idx_drop_lw(JBIDX idx, JBIDX prev);
+
 static const IWKV_val EMPTY_VAL = { 0 };
 
 IW_INLINE iwrc _jb_meta_nrecs_removedb(EJDB db, uint32_t dbid) {
@@ -15,18 +19,18 @@ IW_INLINE iwrc _jb_meta_nrecs_removedb(EJDB db, uint32_t dbid) {
   return iwkv_del(db->nrecdb, &key, 0);
 }
 
-IW_INLINE iwrc _jb_meta_nrecs_update(EJDB db, uint32_t dbid, int64_t delta) {
-  delta = IW_HTOILL(delta);
+IW_INLINE iwrc _jb_meta_nrecs_set(EJDB db, uint32_t dbid, int64_t rnum) {
+  rnum = IW_HTOILL(rnum);
   dbid = IW_HTOIL(dbid);
   IWKV_val val = {
-    .size = sizeof(delta),
-    .data = &delta
+    .size = sizeof(rnum),
+    .data = &rnum
   };
   IWKV_val key = {
     .size = sizeof(dbid),
     .data = &dbid
   };
-  return iwkv_put(db->nrecdb, &key, &val, IWKV_VAL_INCREMENT);
+  return iwkv_put(db->nrecdb, &key, &val, 0);
 }
 
 static int64_t _jb_meta_nrecs_get(EJDB db, uint32_t dbid) {
@@ -44,14 +48,271 @@ static int64_t _jb_meta_nrecs_get(EJDB db, uint32_t dbid) {
   return (int64_t) ret;
 }
 
+static iwrc _jb_db_count(IWDB kdb, int64_t *cntp) {
+  int64_t cnt = 0;
+  IWKV_cursor cur;
+  *cntp = 0;
+  iwrc rc = iwkv_cursor_open(kdb, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    return 0;
+  }
+  RCRET(rc);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    ++cnt;
+  }
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+    *cntp = cnt;
+  }
+  iwkv_cursor_close(&cur);
+  return rc;
+}
+
+/**
+ * Loads number of records of `kdb` persisted in NUMRECSDB_ID.
+ * Records are recounted if persisted counters are stale since database was not closed properly.
+ */
+static iwrc _jb_rnum_load(EJDB db, IWDB kdb, uint32_t dbid, int64_t *rnump, int64_t *flushedp) {
+  *flushedp = _jb_meta_nrecs_get(db, dbid);
+  if (db->rnum_stale) {
+    return _jb_db_count(kdb, rnump);
+  }
+  *rnump = *flushedp;
+  return 0;
+}
+
+/**
+ * Persists records counters of collection and its indexes changed since last flush.
+ * Collection must be locked, `db->rnum_mtx` must be held.
+ */
+static iwrc _jb_coll_rnum_flush(JBCOLL jbc) {
+  iwrc rc = 0;
+  int64_t rnum = __sync_add_and_fetch(&jbc->rnum, 0);
+  if (rnum != jbc->rnum_flushed) {
+    rc = _jb_meta_nrecs_set(jbc->db, jbc->dbid, rnum);
+    if (!rc) {
+      jbc->rnum_flushed = rnum;
+    }
+  }
+  for (JBIDX idx = jbc->idx; idx; idx = idx->next) {
+    rnum = __sync_add_and_fetch(&idx->rnum, 0);
+    if (rnum != idx->rnum_flushed) {
+      iwrc rc2 = _jb_meta_nrecs_set(jbc->db, idx->dbid, rnum);
+      if (!rc2) {
+        idx->rnum_flushed = rnum;
+      } else {
+        IWRC(rc2, rc);
+      }
+    }
+  }
+  return rc;
+}
+
+/**
+ * Persists changed records counters of all collections, database must be locked.
+ */
+static iwrc _jb_rnum_flush_lr(EJDB db) {
+  int rci;
+  iwrc rc = 0;
+  if (db->oflags & IWKV_RDONLY) {
+    return 0;
+  }
+  pthread_mutex_lock(&db->rnum_mtx);
+  for (khiter_t k = kh_begin(db->mcolls); k != kh_end(db->mcolls); ++k) {
+    if (!kh_exist(db->mcolls, k)) {
+      continue;
+    }
+    JBCOLL jbc = kh_val(db->mcolls, k);
+    rci = pthread_rwlock_rdlock(&jbc->rwl);
+    if (rci) {
+      IWRC(iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci), rc);
+      continue;
+    }
+    IWRC(_jb_coll_rnum_flush(jbc), rc);
+    pthread_rwlock_unlock(&jbc->rwl);
+  }
+  pthread_mutex_unlock(&db->rnum_mtx);
+  return rc;
+}
+
+static iwrc _jb_rnum_flush(EJDB db) {
+  iwrc rc = 0;
+  int rci = pthread_rwlock_rdlock(&db->rwl);
+  if (rci) {
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  rc = _jb_rnum_flush_lr(db);
+  API_UNLOCK(db, rci, rc);
+  return rc;
+}
+
+static void *_jb_rnum_flush_thread(void *op) {
+  EJDB db = op;
+  struct timespec deadline;
+  uint32_t timeout = db->opts.rnum_flush_timeout_sec;
+  pthread_mutex_lock(&db->rnum_mtx);
+  while (!db->rnum_stop) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout;
+    pthread_cond_timedwait(&db->rnum_cond, &db->rnum_mtx, &deadline);
+    if (db->rnum_stop) {
+      break;
+    }
+    pthread_mutex_unlock(&db->rnum_mtx);
+    iwrc rc = _jb_rnum_flush(db);
+    if (rc) {
+      iwlog_ecode_error3(rc);
+    }
+    pthread_mutex_lock(&db->rnum_mtx);
+  }
+  pthread_mutex_unlock(&db->rnum_mtx);
+  return 0;
+}
+
+static void _jb_rnum_flush_thread_stop(EJDB db) {
+  if (!db->rnum_thread_started) {
+    return;
+  }
+  pthread_mutex_lock(&db->rnum_mtx);
+  db->rnum_stop = true;
+  pthread_cond_broadcast(&db->rnum_cond);
+  pthread_mutex_unlock(&db->rnum_mtx);
+  pthread_join(db->rnum_thread, 0);
+  db->rnum_thread_started = false;
+}
+
+static iwrc _jb_rnum_clean_mark(EJDB db, bool clean) {
+  uint64_t llv = IW_HTOILL(KEY_NRECS_CLEAN);
+  IWKV_val key = {
+    .data = &llv,
+    .size = sizeof(llv)
+  };
+  if (clean) {
+    uint8_t one = 1;
+    IWKV_val val = {
+      .data = &one,
+      .size = sizeof(one)
+    };
+    return iwkv_put(db->nrecdb, &key, &val, IWKV_SYNC);
+  } else {
+    iwrc rc = iwkv_del(db->nrecdb, &key, IWKV_SYNC);
+    return rc == IWKV_ERROR_NOTFOUND ? 0 : rc;
+  }
+}
+
 static void _jb_idx_release(JBIDX idx) {
   if (idx->idb) {
     iwkv_db_cache_release(idx->idb);
   }
+  jbi_stats_release(idx);
+  jbi_bloom_destroy(&idx->bloom);
+  if (idx->cptrs) {
+    for (int i = 1; i < idx->ncols; ++i) {
+      free(idx->cptrs[i]);
+    }
+    free(idx->cptrs);
+  }
+  free(idx->ctypes);
+  if (idx->filter) {
+    jql_destroy(&idx->filter);
+  }
+  free(idx->filterq);
+  if (idx->iptrs) {
+    for (int i = 0; i < idx->nincl; ++i) {
+      free(idx->iptrs[i]);
+    }
+    free(idx->iptrs);
+  }
+  if (idx->ipaths) {
+    for (char **p = idx->ipaths; *p; ++p) {
+      free(*p);
+    }
+    free(idx->ipaths);
+  }
   free(idx->ptr);
   free(idx);
 }
 
+static iwrc _jb_idx_cols_alloc(JBIDX idx, int ncols) {
+  idx->cptrs = calloc(ncols, sizeof(idx->cptrs[0]));
+  idx->ctypes = calloc(ncols, sizeof(idx->ctypes[0]));
+  if (!idx->cptrs || !idx->ctypes) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  idx->ncols = ncols;
+  return 0;
+}
+
+static iwrc _jb_idx_cols_load(JBIDX idx, void *cl) {
+  int ncols = binn_count(cl);
+  if ((ncols < 1) || (ncols > EJDB_IDX_COLS_MAX)) {
+    return EJDB_ERROR_INVALID_COLLECTION_INDEX_META;
+  }
+  iwrc rc = _jb_idx_cols_alloc(idx, ncols);
+  RCRET(rc);
+  idx->cptrs[0] = idx->ptr;
+  for (int i = 0; i < ncols; ++i) {
+    void *co;
+    char *cptr;
+    if (  !binn_list_get_object(cl, i + 1, &co)
+       || !binn_object_get_str(co, "ptr", &cptr)
+       || !binn_object_get_uint8(co, "type", &idx->ctypes[i])) {
+      return EJDB_ERROR_INVALID_COLLECTION_INDEX_META;
+    }
+    if (i > 0) {
+      rc = jbl_ptr_alloc(cptr, &idx->cptrs[i]);
+      RCRET(rc);
+    }
+  }
+  return 0;
+}
+
+static iwrc _jb_idx_cols_save(JBIDX idx, binn *meta) {
+  iwrc rc = 0;
+  binn *co = 0;
+  IWXSTR *xstr = 0;
+  binn *cl = binn_list();
+  if (!cl) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  xstr = iwxstr_new();
+  if (!xstr) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  for (int i = 0; i < idx->ncols; ++i) {
+    iwxstr_clear(xstr);
+    rc = jbl_ptr_serialize(idx->cptrs[i], xstr);
+    RCGO(rc, finish);
+    co = binn_object();
+    if (!co) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    if (  !binn_object_set_str(co, "ptr", iwxstr_ptr(xstr))
+       || !binn_object_set_uint32(co, "type", idx->ctypes[i])
+       || !binn_list_add_object(cl, co)) {
+      rc = JBL_ERROR_CREATION;
+      goto finish;
+    }
+    binn_free(co);
+    co = 0;
+  }
+  if (!binn_object_set_list(meta, "cols", cl)) {
+    rc = JBL_ERROR_CREATION;
+  }
+
+finish:
+  if (co) {
+    binn_free(co);
+  }
+  if (xstr) {
+    iwxstr_destroy(xstr);
+  }
+  binn_free(cl);
+  return rc;
+}
+
 static void _jb_coll_release(JBCOLL jbc) {
   if (jbc->cdb) {
     iwkv_db_cache_release(jbc->cdb);
@@ -59,6 +320,7 @@ static void _jb_coll_release(JBCOLL jbc) {
   if (jbc->meta) {
     jbl_destroy(&jbc->meta);
   }
+  jbi_bloom_destroy(&jbc->bloom);
   JBIDX nidx;
   for (JBIDX idx = jbc->idx; idx; idx = nidx) {
     nidx = idx->next;
@@ -69,9 +331,145 @@ static void _jb_coll_release(JBCOLL jbc) {
   free(jbc);
 }
 
+static iwrc _jb_idx_incl_init(JBIDX idx, const char *path, const char **include, int ninclude) {
+  iwrc rc = 0;
+  idx->ipaths = calloc(ninclude + 2, sizeof(idx->ipaths[0]));
+  idx->iptrs = calloc(ninclude + 1, sizeof(idx->iptrs[0]));
+  if (!idx->ipaths || !idx->iptrs) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  idx->ipaths[0] = strdup(path);
+  if (!idx->ipaths[0]) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (int i = 0; i < ninclude; ++i) {
+    int j = 0;
+    JBL_PTR ptr;
+    if (!include[i]) {
+      return IW_ERROR_INVALID_ARGS;
+    }
+    rc = jbl_ptr_alloc(include[i], &ptr);
+    RCRET(rc);
+    for ( ; j < idx->nincl && jbl_ptr_cmp(idx->iptrs[j], ptr); ++j) ;
+    if ((j < idx->nincl) || !jbl_ptr_cmp(idx->ptr, ptr)) { // Field is already stored
+      free(ptr);
+      continue;
+    }
+    idx->ipaths[idx->nincl + 1] = strdup(include[i]);
+    if (!idx->ipaths[idx->nincl + 1]) {
+      free(ptr);
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    idx->iptrs[idx->nincl++] = ptr;
+  }
+  return rc;
+}
+
+static iwrc _jb_idx_incl_load(JBIDX idx, const char *path, void *il) {
+  iwrc rc;
+  int ninclude = binn_count(il);
+  const char **include = calloc(ninclude + 1, sizeof(include[0]));
+  if (!include) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (int i = 0; i < ninclude; ++i) {
+    char *ipath;
+    if (!binn_list_get_str(il, i + 1, &ipath)) {
+      rc = EJDB_ERROR_INVALID_COLLECTION_INDEX_META;
+      goto finish;
+    }
+    include[i] = ipath;
+  }
+  rc = _jb_idx_incl_init(idx, path, include, ninclude);
+
+finish:
+  free(include);
+  return rc;
+}
+
+static iwrc _jb_idx_incl_save(JBIDX idx, binn *meta) {
+  iwrc rc = 0;
+  binn *il = binn_list();
+  if (!il) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (int i = 1; i <= idx->nincl; ++i) {
+    if (!binn_list_add_str(il, idx->ipaths[i])) {
+      rc = JBL_ERROR_CREATION;
+      goto finish;
+    }
+  }
+  if (!binn_object_set_list(meta, "include", il)) {
+    rc = JBL_ERROR_CREATION;
+  }
+
+finish:
+  binn_free(il);
+  return rc;
+}
+
+/**
+ * Builds document fragment stored in covering index entry value:
+ * an object consisting of indexed and included fields of `jbl`.
+ */
+iwrc jb_idx_fragment(JBIDX idx, JBL jbl, IWXSTR *xstr, IWPOOL *pool) {
+  void *buf;
+  size_t sz;
+  JBL_NODE root;
+  struct _JBL fjbl = { 0 };
+  iwrc rc = jbl_to_node(jbl, &root, false, pool);
+  RCRET(rc);
+  JBL_NODE frag = iwpool_calloc(sizeof(*frag), pool);
+  if (!frag) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  frag->type = JBV_OBJECT;
+  rc = jbn_copy_paths(root, frag, (const char**) idx->ipaths, false, false, pool);
+  RCRET(rc);
+  rc = _jbl_from_node(&fjbl, frag);
+  RCRET(rc);
+  rc = jbl_as_buf(&fjbl, &buf, &sz);
+  if (!rc) {
+    rc = iwxstr_cat(xstr, buf, sz);
+  }
+  binn_free(&fjbl.bn);
+  return rc;
+}
+
+/**
+ * Builds Bloom filter of unique index keys if filters are enabled by `EJDB_OPTS.bloom_bits`.
+ */
+static iwrc _jb_idx_bloom_init(JBIDX idx) {
+  uint32_t bits = idx->jbc->db->opts.bloom_bits;
+  if (!bits || !(idx->mode & EJDB_IDX_UNIQUE) || idx->ncols) {
+    return 0;
+  }
+  return jbi_bloom_build(idx->idb, idx->rnum, bits, &idx->bloom);
+}
+
+/**
+ * Adds `key` to Bloom filter `*bp` of `db` keys. Filter reached its capacity is rebuilt
+ * from `db` already containing the key, filter is dropped if it cannot be rebuilt.
+ */
+static void _jb_bloom_add(EJDB db, JBBLOOM *bp, IWDB kdb, int64_t nkeys, const void *key, size_t len) {
+  if (!*bp) {
+    return;
+  }
+  if (jbi_bloom_full(*bp)) {
+    iwrc rc = jbi_bloom_build(kdb, nkeys, db->opts.bloom_bits, bp);
+    if (rc) {
+      iwlog_ecode_error3(rc);
+    }
+  } else {
+    jbi_bloom_add(*bp, key, len);
+  }
+}
+
 static iwrc _jb_coll_load_index_lr(JBCOLL jbc, IWKV_val *mval) {
   binn *bn;
-  char *ptr;
+  char *ptr, *filterq;
+  void *cl, *il;
+  BOOL building = FALSE;
   struct _JBL imeta;
   JBIDX idx = calloc(1, sizeof(*idx));
   if (!idx) {
@@ -91,11 +489,44 @@ static iwrc _jb_coll_load_index_lr(JBCOLL jbc, IWKV_val *mval) {
   }
   rc = jbl_ptr_alloc(ptr, &idx->ptr);
   RCGO(rc, finish);
+  if (binn_object_get_list(bn, "cols", &cl)) { // Compound index
+    rc = _jb_idx_cols_load(idx, cl);
+    RCGO(rc, finish);
+  }
+  if (binn_object_get_list(bn, "include", &il)) { // Covering index
+    rc = _jb_idx_incl_load(idx, ptr, il);
+    RCGO(rc, finish);
+  }
+  if (binn_object_get_str(bn, "filter", &filterq)) { // Partial index
+    idx->filterq = strdup(filterq);
+    if (!idx->filterq) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    rc = jql_create(&idx->filter, jbc->name, filterq);
+    RCGO(rc, finish);
+    rc = jbi_idx_filter_init(idx);
+    RCGO(rc, finish);
+  }
 
+  if ((idx->mode & EJDB_IDX_F64) && (idx->idbf & IWDB_REALNUM_KEYS)) {
+    iwlog_warn("Index %s of collection %s keeps F64 values as decimal strings,"
+               " use ejdb_rebuild_index() to convert it to binary keys", ptr, jbc->name);
+  }
   rc = iwkv_db(jbc->db->iwkv, idx->dbid, idx->idbf, &idx->idb);
   RCGO(rc, finish);
   idx->jbc = jbc;
-  idx->rnum = _jb_meta_nrecs_get(jbc->db, idx->dbid);
+  if (binn_object_get_bool(bn, "building", &building) && building) {
+    iwlog_warn("Online build of index %s of collection %s was interrupted, index is removed", ptr, jbc->name);
+    idx->building = true; // Dropped by `_jb_db_meta_load()` once meta is loaded
+  } else {
+    rc = _jb_rnum_load(jbc->db, idx->idb, idx->dbid, &idx->rnum, &idx->rnum_flushed);
+    RCGO(rc, finish);
+    rc = jbi_stats_load(idx);
+    RCGO(rc, finish);
+    rc = _jb_idx_bloom_init(idx);
+    RCGO(rc, finish);
+  }
   idx->next = jbc->idx;
   jbc->idx = idx;
 
@@ -170,7 +601,12 @@ static iwrc _jb_coll_load_meta_lr(JBCOLL jbc) {
   rc = iwkv_db(jbc->db->iwkv, jbc->dbid, IWDB_VNUM64_KEYS, &jbc->cdb);
   RCRET(rc);
 
-  jbc->rnum = _jb_meta_nrecs_get(jbc->db, jbc->dbid);
+  rc = _jb_rnum_load(jbc->db, jbc->cdb, jbc->dbid, &jbc->rnum, &jbc->rnum_flushed);
+  RCRET(rc);
+  if (jbc->db->opts.bloom_bits) {
+    rc = jbi_bloom_build(jbc->cdb, jbc->rnum, jbc->db->opts.bloom_bits, &jbc->bloom);
+    RCRET(rc);
+  }
 
   rc = _jb_coll_load_indexes_lr(jbc);
   RCRET(rc);
@@ -223,6 +659,22 @@ static iwrc _jb_coll_init(JBCOLL jbc, IWKV_val *meta) {
   return rc;
 }
 
+static iwrc _jb_bloom_add_meta(JBBLOOM b, binn *meta) {
+  iwrc rc = 0;
+  binn *bm = binn_object();
+  if (!bm) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  if (  !binn_object_set_int64(bm, "size", jbi_bloom_size(b))
+     || !binn_object_set_int64(bm, "keys", b->nkeys)
+     || !binn_object_set_double(bm, "fpp", jbi_bloom_fpp(b))
+     || !binn_object_set_object(meta, "bloom", bm)) {
+    rc = JBL_ERROR_CREATION;
+  }
+  binn_free(bm);
+  return rc;
+}
+
 static iwrc _jb_idx_add_meta_lr(JBIDX idx, binn *list) {
   iwrc rc = 0;
   IWXSTR *xstr = iwxstr_new();
@@ -245,6 +697,26 @@ static iwrc _jb_idx_add_meta_lr(JBIDX idx, binn *list) {
      || !binn_object_set_int64(meta, "rnum", idx->rnum)) {
     rc = JBL_ERROR_CREATION;
   }
+  if (!rc && idx->ncols) {
+    rc = _jb_idx_cols_save(idx, meta);
+  }
+  if (!rc && idx->ipaths) {
+    rc = _jb_idx_incl_save(idx, meta);
+  }
+  if (idx->building && !binn_object_set_bool(meta, "building", true)) {
+    rc = JBL_ERROR_CREATION;
+  }
+  if (idx->filterq && !binn_object_set_str(meta, "filter", idx->filterq)) {
+    rc = JBL_ERROR_CREATION;
+  }
+  if (  idx->stats
+     && (  !binn_object_set_int64(meta, "ndistinct", idx->stats->ndistinct)
+        || !binn_object_set_double(meta, "nullfrac", idx->stats->null_frac))) {
+    rc = JBL_ERROR_CREATION;
+  }
+  if (!rc && idx->bloom) {
+    rc = _jb_bloom_add_meta(idx->bloom, meta);
+  }
 
   if (!binn_list_add_object(list, meta)) {
     rc = JBL_ERROR_CREATION;
@@ -270,6 +742,10 @@ static iwrc _jb_coll_add_meta_lr(JBCOLL jbc, binn *list) {
     rc = JBL_ERROR_CREATION;
     goto finish;
   }
+  if (jbc->bloom) {
+    rc = _jb_bloom_add_meta(jbc->bloom, meta);
+    RCGO(rc, finish);
+  }
   ilist = binn_list();
   if (!ilist) {
     rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
@@ -306,6 +782,16 @@ static iwrc _jb_db_meta_load(EJDB db) {
     rc = iwkv_db(db->iwkv, NUMRECSDB_ID, IWDB_VNUM64_KEYS, &db->nrecdb);
     RCRET(rc);
   }
+  // Records counters are persisted with clean mark on close
+  uint8_t clean = 0;
+  size_t vsz = 0;
+  uint64_t llv = IW_HTOILL(KEY_NRECS_CLEAN);
+  IWKV_val ckey = {
+    .data = &llv,
+    .size = sizeof(llv)
+  };
+  iwkv_get_copy(db->nrecdb, &ckey, &clean, sizeof(clean), &vsz);
+  db->rnum_stale = !clean;
 
   IWKV_cursor cur;
   rc = iwkv_cursor_open(db->metadb, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
@@ -336,8 +822,36 @@ static iwrc _jb_db_meta_load(EJDB db) {
   if (rc == IWKV_ERROR_NOTFOUND) {
     rc = 0;
   }
+  if (db->rnum_stale && kh_size(db->mcolls)) {
+    iwlog_warn2("Database was not closed properly, numbers of records are recounted");
+  }
+  iwkv_cursor_close(&cur); // Meta of dropped indexes is removed below
+  if (!rc && !(db->oflags & IWKV_RDONLY)) {
+    // Drop indexes of interrupted online builds
+    for (khiter_t k = kh_begin(db->mcolls); !rc && k != kh_end(db->mcolls); ++k) {
+      if (!kh_exist(db->mcolls, k)) {
+        continue;
+      }
+      JBCOLL jbc = kh_val(db->mcolls, k);
+      for (JBIDX idx = jbc->idx, prev = 0, next; !rc && idx; idx = next) {
+        next = idx->next;
+        if (idx->building) {
+          rc = _jb_idx_drop_lw(idx, prev);
+        } else {
+          prev = idx;
+        }
+      }
+    }
+    if (!rc && db->rnum_stale) {
+      rc = _jb_rnum_flush_lr(db);
+    }
+    if (!rc) {
+      rc = _jb_rnum_clean_mark(db, false);
+    }
+  }
 
 finish:
+  db->rnum_stale = false;
   iwkv_cursor_close(&cur);
   return rc;
 }
@@ -351,6 +865,7 @@ static iwrc _jb_db_release(EJDB *dbp) {
     IWRC(jbr_shutdown(&db->jbr), rc);
   }
 #endif
+  _jb_rnum_flush_thread_stop(db);
   if (db->mcolls) {
     for (khiter_t k = kh_begin(db->mcolls); k != kh_end(db->mcolls); ++k) {
       if (!kh_exist(db->mcolls, k)) {
@@ -366,6 +881,10 @@ static iwrc _jb_db_release(EJDB *dbp) {
     IWRC(iwkv_close(&db->iwkv), rc);
   }
   pthread_rwlock_destroy(&db->rwl);
+  pthread_cond_destroy(&db->gc.cond);
+  pthread_mutex_destroy(&db->gc.mtx);
+  pthread_cond_destroy(&db->rnum_cond);
+  pthread_mutex_destroy(&db->rnum_mtx);
 
   EJDB_HTTP *http = &db->opts.http;
   if (http->bind) {
@@ -378,33 +897,100 @@ static iwrc _jb_db_release(EJDB *dbp) {
   return rc;
 }
 
-static iwrc _jb_coll_acquire_keeplock2(EJDB db, const char *coll, jb_coll_acquire_t acm, JBCOLL *jbcp) {
-  if (strlen(coll) > EJDB_COLLECTION_NAME_MAX_LEN) {
-    return EJDB_ERROR_INVALID_COLLECTION_NAME;
-  }
-  int rci;
-  iwrc rc = 0;
-  *jbcp = 0;
+/**
+ * Creates new collection `coll`, database must be write locked.
+ */
+static iwrc _jb_coll_create_lw(EJDB db, const char *coll, JBCOLL *jbcp) {
+  iwrc rc;
   JBCOLL jbc = 0;
-  bool wl = acm & JB_COLL_ACQUIRE_WRITE;
-  API_RLOCK(db, rci);
-  khiter_t k = kh_get(JBCOLLM, db->mcolls, coll);
-  if (k != kh_end(db->mcolls)) {
-    jbc = kh_value(db->mcolls, k);
-    assert(jbc);
-    rci = wl ? pthread_rwlock_wrlock(&jbc->rwl) : pthread_rwlock_rdlock(&jbc->rwl);
-    if (rci) {
-      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
-      goto finish;
-    }
-    *jbcp = jbc;
-  } else {
-    pthread_rwlock_unlock(&db->rwl); // relock
-    if ((db->oflags & IWKV_RDONLY) || (acm & JB_COLL_ACQUIRE_EXISTING)) {
-      return IW_ERROR_NOT_EXISTS;
-    }
-    API_WLOCK(db, rci);
-    k = kh_get(JBCOLLM, db->mcolls, coll);
+  JBL meta = 0;
+  IWDB cdb = 0;
+  uint32_t dbid = 0;
+  char keybuf[JBNUMBUF_SIZE + sizeof(KEY_PREFIX_COLLMETA)];
+  IWKV_val key, val;
+
+  rc = iwkv_new_db(db->iwkv, IWDB_VNUM64_KEYS, &dbid, &cdb);
+  RCGO(rc, finish);
+  jbc = calloc(1, sizeof(*jbc));
+  if (!jbc) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  rc = jbl_create_empty_object(&meta);
+  RCGO(rc, finish);
+  if (!binn_object_set_str(&meta->bn, "name", coll)) {
+    rc = JBL_ERROR_CREATION;
+    goto finish;
+  }
+  if (!binn_object_set_uint32(&meta->bn, "id", dbid)) {
+    rc = JBL_ERROR_CREATION;
+    goto finish;
+  }
+  rc = jbl_as_buf(meta, &val.data, &val.size);
+  RCGO(rc, finish);
+
+  key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_COLLMETA "%u", dbid);
+  if (key.size >= sizeof(keybuf)) {
+    rc = IW_ERROR_OVERFLOW;
+    goto finish;
+  }
+  key.data = keybuf;
+  rc = iwkv_put(db->metadb, &key, &val, IWKV_SYNC);
+  RCGO(rc, finish);
+
+  jbc->db = db;
+  jbc->meta = meta;
+  rc = _jb_coll_init(jbc, 0);
+  if (rc) {
+    iwkv_del(db->metadb, &key, IWKV_SYNC);
+    goto finish;
+  }
+
+finish:
+  if (rc) {
+    if (meta) {
+      jbl_destroy(&meta);
+    }
+    if (cdb) {
+      iwkv_db_destroy(&cdb);
+    }
+    if (jbc) {
+      jbc->meta = 0; // meta was cleared
+      _jb_coll_release(jbc);
+    }
+  } else {
+    *jbcp = jbc;
+  }
+  return rc;
+}
+
+static iwrc _jb_coll_acquire_keeplock2(EJDB db, const char *coll, jb_coll_acquire_t acm, JBCOLL *jbcp) {
+  if (strlen(coll) > EJDB_COLLECTION_NAME_MAX_LEN) {
+    return EJDB_ERROR_INVALID_COLLECTION_NAME;
+  }
+  int rci;
+  iwrc rc = 0;
+  *jbcp = 0;
+  JBCOLL jbc = 0;
+  bool wl = acm & JB_COLL_ACQUIRE_WRITE;
+  API_RLOCK(db, rci);
+  khiter_t k = kh_get(JBCOLLM, db->mcolls, coll);
+  if (k != kh_end(db->mcolls)) {
+    jbc = kh_value(db->mcolls, k);
+    assert(jbc);
+    rci = wl ? pthread_rwlock_wrlock(&jbc->rwl) : pthread_rwlock_rdlock(&jbc->rwl);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      goto finish;
+    }
+    *jbcp = jbc;
+  } else {
+    pthread_rwlock_unlock(&db->rwl); // relock
+    if ((db->oflags & IWKV_RDONLY) || (acm & JB_COLL_ACQUIRE_EXISTING)) {
+      return IW_ERROR_NOT_EXISTS;
+    }
+    API_WLOCK(db, rci);
+    k = kh_get(JBCOLLM, db->mcolls, coll);
     if (k != kh_end(db->mcolls)) {
       jbc = kh_value(db->mcolls, k);
       assert(jbc);
@@ -415,85 +1001,309 @@ static iwrc _jb_coll_acquire_keeplock2(EJDB db, const char *coll, jb_coll_acquir
       }
       *jbcp = jbc;
     } else {
-      JBL meta = 0;
-      IWDB cdb = 0;
-      uint32_t dbid = 0;
-      char keybuf[JBNUMBUF_SIZE + sizeof(KEY_PREFIX_COLLMETA)];
-      IWKV_val key, val;
-
-      rc = iwkv_new_db(db->iwkv, IWDB_VNUM64_KEYS, &dbid, &cdb);
-      RCGO(rc, create_finish);
-      jbc = calloc(1, sizeof(*jbc));
-      if (!jbc) {
-        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
-        goto create_finish;
+      rc = _jb_coll_create_lw(db, coll, &jbc);
+      RCGO(rc, finish);
+      rci = wl ? pthread_rwlock_wrlock(&jbc->rwl) : pthread_rwlock_rdlock(&jbc->rwl); // -V522
+      if (rci) {
+        rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+        goto finish;
       }
-      rc = jbl_create_empty_object(&meta);
-      RCGO(rc, create_finish);
-      if (!binn_object_set_str(&meta->bn, "name", coll)) {
-        rc = JBL_ERROR_CREATION;
-        goto create_finish;
+      *jbcp = jbc;
+    }
+  }
+
+finish:
+  if (rc) {
+    pthread_rwlock_unlock(&db->rwl);
+  }
+  return rc;
+}
+
+IW_INLINE iwrc _jb_coll_acquire_keeplock(EJDB db, const char *coll, bool wl, JBCOLL *jbcp) {
+  return _jb_coll_acquire_keeplock2(db, coll, wl ? JB_COLL_ACQUIRE_WRITE : 0, jbcp);
+}
+
+static iwrc _jb_idx_compound_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev, int64_t *deltap) {
+  uint8_t step;
+  IWKV_val key;
+  bool found, prev_found;
+  char vnbuf[IW_VNUMBUFSZ];
+
+  iwrc rc = 0;
+  int64_t delta = 0; // delta of added/removed index records
+  bool compound = idx->idbf & IWDB_COMPOUND_KEYS;
+  IWXSTR *ckey = iwxstr_new(), *pkey = iwxstr_new();
+
+  if (!ckey || !pkey) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  rc = jbi_jbl_fill_ckey(idx, jbl, ckey, &found);
+  RCGO(rc, finish);
+  rc = jbi_jbl_fill_ckey(idx, jblprev, pkey, &prev_found);
+  RCGO(rc, finish);
+  if (  found && prev_found
+     && (iwxstr_size(ckey) == iwxstr_size(pkey))
+     && !memcmp(iwxstr_ptr(ckey), iwxstr_ptr(pkey), iwxstr_size(ckey))) {
+    goto finish; // Index key is not changed
+  }
+
+  if (prev_found) { // Remove old index element
+    key.data = iwxstr_ptr(pkey);
+    key.size = iwxstr_size(pkey);
+    key.compound = id;
+    rc = iwkv_del(idx->idb, &key, 0);
+    if (!rc) {
+      --delta;
+    } else if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+    }
+    RCGO(rc, finish);
+  }
+
+  if (found) { // Add index record
+    key.data = iwxstr_ptr(ckey);
+    key.size = iwxstr_size(ckey);
+    key.compound = id;
+    if (compound) {
+      rc = iwkv_put(idx->idb, &key, &EMPTY_VAL, IWKV_NO_OVERWRITE);
+      if (!rc) {
+        ++delta;
+      } else if (rc == IWKV_ERROR_KEY_EXISTS) {
+        rc = 0;
       }
-      if (!binn_object_set_uint32(&meta->bn, "id", dbid)) {
-        rc = JBL_ERROR_CREATION;
-        goto create_finish;
+    } else {
+      IW_SETVNUMBUF64(step, vnbuf, id);
+      IWKV_val idval = {
+        .data = vnbuf,
+        .size = step
+      };
+      rc = iwkv_put(idx->idb, &key, &idval, IWKV_NO_OVERWRITE);
+      if (!rc) {
+        ++delta;
+      } else if (rc == IWKV_ERROR_KEY_EXISTS) {
+        rc = EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED;
       }
-      rc = jbl_as_buf(meta, &val.data, &val.size);
-      RCGO(rc, create_finish);
+    }
+  }
 
-      key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_COLLMETA "%u", dbid);
-      if (key.size >= sizeof(keybuf)) {
-        rc = IW_ERROR_OVERFLOW;
-        goto create_finish;
-      }
-      key.data = keybuf;
-      rc = iwkv_put(db->metadb, &key, &val, IWKV_SYNC);
-      RCGO(rc, create_finish);
+finish:
+  if (ckey) {
+    iwxstr_destroy(ckey);
+  }
+  if (pkey) {
+    iwxstr_destroy(pkey);
+  }
+  *deltap += delta;
+  return rc;
+}
 
-      jbc->db = db;
-      jbc->meta = meta;
-      rc = _jb_coll_init(jbc, 0);
-      if (rc) {
-        iwkv_del(db->metadb, &key, IWKV_SYNC);
-        goto create_finish;
+/**
+ * Updates posting lists of full-text index: entries of terms removed from text
+ * are deleted, entries of new terms are added, entries of unchanged terms are kept.
+ */
+static iwrc _jb_idx_text_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev, int64_t *deltap) {
+  IWKV_val key;
+  struct _JBTXT t, pt;
+  int64_t delta = 0; // delta of added/removed index records
+
+  iwrc rc = jbi_text_init(&t);
+  RCRET(rc);
+  rc = jbi_text_init(&pt);
+  if (rc) {
+    jbi_text_destroy(&t);
+    return rc;
+  }
+  rc = jbi_text_add_doc(&t, idx, jbl);
+  RCGO(rc, finish);
+  rc = jbi_text_add_doc(&pt, idx, jblprev);
+  RCGO(rc, finish);
+  jbi_text_distinct(&t);
+  jbi_text_distinct(&pt);
+
+  // Merge sorted terms of new and previous texts
+  for (int i = 0, j = 0; i < t.num || j < pt.num; ) {
+    int cv = (i == t.num) ? 1 : (j == pt.num) ? -1 : strcmp(jbi_text_term(&t, i), jbi_text_term(&pt, j));
+    key.compound = id;
+    if (cv > 0) { // Term is removed
+      key.data = (void*) jbi_text_term(&pt, j++);
+      key.size = strlen(key.data);
+      rc = iwkv_del(idx->idb, &key, 0);
+      if (!rc) {
+        --delta;
+      } else if (rc == IWKV_ERROR_NOTFOUND) {
+        rc = 0;
+      }
+    } else if (cv < 0) { // Term is added
+      key.data = (void*) jbi_text_term(&t, i++);
+      key.size = strlen(key.data);
+      rc = iwkv_put(idx->idb, &key, &EMPTY_VAL, IWKV_NO_OVERWRITE);
+      if (!rc) {
+        ++delta;
+      } else if (rc == IWKV_ERROR_KEY_EXISTS) {
+        rc = 0;
       }
+    } else {
+      ++i;
+      ++j;
+    }
+    RCGO(rc, finish);
+  }
 
-create_finish:
-      if (rc) {
-        if (meta) {
-          jbl_destroy(&meta);
-        }
-        if (cdb) {
-          iwkv_db_destroy(&cdb);
-        }
-        if (jbc) {
-          jbc->meta = 0; // meta was cleared
-          _jb_coll_release(jbc);
-        }
-      } else {
-        rci = wl ? pthread_rwlock_wrlock(&jbc->rwl) : pthread_rwlock_rdlock(&jbc->rwl); // -V522
-        if (rci) {
-          rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+finish:
+  jbi_text_destroy(&t);
+  jbi_text_destroy(&pt);
+  *deltap += delta;
+  return rc;
+}
+
+static int _jb_idx_ikey_cmp(const void *o1, const void *o2) {
+  const IWKV_val *k1 = o1, *k2 = o2;
+  int ret = memcmp(k1->data, k2->data, MIN(k1->size, k2->size));
+  if (!ret) {
+    ret = (k1->size > k2->size) - (k1->size < k2->size);
+  }
+  return ret;
+}
+
+/**
+ * Collects distinct index keys of `arr` elements sorted in `_jb_idx_ikey_cmp()` order.
+ * Key data is allocated in `pool`, array of keys must be released by caller.
+ */
+static iwrc _jb_idx_array_ikeys(JBIDX idx, JBL_NODE arr, IWPOOL *pool, IWKV_val **keysp, int *nump) {
+  iwrc rc = 0;
+  int num = 0, asz = 0;
+  IWKV_val key = { 0 }, *keys = 0;
+  char numbuf[JBNUMBUF_SIZE];
+
+  for (JBL_NODE n = arr->child; n; n = n->next) {
+    jbi_node_fill_ikey(idx, n, &key, numbuf);
+    if (key.size) {
+      if (num >= asz) {
+        int nsz = asz ? asz * 2 : 16;
+        IWKV_val *nkeys = realloc(keys, nsz * sizeof(keys[0]));
+        if (!nkeys) {
+          rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
           goto finish;
         }
-        *jbcp = jbc;
+        keys = nkeys;
+        asz = nsz;
+      }
+      void *data = iwpool_alloc(key.size, pool);
+      if (!data) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        goto finish;
+      }
+      memcpy(data, key.data, key.size);
+      keys[num].data = data;
+      keys[num].size = key.size;
+      keys[num].compound = 0;
+      ++num;
+    }
+    jbi_ikey_dispose(idx, &key, numbuf);
+  }
+  if (num > 1) {
+    int j = 1;
+    qsort(keys, num, sizeof(keys[0]), _jb_idx_ikey_cmp);
+    for (int i = 1; i < num; ++i) {
+      if (_jb_idx_ikey_cmp(&keys[i], &keys[j - 1])) {
+        keys[j++] = keys[i];
       }
     }
+    num = j;
   }
 
 finish:
+  jbi_ikey_dispose(idx, &key, numbuf);
   if (rc) {
-    pthread_rwlock_unlock(&db->rwl);
+    free(keys);
+    keys = 0;
+    num = 0;
   }
+  *keysp = keys;
+  *nump = num;
   return rc;
 }
 
-IW_INLINE iwrc _jb_coll_acquire_keeplock(EJDB db, const char *coll, bool wl, JBCOLL *jbcp) {
-  return _jb_coll_acquire_keeplock2(db, coll, wl ? JB_COLL_ACQUIRE_WRITE : 0, jbcp);
+/**
+ * Updates entries of modified array field: only keys of added and removed elements are touched.
+ */
+static iwrc _jb_idx_array_delta(JBIDX idx, int64_t id, JBL_NODE arr, JBL_NODE parr, IWPOOL *pool, int64_t *delta) {
+  int num, pnum;
+  IWKV_val *keys = 0, *pkeys = 0;
+
+  iwrc rc = _jb_idx_array_ikeys(idx, arr, pool, &keys, &num);
+  RCGO(rc, finish);
+  rc = _jb_idx_array_ikeys(idx, parr, pool, &pkeys, &pnum);
+  RCGO(rc, finish);
+
+  // Merge sorted keys of new and previous arrays
+  for (int i = 0, j = 0; i < num || j < pnum; ) {
+    int cv = (i == num) ? 1 : (j == pnum) ? -1 : _jb_idx_ikey_cmp(&keys[i], &pkeys[j]);
+    if (cv > 0) { // Element is removed
+      IWKV_val *key = &pkeys[j++];
+      key->compound = id;
+      rc = iwkv_del(idx->idb, key, 0);
+      if (!rc) {
+        --*delta;
+      } else if (rc == IWKV_ERROR_NOTFOUND) {
+        rc = 0;
+      }
+    } else if (cv < 0) { // Element is added
+      IWKV_val *key = &keys[i++];
+      key->compound = id;
+      rc = iwkv_put(idx->idb, key, &EMPTY_VAL, IWKV_NO_OVERWRITE);
+      if (!rc) {
+        ++*delta;
+      } else if (rc == IWKV_ERROR_KEY_EXISTS) {
+        rc = 0;
+      }
+    } else {
+      ++i;
+      ++j;
+    }
+    RCGO(rc, finish);
+  }
+
+finish:
+  free(keys);
+  free(pkeys);
+  return rc;
 }
 
-static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
-  IWKV_val key;
+/**
+ * Updates `idx` entries of document `id` changed from `jblprev` to `jbl`.
+ * Number of added/removed index records is added to `deltap` and not persisted.
+ */
+static iwrc _jb_idx_record_put(JBIDX idx, int64_t id, JBL jbl, JBL jblprev, int64_t *deltap) {
+  if (idx->filter) { // Partial index keeps entries of matched documents only
+    iwrc rc;
+    bool matched;
+    if (jbl) {
+      rc = jql_matched(idx->filter, jbl, &matched);
+      RCRET(rc);
+      if (!matched) {
+        jbl = 0;
+      }
+    }
+    if (jblprev) {
+      rc = jql_matched(idx->filter, jblprev, &matched);
+      RCRET(rc);
+      if (!matched) {
+        jblprev = 0;
+      }
+    }
+    if (!jbl && !jblprev) {
+      return 0;
+    }
+  }
+  if (idx->ncols) {
+    return _jb_idx_compound_record_add(idx, id, jbl, jblprev, deltap);
+  }
+  if (idx->mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM)) {
+    return _jb_idx_text_record_add(idx, id, jbl, jblprev, deltap);
+  }
+  IWKV_val key = { 0 };
   uint8_t step;
   char vnbuf[IW_VNUMBUFSZ];
   char numbuf[JBNUMBUF_SIZE];
@@ -504,6 +1314,9 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
 
   iwrc rc = 0;
   IWPOOL *pool = 0;
+  size_t foff = 0;
+  IWXSTR *ival = 0, *pval = 0;
+  IWKV_val fval = { 0 };
   int64_t delta = 0; // delta of added/removed index records
   bool compound = idx->idbf & IWDB_COMPOUND_KEYS;
 
@@ -523,8 +1336,37 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
     jbv_found = false;
   }
 
-  if (  compound
-     && (jbv_type == jbvprev_type)
+  if (idx->ipaths) { // Covering index entries keep fragments of documents
+    pool = iwpool_create(1024);
+    ival = iwxstr_new();
+    pval = iwxstr_new();
+    if (!pool || !ival || !pval) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    if (!compound) { // Unique index entry value: document id followed by fragment
+      IW_SETVNUMBUF64(step, vnbuf, id);
+      rc = iwxstr_cat(ival, vnbuf, step);
+      RCGO(rc, finish);
+      foff = step;
+    }
+    if (jbl) {
+      rc = jb_idx_fragment(idx, jbl, ival, pool);
+      RCGO(rc, finish);
+    }
+    if (jblprev) {
+      rc = jb_idx_fragment(idx, jblprev, pval, pool);
+      RCGO(rc, finish);
+    }
+    if (  jbl && jblprev
+       && (iwxstr_size(pval) + foff == iwxstr_size(ival))
+       && !memcmp(iwxstr_ptr(pval), iwxstr_ptr(ival) + foff, iwxstr_size(pval))) {
+      goto finish; // Neither index key nor stored fields are changed
+    }
+    fval.data = iwxstr_ptr(ival);
+    fval.size = iwxstr_size(ival);
+  } else if (  compound
+            && (jbv_type == jbvprev_type)
      && (jbvprev_type == JBV_ARRAY)) {  // compare next/prev obj arrays
     pool = iwpool_create(1024);
     if (!pool) {
@@ -543,12 +1385,15 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
     if (_jbl_compare_nodes(jbv_node, jbvprev_node, &rc) == 0) {
       goto finish; // Arrays are equal or error
     }
+    // Arrays without stored fragments are updated by delta of their element keys
+    rc = _jb_idx_array_delta(idx, id, jbv_node, jbvprev_node, pool, &delta);
+    goto finish;
   } else if (_jbl_is_eq_atomic_values(&jbv, &jbvprev)) {
     return 0;
   }
 
   if (jbvprev_found) {               // Remove old index elements
-    if (jbvprev_type == JBV_ARRAY) { // TODO: array modification delta?
+    if (jbvprev_type == JBV_ARRAY) {
       JBL_NODE n;
       if (!pool) {
         pool = iwpool_create(1024);
@@ -560,6 +1405,7 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
       rc = jbl_to_node(&jbvprev, &n, false, pool);
       RCGO(rc, finish);
       for (n = n->child; n; n = n->next) {
+        jbi_ikey_dispose(idx, &key, numbuf);
         jbi_node_fill_ikey(idx, n, &key, numbuf);
         if (key.size) {
           key.compound = id;
@@ -573,6 +1419,7 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
         }
       }
     } else {
+      jbi_ikey_dispose(idx, &key, numbuf);
       jbi_jbl_fill_ikey(idx, &jbvprev, &key, numbuf);
       if (key.size) {
         key.compound = id;
@@ -588,7 +1435,7 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
   }
 
   if (jbv_found) {               // Add index record
-    if (jbv_type == JBV_ARRAY) { // TODO: array modification delta?
+    if (jbv_type == JBV_ARRAY) {
       JBL_NODE n;
       if (!pool) {
         pool = iwpool_create(1024);
@@ -600,10 +1447,11 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
       rc = jbl_to_node(&jbv, &n, false, pool);
       RCGO(rc, finish);
       for (n = n->child; n; n = n->next) {
+        jbi_ikey_dispose(idx, &key, numbuf);
         jbi_node_fill_ikey(idx, n, &key, numbuf);
         if (key.size) {
           key.compound = id;
-          rc = iwkv_put(idx->idb, &key, &EMPTY_VAL, IWKV_NO_OVERWRITE);
+          rc = iwkv_put(idx->idb, &key, &fval, IWKV_NO_OVERWRITE);
           if (!rc) {
             ++delta;
           } else if (rc == IWKV_ERROR_KEY_EXISTS) {
@@ -614,11 +1462,12 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
         }
       }
     } else {
+      jbi_ikey_dispose(idx, &key, numbuf);
       jbi_jbl_fill_ikey(idx, &jbv, &key, numbuf);
       if (key.size) {
         if (compound) {
           key.compound = id;
-          rc = iwkv_put(idx->idb, &key, &EMPTY_VAL, IWKV_NO_OVERWRITE);
+          rc = iwkv_put(idx->idb, &key, &fval, IWKV_NO_OVERWRITE);
           if (!rc) {
             ++delta;
           } else if (rc == IWKV_ERROR_KEY_EXISTS) {
@@ -630,9 +1479,10 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
             .data = vnbuf,
             .size = step
           };
-          rc = iwkv_put(idx->idb, &key, &idval, IWKV_NO_OVERWRITE);
+          rc = iwkv_put(idx->idb, &key, ival ? &fval : &idval, IWKV_NO_OVERWRITE);
           if (!rc) {
             ++delta;
+            _jb_bloom_add(idx->jbc->db, &idx->bloom, idx->idb, idx->rnum + delta, key.data, key.size);
           } else if (rc == IWKV_ERROR_KEY_EXISTS) {
             rc = EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED;
             goto finish;
@@ -643,11 +1493,25 @@ static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
   }
 
 finish:
+  jbi_ikey_dispose(idx, &key, numbuf);
   if (pool) {
     iwpool_destroy(pool);
   }
-  if (delta && !_jb_meta_nrecs_update(idx->jbc->db, idx->dbid, delta)) {
-    idx->rnum += delta;
+  if (ival) {
+    iwxstr_destroy(ival);
+  }
+  if (pval) {
+    iwxstr_destroy(pval);
+  }
+  *deltap += delta;
+  return rc;
+}
+
+static iwrc _jb_idx_record_add(JBIDX idx, int64_t id, JBL jbl, JBL jblprev) {
+  int64_t delta = 0;
+  iwrc rc = _jb_idx_record_put(idx, id, jbl, jblprev, &delta);
+  if (delta) {
+    __sync_add_and_fetch(&idx->rnum, delta);
   }
   return rc;
 }
@@ -657,30 +1521,14 @@ IW_INLINE iwrc _jb_idx_record_remove(JBIDX idx, int64_t id, JBL jbl) {
 }
 
 static iwrc _jb_idx_fill(JBIDX idx) {
-  IWKV_cursor cur;
-  IWKV_val key, val;
-  struct _JBL jbs;
-  int64_t llv;
-  JBL jbl = &jbs;
-
-  iwrc rc = iwkv_cursor_open(idx->jbc->cdb, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
-  while (!rc) {
-    rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT);
-    if (rc == IWKV_ERROR_NOTFOUND) {
-      rc = 0;
-      break;
-    }
-    rc = iwkv_cursor_get(cur, &key, &val);
-    RCBREAK(rc);
-    if (!binn_load(val.data, &jbs.bn)) {
-      rc = JBL_ERROR_CREATION;
-      break;
-    }
-    memcpy(&llv, key.data, sizeof(llv));
-    rc = _jb_idx_record_add(idx, llv, jbl, 0);
-    iwkv_kv_dispose(&key, &val);
+  int64_t rnum = 0;
+  iwrc rc = jbi_idx_build(idx, &rnum);
+  if (rnum) { // Index records number is updated once for the whole build
+    __sync_add_and_fetch(&idx->rnum, rnum);
+  }
+  if (!rc) {
+    rc = _jb_idx_bloom_init(idx);
   }
-  IWRC(iwkv_cursor_close(&cur), rc);
   return rc;
 }
 
@@ -712,21 +1560,33 @@ static iwrc _jb_put_handler_after(iwrc rc, struct _JBPHCTX *ctx) {
     }
   }
   if (!prev) {
-    _jb_meta_nrecs_update(jbc->db, jbc->dbid, 1);
-    jbc->rnum += 1;
+    __sync_add_and_fetch(&jbc->rnum, 1);
+    _jb_bloom_add(jbc->db, &jbc->bloom, jbc->cdb, jbc->rnum, &ctx->id, sizeof(ctx->id));
   }
 
 finish:
-  if (oldval->size) {
-    iwkv_val_dispose(oldval);
-  }
-  if (rc && !oldval->size) {
-    // Cleanup on error inserting new record
+  if (rc) {
     IWKV_val key = { .data = &ctx->id, .size = sizeof(ctx->id) };
-    for (JBIDX idx = jbc->idx; idx && idx != fail_idx; idx = idx->next) {
-      IWRC(_jb_idx_record_remove(idx, ctx->id, ctx->jbl), rc);
+    if (prev) { // Restore replaced document
+      for (JBIDX idx = jbc->idx; idx && idx != fail_idx; idx = idx->next) {
+        IWRC(_jb_idx_record_add(idx, ctx->id, prev, ctx->jbl), rc);
+      }
+      if (fail_idx) { // Failed index may have keys of replaced document removed
+        iwrc rc2 = _jb_idx_record_add(fail_idx, ctx->id, prev, 0);
+        if (rc2 && (rc2 != EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED)) {
+          iwlog_ecode_error3(rc2);
+        }
+      }
+      IWRC(iwkv_put(jbc->cdb, &key, oldval, 0), rc);
+    } else { // Cleanup on error inserting new record
+      for (JBIDX idx = jbc->idx; idx && idx != fail_idx; idx = idx->next) {
+        IWRC(_jb_idx_record_remove(idx, ctx->id, ctx->jbl), rc);
+      }
+      IWRC(iwkv_del(jbc->cdb, &key, 0), rc);
     }
-    IWRC(iwkv_del(jbc->cdb, &key, 0), rc);
+  }
+  if (oldval->size) {
+    iwkv_val_dispose(oldval);
   }
   return rc;
 }
@@ -757,8 +1617,14 @@ static iwrc _jb_exec_scan_init(JBEXEC *ctx) {
   }
   iwrc rc = jbi_selection(ctx);
   RCRET(rc);
-  if (ctx->midx.idx) {
-    if (ctx->midx.idx->idbf & IWDB_COMPOUND_KEYS) {
+  if (ctx->mplan) {
+    ctx->scanner = jbi_multi_scanner;
+  } else if (ctx->midx.idx) {
+    if (ctx->midx.idx->ncols) {
+      ctx->scanner = jbi_compound_scanner;
+    } else if (ctx->midx.idx->mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM)) {
+      ctx->scanner = jbi_text_scanner;
+    } else if (ctx->midx.idx->idbf & IWDB_COMPOUND_KEYS) {
       ctx->scanner = jbi_dup_scanner;
     } else {
       ctx->scanner = jbi_uniq_scanner;
@@ -780,7 +1646,9 @@ static void _jb_exec_scan_release(JBEXEC *ctx) {
   if (ctx->proj_joined_nodes_pool) {
     iwpool_destroy(ctx->proj_joined_nodes_pool);
   }
+  free(ctx->mplan);
   free(ctx->jblbuf);
+  free(ctx->cvbuf);
 }
 
 static iwrc _jb_noop_visitor(struct _EJDB_EXEC *ctx, EJDB_DOC doc, int64_t *step) {
@@ -901,9 +1769,24 @@ iwrc ejdb_exec(EJDB_EXEC *ux) {
 
   rc = _jb_exec_scan_init(&ctx);
   RCGO(rc, finish);
-  if (ctx.sorting) {
+  if (ctx.idx_count) {
+    if (ux->log) {
+      iwxstr_cat2(ux->log, " [COLLECTOR] COUNT\n");
+    }
+    rc = ctx.scanner(&ctx, jbi_count_consumer);
+  } else if (ctx.sorting) {
+    // Top-K heap keeps only first `skip + limit` documents so it is used
+    // for visitors known to never step over documents, user visitors may set `step` other than 1
+    if (  ((ux->visitor == _jb_noop_visitor) || (ux->visitor == _jb_exec_list_visitor))
+       && (ux->limit <= JB_SORT_TOPK_MAX) && (ux->skip <= JB_SORT_TOPK_MAX - ux->limit)) {
+      ctx.ssc.topk_max = (uint32_t) (ux->skip + ux->limit);
+    }
     if (ux->log) {
-      iwxstr_cat2(ux->log, " [COLLECTOR] SORTER\n");
+      if (ctx.ssc.topk_max) {
+        iwxstr_printf(ux->log, " [COLLECTOR] SORTER TOPK: %u\n", ctx.ssc.topk_max);
+      } else {
+        iwxstr_cat2(ux->log, " [COLLECTOR] SORTER\n");
+      }
     }
     rc = ctx.scanner(&ctx, jbi_sorter_consumer);
   } else {
@@ -1104,42 +1987,142 @@ void ejdb_list_destroy(EJDB_LIST *listp) {
   }
 }
 
-iwrc ejdb_remove_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode) {
-  if (!db || !coll || !path) {
-    return IW_ERROR_INVALID_ARGS;
+/**
+ * Checks index has exactly one values type, full-text index cannot be unique.
+ */
+static bool _jb_idx_mode_valid(ejdb_idx_mode_t mode) {
+  if ((mode & (EJDB_IDX_NOCASE | EJDB_IDX_HASH)) && !(mode & EJDB_IDX_STR)) {
+    return false;
   }
-  int rci;
-  JBCOLL jbc;
-  IWKV_val key;
-  JBL_PTR ptr = 0;
-  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
+  if ((mode & EJDB_IDX_HASH) && (mode & EJDB_IDX_UNIQUE)) {
+    return false;
+  }
+  switch (mode & (EJDB_IDX_STR | EJDB_IDX_I64 | EJDB_IDX_F64 | EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM)) {
+    case EJDB_IDX_STR:
+    case EJDB_IDX_I64:
+    case EJDB_IDX_F64:
+      return true;
+    case EJDB_IDX_TEXT:
+    case EJDB_IDX_TRIGRAM:
+      return !(mode & EJDB_IDX_UNIQUE);
+    default:
+      return false;
+  }
+}
 
-  iwrc rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
-  RCRET(rc);
+IW_INLINE iwdb_flags_t _jb_idx_dbflags(ejdb_idx_mode_t mode) {
+  iwdb_flags_t idbf = 0;
+  if (mode & EJDB_IDX_I64) {
+    idbf |= IWDB_VNUM64_KEYS;
+  }
+  // F64 keys are binary sortable byte strings, see `jbi_f64_key()`
+  if (!(mode & EJDB_IDX_UNIQUE)) {
+    idbf |= IWDB_COMPOUND_KEYS;
+  }
+  return idbf;
+}
+
+/**
+ * Saves meta of single field index `idx` into metadb.
+ */
+static iwrc _jb_idx_meta_put(JBIDX idx, const char *path) {
+  iwrc rc = 0;
+  IWKV_val key, val;
+  JBCOLL jbc = idx->jbc;
+  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
+  binn *imeta = binn_object();
+  if (!imeta) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  if (  !binn_object_set_str(imeta, "ptr", path)
+     || !binn_object_set_uint32(imeta, "mode", idx->mode)
+     || !binn_object_set_uint32(imeta, "idbf", idx->idbf)
+     || !binn_object_set_uint32(imeta, "dbid", idx->dbid)) {
+    rc = JBL_ERROR_CREATION;
+    goto finish;
+  }
+  if (idx->ipaths) {
+    rc = _jb_idx_incl_save(idx, imeta);
+    RCGO(rc, finish);
+  }
+  if (idx->filterq && !binn_object_set_str(imeta, "filter", idx->filterq)) {
+    rc = JBL_ERROR_CREATION;
+    goto finish;
+  }
+  if (idx->building && !binn_object_set_bool(imeta, "building", true)) {
+    rc = JBL_ERROR_CREATION;
+    goto finish;
+  }
+
+  key.data = keybuf;
+  // Full key format: i.<coldbid>.<idxdbid>
+  key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_IDXMETA "%u" "." "%u", jbc->dbid, idx->dbid);
+  if (key.size >= sizeof(keybuf)) {
+    rc = IW_ERROR_OVERFLOW;
+    goto finish;
+  }
+  val.data = binn_ptr(imeta);
+  val.size = binn_size(imeta);
+  rc = iwkv_put(jbc->db->metadb, &key, &val, 0);
+
+finish:
+  binn_free(imeta);
+  return rc;
+}
+
+/**
+ * Removes index `idx` following `prev` in collection indexes chain
+ * along with its meta, counters and database.
+ */
+static iwrc _jb_idx_drop_lw(JBIDX idx, JBIDX prev) {
+  IWKV_val key;
+  JBCOLL jbc = idx->jbc;
+  EJDB db = jbc->db;
+  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
+
+  key.data = keybuf;
+  key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_IDXMETA "%u" "." "%u", jbc->dbid, idx->dbid);
+  if (key.size >= sizeof(keybuf)) {
+    return IW_ERROR_OVERFLOW;
+  }
+  iwrc rc = iwkv_del(db->metadb, &key, 0);
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  RCRET(rc);
+  _jb_meta_nrecs_removedb(db, idx->dbid);
+  jbi_stats_remove(idx);
+  if (prev) {
+    prev->next = idx->next;
+  } else {
+    jbc->idx = idx->next;
+  }
+  if (idx->idb) {
+    iwkv_db_destroy(&idx->idb);
+  }
+  _jb_idx_release(idx);
+  __sync_add_and_fetch(&db->idx_gen, 1);
+  return 0;
+}
+
+iwrc ejdb_remove_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode) {
+  if (!db || !coll || !path) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  JBCOLL jbc;
+  JBL_PTR ptr = 0;
+
+  iwrc rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
+  RCRET(rc);
 
   rc = jbl_ptr_alloc(path, &ptr);
   RCGO(rc, finish);
 
   for (JBIDX idx = jbc->idx, prev = 0; idx; idx = idx->next) {
-    if (((idx->mode & ~EJDB_IDX_UNIQUE) == (mode & ~EJDB_IDX_UNIQUE)) && !jbl_ptr_cmp(idx->ptr, ptr)) {
-      key.data = keybuf;
-      key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_IDXMETA "%u" "." "%u", jbc->dbid, idx->dbid);
-      if (key.size >= sizeof(keybuf)) {
-        rc = IW_ERROR_OVERFLOW;
-        goto finish;
-      }
-      rc = iwkv_del(db->metadb, &key, 0);
-      RCGO(rc, finish);
-      _jb_meta_nrecs_removedb(db, idx->dbid);
-      if (prev) {
-        prev->next = idx->next;
-      } else {
-        jbc->idx = idx->next;
-      }
-      if (idx->idb) {
-        iwkv_db_destroy(&idx->idb);
-      }
-      _jb_idx_release(idx);
+    if (  !idx->ncols
+       && ((idx->mode & ~EJDB_IDX_UNIQUE) == (mode & ~EJDB_IDX_UNIQUE)) && !jbl_ptr_cmp(idx->ptr, ptr)) {
+      rc = _jb_idx_drop_lw(idx, prev);
       break;
     }
     prev = idx;
@@ -1152,25 +2135,22 @@ finish:
 }
 
 iwrc ejdb_ensure_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode) {
-  if (!db || !coll || !path) {
+  return ejdb_ensure_index2(db, coll, path, mode, 0, 0);
+}
+
+static iwrc _jb_idx_ensure(
+  EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode,
+  const char **include, int ninclude, const char *filter) {
+  if (!db || !coll || !path || (ninclude < 0) || (ninclude && !include)) {
     return IW_ERROR_INVALID_ARGS;
   }
   int rci;
   JBCOLL jbc;
-  IWKV_val key, val;
-  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
-
   JBIDX idx = 0;
   JBL_PTR ptr = 0;
-  binn *imeta = 0;
 
-  switch (mode & (EJDB_IDX_STR | EJDB_IDX_I64 | EJDB_IDX_F64)) {
-    case EJDB_IDX_STR:
-    case EJDB_IDX_I64:
-    case EJDB_IDX_F64:
-      break;
-    default:
-      return EJDB_ERROR_INVALID_INDEX_MODE;
+  if (!_jb_idx_mode_valid(mode) || ((mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM | EJDB_IDX_HASH)) && ninclude)) {
+    return EJDB_ERROR_INVALID_INDEX_MODE;
   }
 
   iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
@@ -1179,10 +2159,17 @@ iwrc ejdb_ensure_index(EJDB db, const char *coll, const char *path, ejdb_idx_mod
   RCGO(rc, finish);
 
   for (idx = jbc->idx; idx; idx = idx->next) {
-    if (((idx->mode & ~EJDB_IDX_UNIQUE) == (mode & ~EJDB_IDX_UNIQUE)) && !jbl_ptr_cmp(idx->ptr, ptr)) {
+    if (  !idx->ncols
+       && ((idx->mode & ~EJDB_IDX_UNIQUE) == (mode & ~EJDB_IDX_UNIQUE)) && !jbl_ptr_cmp(idx->ptr, ptr)) {
       if (idx->mode != mode) {
         rc = EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE;
         idx = 0;
+      } else if (idx->building) {
+        rc = EJDB_ERROR_INDEX_BUILDING;
+        idx = 0;
+      } else if ((!filter != !idx->filterq) || (filter && strcmp(filter, idx->filterq))) {
+        rc = EJDB_ERROR_MISMATCHED_INDEX_FILTER;
+        idx = 0;
       }
       goto finish;
     }
@@ -1197,35 +2184,536 @@ iwrc ejdb_ensure_index(EJDB db, const char *coll, const char *path, ejdb_idx_mod
   idx->jbc = jbc;
   idx->ptr = ptr;
   ptr = 0;
-  idx->idbf = 0;
-  if (mode & EJDB_IDX_I64) {
-    idx->idbf |= IWDB_VNUM64_KEYS;
-  } else if (mode & EJDB_IDX_F64) {
-    idx->idbf |= IWDB_REALNUM_KEYS;
+  if (include) {
+    rc = _jb_idx_incl_init(idx, path, include, ninclude);
+    RCGO(rc, finish);
   }
-  if (!(mode & EJDB_IDX_UNIQUE)) {
-    idx->idbf |= IWDB_COMPOUND_KEYS;
+  if (filter) {
+    rc = jql_create(&idx->filter, coll, filter);
+    RCGO(rc, finish);
+    rc = jbi_idx_filter_init(idx);
+    RCGO(rc, finish);
+    idx->filterq = strdup(filter);
+    if (!idx->filterq) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+  }
+  idx->idbf = _jb_idx_dbflags(mode);
+  rc = iwkv_new_db(db->iwkv, idx->idbf, &idx->dbid, &idx->idb);
+  RCGO(rc, finish);
+
+  rc = _jb_idx_fill(idx);
+  RCGO(rc, finish);
+
+  if (idx->rnum) {
+    rc = jbi_stats_collect(idx);
+    RCGO(rc, finish);
+  }
+
+  rc = _jb_idx_meta_put(idx, path);
+  RCGO(rc, finish);
+
+  idx->next = jbc->idx;
+  jbc->idx = idx;
+  __sync_add_and_fetch(&db->idx_gen, 1);
+
+finish:
+  if (rc) {
+    if (idx) {
+      if (idx->stats) {
+        jbi_stats_remove(idx);
+      }
+      if (idx->idb) {
+        iwkv_db_destroy(&idx->idb);
+        idx->idb = 0;
+      }
+      _jb_idx_release(idx);
+    }
+  }
+  free(ptr);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  return rc;
+}
+
+iwrc ejdb_ensure_index2(
+  EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode,
+  const char **include, int ninclude) {
+  return _jb_idx_ensure(db, coll, path, mode, include, ninclude, 0);
+}
+
+iwrc ejdb_ensure_partial_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode, const char *filter) {
+  if (!filter) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  return _jb_idx_ensure(db, coll, path, mode, 0, 0, filter);
+}
+
+/**
+ * Returns true if unique `idx` entry of `jbl` document is already stored for document `id`.
+ */
+static bool _jb_idx_uniq_owned(JBIDX idx, int64_t id, JBL jbl) {
+  size_t sz;
+  int64_t eid;
+  IWKV_val key;
+  struct _JBL jbv;
+  char numbuf[JBNUMBUF_SIZE];
+  char vnbuf[IW_VNUMBUFSZ];
+
+  if (!_jbl_at(jbl, idx->ptr, &jbv)) {
+    return false;
+  }
+  jbi_jbl_fill_ikey(idx, &jbv, &key, numbuf);
+  bool found = key.size
+               && jbi_bloom_may_contain(idx->bloom, key.data, key.size)
+               && !iwkv_get_copy(idx->idb, &key, vnbuf, sizeof(vnbuf), &sz);
+  jbi_ikey_dispose(idx, &key, numbuf);
+  if (!found) {
+    return false;
+  }
+  IW_READVNUMBUF64_2(vnbuf, eid);
+  return eid == id;
+}
+
+/**
+ * Adds to index being built at most `JB_IDX_ONLINE_CHUNK` documents following `*lid` document id.
+ * Documents are visited in ascending ids order, `done` is set when all documents are indexed.
+ */
+static iwrc _jb_idx_fill_chunk(JBIDX idx, int64_t *lid, bool *done) {
+  IWKV_cursor cur;
+  IWKV_val key, val;
+  struct _JBL jbs;
+  int64_t id = *lid + 1;
+  IWKV_val skey = {
+    .data = &id,
+    .size = sizeof(id)
+  };
+
+  iwrc rc = iwkv_cursor_open(idx->jbc->cdb, &cur, IWKV_CURSOR_GE, &skey);
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    *done = true;
+    return 0;
+  }
+  RCRET(rc);
+  for (int i = 0; i < JB_IDX_ONLINE_CHUNK; ++i) {
+    rc = iwkv_cursor_get(cur, &key, &val);
+    RCBREAK(rc);
+    if (!binn_load(val.data, &jbs.bn)) {
+      iwkv_kv_dispose(&key, &val);
+      rc = JBL_ERROR_CREATION;
+      break;
+    }
+    memcpy(&id, key.data, sizeof(id));
+    rc = _jb_idx_record_add(idx, id, &jbs, 0);
+    if ((rc == EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED) && _jb_idx_uniq_owned(idx, id, &jbs)) {
+      rc = 0; // Document is already indexed by concurrent put
+    }
+    iwkv_kv_dispose(&key, &val);
+    RCBREAK(rc);
+    *lid = id;
+    rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV); // Ascending ids order
+    if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+      *done = true;
+      break;
+    }
+    RCBREAK(rc);
+  }
+  IWRC(iwkv_cursor_close(&cur), rc);
+  return rc;
+}
+
+static JBIDX _jb_idx_find_building(JBCOLL jbc, uint32_t dbid, JBIDX *prevp) {
+  JBIDX prev = 0;
+  for (JBIDX idx = jbc->idx; idx; prev = idx, idx = idx->next) {
+    if (idx->building && (idx->dbid == dbid)) {
+      if (prevp) {
+        *prevp = prev;
+      }
+      return idx;
+    }
+  }
+  return 0;
+}
+
+iwrc ejdb_ensure_index_online(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode) {
+  if (!db || !coll || !path) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  JBCOLL jbc;
+  JBIDX idx = 0, prev = 0;
+  JBL_PTR ptr = 0;
+  uint32_t dbid = 0;
+  int64_t lid = INT64_MIN; // Last indexed document id
+  bool done = false;
+
+  if (!_jb_idx_mode_valid(mode)) {
+    return EJDB_ERROR_INVALID_INDEX_MODE;
+  }
+
+  // Register index in building state, so it is maintained by puts and deletes from now on
+  iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
+  RCRET(rc);
+  rc = jbl_ptr_alloc(path, &ptr);
+  RCGO(rc, finish);
+
+  for (idx = jbc->idx; idx; idx = idx->next) {
+    if (  !idx->ncols
+       && ((idx->mode & ~EJDB_IDX_UNIQUE) == (mode & ~EJDB_IDX_UNIQUE)) && !jbl_ptr_cmp(idx->ptr, ptr)) {
+      if (idx->mode != mode) {
+        rc = EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE;
+      } else if (idx->building) {
+        rc = EJDB_ERROR_INDEX_BUILDING;
+      } else if (idx->filterq) {
+        rc = EJDB_ERROR_MISMATCHED_INDEX_FILTER;
+      }
+      idx = 0;
+      goto finish;
+    }
+  }
+  idx = calloc(1, sizeof(*idx));
+  if (!idx) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  idx->mode = mode;
+  idx->jbc = jbc;
+  idx->ptr = ptr;
+  ptr = 0;
+  idx->idbf = _jb_idx_dbflags(mode);
+  idx->building = true;
+  rc = iwkv_new_db(db->iwkv, idx->idbf, &idx->dbid, &idx->idb);
+  RCGO(rc, finish);
+  // Index interrupted by crash is dropped on database open
+  rc = _jb_idx_meta_put(idx, path);
+  RCGO(rc, finish);
+  idx->next = jbc->idx;
+  jbc->idx = idx;
+  dbid = idx->dbid;
+  idx = 0;
+
+finish:
+  if (rc && idx) {
+    if (idx->idb) {
+      iwkv_db_destroy(&idx->idb);
+      idx->idb = 0;
+    }
+    _jb_idx_release(idx);
+  }
+  free(ptr);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  if (rc || !dbid) {
+    return rc;
+  }
+
+  // Index existing documents by chunks holding collection read lock,
+  // so readers are not blocked and writers wait only for a chunk
+  while (!done) {
+    rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_EXISTING, &jbc);
+    RCRET(rc);
+    idx = _jb_idx_find_building(jbc, dbid, 0);
+    if (!idx) {
+      rc = IW_ERROR_NOT_EXISTS; // Index was removed
+    } else {
+      rc = _jb_idx_fill_chunk(idx, &lid, &done);
+      if (!rc && done && idx->rnum) {
+        rc = jbi_stats_collect(idx);
+      }
+    }
+    API_COLL_UNLOCK(jbc, rci, rc);
+    RCBREAK(rc);
   }
+
+  // Switch index to active state or drop it on failure
+  iwrc rc2 = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
+  if (rc2) {
+    return rc ? rc : rc2;
+  }
+  idx = _jb_idx_find_building(jbc, dbid, &prev);
+  if (idx) {
+    if (!rc) {
+      rc = _jb_idx_bloom_init(idx);
+    }
+    if (!rc) {
+      idx->building = false;
+      rc = _jb_idx_meta_put(idx, path);
+      if (rc) {
+        idx->building = true;
+      }
+    }
+    if (rc) {
+      IWRC(_jb_idx_drop_lw(idx, prev), rc);
+    } else {
+      __sync_add_and_fetch(&db->idx_gen, 1);
+    }
+  }
+  API_COLL_UNLOCK(jbc, rci, rc);
+  return rc;
+}
+
+iwrc ejdb_rebuild_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode) {
+  if (!db || !coll || !path) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  JBCOLL jbc;
+  IWKV_val key;
+  JBIDX idx = 0;
+  JBL_PTR ptr = 0;
+  IWXSTR *xstr = 0;
+  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
+
+  iwrc rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
+  RCRET(rc);
+  rc = jbl_ptr_alloc(path, &ptr);
+  RCGO(rc, finish);
+
+  for (idx = jbc->idx; idx; idx = idx->next) {
+    if (  !idx->ncols && !idx->building
+       && ((idx->mode & ~EJDB_IDX_UNIQUE) == (mode & ~EJDB_IDX_UNIQUE)) && !jbl_ptr_cmp(idx->ptr, ptr)) {
+      break;
+    }
+  }
+  if (!idx) {
+    rc = IW_ERROR_NOT_EXISTS;
+    goto finish;
+  }
+  xstr = iwxstr_new();
+  if (!xstr) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  rc = jbl_ptr_serialize(idx->ptr, xstr);
+  RCGO(rc, finish);
+
+  IWDB odb = idx->idb;
+  uint32_t odbid = idx->dbid;
+  iwdb_flags_t oidbf = idx->idbf;
+  int64_t ornum = idx->rnum;
+  int64_t ornum_flushed = idx->rnum_flushed;
+
+  rc = jbi_stats_remove(idx);
+  RCGO(rc, finish);
+
+  // Fill new index database then switch index to it
+  idx->idbf = _jb_idx_dbflags(idx->mode);
+  idx->rnum = 0;
+  idx->rnum_flushed = 0;
+  rc = iwkv_new_db(db->iwkv, idx->idbf, &idx->dbid, &idx->idb);
+  if (!rc) {
+    rc = _jb_idx_fill(idx);
+    if (!rc) {
+      rc = _jb_idx_meta_put(idx, iwxstr_ptr(xstr));
+    }
+    if (rc) {
+      _jb_meta_nrecs_removedb(db, idx->dbid);
+      iwkv_db_destroy(&idx->idb);
+    }
+  }
+  if (rc) {
+    idx->idb = odb;
+    idx->dbid = odbid;
+    idx->idbf = oidbf;
+    idx->rnum = ornum;
+    idx->rnum_flushed = ornum_flushed;
+    goto finish;
+  }
+
+  key.data = keybuf;
+  key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_IDXMETA "%u" "." "%u", jbc->dbid, odbid);
+  if (key.size >= sizeof(keybuf)) {
+    rc = IW_ERROR_OVERFLOW;
+  } else {
+    IWRC(iwkv_del(db->metadb, &key, 0), rc);
+  }
+  _jb_meta_nrecs_removedb(db, odbid);
+  IWRC(iwkv_db_destroy(&odb), rc);
+  if (idx->rnum) {
+    IWRC(jbi_stats_collect(idx), rc);
+  }
+  __sync_add_and_fetch(&db->idx_gen, 1);
+
+finish:
+  if (xstr) {
+    iwxstr_destroy(xstr);
+  }
+  free(ptr);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  return rc;
+}
+
+static iwrc _jb_idx_cols_parse(
+  const EJDB_IDX_COL *cols, int ncols,
+  JBL_PTR ptrs[static EJDB_IDX_COLS_MAX]) {
+
+  iwrc rc = 0;
+  if (!cols || (ncols < 1) || (ncols > EJDB_IDX_COLS_MAX)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  for (int i = 0; i < ncols; ++i) {
+    switch (cols[i].type) {
+      case EJDB_IDX_STR:
+      case EJDB_IDX_I64:
+      case EJDB_IDX_F64:
+        break;
+      default:
+        return EJDB_ERROR_INVALID_INDEX_MODE;
+    }
+    if (!cols[i].path) {
+      return IW_ERROR_INVALID_ARGS;
+    }
+  }
+  for (int i = 0; i < ncols; ++i) {
+    rc = jbl_ptr_alloc(cols[i].path, &ptrs[i]);
+    RCBREAK(rc);
+  }
+  return rc;
+}
+
+static JBIDX _jb_idx_find_compound(JBCOLL jbc, const EJDB_IDX_COL *cols, int ncols, JBL_PTR *ptrs, JBIDX *prevp) {
+  JBIDX prev = 0;
+  for (JBIDX idx = jbc->idx; idx; prev = idx, idx = idx->next) {
+    if (idx->ncols != ncols) {
+      continue;
+    }
+    int i = 0;
+    for ( ; i < ncols && idx->ctypes[i] == cols[i].type && !jbl_ptr_cmp(idx->cptrs[i], ptrs[i]); ++i) ;
+    if (i == ncols) {
+      if (prevp) {
+        *prevp = prev;
+      }
+      return idx;
+    }
+  }
+  return 0;
+}
+
+iwrc ejdb_remove_compound_index(EJDB db, const char *coll, const EJDB_IDX_COL *cols, int ncols) {
+  if (!db || !coll || !cols) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  JBCOLL jbc;
+  IWKV_val key;
+  JBIDX idx, prev = 0;
+  JBL_PTR ptrs[EJDB_IDX_COLS_MAX] = { 0 };
+  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
+
+  iwrc rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
+  RCRET(rc);
+
+  rc = _jb_idx_cols_parse(cols, ncols, ptrs);
+  RCGO(rc, finish);
+
+  idx = _jb_idx_find_compound(jbc, cols, ncols, ptrs, &prev);
+  if (idx) {
+    key.data = keybuf;
+    key.size = snprintf(keybuf, sizeof(keybuf), KEY_PREFIX_IDXMETA "%u" "." "%u", jbc->dbid, idx->dbid);
+    if (key.size >= sizeof(keybuf)) {
+      rc = IW_ERROR_OVERFLOW;
+      goto finish;
+    }
+    rc = iwkv_del(db->metadb, &key, 0);
+    RCGO(rc, finish);
+    _jb_meta_nrecs_removedb(db, idx->dbid);
+    jbi_stats_remove(idx);
+    if (prev) {
+      prev->next = idx->next;
+    } else {
+      jbc->idx = idx->next;
+    }
+    if (idx->idb) {
+      iwkv_db_destroy(&idx->idb);
+    }
+    _jb_idx_release(idx);
+    __sync_add_and_fetch(&db->idx_gen, 1);
+  }
+
+finish:
+  for (int i = 0; i < EJDB_IDX_COLS_MAX; ++i) {
+    free(ptrs[i]);
+  }
+  API_COLL_UNLOCK(jbc, rci, rc);
+  return rc;
+}
+
+iwrc ejdb_ensure_compound_index(
+  EJDB db, const char *coll, const EJDB_IDX_COL *cols, int ncols,
+  ejdb_idx_mode_t mode) {
+
+  if (!db || !coll || !cols) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (mode & ~EJDB_IDX_UNIQUE) {
+    return EJDB_ERROR_INVALID_INDEX_MODE;
+  }
+  int rci;
+  JBCOLL jbc;
+  IWKV_val key, val;
+  char keybuf[sizeof(KEY_PREFIX_IDXMETA) + 1 + 2 * JBNUMBUF_SIZE]; // Full key format: i.<coldbid>.<idxdbid>
+
+  JBIDX idx = 0;
+  binn *imeta = 0;
+  JBL_PTR ptrs[EJDB_IDX_COLS_MAX] = { 0 };
+
+  iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
+  RCRET(rc);
+  rc = _jb_idx_cols_parse(cols, ncols, ptrs);
+  RCGO(rc, finish);
+
+  idx = _jb_idx_find_compound(jbc, cols, ncols, ptrs, 0);
+  if (idx) {
+    if (idx->mode != mode) {
+      rc = EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE;
+    }
+    idx = 0;
+    goto finish;
+  }
+
+  idx = calloc(1, sizeof(*idx));
+  if (!idx) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  idx->mode = mode;
+  idx->jbc = jbc;
+  rc = _jb_idx_cols_alloc(idx, ncols);
+  RCGO(rc, finish);
+  for (int i = 0; i < ncols; ++i) {
+    idx->cptrs[i] = ptrs[i];
+    idx->ctypes[i] = cols[i].type;
+    ptrs[i] = 0;
+  }
+  idx->ptr = idx->cptrs[0];
+  // Tuple keys are compared as byte strings
+  idx->idbf = (mode & EJDB_IDX_UNIQUE) ? 0 : IWDB_COMPOUND_KEYS;
   rc = iwkv_new_db(db->iwkv, idx->idbf, &idx->dbid, &idx->idb);
   RCGO(rc, finish);
 
   rc = _jb_idx_fill(idx);
   RCGO(rc, finish);
 
+  if (idx->rnum) {
+    rc = jbi_stats_collect(idx);
+    RCGO(rc, finish);
+  }
+
   // save index meta into metadb
   imeta = binn_object();
   if (!imeta) {
     rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
     goto finish;
   }
-
-  if (  !binn_object_set_str(imeta, "ptr", path)
+  if (  !binn_object_set_str(imeta, "ptr", cols[0].path)
      || !binn_object_set_uint32(imeta, "mode", idx->mode)
      || !binn_object_set_uint32(imeta, "idbf", idx->idbf)
      || !binn_object_set_uint32(imeta, "dbid", idx->dbid)) {
     rc = JBL_ERROR_CREATION;
     goto finish;
   }
+  rc = _jb_idx_cols_save(idx, imeta);
+  RCGO(rc, finish);
 
   key.data = keybuf;
   // Full key format: i.<coldbid>.<idxdbid>
@@ -1241,10 +2729,14 @@ iwrc ejdb_ensure_index(EJDB db, const char *coll, const char *path, ejdb_idx_mod
 
   idx->next = jbc->idx;
   jbc->idx = idx;
+  __sync_add_and_fetch(&db->idx_gen, 1);
 
 finish:
   if (rc) {
     if (idx) {
+      if (idx->stats) {
+        jbi_stats_remove(idx);
+      }
       if (idx->idb) {
         iwkv_db_destroy(&idx->idb);
         idx->idb = 0;
@@ -1252,32 +2744,55 @@ finish:
       _jb_idx_release(idx);
     }
   }
-  free(ptr);
+  for (int i = 0; i < EJDB_IDX_COLS_MAX; ++i) {
+    free(ptrs[i]);
+  }
   binn_free(imeta);
   API_COLL_UNLOCK(jbc, rci, rc);
   return rc;
 }
 
-static iwrc _jb_patch(
-  EJDB db, const char *coll, int64_t id, bool upsert,
-  const char *patchjson, JBL_NODE patchjbn, JBL patchjbl) {
-
+iwrc ejdb_analyze(EJDB db, const char *coll) {
+  if (!db || !coll) {
+    return IW_ERROR_INVALID_ARGS;
+  }
   int rci;
   JBCOLL jbc;
+  iwrc rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
+  RCRET(rc);
+  for (JBIDX idx = jbc->idx; idx; idx = idx->next) {
+    if (idx->building) {
+      continue;
+    }
+    rc = jbi_stats_collect(idx);
+    RCBREAK(rc);
+  }
+  __sync_add_and_fetch(&db->idx_gen, 1);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  return rc;
+}
+
+static iwrc _jb_patch_lw(
+  JBCOLL jbc, int64_t id, bool upsert,
+  const char *patchjson, JBL_NODE patchjbn, JBL patchjbl) {
+
+  iwrc rc;
   struct _JBL sjbl;
   JBL_NODE root, patch;
   JBL ujbl = 0;
   IWPOOL *pool = 0;
+  bool inplace = false;
   IWKV_val val = { 0 };
   IWKV_val key = {
     .data = &id,
     .size = sizeof(id)
   };
 
-  iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
-  RCGO(rc, finish);
-
-  rc = iwkv_get(jbc->cdb, &key, &val);
+  if (jbi_bloom_may_contain(jbc->bloom, &id, sizeof(id))) {
+    rc = iwkv_get(jbc->cdb, &key, &val);
+  } else {
+    rc = IWKV_ERROR_NOTFOUND;
+  }
   if (upsert && (rc == IWKV_ERROR_NOTFOUND)) {
     if (patchjson) {
       rc = jbl_from_json(&ujbl, patchjson);
@@ -1311,9 +2826,6 @@ static iwrc _jb_patch(
     goto finish;
   }
 
-  rc = jbl_to_node(&sjbl, &root, false, pool);
-  RCGO(rc, finish);
-
   if (patchjson) {
     rc = jbn_from_json(patchjson, &patch, pool);
   } else if (patchjbl) {
@@ -1325,6 +2837,16 @@ static iwrc _jb_patch(
   }
   RCGO(rc, finish);
 
+  rc = jbl_patch_inplace(&sjbl, patch, &inplace);
+  RCGO(rc, finish);
+  if (inplace) {
+    rc = _jb_put_impl(jbc, &sjbl, id);
+    goto finish;
+  }
+
+  rc = jbl_to_node(&sjbl, &root, false, pool);
+  RCGO(rc, finish);
+
   rc = jbn_patch_auto(root, patch, pool);
   RCGO(rc, finish);
 
@@ -1344,14 +2866,143 @@ static iwrc _jb_patch(
   rc = _jb_put_impl(jbc, ujbl, id);
 
 finish:
-  API_COLL_UNLOCK(jbc, rci, rc);
   if (ujbl != patchjbl) {
     jbl_destroy(&ujbl);
   }
+  if (inplace) {
+    binn_free(&sjbl.bn);
+  }
   if (val.data) {
     iwkv_val_dispose(&val);
   }
-  iwpool_destroy(pool);
+  iwpool_destroy(pool);
+  return rc;
+}
+
+static uint64_t _jb_gc_time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Waits until records written by caller are synced to storage together with records of writers
+ * arrived within group commit window. The first writer of group becomes its leader: it collects writers
+ * until window end, waits for sync of previous group and syncs its group by single `iwkv_sync()`.
+ * Must be called with no database locks held since WAL savepoint write locks database.
+ */
+static iwrc _jb_group_commit(EJDB db) {
+  iwrc rc;
+  uint32_t window = db->opts.wal_group_commit_us;
+  uint32_t max = db->opts.wal_group_commit_max;
+  struct _JBGCOMMIT *gc = &db->gc;
+  if (!window) {
+    return 0;
+  }
+  uint64_t start = _jb_gc_time_us();
+
+  pthread_mutex_lock(&gc->mtx);
+  uint64_t gen = gc->gen;
+  ++gc->nwriters;
+  if (!gc->leader) {
+    struct timespec deadline;
+    gc->leader = true;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += window / 1000000;
+    deadline.tv_nsec += (long) (window % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    while (!max || gc->nwriters < max) {
+      if (pthread_cond_timedwait(&gc->cond, &gc->mtx, &deadline) == ETIMEDOUT) {
+        break;
+      }
+    }
+    while (gc->syncing) {
+      pthread_cond_wait(&gc->cond, &gc->mtx);
+    }
+    // Close group, writers arriving during sync join the next one
+    uint32_t batch = gc->nwriters;
+    gc->nwriters = 0;
+    gc->leader = false;
+    gc->syncing = true;
+    ++gc->gen;
+    pthread_mutex_unlock(&gc->mtx);
+
+    rc = _jb_rnum_flush(db);
+    if (!rc) {
+      rc = iwkv_sync(db->iwkv, 0);
+    }
+
+    pthread_mutex_lock(&gc->mtx);
+    gc->syncing = false;
+    gc->synced = gen;
+    if (rc) {
+      gc->failed = gen;
+      gc->failed_rc = rc;
+    }
+    gc->groups += 1;
+    gc->writes += batch;
+    if (batch > gc->max_batch) {
+      gc->max_batch = batch;
+    }
+    pthread_cond_broadcast(&gc->cond);
+  } else {
+    if (max && (gc->nwriters >= max)) {
+      pthread_cond_broadcast(&gc->cond);
+    }
+    while (gc->synced < gen) {
+      pthread_cond_wait(&gc->cond, &gc->mtx);
+    }
+    // Later groups may be synced before follower wakes up, so failure of any group
+    // since own one is reported: this never reports success of a failed sync
+    rc = gc->failed >= gen ? gc->failed_rc : 0;
+  }
+  uint64_t wait = _jb_gc_time_us() - start;
+  gc->wait_us += wait;
+  if (wait > gc->max_wait_us) {
+    gc->max_wait_us = wait;
+  }
+  pthread_mutex_unlock(&gc->mtx);
+  return rc;
+}
+
+static iwrc _jb_group_commit_add_meta(EJDB db, binn *meta) {
+  iwrc rc = 0;
+  struct _JBGCOMMIT *gc = &db->gc;
+  binn *gm = binn_object();
+  if (!gm) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  pthread_mutex_lock(&gc->mtx);
+  if (  !binn_object_set_int64(gm, "groups", gc->groups)
+     || !binn_object_set_int64(gm, "writes", gc->writes)
+     || !binn_object_set_uint32(gm, "max_batch", gc->max_batch)
+     || !binn_object_set_int64(gm, "wait_us", gc->wait_us)
+     || !binn_object_set_int64(gm, "max_wait_us", gc->max_wait_us)) {
+    rc = JBL_ERROR_CREATION;
+  }
+  pthread_mutex_unlock(&gc->mtx);
+  if (!rc && !binn_object_set_object(meta, "group_commit", gm)) {
+    rc = JBL_ERROR_CREATION;
+  }
+  binn_free(gm);
+  return rc;
+}
+
+static iwrc _jb_patch(
+  EJDB db, const char *coll, int64_t id, bool upsert,
+  const char *patchjson, JBL_NODE patchjbn, JBL patchjbl) {
+  int rci;
+  JBCOLL jbc;
+  iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
+  RCRET(rc);
+  rc = _jb_patch_lw(jbc, id, upsert, patchjson, patchjbn, patchjbl);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  if (!rc) {
+    rc = _jb_group_commit(db);
+  }
   return rc;
 }
 
@@ -1405,6 +3056,9 @@ iwrc ejdb_put(EJDB db, const char *coll, JBL jbl, int64_t id) {
     jbc->id_seq = id;
   }
   API_COLL_UNLOCK(jbc, rci, rc);
+  if (!rc) {
+    rc = _jb_group_commit(db);
+  }
   return rc;
 }
 
@@ -1448,6 +3102,9 @@ iwrc ejdb_put_new(EJDB db, const char *coll, JBL jbl, int64_t *id) {
   rc = _jb_put_new_lw(jbc, jbl, id);
 
   API_COLL_UNLOCK(jbc, rci, rc);
+  if (!rc) {
+    rc = _jb_group_commit(db);
+  }
   return rc;
 }
 
@@ -1460,6 +3117,290 @@ iwrc ejdb_put_new_jbn(EJDB db, const char *coll, JBL_NODE jbn, int64_t *id) {
   return rc;
 }
 
+/** Document of batch put */
+struct _JBBDOC {
+  IWKV_val ikey;          /**< Index key of document ordering index updates */
+  struct _JBPHCTX pctx;   /**< Put context keeping document id and replaced document data */
+  struct _JBL     jblprev;
+  JBL  prev;              /**< Replaced document, zero for new document */
+  bool stored;            /**< Document is stored in collection database */
+};
+
+static int _jb_bdoc_cmp(const void *o1, const void *o2) {
+  const struct _JBBDOC *d1 = *(struct _JBBDOC* const*) o1;
+  const struct _JBBDOC *d2 = *(struct _JBBDOC* const*) o2;
+  if (!d1->ikey.size || !d2->ikey.size) {
+    return (d1->ikey.size > 0) - (d2->ikey.size > 0);
+  }
+  return _jb_idx_ikey_cmp(&d1->ikey, &d2->ikey);
+}
+
+static int _jb_id_cmp(const void *o1, const void *o2) {
+  int64_t v1 = *(const int64_t*) o1, v2 = *(const int64_t*) o2;
+  return (v1 > v2) - (v1 < v2);
+}
+
+/**
+ * Orders batch documents by their keys of single field `idx`
+ * so index database is updated in keys order.
+ */
+static iwrc _jb_bdocs_order(JBIDX idx, struct _JBBDOC **order, int num, IWPOOL *pool) {
+  struct _JBL jbv;
+  IWKV_val key;
+  char numbuf[JBNUMBUF_SIZE];
+  if (idx->ncols || (idx->mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM))) {
+    return 0;
+  }
+  for (int i = 0; i < num; ++i) {
+    struct _JBBDOC *d = order[i];
+    d->ikey.size = 0;
+    if (!_jbl_at(d->pctx.jbl, idx->ptr, &jbv)) {
+      continue;
+    }
+    jbi_jbl_fill_ikey(idx, &jbv, &key, numbuf);
+    if (key.size) {
+      d->ikey.data = iwpool_alloc(key.size, pool);
+      if (!d->ikey.data) {
+        jbi_ikey_dispose(idx, &key, numbuf);
+        return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      }
+      if ((idx->mode & EJDB_IDX_I64) && (key.size == sizeof(int64_t))) {
+        uint64_t llv; // Big endian with flipped sign bit is byte ordered as signed number
+        memcpy(&llv, key.data, sizeof(llv));
+        llv = IW_HTOBE64(llv ^ (UINT64_C(1) << 63));
+        memcpy(d->ikey.data, &llv, sizeof(llv));
+      } else {
+        memcpy(d->ikey.data, key.data, key.size);
+      }
+      d->ikey.size = key.size;
+    }
+    jbi_ikey_dispose(idx, &key, numbuf);
+  }
+  qsort(order, num, sizeof(order[0]), _jb_bdoc_cmp);
+  return 0;
+}
+
+/**
+ * Saves `num` documents of `jbls` under `ids` or under new ids if `ids` is zero.
+ * Documents are stored first, then every index is updated by documents ordered by index key,
+ * records counters are updated once per database.
+ * Batch is reverted if any of documents cannot be stored or indexed.
+ */
+static iwrc _jb_put_batch_lw(JBCOLL jbc, JBL *jbls, const int64_t *ids, int num, int64_t *oids) {
+  iwrc rc = 0;
+  int nidx = 0, nidone = 0, fail_pos = 0;
+  bool fail_put = false;
+  int64_t nnew = 0;
+  IWPOOL *pool = 0;
+  int64_t *deltas = 0, *sids = 0;
+  struct _JBBDOC *docs = 0, **orders = 0;
+
+  for (int i = 0; i < num; ++i) {
+    if (!jbls[i] || (ids && (ids[i] < 1))) {
+      return IW_ERROR_INVALID_ARGS;
+    }
+  }
+  for (JBIDX idx = jbc->idx; idx; idx = idx->next) {
+    ++nidx;
+  }
+  docs = calloc(num, sizeof(*docs));
+  // Every index keeps its own order of updates so they can be reverted
+  orders = malloc((size_t) (nidx + 1) * num * sizeof(*orders));
+  deltas = calloc(nidx + 1, sizeof(*deltas));
+  if (!docs || !orders || !deltas) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  if (ids) { // Every document of batch must have distinct id
+    sids = malloc(num * sizeof(*sids));
+    if (!sids) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    memcpy(sids, ids, num * sizeof(*sids));
+    qsort(sids, num, sizeof(*sids), _jb_id_cmp);
+    for (int i = 1; i < num; ++i) {
+      if (sids[i] == sids[i - 1]) {
+        rc = IW_ERROR_INVALID_ARGS;
+        goto finish;
+      }
+    }
+  }
+
+  for (int i = 0; i < num; ++i) {
+    struct _JBBDOC *d = &docs[i];
+    IWKV_val val, key = {
+      .data = &d->pctx.id,
+      .size = sizeof(d->pctx.id)
+    };
+    d->pctx.id = ids ? ids[i] : jbc->id_seq + 1 + i;
+    d->pctx.jbc = jbc;
+    d->pctx.jbl = jbls[i];
+    orders[i] = d;
+    rc = jbl_as_buf(d->pctx.jbl, &val.data, &val.size);
+    RCGO(rc, finish);
+    rc = iwkv_puth(jbc->cdb, &key, &val, 0, _jb_put_handler, &d->pctx);
+    RCGO(rc, finish);
+    d->stored = true;
+    if (d->pctx.oldval.size) {
+      rc = jbl_from_buf_keep_onstack(&d->jblprev, d->pctx.oldval.data, d->pctx.oldval.size);
+      RCGO(rc, finish);
+      d->prev = &d->jblprev;
+    } else {
+      ++nnew;
+    }
+  }
+
+  for (JBIDX idx = jbc->idx; idx; idx = idx->next, ++nidone) {
+    struct _JBBDOC **order = orders + (size_t) nidone * num;
+    if (nidone) {
+      memcpy(order, order - num, num * sizeof(*order));
+    }
+    fail_pos = 0;
+    pool = iwpool_create(1024);
+    if (!pool) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    rc = _jb_bdocs_order(idx, order, num, pool);
+    RCGO(rc, finish);
+    for ( ; fail_pos < num; ++fail_pos) {
+      struct _JBBDOC *d = order[fail_pos];
+      rc = _jb_idx_record_put(idx, d->pctx.id, d->pctx.jbl, d->prev, &deltas[nidone]);
+      if (rc) {
+        fail_put = true;
+        goto finish;
+      }
+    }
+    iwpool_destroy(pool);
+    pool = 0;
+  }
+
+finish:
+  if (rc && docs) {
+    // Revert index entries to replaced documents. Updates of every index are reverted
+    // in reverse order so keys moved between documents of batch are restored without collisions.
+    iwrc rrc = 0;
+    int k = 0;
+    for (JBIDX idx = jbc->idx; idx && k <= nidone && k < nidx; idx = idx->next, ++k) {
+      struct _JBBDOC **order = orders + (size_t) k * num;
+      int n = k < nidone ? num : fail_pos;
+      if ((k == nidone) && fail_put && order[fail_pos]->prev) {
+        // Failed index may have keys of replaced document removed
+        struct _JBBDOC *d = order[fail_pos];
+        iwrc rc2 = _jb_idx_record_put(idx, d->pctx.id, d->prev, 0, &deltas[k]);
+        if (rc2 && (rc2 != EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED) && !rrc) {
+          rrc = rc2;
+        }
+      }
+      for (int i = n - 1; i >= 0; --i) {
+        struct _JBBDOC *d = order[i];
+        iwrc rc2 = _jb_idx_record_put(idx, d->pctx.id, d->prev, d->pctx.jbl, &deltas[k]);
+        if (rc2 && !rrc) {
+          rrc = rc2;
+        }
+      }
+    }
+    if (rrc) { // Indexes are inconsistent, report revert failure instead of original error
+      iwlog_ecode_error3(rc);
+      rc = rrc;
+    }
+    for (int i = 0; i < num && docs[i].stored; ++i) {
+      struct _JBBDOC *d = &docs[i];
+      IWKV_val key = {
+        .data = &d->pctx.id,
+        .size = sizeof(d->pctx.id)
+      };
+      if (d->pctx.oldval.size) {
+        IWRC(iwkv_put(jbc->cdb, &key, &d->pctx.oldval, 0), rc);
+      } else {
+        IWRC(iwkv_del(jbc->cdb, &key, 0), rc);
+      }
+    }
+  }
+  if (deltas) {
+    int k = 0;
+    for (JBIDX idx = jbc->idx; idx; idx = idx->next, ++k) {
+      if (deltas[k]) {
+        __sync_add_and_fetch(&idx->rnum, deltas[k]);
+      }
+    }
+  }
+  if (!rc) {
+    if (nnew) {
+      __sync_add_and_fetch(&jbc->rnum, nnew);
+    }
+    for (int i = 0; i < num; ++i) {
+      struct _JBBDOC *d = &docs[i];
+      if (!d->prev) {
+        _jb_bloom_add(jbc->db, &jbc->bloom, jbc->cdb, jbc->rnum, &d->pctx.id, sizeof(d->pctx.id));
+      }
+      if (jbc->id_seq < d->pctx.id) {
+        jbc->id_seq = d->pctx.id;
+      }
+      if (oids) {
+        oids[i] = d->pctx.id;
+      }
+    }
+  }
+  if (docs) {
+    for (int i = 0; i < num; ++i) {
+      if (docs[i].pctx.oldval.size) {
+        iwkv_val_dispose(&docs[i].pctx.oldval);
+      }
+    }
+  }
+  if (pool) {
+    iwpool_destroy(pool);
+  }
+  free(docs);
+  free(orders);
+  free(deltas);
+  free(sids);
+  return rc;
+}
+
+iwrc ejdb_put_batch(EJDB db, const char *coll, JBL *jbls, const int64_t *ids, int num) {
+  if (!jbls || !ids || (num < 0)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (!num) {
+    return 0;
+  }
+  int rci;
+  JBCOLL jbc;
+  iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
+  RCRET(rc);
+  rc = _jb_put_batch_lw(jbc, jbls, ids, num, 0);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  if (!rc) {
+    rc = _jb_group_commit(db);
+  }
+  return rc;
+}
+
+iwrc ejdb_put_new_batch(EJDB db, const char *coll, JBL *jbls, int num, int64_t *ids) {
+  if (!jbls || (num < 0)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (ids) {
+    memset(ids, 0, num * sizeof(*ids));
+  }
+  if (!num) {
+    return 0;
+  }
+  int rci;
+  JBCOLL jbc;
+  iwrc rc = _jb_coll_acquire_keeplock(db, coll, true, &jbc);
+  RCRET(rc);
+  rc = _jb_put_batch_lw(jbc, jbls, 0, num, ids);
+  API_COLL_UNLOCK(jbc, rci, rc);
+  if (!rc) {
+    rc = _jb_group_commit(db);
+  }
+  return rc;
+}
+
 iwrc jb_get(EJDB db, const char *coll, int64_t id, jb_coll_acquire_t acm, JBL *jblp) {
   if (!id || !jblp) {
     return IW_ERROR_INVALID_ARGS;
@@ -1473,6 +3414,10 @@ iwrc jb_get(EJDB db, const char *coll, int64_t id, jb_coll_acquire_t acm, JBL *j
   iwrc rc = _jb_coll_acquire_keeplock2(db, coll, acm, &jbc);
   RCRET(rc);
 
+  if (!jbi_bloom_may_contain(jbc->bloom, &id, sizeof(id))) {
+    rc = IWKV_ERROR_NOTFOUND;
+    goto finish;
+  }
   rc = iwkv_get(jbc->cdb, &key, &val);
   RCGO(rc, finish);
   rc = jbl_from_buf_keep(&jbl, val.data, val.size, false);
@@ -1504,6 +3449,10 @@ iwrc ejdb_del(EJDB db, const char *coll, int64_t id) {
   iwrc rc = _jb_coll_acquire_keeplock2(db, coll, JB_COLL_ACQUIRE_WRITE | JB_COLL_ACQUIRE_EXISTING, &jbc);
   RCRET(rc);
 
+  if (!jbi_bloom_may_contain(jbc->bloom, &id, sizeof(id))) {
+    rc = IWKV_ERROR_NOTFOUND;
+    goto finish;
+  }
   rc = iwkv_get(jbc->cdb, &key, &val);
   RCGO(rc, finish);
 
@@ -1515,14 +3464,16 @@ iwrc ejdb_del(EJDB db, const char *coll, int64_t id) {
   }
   rc = iwkv_del(jbc->cdb, &key, 0);
   RCGO(rc, finish);
-  _jb_meta_nrecs_update(jbc->db, jbc->dbid, -1);
-  jbc->rnum -= 1;
+  __sync_sub_and_fetch(&jbc->rnum, 1);
 
 finish:
   if (val.data) {
     iwkv_val_dispose(&val);
   }
   API_COLL_UNLOCK(jbc, rci, rc);
+  if (!rc) {
+    rc = _jb_group_commit(db);
+  }
   return rc;
 }
 
@@ -1534,8 +3485,7 @@ iwrc jb_del(JBCOLL jbc, JBL jbl, int64_t id) {
   }
   rc = iwkv_del(jbc->cdb, &key, 0);
   RCRET(rc);
-  _jb_meta_nrecs_update(jbc->db, jbc->dbid, -1);
-  jbc->rnum -= 1;
+  __sync_sub_and_fetch(&jbc->rnum, 1);
   return rc;
 }
 
@@ -1546,8 +3496,226 @@ iwrc jb_cursor_del(JBCOLL jbc, IWKV_cursor cur, int64_t id, JBL jbl) {
   }
   rc = iwkv_cursor_del(cur, 0);
   RCRET(rc);
-  _jb_meta_nrecs_update(jbc->db, jbc->dbid, -1);
-  jbc->rnum -= 1;
+  __sync_sub_and_fetch(&jbc->rnum, 1);
+  return rc;
+}
+
+iwrc ejdb_txn_begin(EJDB db, EJDB_TXN *txnp) {
+  if (!db || !txnp) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  *txnp = 0;
+  ENSURE_OPEN(db);
+  EJDB_TXN txn = calloc(1, sizeof(*txn));
+  if (!txn) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  txn->pool = iwpool_create(1024);
+  if (!txn->pool) {
+    free(txn);
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  txn->db = db;
+  *txnp = txn;
+  return 0;
+}
+
+static iwrc _jb_txn_op_add(EJDB_TXN txn, jb_txnop_t type, const char *coll, int64_t id, struct _JBTXNOP **opp) {
+  *opp = 0;
+  if (!txn || !coll || (id < 1)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (strlen(coll) > EJDB_COLLECTION_NAME_MAX_LEN) {
+    return EJDB_ERROR_INVALID_COLLECTION_NAME;
+  }
+  struct _JBTXNOP *op = iwpool_calloc(sizeof(*op), txn->pool);
+  if (!op) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  iwrc rc = 0;
+  op->coll = iwpool_strdup(txn->pool, coll, &rc);
+  RCRET(rc);
+  op->type = type;
+  op->id = id;
+  if (txn->last) {
+    txn->last->next = op;
+    op->prev = txn->last;
+  } else {
+    txn->first = op;
+  }
+  txn->last = op;
+  *opp = op;
+  return 0;
+}
+
+iwrc ejdb_txn_put(EJDB_TXN txn, const char *coll, JBL jbl, int64_t id) {
+  struct _JBTXNOP *op;
+  if (!jbl) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  iwrc rc = _jb_txn_op_add(txn, JB_TXNOP_PUT, coll, id, &op);
+  RCRET(rc);
+  return jbl_clone_into_pool(jbl, &op->jbl, txn->pool);
+}
+
+iwrc ejdb_txn_patch(EJDB_TXN txn, const char *coll, const char *patchjson, int64_t id) {
+  struct _JBTXNOP *op;
+  if (!patchjson) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  iwrc rc = _jb_txn_op_add(txn, JB_TXNOP_PATCH, coll, id, &op);
+  RCRET(rc);
+  return jbn_from_json(patchjson, &op->patch, txn->pool);
+}
+
+iwrc ejdb_txn_del(EJDB_TXN txn, const char *coll, int64_t id) {
+  struct _JBTXNOP *op;
+  return _jb_txn_op_add(txn, JB_TXNOP_DEL, coll, id, &op);
+}
+
+void ejdb_txn_abort(EJDB_TXN *txnp) {
+  if (!txnp || !*txnp) {
+    return;
+  }
+  EJDB_TXN txn = *txnp;
+  for (struct _JBTXNOP *op = txn->first; op; op = op->next) {
+    if (op->oldval.size) {
+      iwkv_val_dispose(&op->oldval);
+    }
+  }
+  iwpool_destroy(txn->pool);
+  free(txn);
+  *txnp = 0;
+}
+
+static iwrc _jb_txn_op_apply_lw(EJDB db, struct _JBTXNOP *op) {
+  iwrc rc = 0;
+  struct _JBL jbl;
+  IWKV_val key = {
+    .data = &op->id,
+    .size = sizeof(op->id)
+  };
+  khiter_t k = kh_get(JBCOLLM, db->mcolls, op->coll);
+  if (k != kh_end(db->mcolls)) {
+    op->jbc = kh_value(db->mcolls, k);
+  } else if (op->type == JB_TXNOP_PUT) {
+    rc = _jb_coll_create_lw(db, op->coll, &op->jbc);
+    RCRET(rc);
+  } else {
+    return op->type == JB_TXNOP_DEL ? IW_ERROR_NOT_EXISTS : IWKV_ERROR_NOTFOUND;
+  }
+  JBCOLL jbc = op->jbc;
+
+  if (jbi_bloom_may_contain(jbc->bloom, &op->id, sizeof(op->id))) {
+    rc = iwkv_get(jbc->cdb, &key, &op->oldval);
+    if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+    }
+    RCRET(rc);
+  }
+  switch (op->type) {
+    case JB_TXNOP_PUT:
+      rc = _jb_put_impl(jbc, op->jbl, op->id);
+      if (!rc && (jbc->id_seq < op->id)) {
+        jbc->id_seq = op->id;
+      }
+      break;
+    case JB_TXNOP_PATCH:
+      if (!op->oldval.size) {
+        return IWKV_ERROR_NOTFOUND;
+      }
+      rc = _jb_patch_lw(jbc, op->id, false, 0, op->patch, 0);
+      break;
+    case JB_TXNOP_DEL:
+      if (!op->oldval.size) {
+        return IWKV_ERROR_NOTFOUND;
+      }
+      rc = jbl_from_buf_keep_onstack(&jbl, op->oldval.data, op->oldval.size);
+      RCRET(rc);
+      rc = jb_del(jbc, &jbl, op->id);
+      break;
+  }
+  op->applied = !rc;
+  return rc;
+}
+
+/**
+ * Restores document stored before operation was applied.
+ */
+static iwrc _jb_txn_op_revert_lw(struct _JBTXNOP *op) {
+  iwrc rc;
+  struct _JBL jbl;
+  IWKV_val val = { 0 };
+  IWKV_val key = {
+    .data = &op->id,
+    .size = sizeof(op->id)
+  };
+  if (op->oldval.size) {
+    rc = jbl_from_buf_keep_onstack(&jbl, op->oldval.data, op->oldval.size);
+    RCRET(rc);
+    return _jb_put_impl(op->jbc, &jbl, op->id);
+  }
+  rc = iwkv_get(op->jbc->cdb, &key, &val);
+  RCRET(rc);
+  rc = jbl_from_buf_keep_onstack(&jbl, val.data, val.size);
+  if (!rc) {
+    rc = jb_del(op->jbc, &jbl, op->id);
+  }
+  iwkv_val_dispose(&val);
+  return rc;
+}
+
+iwrc ejdb_txn_commit(EJDB_TXN *txnp) {
+  if (!txnp || !*txnp) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  iwrc rc = 0;
+  EJDB_TXN txn = *txnp;
+  EJDB db = txn->db;
+  if (!txn->first) {
+    ejdb_txn_abort(txnp);
+    return 0;
+  }
+  if (db->oflags & IWKV_RDONLY) {
+    ejdb_txn_abort(txnp);
+    return IW_ERROR_READONLY;
+  }
+  // Exclusive lock keeps concurrent writers and WAL savepoints out of transaction
+  rci = pthread_rwlock_wrlock(&db->rwl);
+  if (rci) {
+    ejdb_txn_abort(txnp);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  if (!db->open) {
+    rc = IW_ERROR_INVALID_STATE;
+    goto finish;
+  }
+  for (struct _JBTXNOP *op = txn->first; op; op = op->next) {
+    rc = _jb_txn_op_apply_lw(db, op);
+    RCBREAK(rc);
+  }
+  if (rc) {
+    for (struct _JBTXNOP *op = txn->last; op; op = op->prev) {
+      if (op->applied) {
+        IWRC(_jb_txn_op_revert_lw(op), rc);
+      }
+    }
+  }
+
+finish:
+  API_UNLOCK(db, rci, rc);
+  if (!rc) {
+    if (db->opts.wal_group_commit_us) {
+      rc = _jb_group_commit(db);
+    } else {
+      rc = _jb_rnum_flush(db);
+      if (!rc) {
+        rc = iwkv_sync(db->iwkv, 0);
+      }
+    }
+  }
+  ejdb_txn_abort(txnp);
   return rc;
 }
 
@@ -1588,6 +3756,7 @@ iwrc ejdb_remove_collection(EJDB db, const char *coll) {
       rc = iwkv_del(jbc->db->metadb, &key, 0);
       RCGO(rc, finish);
       _jb_meta_nrecs_removedb(db, idx->dbid);
+      jbi_stats_remove(idx);
     }
     for (JBIDX idx = jbc->idx, nidx; idx; idx = nidx) {
       IWRC(iwkv_db_destroy(&idx->idb), rc);
@@ -1599,6 +3768,7 @@ iwrc ejdb_remove_collection(EJDB db, const char *coll) {
     IWRC(iwkv_db_destroy(&jbc->cdb), rc);
     kh_del(JBCOLLM, db->mcolls, k);
     _jb_coll_release(jbc);
+    __sync_add_and_fetch(&db->idx_gen, 1);
   }
 
 finish:
@@ -1694,6 +3864,7 @@ iwrc ejdb_rename_collection(EJDB db, const char *coll, const char *new_coll) {
   }
 
   jbc->name = new_name;
+  __sync_add_and_fetch(&db->idx_gen, 1);
   jbl_destroy(&jbc->meta);
   jbc->meta = nmeta;
 
@@ -1749,6 +3920,9 @@ iwrc ejdb_get_meta(EJDB db, JBL *jblp) {
   }
   binn_free(clist);
   clist = 0;
+  if (db->opts.wal_group_commit_us) {
+    rc = _jb_group_commit_add_meta(db, &jbl->bn);
+  }
 
 finish:
   API_UNLOCK(db, rci, rc);
@@ -1765,6 +3939,8 @@ finish:
 
 iwrc ejdb_online_backup(EJDB db, uint64_t *ts, const char *target_file) {
   ENSURE_OPEN(db);
+  iwrc rc = _jb_rnum_flush(db);
+  RCRET(rc);
   return iwkv_online_backup(db->iwkv, ts, target_file);
 }
 
@@ -1803,6 +3979,9 @@ iwrc ejdb_open(const EJDB_OPTS *_opts, EJDB *ejdbp) {
   if (db->opts.document_buffer_sz < 16 * 1024) { // Min 16Kb
     db->opts.document_buffer_sz = 16 * 1024;
   }
+  if (!db->opts.rnum_flush_timeout_sec) {
+    db->opts.rnum_flush_timeout_sec = JB_RNUM_FLUSH_TIMEOUT_SEC;
+  }
   EJDB_HTTP *http = &db->opts.http;
   if (http->bind) {
     http->bind = strdup(http->bind);
@@ -1826,6 +4005,11 @@ iwrc ejdb_open(const EJDB_OPTS *_opts, EJDB *ejdbp) {
     free(db);
     return rc;
   }
+  pthread_mutex_init(&db->gc.mtx, 0);
+  pthread_cond_init(&db->gc.cond, 0);
+  db->gc.gen = 1;
+  pthread_mutex_init(&db->rnum_mtx, 0);
+  pthread_cond_init(&db->rnum_cond, 0);
   db->mcolls = kh_init(JBCOLLM);
   if (!db->mcolls) {
     rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
@@ -1845,6 +4029,15 @@ iwrc ejdb_open(const EJDB_OPTS *_opts, EJDB *ejdbp) {
   rc = _jb_db_meta_load(db);
   RCGO(rc, finish);
 
+  if (!(db->oflags & IWKV_RDONLY)) {
+    rci = pthread_create(&db->rnum_thread, 0, _jb_rnum_flush_thread, db);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      goto finish;
+    }
+    db->rnum_thread_started = true;
+  }
+
   if (db->opts.http.enabled) {
     // Maximum WS/HTTP API body size. Default: 64Mb, Min: 512K
     if (!db->opts.http.max_body_size) {
@@ -1885,7 +4078,29 @@ iwrc ejdb_close(EJDB *ejdbp) {
     iwlog_error2("Database is closed already");
     return IW_ERROR_INVALID_STATE;
   }
-  iwrc rc = _jb_db_release(ejdbp);
+  int rci;
+  iwrc rc = 0;
+#ifdef JB_HTTP
+  if (db->jbr) { // HTTP endpoint writes into database, stop it before counters are persisted
+    IWRC(jbr_shutdown(&db->jbr), rc);
+  }
+#endif
+  _jb_rnum_flush_thread_stop(db);
+  if (!(db->oflags & IWKV_RDONLY)) {
+    // Exclusive lock waits for writers started before database was marked as closed
+    rci = pthread_rwlock_wrlock(&db->rwl);
+    if (rci) {
+      IWRC(iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci), rc);
+    } else {
+      iwrc rc2 = _jb_rnum_flush_lr(db);
+      if (!rc2) {
+        rc2 = _jb_rnum_clean_mark(db, true);
+      }
+      IWRC(rc2, rc);
+      API_UNLOCK(db, rci, rc);
+    }
+  }
+  IWRC(_jb_db_release(ejdbp), rc);
   return rc;
 }
 
@@ -1932,6 +4147,14 @@ static const char *_ejdb_ecodefn(locale_t locale, uint32_t ecode) {
       return "Target collection exists (EJDB_ERROR_TARGET_COLLECTION_EXISTS)";
     case EJDB_ERROR_PATCH_JSON_NOT_OBJECT:
       return "Patch JSON must be an object (map) (EJDB_ERROR_PATCH_JSON_NOT_OBJECT)";
+    case EJDB_ERROR_INVALID_INDEX_FILTER:
+      return "Partial index filter is not a conjunction of field conditions (EJDB_ERROR_INVALID_INDEX_FILTER)";
+    case EJDB_ERROR_MISMATCHED_INDEX_FILTER:
+      return "Index exists but mismatched partial index filter (EJDB_ERROR_MISMATCHED_INDEX_FILTER)";
+    case EJDB_ERROR_SORT_STEP_BACKWARD:
+      return "Visitor stepped backward over documents sorted in temp files (EJDB_ERROR_SORT_STEP_BACKWARD)";
+    case EJDB_ERROR_INDEX_BUILDING:
+      return "Index is being built online and is not ready yet (EJDB_ERROR_INDEX_BUILDING)";
   }
   return 0;
 }
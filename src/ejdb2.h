@@ -57,6 +57,10 @@ typedef enum {
   EJDB_ERROR_COLLECTION_NOT_FOUND,                /**< Collection not found */
   EJDB_ERROR_TARGET_COLLECTION_EXISTS,            /**< Target collection exists */
   EJDB_ERROR_PATCH_JSON_NOT_OBJECT,               /**< Patch JSON must be an object (map) */
+  EJDB_ERROR_INVALID_INDEX_FILTER,                /**< Partial index filter is not a conjunction of field conditions */
+  EJDB_ERROR_MISMATCHED_INDEX_FILTER,             /**< Index exists but mismatched partial index filter */
+  EJDB_ERROR_SORT_STEP_BACKWARD,                  /**< Visitor stepped backward over documents sorted in temp files */
+  EJDB_ERROR_INDEX_BUILDING,                      /**< Index is being built online and is not ready yet */
   _EJDB_ERROR_END,
 } ejdb_ecode_t;
 
@@ -66,6 +70,15 @@ typedef uint8_t ejdb_idx_mode_t;
 /** Marks index is unique, no duplicated values allowed. */
 #define EJDB_IDX_UNIQUE ((ejdb_idx_mode_t) 0x01U)
 
+/** Trigram index of string values or of string elements of arrays.
+ *  Every three byte substring of value is indexed.
+ *  Index is used by JQL `re` operator if regular expression has literal runs
+ *  of at least three characters and no top level alternatives: `/[message re "disk .*failure"]`.
+ *  @note Cannot be unique since the same trigram occurs in many values. Cannot have included
+ *        fields since index only preselects documents which are always matched by the regular expression.
+ */
+#define EJDB_IDX_TRIGRAM ((ejdb_idx_mode_t) 0x02U)
+
 /** Index values have string type.
  *  Type conversion will be performed on atempt to save value with other type */
 #define EJDB_IDX_STR ((ejdb_idx_mode_t) 0x04U)
@@ -75,17 +88,61 @@ typedef uint8_t ejdb_idx_mode_t;
 #define EJDB_IDX_I64 ((ejdb_idx_mode_t) 0x08U)
 
 /** Index value have floating point type.
- *  @note Internally floating point numbers are converted to string
- *        with precision of 6 digits after decimal point.
+ *  @note Floating point numbers are stored as 8 byte binary keys ordered as numbers,
+ *        so no precision is lost. Indexes created by older versions keep values as decimal
+ *        strings with precision of 6 digits after decimal point until `ejdb_rebuild_index()` is called.
  */
 #define EJDB_IDX_F64 ((ejdb_idx_mode_t) 0x10U)
 
+/** Full-text index of words contained in string values or in string elements of arrays.
+ *  Text is split into words of letters and digits, normalized to NFKC form and case folded.
+ *  Index is used by JQL `text` operator: `/[description text "quick fox"]`.
+ *  @note Cannot be unique since index keys are words shared by documents rather than field values.
+ *        Cannot have included fields since a document has an entry for every its word.
+ */
+#define EJDB_IDX_TEXT ((ejdb_idx_mode_t) 0x20U)
+
+/** Case insensitive string index, can be combined with `EJDB_IDX_STR` only.
+ *  Index keys are strings normalized to NFKC form and case folded.
+ *  Index is used by case insensitive JQL operators `ieq`, `iin` and `i~`
+ *  but not by their case sensitive counterparts.
+ */
+#define EJDB_IDX_NOCASE ((ejdb_idx_mode_t) 0x40U)
+
+/** Hash index, can be combined with `EJDB_IDX_STR` (and `EJDB_IDX_NOCASE`) only.
+ *  Index keys are 64 bit hashes of string values, so index is compact for long values
+ *  and is used only by `=`, `eq` and `in` operators (`ieq`, `iin` for `EJDB_IDX_NOCASE`).
+ *  Documents fetched by hash index are always verified by query filter.
+ *  @note Cannot be unique since distinct values may have the same hash. Cannot have
+ *        included fields since fetched documents must be verified against original values anyway.
+ */
+#define EJDB_IDX_HASH ((ejdb_idx_mode_t) 0x80U)
+
+/**
+ * @brief Column of compound index.
+ * @see ejdb_ensure_compound_index()
+ */
+typedef struct _EJDB_IDX_COL {
+  const char     *path;       /**< rfc6901 JSON pointer to indexed field */
+  ejdb_idx_mode_t type;       /**< Column values type: `EJDB_IDX_STR`, `EJDB_IDX_I64` or `EJDB_IDX_F64` */
+} EJDB_IDX_COL;
+
+/** Max number of columns in compound index */
+#define EJDB_IDX_COLS_MAX 8
+
 /**
  * @brief Database handler.
  */
 struct _EJDB;
 typedef struct _EJDB*EJDB;
 
+/**
+ * @brief Write transaction handler.
+ * @see ejdb_txn_begin()
+ */
+struct _EJDB_TXN;
+typedef struct _EJDB_TXN*EJDB_TXN;
+
 /**
  * @brief EJDB HTTP/Websocket Server options.
  */
@@ -109,12 +166,38 @@ typedef struct _EJDB_OPTS {
   IWKV_OPTS kv;                 /**< IWKV storage options. @see iwkv.h */
   EJDB_HTTP http;               /**< HTTP/Websocket server options */
   bool      no_wal;             /**< Do not use write-ahead-log. Default: false */
-  uint32_t  sort_buffer_sz;     /**< Max sorting buffer size. If exceeded an overflow temp file for sorted data will
-                                   created.
+  uint32_t  sort_buffer_sz;     /**< Max sorting buffer size. If exceeded sorted data is split into runs
+                                   stored in temp files and merged. Also used as a size of documents batch
+                                   sorted into a run when index is built over existing collection.
                                      Default 16Mb, min: 1Mb */
   uint32_t document_buffer_sz;  /**< Initial size of buffer in bytes used to process/store document during query
                                    execution.
                                      Default 64Kb, min: 16Kb */
+  uint32_t full_scan_threads;   /**< Max number of threads used to scan large collections
+                                   when query cannot be served by index. Documents are matched by worker threads
+                                   in parallel, query results are passed to visitor in the scan order.
+                                     Default: 0 (parallel scan is disabled) */
+  uint32_t sort_threads;        /**< Max number of threads sorting runs of external merge sort
+                                   used when sorted query results exceed `sort_buffer_sz`
+                                   or when index entries are extracted and sorted by `ejdb_ensure_index()`.
+                                     Default: 0 (runs are sorted by query thread) */
+  uint32_t bloom_bits;          /**< Number of bits per key of in-memory Bloom filters of documents ids and
+                                   `EJDB_IDX_UNIQUE` index keys. Filters are built when collection is loaded,
+                                   lookups of absent ids and unique keys skip storage access.
+                                     Default: 0 (filters are disabled), max: 32 */
+  uint32_t wal_group_commit_us; /**< Group commit window in microseconds. If set, documents write calls return
+                                   once written records are synced to storage by `iwkv_sync()`
+                                   (savepoint of write-ahead-log). Writers arrived within window are synced
+                                   together by single sync. Group commit counters are reported by `ejdb_get_meta()`.
+                                     Default: 0 (writes are not synced individually) */
+  uint32_t wal_group_commit_max; /**< Max number of writes in group, group is synced without waiting
+                                    window end once reached.
+                                      Default: 0 (unlimited) */
+  uint32_t rnum_flush_timeout_sec; /**< Max time in seconds numbers of records of collections and indexes
+                                      counted in memory are kept unpersisted. Counters are also persisted
+                                      by write synced to storage and on database close, if database was not
+                                      closed properly records are recounted when it is opened.
+                                        Default: 10 */
 } EJDB_OPTS;
 
 /**
@@ -164,6 +247,8 @@ struct _EJDB_EXEC;
  * @param doc Data in `doc` is valid only during execution of this method, to keep a data for farther
  *        processing you need to copy it.
  * @param step [out] Move forward cursor to given number of steps, `1` by default.
+ *        Sorted result set exceeded `sort_buffer_sz` can't be stepped backward,
+ *        `EJDB_ERROR_SORT_STEP_BACKWARD` is returned in this case.
  */
 typedef iwrc (*EJDB_EXEC_VISITOR)(struct _EJDB_EXEC *ctx, EJDB_DOC doc, int64_t *step);
 
@@ -493,6 +578,39 @@ IW_EXPORT WUR iwrc ejdb_put_new(EJDB db, const char *coll, JBL jbl, int64_t *oid
  */
 IW_EXPORT iwrc ejdb_put_new_jbn(EJDB db, const char *coll, JBL_NODE jbn, int64_t *id);
 
+/**
+ * @brief Save `num` documents into `coll` under new identifiers.
+ *
+ * Collection is locked once for the whole batch, every index is updated
+ * by documents ordered by index key and records counters are updated once.
+ * Either all documents are saved or none of them.
+ *
+ * @param db          Database handle. Not zero.
+ * @param coll        Collection name. Not zero.
+ * @param jbls        Array of `num` JSON documents. Not zero.
+ * @param num         Number of documents.
+ * @param [out] ids   Optional array of `num` placeholders for new documents ids.
+ *
+ * @return `0` on success.
+ *          Any non zero error codes.
+ */
+IW_EXPORT WUR iwrc ejdb_put_new_batch(EJDB db, const char *coll, JBL *jbls, int num, int64_t *ids);
+
+/**
+ * @brief Save `num` documents into `coll` under specified identifiers.
+ * @see ejdb_put_new_batch()
+ *
+ * @param db          Database handle. Not zero.
+ * @param coll        Collection name. Not zero.
+ * @param jbls        Array of `num` JSON documents. Not zero.
+ * @param ids         Array of `num` distinct documents identifiers. Not zero.
+ * @param num         Number of documents.
+ *
+ * @return `0` on success.
+ *          Any non zero error codes.
+ */
+IW_EXPORT WUR iwrc ejdb_put_batch(EJDB db, const char *coll, JBL *jbls, const int64_t *ids, int num);
+
 /**
  * @brief Retrieve document identified by given `id` from collection `coll`.
  *
@@ -522,6 +640,72 @@ IW_EXPORT WUR iwrc ejdb_get(EJDB db, const char *coll, int64_t id, JBL *jblp);
  */
 IW_EXPORT iwrc ejdb_del(EJDB db, const char *coll, int64_t id);
 
+/**
+ * @brief Start write transaction grouping puts, patches and removals of documents
+ *        of any collections applied atomically by `ejdb_txn_commit()`.
+ *
+ * Operations are buffered by transaction and not visible until commit.
+ * Transaction handle must be released by `ejdb_txn_commit()` or `ejdb_txn_abort()`.
+ *
+ * @param db          Database handle. Not zero.
+ * @param [out] txnp  Placeholder for transaction handle. Not zero.
+ */
+IW_EXPORT WUR iwrc ejdb_txn_begin(EJDB db, EJDB_TXN *txnp);
+
+/**
+ * @brief Add to transaction saving of `jbl` document under specified `id`.
+ * @note Document is copied by transaction.
+ *
+ * @param txn       Transaction handle. Not zero.
+ * @param coll      Collection name. Not zero.
+ * @param jbl       JSON document. Not zero.
+ * @param id        Document identifier. Not zero.
+ */
+IW_EXPORT WUR iwrc ejdb_txn_put(EJDB_TXN txn, const char *coll, JBL jbl, int64_t id);
+
+/**
+ * @brief Add to transaction applying of JSON patch to document identified by `id`.
+ * @see ejdb_patch()
+ *
+ * @param txn         Transaction handle. Not zero.
+ * @param coll        Collection name. Not zero.
+ * @param patchjson   JSON patch conformed to rfc6902 or rfc7386 specification. Not zero.
+ * @param id          Document id. Not zero.
+ */
+IW_EXPORT WUR iwrc ejdb_txn_patch(EJDB_TXN txn, const char *coll, const char *patchjson, int64_t id);
+
+/**
+ * @brief Add to transaction removal of document identified by `id`.
+ *
+ * @param txn   Transaction handle. Not zero.
+ * @param coll  Collection name. Not zero.
+ * @param id    Document id. Not zero.
+ */
+IW_EXPORT WUR iwrc ejdb_txn_del(EJDB_TXN txn, const char *coll, int64_t id);
+
+/**
+ * @brief Apply operations of transaction in the order they were added
+ *        and release transaction handle.
+ *
+ * Database is exclusively locked while operations are applied so WAL savepoint
+ * cannot split them. If any operation fails all applied operations are reverted.
+ * Storage is synced once when all operations are applied.
+ *
+ * @param txnp  Pointer to transaction handle. Not zero.
+ *
+ * @return `0` on success.
+ *         `IWKV_ERROR_NOTFOUND` if patched or removed document not found.
+ *          Any non zero error code of failed operation.
+ */
+IW_EXPORT iwrc ejdb_txn_commit(EJDB_TXN *txnp);
+
+/**
+ * @brief Discard operations of transaction and release transaction handle.
+ *
+ * @param txnp  Pointer to transaction handle. Not zero.
+ */
+IW_EXPORT void ejdb_txn_abort(EJDB_TXN *txnp);
+
 /**
  * @brief Remove collection under the given name `coll`.
  *
@@ -590,11 +774,104 @@ IW_EXPORT iwrc ejdb_ensure_collection(EJDB db, const char *coll);
  *         `EJDB_ERROR_INVALID_INDEX_MODE` Invalid `mode` specified
  *         `EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE` trying to create non unique index over existing unique or vice
  * versa.
+ *         `EJDB_ERROR_INDEX_BUILDING` Index over the same field is being built by `ejdb_ensure_index_online()`.
  *          Any non zero error codes.
  *
  */
 IW_EXPORT iwrc ejdb_ensure_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode);
 
+/**
+ * @brief Create index storing values of `include` fields in its entries
+ *        if it has not existed before.
+ *
+ * Queries filtering, sorting and projecting only by indexed `path` and `include`
+ * fields are answered from index entries without fetching collection documents (covering index).
+ *
+ * Create index over user emails keeping user names in its entries:
+ *
+ * @code {.c}
+ * const char *include[] = { "/name" };
+ * iwrc rc = ejdb_ensure_index2(db, "users", "/email", EJDB_IDX_UNIQUE | EJDB_IDX_STR, include, 1);
+ * @endcode
+ *
+ * Query `/[email = :email] | /{email,name}` will be executed using index entries only.
+ *
+ * @note Include fields of an already existing index are not changed.
+ *
+ * @param db       Database handle. Not zero.
+ * @param coll     Collection name. Not zero.
+ * @param path     rfc6901 JSON pointer to indexed field.
+ * @param mode     Index mode.
+ * @param include  Array of rfc6901 JSON pointers to fields stored in index entries. Optional.
+ * @param ninclude Number of elements in `include` array.
+ *
+ * @return `0` on success.
+ *         `EJDB_ERROR_INVALID_INDEX_MODE` Invalid `mode` specified
+ *         `EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE` trying to create non unique index over existing unique or vice
+ * versa.
+ *         `EJDB_ERROR_INDEX_BUILDING` Index over the same field is being built by `ejdb_ensure_index_online()`.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_ensure_index2(
+  EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode,
+  const char **include, int ninclude);
+
+/**
+ * @brief Create partial index keeping entries of documents matched by `filter` query only.
+ *
+ * Filter must be a conjunction of field conditions with literal values, eg: `/[status = "pending"]`.
+ * Partial index is used by query only if query implies the filter: every condition of filter
+ * is found among query conditions joined by `and`.
+ *
+ * @code {.c}
+ * iwrc rc = ejdb_ensure_partial_index(db, "tasks", "/created", EJDB_IDX_I64, "/[status = pending]");
+ * @endcode
+ *
+ * @param db     Database handle. Not zero.
+ * @param coll   Collection name. Not zero.
+ * @param path   rfc6901 JSON pointer to indexed field.
+ * @param mode   Index mode.
+ * @param filter JQL query matching indexed documents. Not zero.
+ *
+ * @return `0` on success.
+ *         `EJDB_ERROR_INVALID_INDEX_MODE` Invalid `mode` specified
+ *         `EJDB_ERROR_INVALID_INDEX_FILTER` Filter is not a conjunction of field conditions.
+ *         `EJDB_ERROR_MISMATCHED_INDEX_FILTER` Index over the same field exists but has different filter.
+ *         `EJDB_ERROR_INDEX_BUILDING` Index over the same field is being built by `ejdb_ensure_index_online()`.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_ensure_partial_index(
+  EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode,
+  const char *filter);
+
+/**
+ * @brief Create index like `ejdb_ensure_index()` without blocking the collection for the time of build.
+ *
+ * Index is registered in building state: it is maintained by concurrent document updates
+ * but is not used by queries. Existing documents are indexed by chunks holding collection
+ * read lock, so readers are not blocked and writers wait only for a chunk to be indexed.
+ * Once all documents are indexed the index is stored and becomes available for queries.
+ *
+ * Function returns when the build is finished, call it from a separate thread
+ * to build index in background. Index being built is reported in `ejdb_get_meta()`
+ * with `building` flag set. If build is interrupted by crash the index is removed
+ * on next database open.
+ *
+ * @param db    Database handle. Not zero.
+ * @param coll  Collection name. Not zero.
+ * @param path  rfc6901 JSON pointer to indexed field.
+ * @param mode  Index mode.
+ *
+ * @return `0` on success.
+ *         `EJDB_ERROR_INVALID_INDEX_MODE` Invalid `mode` specified
+ *         `EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE` trying to create non unique index over existing unique or vice
+ * versa.
+ *         `IW_ERROR_NOT_EXISTS` if collection or index was removed during build.
+ *         `EJDB_ERROR_INDEX_BUILDING` Index over the same field is being built by `ejdb_ensure_index_online()`.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_ensure_index_online(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode);
+
 /**
  * @brief Remove index if it has existed before.
  *
@@ -609,6 +886,92 @@ IW_EXPORT iwrc ejdb_ensure_index(EJDB db, const char *coll, const char *path, ej
  */
 IW_EXPORT iwrc ejdb_remove_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode);
 
+/**
+ * @brief Rebuilds existing index from collection documents using current index keys format.
+ *
+ * `EJDB_IDX_F64` indexes created by previous versions of ejdb2 keep values
+ * as decimal strings: such keys are slow to build and compare and lose precision.
+ * Rebuilt index keeps values as fixed width binary keys sorted as raw bytes.
+ *
+ * @param db    Database handle. Not zero.
+ * @param coll  Collection name. Not zero.
+ * @param path  rfc6901 JSON pointer to indexed field.
+ * @param mode  Index mode.
+ *
+ * @return `0` on success.
+ *         `IW_ERROR_NOT_EXISTS` if collection or index is not found.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_rebuild_index(EJDB db, const char *coll, const char *path, ejdb_idx_mode_t mode);
+
+/**
+ * @brief Create compound index over ordered tuple of document fields if it has not existed before.
+ *
+ * Index keys are built from values of all `cols` so query with equality conditions
+ * on leading columns and optional range condition on the next column
+ * is served by single index scan. Query results ordered by index columns
+ * following the equality matched ones are not sorted.
+ *
+ * Document is not indexed if the first column value is absent,
+ * absent values of other columns are ordered before any other values.
+ *
+ * Create index to query events of tenant ordered by timestamp:
+ *
+ * @code {.c}
+ * EJDB_IDX_COL cols[] = {
+ *   { "/tenant", EJDB_IDX_STR },
+ *   { "/ts",     EJDB_IDX_I64 }
+ * };
+ * iwrc rc = ejdb_ensure_compound_index(db, "events", cols, 2, 0);
+ * // Query: @events/[tenant = :tenant] and /[ts > :ts] | asc /ts
+ * @endcode
+ *
+ * @param db    Database handle. Not zero.
+ * @param coll  Collection name. Not zero.
+ * @param cols  Index columns. Not zero.
+ * @param ncols Number of index columns, up to `EJDB_IDX_COLS_MAX`.
+ * @param mode  Index mode: `0` or `EJDB_IDX_UNIQUE`.
+ *
+ * @return `0` on success.
+ *         `EJDB_ERROR_INVALID_INDEX_MODE` Invalid `mode` or column type specified
+ *         `EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE` trying to create non unique index over existing unique or vice
+ * versa.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_ensure_compound_index(
+  EJDB db, const char *coll, const EJDB_IDX_COL *cols, int ncols,
+  ejdb_idx_mode_t mode);
+
+/**
+ * @brief Remove compound index if it has existed before.
+ *
+ * @param db    Database handle. Not zero.
+ * @param coll  Collection name. Not zero.
+ * @param cols  Index columns. Not zero.
+ * @param ncols Number of index columns.
+ *
+ * @return `0` on success.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_remove_compound_index(EJDB db, const char *coll, const EJDB_IDX_COL *cols, int ncols);
+
+/**
+ * @brief Collect statistics of all indexes of the given collection.
+ *
+ * Statistics (number of distinct keys, keys histogram, null fraction) is used
+ * by query planner to estimate number of records matched by index.
+ * It is collected automatically on index creation, call this function
+ * after significant collection data changes to keep statistics up to date.
+ *
+ * @param db    Database handle. Not zero.
+ * @param coll  Collection name. Not zero.
+ *
+ * @return `0` on success.
+ *         `IW_ERROR_NOT_EXISTS` if collection is not found.
+ *          Any non zero error codes.
+ */
+IW_EXPORT iwrc ejdb_analyze(EJDB db, const char *coll);
+
 /**
  * @brief Returns JSON document describind database structure.
  * @note Returned `jblp` must be disposed by `jbl_destroy()`
@@ -632,6 +995,17 @@ IW_EXPORT iwrc ejdb_remove_index(EJDB db, const char *coll, const char *path, ej
  *        "idbf": 96,     // Index flags. See iwdb_flags_t
  *        "dbid": 4,      // Index database ID
  *        "rnum": 2       // Number records stored in index database
+ *       },
+ *       {
+ *        "ptr": "/a",    // JSON pointer of the first column of compound index
+ *        "mode": 0,      // Index mode
+ *        "cols": [       // Compound index columns
+ *          { "ptr": "/a", "type": 4 },
+ *          { "ptr": "/b", "type": 8 }
+ *        ],
+ *        "idbf": 32,
+ *        "dbid": 5,
+ *        "rnum": 2
  *       }
  *      ]
  *     }
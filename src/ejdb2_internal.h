@@ -51,6 +51,8 @@ static_assert(JBNUMBUF_SIZE >= IWFTOA_BUFSIZE, "JBNUMBUF_SIZE >= IWFTOA_BUFSIZE"
 
 #define METADB_ID           1
 #define NUMRECSDB_ID        2    // DB for number of records per index/collection
+#define KEY_IDXSTATS(dbid_) ((((uint64_t) 1) << 32) | (dbid_)) // Key of index statistics in NUMRECSDB_ID
+#define KEY_NRECS_CLEAN     (((uint64_t) 2) << 32) // Mark of records counters persisted on close in NUMRECSDB_ID
 #define KEY_PREFIX_COLLMETA "c." // Full key format: c.<coldbid>
 #define KEY_PREFIX_IDXMETA  "i." // Full key format: i.<coldbid>.<idxdbid>
 
@@ -88,6 +90,15 @@ static_assert(JBNUMBUF_SIZE >= IWFTOA_BUFSIZE, "JBNUMBUF_SIZE >= IWFTOA_BUFSIZE"
 struct _JBIDX;
 typedef struct _JBIDX*JBIDX;
 
+/** Blocked Bloom filter of keys stored in database, see `jbi_bloom_build()` */
+typedef struct _JBBLOOM {
+  uint64_t *blocks;         /**< Filter bits, `JB_BLOOM_BLOCK_WORDS` words per block */
+  uint32_t  nblocks;        /**< Number of blocks */
+  uint32_t  k;              /**< Number of bits set by every key */
+  int64_t   nkeys;          /**< Number of keys added since filter was built */
+  int64_t   capacity;       /**< Max number of keys filter is sized for */
+} *JBBLOOM;
+
 /** Database collection */
 typedef struct _JBCOLL {
   uint32_t    dbid;         /**< IWKV collection database ID */
@@ -97,20 +108,46 @@ typedef struct _JBCOLL {
   JBL     meta;             /**< Collection meta object */
   JBIDX   idx;              /**< First index in chain */
   int64_t rnum;             /**< Number of records stored in collection */
+  int64_t rnum_flushed;     /**< Number of records persisted in NUMRECSDB_ID */
   pthread_rwlock_t rwl;
   int64_t id_seq;
+  JBBLOOM bloom;            /**< Bloom filter of documents ids (optional) */
 } *JBCOLL;
 
+/** Index statistics used by query planner */
+typedef struct _JBIDX_STATS {
+  int64_t  nkeys;           /**< Number of index entries at the time statistics was collected */
+  int64_t  ndistinct;       /**< Number of distinct index keys */
+  int64_t  depth;           /**< Number of index entries per histogram bucket */
+  double   null_frac;       /**< Fraction of collection documents having no indexed value */
+  int      nbounds;         /**< Number of histogram bounds: minimal key followed by upper bounds of buckets */
+  IWKV_val bounds[];        /**< Equi-depth histogram bounds, points to `data` */
+} *JBIDX_STATS;
+
 /** Database collection index */
 struct _JBIDX {
   struct _JBIDX *next;      /**< Next index in chain */
   int64_t  rnum;            /**< Number of records stored in index */
+  int64_t  rnum_flushed;    /**< Number of records persisted in NUMRECSDB_ID */
   JBCOLL   jbc;             /**< Owner document collection */
   JBL_PTR  ptr;             /**< Indexed JSON path poiner 0*/
   IWDB     idb;             /**< KV database for this index */
   uint32_t dbid;            /**< IWKV collection database ID */
   ejdb_idx_mode_t mode;     /**< Index mode/type mask */
   iwdb_flags_t    idbf;     /**< Index database flags */
+  JBIDX_STATS     stats;    /**< Index statistics (optional) */
+  int      ncols;           /**< Number of compound index columns, zero for single field index */
+  JBL_PTR *cptrs;           /**< Compound index columns pointers, `cptrs[0]` is `ptr` */
+  ejdb_idx_mode_t *ctypes;  /**< Compound index columns value types */
+  int      nincl;           /**< Number of included fields stored in entries of covering index */
+  JBL_PTR *iptrs;           /**< Included fields pointers */
+  char   **ipaths;          /**< Zero terminated paths of indexed and included fields, `ipaths[0]` is indexed path.
+                                 Not zero for covering index only */
+  bool     building;        /**< Index is being built online and is not used by queries yet */
+  JQL      filter;          /**< Filter of documents stored in partial index (optional) */
+  char    *filterq;         /**< Partial index filter query text */
+  JQVAL  **fvals;           /**< Values of partial index filter conditions, resolved by `jbi_idx_filter_init()` */
+  JBBLOOM  bloom;           /**< Bloom filter of `EJDB_IDX_UNIQUE` index keys (optional) */
 };
 
 /** Pair: collection name, document id */
@@ -122,6 +159,24 @@ struct _JBDOCREF {
 // -V:KHASH_MAP_INIT_STR:522
 KHASH_MAP_INIT_STR(JBCOLLM, JBCOLL)
 
+/** Group commit of writes synced together, see `EJDB_OPTS.wal_group_commit_us` */
+struct _JBGCOMMIT {
+  pthread_mutex_t mtx;
+  pthread_cond_t  cond;
+  uint64_t gen;             /**< Generation of group collecting writers */
+  uint64_t synced;          /**< Generation of last synced group */
+  uint64_t failed;          /**< Generation of last group failed to sync, zero if none */
+  iwrc     failed_rc;       /**< Sync error of `failed` group */
+  uint32_t nwriters;        /**< Number of writers in collecting group */
+  bool     leader;          /**< Collecting group has leader thread which syncs it */
+  bool     syncing;         /**< Sync of previous group is in progress */
+  uint64_t groups;          /**< Number of synced groups */
+  uint64_t writes;          /**< Number of synced writes */
+  uint32_t max_batch;       /**< Max number of writes synced together */
+  uint64_t wait_us;         /**< Total time writers waited for sync in microseconds */
+  uint64_t max_wait_us;     /**< Max time writer waited for sync in microseconds */
+};
+
 struct _EJDB {
   IWKV iwkv;
   IWDB metadb;
@@ -133,7 +188,41 @@ struct _EJDB {
   iwkv_openflags    oflags;
   pthread_rwlock_t  rwl;      /**< Main RWL */
   struct _EJDB_OPTS opts;
-  volatile bool     open;
+  volatile uint64_t idx_gen;  /**< Generation of indexes set, changed on indexes creation/removal */
+  struct _JBGCOMMIT gc;       /**< Group commit state */
+  pthread_mutex_t   rnum_mtx; /**< Serializes records counters flushes, guards `rnum_stop` */
+  pthread_cond_t    rnum_cond;
+  pthread_t rnum_thread;      /**< Thread of periodic records counters flush */
+  bool      rnum_thread_started;
+  bool      rnum_stop;        /**< Counters flush thread is requested to stop */
+  bool      rnum_stale;       /**< Persisted counters are stale, records are recounted on load */
+  volatile bool open;
+};
+
+typedef uint8_t jb_txnop_t;
+#define JB_TXNOP_PUT   ((jb_txnop_t) 0x01U)
+#define JB_TXNOP_PATCH ((jb_txnop_t) 0x02U)
+#define JB_TXNOP_DEL   ((jb_txnop_t) 0x03U)
+
+/** Buffered operation of write transaction */
+struct _JBTXNOP {
+  struct _JBTXNOP *next;
+  struct _JBTXNOP *prev;
+  jb_txnop_t  type;
+  const char *coll;
+  int64_t     id;
+  JBL      jbl;             /**< Document of put operation */
+  JBL_NODE patch;           /**< Patch of patch operation */
+  JBCOLL   jbc;             /**< Collection of applied operation */
+  IWKV_val oldval;          /**< Document stored before operation was applied */
+  bool     applied;
+};
+
+struct _EJDB_TXN {
+  EJDB    db;
+  IWPOOL *pool;             /**< Pool of operations and their data */
+  struct _JBTXNOP *first;
+  struct _JBTXNOP *last;
 };
 
 struct _JBPHCTX {
@@ -149,20 +238,77 @@ typedef iwrc (*JB_SCAN_CONSUMER)(
   struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id,
   int64_t *step, bool *matched, iwrc err);
 
+/** Sorter document reference */
+struct _JBSREF {
+  uint64_t kp;                /**< Sort key prefix, set before sorting */
+  uint32_t doc;               /**< Document offset in `docs` */
+  uint32_t key;               /**< Sort key offset in `keys` */
+};
+
+/** Temp file of sorted records `[uint32 size][record]`, see `jbi_merge()` */
+struct _JBRUNF {
+  IWFS_EXT  f;                /**< Run file */
+  bool      fopen;            /**< Run file is opened */
+  off_t     fsz;              /**< Run file size */
+  IWXSTR   *wbuf;             /**< Write buffer */
+  off_t     roff;             /**< Next read offset in run file */
+  uint8_t  *rbuf;             /**< Read buffer, allocated by the first read */
+  size_t    rbuf_len;         /**< Number of bytes in read buffer */
+  size_t    rbuf_pos;         /**< Current position in read buffer */
+  uint8_t  *rec;              /**< Current record read */
+  size_t    rec_asz;          /**< Allocated size of `rec` */
+};
+
+/** Source of sorted records merged by `jbi_merge()` */
+struct _JBMSRC {
+  const uint8_t *rec;                           /**< Current record */
+  iwrc (*next)(struct _JBMSRC *src, bool *eof); /**< Moves `rec` to the next record */
+  void (*close)(struct _JBMSRC *src);           /**< Releases read buffers of merged source (optional) */
+};
+
+/** K-way merge of sorted sources with bounded fan-in */
+struct _JBMERGE {
+  struct _JBMSRC **srcs;      /**< Sorted sources positioned before their first records */
+  uint32_t srcs_num;          /**< Number of sources */
+  int    (*cmp)(const uint8_t *r1, const uint8_t *r2, void *op); /**< Records comparator */
+  size_t (*size)(const uint8_t *rec, void *op);                  /**< Size of record */
+  iwrc   (*sink)(const uint8_t *rec, void *op, bool *stop);      /**< Consumer of merged records */
+  void    *op;                /**< User data of callbacks */
+};
+
+/** Sorted run of external merge sort */
+struct _JBSRUN {
+  struct _JBMSRC src;         /**< Merge source, must be the first member */
+  struct _JBRUNF rf;          /**< Run file: sort key, document size, `id` and document records */
+  struct _JBSREF *refs;       /**< Run documents references, released when run is written */
+  uint32_t  refs_num;         /**< Number of documents in run */
+  uint8_t  *docs;             /**< Run documents, released when run is written */
+  IWXSTR   *keys;             /**< Run documents sort keys, released when run is written */
+  bool      kradix;           /**< Run keys can be radix sorted */
+  bool      thr_active;       /**< Run is being sorted by `thr` thread */
+  pthread_t thr;              /**< Run sorting thread */
+  iwrc      rc;               /**< Run sorting result */
+};
+
 /**
  * @brief Index can sorter consumer context
  */
 struct _JBSSC {
-  iwrc      rc;               /**< RC code used for in `_jb_do_sorting` */
-  uint32_t *refs;             /**< Document references array */
+  struct _JBSREF *refs;       /**< Document references array */
   uint32_t  refs_asz;         /**< Document references array allocated size */
   uint32_t  refs_num;         /**< Document references array elements count */
   uint32_t  docs_asz;         /**< Documents array allocated size */
   uint8_t  *docs;             /**< Documents byte array */
   uint32_t  docs_npos;        /**< Next document offset */
-  jmp_buf   fatal_jmp;
-  IWFS_EXT  sof;              /**< Sort overflow file */
-  bool      sof_active;
+  IWXSTR   *keys;             /**< Documents sort keys */
+  jbl_type_t ktype;           /**< Type of the first order-by value of the first document */
+  bool      kradix;           /**< All keys are numeric values of `ktype` so radix sort can be used */
+  struct _JBSRUN **runs;      /**< Sorted runs if documents exceeded `sort_buffer_sz` */
+  uint32_t  runs_num;         /**< Number of sorted runs */
+  uint32_t  runs_joined;      /**< Number of leading runs with finished sorting threads */
+  uint8_t **topk;             /**< Top-K documents max-heap: sort key, `id` followed by document buffer */
+  uint32_t  topk_num;         /**< Number of documents in `topk` heap */
+  uint32_t  topk_max;         /**< Top-K heap capacity (`skip + limit`), zero if top-K sorting is not used */
 };
 
 struct _JBMIDX {
@@ -174,8 +320,34 @@ struct _JBMIDX {
   IWKV_cursor_op cursor_init;         /**< Initial index cursor position (optional) */
   IWKV_cursor_op cursor_step;         /**< Next index cursor step */
   bool orderby_support;               /**< Index supported first order-by clause */
+  int  neq;                           /**< Number of leading compound index columns matched by equality */
+  JQP_EXPR *cexprs[EJDB_IDX_COLS_MAX];/**< Equality expressions of leading compound index columns */
+  bool estimated;                     /**< Estimated by index statistics */
+  int64_t rows;                       /**< Estimated number of index entries to be scanned */
+  double  cost;                       /**< Estimated cost of index scan */
+};
+
+/** Set of document ids collected by index scan */
+struct _JBIDSET {
+  int64_t *ids;   /**< Document ids */
+  size_t   num;   /**< Number of ids */
+  size_t   cap;   /**< Allocated capacity of `ids` */
 };
 
+/** Index selection cached by prepared query */
+typedef struct _JBQPLAN {
+  uint64_t idx_gen;            /**< Indexes generation the plan was selected for */
+  JBCOLL   jbc;                /**< Collection the plan was selected for */
+  IWKV_cursor_op cursor_init;  /**< Collection cursor initial position */
+  IWKV_cursor_op cursor_step;  /**< Collection cursor step */
+  bool sorting;                /**< Resultset sorting needed */
+  bool idx_count;              /**< Query is counted by index entries */
+  bool mplan_or;               /**< Union of multi-index plan ids */
+  int  mplan_num;              /**< Number of index scans in multi-index plan */
+  struct _JBMIDX midx;         /**< Selected index */
+  struct _JBMIDX mplan[];      /**< Index scans of multi-index plan */
+} *JBQPLAN;
+
 typedef struct _JBEXEC {
   EJDB_EXEC *ux;           /**< User defined context */
   JBCOLL     jbc;          /**< Collection */
@@ -185,10 +357,20 @@ typedef struct _JBEXEC {
   uint8_t *jblbuf;            /**< Buffer used to keep currently processed document */
   size_t   jblbufsz;          /**< Size of jblbuf allocated memory */
   bool     sorting;           /**< Resultset sorting needed */
+  bool     prematched;        /**< Documents passed to consumer are already matched by scanner */
+  bool     idx_count;         /**< Query is counted by index entries, documents are not fetched */
+  bool     covering;          /**< Documents are substituted by fragments stored in covering index entries */
+  uint8_t *cvbuf;             /**< Buffer used to keep value of currently processed covering index entry */
+  size_t   cvbufsz;           /**< Size of cvbuf allocated memory */
+  IWKV_val cvdoc;             /**< Document fragment of currently processed covering index entry, points to `cvbuf` */
   IWKV_cursor_op cursor_init; /**< Initial index cursor position (optional) */
   IWKV_cursor_op cursor_step; /**< Next index cursor step */
   struct _JBMIDX midx;        /**< Index matching context */
   struct _JBSSC  ssc;         /**< Result set sorting context */
+  struct _JBMIDX *mplan;      /**< Index scans of multi-index plan (optional) */
+  int  mplan_num;             /**< Number of index scans in multi-index plan */
+  bool mplan_or;              /**< Union of multi-index plan ids, intersection otherwise */
+  struct _JBIDSET mset;       /**< Ids collected by current index scan of multi-index plan */
 
   // JQL joned nodes cache
   IWSTREE *proj_joined_nodes_cache;
@@ -196,6 +378,15 @@ typedef struct _JBEXEC {
 } JBEXEC;
 
 
+/** Terms of tokenized text, see `jbi_text_add()` */
+struct _JBTXT {
+  IWXSTR *buf;   /**< Terms data, every term is followed by zero byte */
+  size_t *offs;  /**< Offsets of terms in `buf`, empty term separates phrases */
+  int     num;   /**< Number of terms */
+  int     asz;   /**< Allocated size of `offs` */
+  bool    trigrams; /**< Terms are trigrams of `EJDB_IDX_TRIGRAM` index */
+};
+
 typedef uint8_t jb_coll_acquire_t;
 #define JB_COLL_ACQUIRE_WRITE    ((jb_coll_acquire_t) 0x01U)
 #define JB_COLL_ACQUIRE_EXISTING ((jb_coll_acquire_t) 0x02U)
@@ -205,24 +396,148 @@ typedef uint8_t jb_coll_acquire_t;
 #define JB_IDX_EMPIRIC_MIN_INOP_ARRAY_SIZE  10
 #define JB_IDX_EMPIRIC_MAX_INOP_ARRAY_RATIO 200
 
+// Index statistics constants
+#define JB_IDX_STATS_BUCKETS  64  // Max number of equi-depth histogram buckets
+#define JB_IDX_COST_SORT_RATE 0.2 // Cost of sorting a record relative to its index fetch
+#define JB_IDX_F64_KEY_SIZE   8   // Size of binary sortable key of F64 index
+#define JB_IDX_COVERING_MAX_PATH 32 // Max number of path segments checked against covering index fields
+#define JB_IDX_ONLINE_CHUNK 1024    // Number of documents indexed per collection lock hold by online index build
+#define JB_TEXT_TERM_MAX 64         // Max size in bytes of full-text index term, longer terms are truncated
+#define JB_IDX_HASH_KEY_SIZE 8      // Size of key of `EJDB_IDX_HASH` index
+#define JB_RNUM_FLUSH_TIMEOUT_SEC 10 // Default max time in-memory records counters are kept unpersisted
+#define JB_BLOOM_BITS_MAX 32        // Max number of Bloom filter bits per key
+#define JB_BLOOM_MIN_KEYS 1024      // Min number of keys Bloom filter is sized for
+#define JB_BLOOM_BLOCK_WORDS 8      // Size of Bloom filter block in 64 bit words (one cache line)
+#define JB_SORT_TOPK_MAX 4096    // Max `skip + limit` of sorted query served by top-K heap
+#define JB_SORT_RADIX_MIN 1024   // Min number of numeric sort keys to use radix sort
+#define JB_SORT_RUN_BUFSZ (256 * 1024) // Sorted run file read/write buffer size
+#define JB_SORT_MERGE_FANIN 64   // Max number of sorted runs merged at once
+
+// Multi-index plan constants
+#define JB_IDX_MULTI_MAX             8    // Max number of index scans in multi-index plan
+#define JB_IDX_MULTI_MIN_ROWS        64   // Min estimated rows of the best index to try intersection with others
+#define JB_IDX_MULTI_SCAN_RATE       0.1  // Cost of reading index entry relative to document fetch
+#define JB_IDX_MULTI_MAX_UNION_RATIO 0.5  // Max ratio of estimated union rows to collection records
+
+// Parallel full scan constants
+#define JB_PARALLEL_SCAN_MIN_RECORDS   10000 // Min number of collection records to scan it in parallel
+#define JB_PARALLEL_SCAN_THREAD_RANGES 8     // Number of id ranges per scan thread
+
 void jbi_jbl_fill_ikey(JBIDX idx, JBL jbv, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]);
 void jbi_jqval_fill_ikey(JBIDX idx, const JQVAL *jqval, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]);
 void jbi_node_fill_ikey(JBIDX idx, JBL_NODE node, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]);
+void jbi_f64_key(double v, uint8_t key[static JB_IDX_F64_KEY_SIZE]);
+double jbi_f64_key_value(const void *key);
+uint64_t jbi_hash64(const void *buf, size_t len);
+char *jbi_nocase(const char *str, size_t len, size_t *olen);
+
+/**
+ * Releases key filled by `jbi_*_fill_ikey()` of `EJDB_IDX_NOCASE` index
+ * if case folded key doesn't fit into `numbuf`.
+ */
+IW_INLINE void jbi_ikey_dispose(JBIDX idx, IWKV_val *ikey, char *numbuf) {
+  if ((idx->mode & EJDB_IDX_NOCASE) && ikey->data && (ikey->data != numbuf)) {
+    free(ikey->data);
+  }
+  ikey->data = 0;
+  ikey->size = 0;
+}
+
+/**
+ * Returns case sensitive counterpart of case insensitive query operation.
+ */
+IW_INLINE jqp_op_t jbi_op_cased(jqp_op_t op) {
+  switch (op) {
+    case JQP_OP_IEQ:
+      return JQP_OP_EQ;
+    case JQP_OP_IIN:
+      return JQP_OP_IN;
+    case JQP_OP_IPREFIX:
+      return JQP_OP_PREFIX;
+    default:
+      return op;
+  }
+}
+
+IW_INLINE bool jbi_op_nocase(jqp_op_t op) {
+  return op == JQP_OP_IEQ || op == JQP_OP_IIN || op == JQP_OP_IPREFIX;
+}
 
 iwrc jbi_consumer(struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id, int64_t *step, bool *matched, iwrc err);
+iwrc jbi_count_consumer(struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id, int64_t *step, bool *matched, iwrc err);
 iwrc jbi_sorter_consumer(struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id, int64_t *step, bool *matched, iwrc err);
 iwrc jbi_full_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
 iwrc jbi_selection(JBEXEC *ctx);
+iwrc jbi_idx_filter_init(struct _JBIDX *idx);
 iwrc jbi_pk_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
 iwrc jbi_uniq_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
 iwrc jbi_dup_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
+iwrc jbi_multi_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
+iwrc jbi_compound_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
+iwrc jbi_text_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer);
+iwrc jbi_compound_bounds(
+  struct _JBEXEC *ctx, struct _JBMIDX *midx,
+  IWXSTR *lo, IWXSTR *hi, bool *hi_inf, bool *empty);
+iwrc jbi_jbl_fill_ckey(JBIDX idx, JBL jbl, IWXSTR *ckey, bool *found);
+iwrc jbi_jqval_add_ckey(ejdb_idx_mode_t type, const JQVAL *jqval, IWXSTR *ckey, bool *added);
+bool jbi_ckey_succ(IWXSTR *ckey);
+iwrc jbi_covering_load(struct _JBEXEC *ctx, IWKV_cursor cur, const IWKV_val *key);
 bool jbi_node_expr_matched(JQP_AUX *aux, JBIDX idx, IWKV_cursor cur, JQP_EXPR *expr, iwrc *rcp);
 
+iwrc jbi_idx_build(JBIDX idx, int64_t *rnum);
+
+iwrc jbi_runf_open(struct _JBRUNF *rf);
+iwrc jbi_runf_put(struct _JBRUNF *rf, uint32_t size);
+iwrc jbi_runf_cat(struct _JBRUNF *rf, const void *buf, size_t len);
+iwrc jbi_runf_flush(struct _JBRUNF *rf);
+iwrc jbi_runf_next(struct _JBRUNF *rf, bool *eof);
+void jbi_runf_release(struct _JBRUNF *rf);
+void jbi_runf_close(struct _JBRUNF *rf);
+iwrc jbi_merge(struct _JBMERGE *m);
+
+iwrc jbi_text_init(struct _JBTXT *t);
+void jbi_text_destroy(struct _JBTXT *t);
+iwrc jbi_text_add(struct _JBTXT *t, const char *text, size_t len);
+iwrc jbi_text_add_jqval(struct _JBTXT *t, const JQVAL *jqval);
+iwrc jbi_text_add_doc(struct _JBTXT *t, JBIDX idx, JBL jbl);
+iwrc jbi_text_add_query(struct _JBTXT *t, JBIDX idx, const JQVAL *jqval);
+void jbi_text_distinct(struct _JBTXT *t);
+bool jbi_text_matched(const struct _JBTXT *t, const struct _JBTXT *q);
+
+IW_INLINE const char *jbi_text_term(const struct _JBTXT *t, int i) {
+  return iwxstr_ptr(t->buf) + t->offs[i];
+}
+
+iwrc jbi_stats_collect(JBIDX idx);
+iwrc jbi_stats_load(JBIDX idx);
+iwrc jbi_stats_remove(JBIDX idx);
+void jbi_stats_release(JBIDX idx);
+iwrc jbi_stats_estimate(JBEXEC *ctx, struct _JBMIDX *midx);
+double jbi_stats_key_rows(JBIDX idx, const IWKV_val *key);
+
+iwrc jbi_bloom_build(IWDB db, int64_t nkeys, uint32_t bits, JBBLOOM *bp);
+void jbi_bloom_destroy(JBBLOOM *bp);
+void jbi_bloom_add(JBBLOOM b, const void *key, size_t len);
+bool jbi_bloom_may_contain(JBBLOOM b, const void *key, size_t len);
+double jbi_bloom_fpp(JBBLOOM b);
+
+IW_INLINE size_t jbi_bloom_size(JBBLOOM b) {
+  return (size_t) b->nblocks * JB_BLOOM_BLOCK_WORDS * sizeof(b->blocks[0]);
+}
+
+/**
+ * Returns true if filter has more keys than it is sized for and must be rebuilt.
+ */
+IW_INLINE bool jbi_bloom_full(JBBLOOM b) {
+  return b->nkeys >= b->capacity;
+}
+
 iwrc jb_get(EJDB db, const char *coll, int64_t id, jb_coll_acquire_t acm, JBL *jblp);
 iwrc jb_put(JBCOLL jbc, JBL jbl, int64_t id);
 iwrc jb_del(JBCOLL jbc, JBL jbl, int64_t id);
 iwrc jb_cursor_set(JBCOLL jbc, IWKV_cursor cur, int64_t id, JBL jbl);
 iwrc jb_cursor_del(JBCOLL jbc, IWKV_cursor cur, int64_t id, JBL jbl);
+iwrc jb_idx_fragment(JBIDX idx, JBL jbl, IWXSTR *xstr, IWPOOL *pool);
 
 iwrc jb_collection_join_resolver(int64_t id, const char *coll, JBL *out, JBEXEC *ctx);
 int jb_proj_node_cache_cmp(const void *v1, const void *v2);
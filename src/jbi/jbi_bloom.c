@@ -0,0 +1,158 @@
+#include "ejdb2_internal.h"
+
+// Every key sets `k` bits within a single cache line sized block selected by key hash,
+// so a lookup touches one block only. Keys cannot be removed from filter:
+// removed keys are kept as false positives until filter is rebuilt
+// once the number of added keys reaches filter capacity.
+
+#define _JB_BLOOM_BLOCK_BITS (JB_BLOOM_BLOCK_WORDS * 64)
+
+static iwrc _jbi_bloom_create(int64_t nkeys, uint32_t bits, JBBLOOM *bp) {
+  *bp = 0;
+  JBBLOOM b = calloc(1, sizeof(*b));
+  if (!b) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  if (bits > JB_BLOOM_BITS_MAX) {
+    bits = JB_BLOOM_BITS_MAX;
+  }
+  b->capacity = MAX(nkeys * 2, JB_BLOOM_MIN_KEYS);
+  uint64_t nblocks = ((uint64_t) b->capacity * bits + _JB_BLOOM_BLOCK_BITS - 1) / _JB_BLOOM_BLOCK_BITS;
+  if (nblocks > UINT32_MAX) {
+    free(b);
+    return IW_ERROR_OVERFLOW;
+  }
+  b->nblocks = (uint32_t) nblocks;
+  b->k = (uint32_t) (bits * 0.69 + 0.5); // Optimal: bits per key * ln(2)
+  if (b->k < 1) {
+    b->k = 1;
+  } else if (b->k > 16) {
+    b->k = 16;
+  }
+  b->blocks = calloc(nblocks * JB_BLOOM_BLOCK_WORDS, sizeof(b->blocks[0]));
+  if (!b->blocks) {
+    iwrc rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    free(b);
+    return rc;
+  }
+  *bp = b;
+  return 0;
+}
+
+void jbi_bloom_destroy(JBBLOOM *bp) {
+  if (bp && *bp) {
+    free((*bp)->blocks);
+    free(*bp);
+    *bp = 0;
+  }
+}
+
+/**
+ * Returns block of `key` and fills its in-block bits positions by double hashing.
+ */
+static uint64_t *_jbi_bloom_key(JBBLOOM b, const void *key, size_t len, uint32_t *h1, uint32_t *h2) {
+  uint64_t h = jbi_hash64(key, len);
+  uint64_t g = h * 0x9e3779b97f4a7c15ULL;
+  *h1 = (uint32_t) g;
+  *h2 = (uint32_t) (g >> 32) | 1;
+  return b->blocks + (((h >> 32) * b->nblocks) >> 32) * JB_BLOOM_BLOCK_WORDS;
+}
+
+void jbi_bloom_add(JBBLOOM b, const void *key, size_t len) {
+  uint32_t h1, h2;
+  uint64_t *block = _jbi_bloom_key(b, key, len, &h1, &h2);
+  for (uint32_t i = 0; i < b->k; ++i, h1 += h2) {
+    uint32_t bit = h1 % _JB_BLOOM_BLOCK_BITS;
+    block[bit >> 6] |= 1ULL << (bit & 63);
+  }
+  ++b->nkeys;
+}
+
+bool jbi_bloom_may_contain(JBBLOOM b, const void *key, size_t len) {
+  if (!b) {
+    return true;
+  }
+  uint32_t h1, h2;
+  uint64_t *block = _jbi_bloom_key(b, key, len, &h1, &h2);
+  for (uint32_t i = 0; i < b->k; ++i, h1 += h2) {
+    uint32_t bit = h1 % _JB_BLOOM_BLOCK_BITS;
+    if (!(block[bit >> 6] & (1ULL << (bit & 63)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Returns false positive rate estimated by fraction of filter bits set.
+ */
+double jbi_bloom_fpp(JBBLOOM b) {
+  uint64_t nset = 0;
+  uint64_t nwords = (uint64_t) b->nblocks * JB_BLOOM_BLOCK_WORDS;
+  for (uint64_t i = 0; i < nwords; ++i) {
+    nset += __builtin_popcountll(b->blocks[i]);
+  }
+  double r = (double) nset / ((double) nwords * 64), ret = 1.0;
+  for (uint32_t i = 0; i < b->k; ++i) {
+    ret *= r;
+  }
+  return ret;
+}
+
+/**
+ * Creates filter of keys of `db` with `bits` per key sized for twice of `nkeys` estimated keys.
+ * Filter previously stored in `bp` is destroyed, `bp` is zero on error.
+ */
+iwrc jbi_bloom_build(IWDB db, int64_t nkeys, uint32_t bits, JBBLOOM *bp) {
+  size_t sz;
+  JBBLOOM b;
+  IWKV_cursor cur = 0;
+  char kbuf[JBNUMBUF_SIZE], *buf = kbuf;
+  size_t bufsz = sizeof(kbuf);
+
+  jbi_bloom_destroy(bp);
+  iwrc rc = _jbi_bloom_create(nkeys, bits, &b);
+  RCRET(rc);
+
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  RCGO(rc, finish);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    rc = iwkv_cursor_copy_key(cur, buf, bufsz, &sz, 0);
+    RCGO(rc, finish);
+    if (sz > bufsz) {
+      char *nbuf = malloc(sz);
+      if (!nbuf) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        goto finish;
+      }
+      if (buf != kbuf) {
+        free(buf);
+      }
+      buf = nbuf;
+      bufsz = sz;
+      rc = iwkv_cursor_copy_key(cur, buf, bufsz, &sz, 0);
+      RCGO(rc, finish);
+    }
+    jbi_bloom_add(b, buf, sz);
+  }
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+
+finish:
+  if (cur) {
+    iwkv_cursor_close(&cur);
+  }
+  if (buf != kbuf) {
+    free(buf);
+  }
+  if (rc) {
+    jbi_bloom_destroy(&b);
+  } else {
+    if (b->nkeys >= b->capacity) { // Keys number estimation is stale
+      b->capacity = b->nkeys + 1;
+    }
+    *bp = b;
+  }
+  return rc;
+}
@@ -0,0 +1,559 @@
+#include "ejdb2_internal.h"
+#include "sort_r.h"
+
+// Index over existing collection documents is built in bulk.
+// Documents are read sequentially in batches of `sort_buffer_sz` size,
+// index entries of every batch are extracted and sorted as a run
+// by worker threads if `sort_threads` option is set.
+// All runs except the last one are written into temp files as
+// `[uint32 klen][key][int64 id][uint32 vlen][value]` records.
+// Runs are merged by `jbi_merge()` and stored into index database in key order,
+// index records number is updated once at the end.
+
+/** Sorted run of index entries */
+struct _JBIB_RUN {
+  struct _JBMSRC src;         /**< Merge source, must be the first member */
+  JBIDX     idx;
+  JQL       filter;           /**< Run copy of partial index filter (optional) */
+  uint8_t  *docs;             /**< Batch documents `[int64 id][uint32 size][document]`, released when run is sorted */
+  size_t    docs_num;         /**< Size of batch documents data */
+  size_t    docs_asz;         /**< Allocated size of `docs` */
+  IWXSTR   *ents;             /**< Extracted index entries, released when run is written */
+  size_t   *refs;             /**< Offsets of entries in `ents` */
+  uint32_t  refs_num;         /**< Number of entries in run */
+  uint32_t  refs_asz;         /**< Allocated size of `refs` */
+  uint32_t  refs_pos;         /**< Next entry to merge if run is kept in memory */
+  bool      spill;            /**< Run should be written into temp file */
+  bool      thr_active;       /**< Run is being sorted by `thr` thread */
+  pthread_t thr;              /**< Run sorting thread */
+  iwrc      rc;               /**< Run sorting result */
+  struct _JBRUNF rf;          /**< Run file of spilled run */
+};
+
+/** Index bulk build context */
+struct _JBIB {
+  JBIDX     idx;
+  struct _JBIB_RUN **runs;
+  uint32_t  runs_num;
+  uint32_t  runs_joined;      /**< Number of leading runs with finished sorting threads */
+  uint32_t  threads;          /**< Max number of runs sorted concurrently */
+  int64_t   rnum;             /**< Number of stored index entries */
+};
+
+#define _JBIB_DOC_HDR (sizeof(int64_t) + sizeof(uint32_t))
+
+static void _jbi_build_run_destroy(struct _JBIB_RUN *run) {
+  if (run->thr_active) {
+    pthread_join(run->thr, 0);
+  }
+  jbi_runf_close(&run->rf);
+  free(run->docs);
+  iwxstr_destroy(run->ents);
+  free(run->refs);
+  if (run->filter) {
+    jql_destroy(&run->filter);
+  }
+  free(run);
+}
+
+IW_INLINE size_t _jbi_build_rec_size(const uint8_t *rec) {
+  uint32_t klen, vlen;
+  memcpy(&klen, rec, sizeof(klen));
+  memcpy(&vlen, rec + sizeof(klen) + klen + sizeof(int64_t), sizeof(vlen));
+  return sizeof(klen) + klen + sizeof(int64_t) + sizeof(vlen) + vlen;
+}
+
+/**
+ * Compares index entries by key then by document id.
+ * `i64` keys are compared as numbers.
+ */
+static int _jbi_build_rec_cmp(const uint8_t *r1, const uint8_t *r2, bool i64) {
+  int ret;
+  uint32_t l1, l2;
+  int64_t v1, v2;
+  memcpy(&l1, r1, sizeof(l1));
+  memcpy(&l2, r2, sizeof(l2));
+  r1 += sizeof(l1);
+  r2 += sizeof(l2);
+  if (i64 && (l1 == sizeof(v1)) && (l2 == sizeof(v2))) {
+    memcpy(&v1, r1, sizeof(v1));
+    memcpy(&v2, r2, sizeof(v2));
+    ret = v1 < v2 ? -1 : v1 > v2 ? 1 : 0;
+  } else {
+    ret = memcmp(r1, r2, MIN(l1, l2));
+    if (!ret) {
+      ret = l1 < l2 ? -1 : l1 > l2 ? 1 : 0;
+    }
+  }
+  if (ret) {
+    return ret;
+  }
+  memcpy(&v1, r1 + l1, sizeof(v1));
+  memcpy(&v2, r2 + l2, sizeof(v2));
+  return v1 < v2 ? -1 : v1 > v2 ? 1 : 0;
+}
+
+static int _jbi_build_cmp(const void *o1, const void *o2, void *op) {
+  struct _JBIB_RUN *run = op;
+  const uint8_t *ents = (const uint8_t*) iwxstr_ptr(run->ents);
+  return _jbi_build_rec_cmp(ents + *(const size_t*) o1, ents + *(const size_t*) o2,
+                            run->idx->idbf & IWDB_VNUM64_KEYS);
+}
+
+static iwrc _jbi_build_entry_add(struct _JBIB_RUN *run, const IWKV_val *key, int64_t id, IWXSTR *val) {
+  iwrc rc;
+  uint32_t klen = key->size, vlen = iwxstr_size(val);
+  if (run->refs_num == run->refs_asz) {
+    uint32_t nsize = run->refs_asz ? run->refs_asz * 2 : 1024;
+    size_t *nrefs = realloc(run->refs, nsize * sizeof(run->refs[0]));
+    if (!nrefs) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    run->refs = nrefs;
+    run->refs_asz = nsize;
+  }
+  run->refs[run->refs_num] = iwxstr_size(run->ents);
+  rc = iwxstr_cat(run->ents, &klen, sizeof(klen));
+  RCRET(rc);
+  rc = iwxstr_cat(run->ents, key->data, klen);
+  RCRET(rc);
+  rc = iwxstr_cat(run->ents, &id, sizeof(id));
+  RCRET(rc);
+  rc = iwxstr_cat(run->ents, &vlen, sizeof(vlen));
+  RCRET(rc);
+  rc = iwxstr_cat(run->ents, iwxstr_ptr(val), vlen);
+  RCRET(rc);
+  ++run->refs_num;
+  return 0;
+}
+
+/**
+ * Adds entry of every distinct term of document text into full-text index run.
+ */
+static iwrc _jbi_build_text_doc(struct _JBIB_RUN *run, int64_t id, JBL jbl, IWXSTR *val) {
+  IWKV_val key;
+  struct _JBTXT t;
+  iwrc rc = jbi_text_init(&t);
+  RCRET(rc);
+  rc = jbi_text_add_doc(&t, run->idx, jbl);
+  RCGO(rc, finish);
+  jbi_text_distinct(&t);
+  for (int i = 0; i < t.num; ++i) {
+    key.data = (void*) jbi_text_term(&t, i);
+    key.size = strlen(key.data);
+    rc = _jbi_build_entry_add(run, &key, id, val);
+    RCGO(rc, finish);
+  }
+
+finish:
+  jbi_text_destroy(&t);
+  return rc;
+}
+
+/**
+ * Extracts index entries of `jbl` document the same way as `_jb_idx_record_add()` does.
+ */
+static iwrc _jbi_build_doc(struct _JBIB_RUN *run, int64_t id, JBL jbl, IWXSTR *val, IWXSTR *ckey) {
+  uint8_t step;
+  IWKV_val key;
+  struct _JBL jbv;
+  jbl_type_t jbv_type;
+  char vnbuf[IW_VNUMBUFSZ];
+  char numbuf[JBNUMBUF_SIZE];
+
+  iwrc rc = 0;
+  IWPOOL *pool = 0;
+  JBIDX idx = run->idx;
+  bool compound = idx->idbf & IWDB_COMPOUND_KEYS;
+
+  if (run->filter) { // Partial index keeps entries of matched documents only
+    bool matched;
+    rc = jql_matched(run->filter, jbl, &matched);
+    if (rc || !matched) {
+      return rc;
+    }
+  }
+  iwxstr_clear(val);
+  if (!compound) { // Unique index entry value starts with document id
+    IW_SETVNUMBUF64(step, vnbuf, id);
+    rc = iwxstr_cat(val, vnbuf, step);
+    RCRET(rc);
+  }
+  if (idx->mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM)) {
+    return _jbi_build_text_doc(run, id, jbl, val);
+  }
+  if (idx->ncols) {
+    bool found;
+    iwxstr_clear(ckey);
+    rc = jbi_jbl_fill_ckey(idx, jbl, ckey, &found);
+    if (!rc && found) {
+      key.data = iwxstr_ptr(ckey);
+      key.size = iwxstr_size(ckey);
+      rc = _jbi_build_entry_add(run, &key, id, val);
+    }
+    return rc;
+  }
+  if (!_jbl_at(jbl, idx->ptr, &jbv)) {
+    return 0;
+  }
+  jbv_type = jbl_type(&jbv);
+  // Do not index NULLs, OBJECTs, ARRAYs (in `EJDB_IDX_UNIQUE` mode)
+  if (  ((jbv_type == JBV_OBJECT) || (jbv_type <= JBV_NULL))
+     || ((jbv_type == JBV_ARRAY) && !compound)) {
+    return 0;
+  }
+  if (idx->ipaths || (jbv_type == JBV_ARRAY)) {
+    pool = iwpool_create(1024);
+    if (!pool) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+  }
+  if (idx->ipaths) {
+    rc = jb_idx_fragment(idx, jbl, val, pool);
+    RCGO(rc, finish);
+  }
+  if (jbv_type == JBV_ARRAY) {
+    JBL_NODE n;
+    rc = jbl_to_node(&jbv, &n, false, pool);
+    RCGO(rc, finish);
+    for (n = n->child; n; n = n->next) {
+      jbi_node_fill_ikey(idx, n, &key, numbuf);
+      if (key.size) {
+        rc = _jbi_build_entry_add(run, &key, id, val);
+      }
+      jbi_ikey_dispose(idx, &key, numbuf);
+      RCGO(rc, finish);
+    }
+  } else {
+    jbi_jbl_fill_ikey(idx, &jbv, &key, numbuf);
+    if (key.size) {
+      rc = _jbi_build_entry_add(run, &key, id, val);
+    }
+    jbi_ikey_dispose(idx, &key, numbuf);
+  }
+
+finish:
+  if (pool) {
+    iwpool_destroy(pool);
+  }
+  return rc;
+}
+
+/**
+ * Writes sorted run entries sequentially into run file.
+ * Run entries are released afterwards.
+ */
+static iwrc _jbi_build_run_write(struct _JBIB_RUN *run) {
+  const uint8_t *ents = (const uint8_t*) iwxstr_ptr(run->ents);
+  iwrc rc = jbi_runf_open(&run->rf);
+  RCGO(rc, finish);
+  for (uint32_t i = 0; i < run->refs_num; ++i) {
+    const uint8_t *rec = ents + run->refs[i];
+    size_t sz = _jbi_build_rec_size(rec);
+    rc = jbi_runf_put(&run->rf, sz);
+    RCGO(rc, finish);
+    rc = jbi_runf_cat(&run->rf, rec, sz);
+    RCGO(rc, finish);
+  }
+  rc = jbi_runf_flush(&run->rf);
+
+finish:
+  jbi_runf_release(&run->rf);
+  iwxstr_destroy(run->ents);
+  free(run->refs);
+  run->ents = 0;
+  run->refs = 0;
+  run->refs_asz = 0;
+  return rc;
+}
+
+/**
+ * Extracts index entries of run documents and sorts them.
+ * Spilled run is written into temp file.
+ */
+static iwrc _jbi_build_run_sort(struct _JBIB_RUN *run) {
+  iwrc rc = 0;
+  struct _JBL jbl;
+  uint8_t *dp = run->docs, *ep = run->docs + run->docs_num;
+  IWXSTR *val = iwxstr_new(), *ckey = iwxstr_new();
+
+  run->ents = iwxstr_new();
+  if (!run->ents || !val || !ckey) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  while (dp < ep) {
+    int64_t id;
+    uint32_t sz;
+    memcpy(&id, dp, sizeof(id));
+    memcpy(&sz, dp + sizeof(id), sizeof(sz));
+    dp += _JBIB_DOC_HDR;
+    rc = jbl_from_buf_keep_onstack(&jbl, dp, sz);
+    RCGO(rc, finish);
+    rc = _jbi_build_doc(run, id, &jbl, val, ckey);
+    RCGO(rc, finish);
+    dp += sz;
+  }
+  free(run->docs);
+  run->docs = 0;
+  run->docs_asz = 0;
+
+  sort_r(run->refs, run->refs_num, sizeof(run->refs[0]), _jbi_build_cmp, run);
+  if (run->spill) {
+    rc = _jbi_build_run_write(run);
+  }
+
+finish:
+  iwxstr_destroy(val);
+  iwxstr_destroy(ckey);
+  return rc;
+}
+
+static void *_jbi_build_run_worker(void *op) {
+  struct _JBIB_RUN *run = op;
+  run->rc = _jbi_build_run_sort(run);
+  return 0;
+}
+
+static iwrc _jbi_build_run_join(struct _JBIB_RUN *run) {
+  if (run->thr_active) {
+    pthread_join(run->thr, 0);
+    run->thr_active = false;
+  }
+  return run->rc;
+}
+
+static iwrc _jbi_build_run_create(struct _JBIB *b, struct _JBIB_RUN **runp) {
+  *runp = 0;
+  struct _JBIB_RUN **nruns = realloc(b->runs, (b->runs_num + 1) * sizeof(b->runs[0]));
+  if (!nruns) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  b->runs = nruns;
+  struct _JBIB_RUN *run = calloc(1, sizeof(*run));
+  if (!run) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  run->idx = b->idx;
+  b->runs[b->runs_num++] = run;
+  *runp = run;
+  if (b->idx->filter) { // Filter is matched by run sorting thread
+    return jql_clone(b->idx->filter, &run->filter);
+  }
+  return 0;
+}
+
+/**
+ * Starts sorting of the last filled run.
+ * Run is sorted by a separate thread if `sort_threads` option is set.
+ */
+static iwrc _jbi_build_run_start(struct _JBIB *b, struct _JBIB_RUN *run, bool spill) {
+  iwrc rc;
+  run->spill = spill;
+  if (b->threads) {
+    // Keep at most `threads` runs sorted concurrently
+    while (b->runs_num - 1 - b->runs_joined >= b->threads) {
+      rc = _jbi_build_run_join(b->runs[b->runs_joined++]);
+      RCRET(rc);
+    }
+    if (!pthread_create(&run->thr, 0, _jbi_build_run_worker, run)) {
+      run->thr_active = true;
+      return 0;
+    }
+    // Sort run in the current thread if worker cannot be started
+  }
+  run->rc = _jbi_build_run_sort(run);
+  return run->rc;
+}
+
+static iwrc _jbi_build_docs_reserve(struct _JBIB_RUN *run, size_t size) {
+  if (size > run->docs_asz) {
+    size_t nsize = MAX(size, run->docs_asz * 2);
+    uint8_t *ndocs = realloc(run->docs, nsize);
+    if (!ndocs) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    run->docs = ndocs;
+    run->docs_asz = nsize;
+  }
+  return 0;
+}
+
+/**
+ * Appends document at cursor position to the run batch.
+ */
+static iwrc _jbi_build_doc_read(struct _JBIB_RUN *run, IWKV_cursor cur, size_t bufsz) {
+  size_t sz, vsz;
+  int64_t id;
+  uint32_t dsz;
+  iwrc rc = iwkv_cursor_copy_key(cur, &id, sizeof(id), &sz, 0);
+  RCRET(rc);
+  if (sz != sizeof(id)) {
+    rc = IWKV_ERROR_CORRUPTED;
+    iwlog_ecode_error3(rc);
+    return rc;
+  }
+  rc = _jbi_build_docs_reserve(run, run->docs_num + _JBIB_DOC_HDR + MIN(bufsz, 64 * 1024));
+  RCRET(rc);
+  uint8_t *wp = run->docs + run->docs_num;
+  rc = iwkv_cursor_copy_val(cur, wp + _JBIB_DOC_HDR, run->docs_asz - run->docs_num - _JBIB_DOC_HDR, &vsz);
+  RCRET(rc);
+  if (vsz > run->docs_asz - run->docs_num - _JBIB_DOC_HDR) {
+    rc = _jbi_build_docs_reserve(run, run->docs_num + _JBIB_DOC_HDR + vsz);
+    RCRET(rc);
+    wp = run->docs + run->docs_num;
+    rc = iwkv_cursor_copy_val(cur, wp + _JBIB_DOC_HDR, vsz, &vsz);
+    RCRET(rc);
+  }
+  dsz = vsz;
+  memcpy(wp, &id, sizeof(id));
+  memcpy(wp + sizeof(id), &dsz, sizeof(dsz));
+  run->docs_num += _JBIB_DOC_HDR + vsz;
+  return 0;
+}
+
+/**
+ * Sets `rec` of merge source to the next run entry.
+ * `eof` is set if run has no more entries.
+ */
+static iwrc _jbi_build_run_next(struct _JBMSRC *src, bool *eof) {
+  struct _JBIB_RUN *run = (void*) src;
+  if (!run->rf.fopen) {
+    *eof = run->refs_pos >= run->refs_num;
+    if (!*eof) {
+      src->rec = (const uint8_t*) iwxstr_ptr(run->ents) + run->refs[run->refs_pos++];
+    }
+    return 0;
+  }
+  iwrc rc = jbi_runf_next(&run->rf, eof);
+  src->rec = run->rf.rec;
+  return rc;
+}
+
+static void _jbi_build_run_close(struct _JBMSRC *src) {
+  struct _JBIB_RUN *run = (void*) src;
+  jbi_runf_release(&run->rf);
+}
+
+static int _jbi_build_merge_cmp(const uint8_t *r1, const uint8_t *r2, void *op) {
+  struct _JBIB *b = op;
+  return _jbi_build_rec_cmp(r1, r2, b->idx->idbf & IWDB_VNUM64_KEYS);
+}
+
+static size_t _jbi_build_merge_size(const uint8_t *rec, void *op) {
+  return _jbi_build_rec_size(rec);
+}
+
+static iwrc _jbi_build_put(const uint8_t *rec, void *op, bool *stop) {
+  struct _JBIB *b = op;
+  uint32_t klen, vlen;
+  int64_t id;
+  IWKV_val key, val;
+  JBIDX idx = b->idx;
+  bool compound = idx->idbf & IWDB_COMPOUND_KEYS;
+
+  memcpy(&klen, rec, sizeof(klen));
+  rec += sizeof(klen);
+  key.data = (void*) rec;
+  key.size = klen;
+  rec += klen;
+  memcpy(&id, rec, sizeof(id));
+  rec += sizeof(id);
+  memcpy(&vlen, rec, sizeof(vlen));
+  rec += sizeof(vlen);
+  val.data = (void*) rec;
+  val.size = vlen;
+  key.compound = compound ? id : 0;
+
+  iwrc rc = iwkv_put(idx->idb, &key, &val, IWKV_NO_OVERWRITE);
+  if (!rc) {
+    ++b->rnum;
+  } else if (rc == IWKV_ERROR_KEY_EXISTS) {
+    rc = compound ? 0 : EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED;
+  }
+  return rc;
+}
+
+/**
+ * Merge of sorted runs stored into index database.
+ */
+static iwrc _jbi_build_merge(struct _JBIB *b) {
+  iwrc rc;
+  struct _JBMSRC **srcs;
+
+  if (!b->runs_num) {
+    return 0;
+  }
+  srcs = malloc(b->runs_num * sizeof(srcs[0]));
+  if (!srcs) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (uint32_t i = 0; i < b->runs_num; ++i) {
+    struct _JBIB_RUN *run = b->runs[i];
+    run->src.next = _jbi_build_run_next;
+    run->src.close = _jbi_build_run_close;
+    srcs[i] = &run->src;
+  }
+  struct _JBMERGE m = {
+    .srcs     = srcs,
+    .srcs_num = b->runs_num,
+    .cmp      = _jbi_build_merge_cmp,
+    .size     = _jbi_build_merge_size,
+    .sink     = _jbi_build_put,
+    .op       = b
+  };
+  rc = jbi_merge(&m);
+  free(srcs);
+  return rc;
+}
+
+iwrc jbi_idx_build(JBIDX idx, int64_t *rnum) {
+  IWKV_cursor cur;
+  struct _JBIB_RUN *run = 0;
+  EJDB db = idx->jbc->db;
+  size_t bufsz = db->opts.sort_buffer_sz;
+  struct _JBIB b = {
+    .idx     = idx,
+    .threads = db->opts.sort_threads
+  };
+
+  *rnum = 0;
+  iwrc rc = iwkv_cursor_open(idx->jbc->cdb, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  RCRET(rc);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    if (!run) {
+      rc = _jbi_build_run_create(&b, &run);
+      RCBREAK(rc);
+    }
+    rc = _jbi_build_doc_read(run, cur, bufsz);
+    RCBREAK(rc);
+    if (run->docs_num >= bufsz) {
+      rc = _jbi_build_run_start(&b, run, true);
+      RCBREAK(rc);
+      run = 0;
+    }
+  }
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  IWRC(iwkv_cursor_close(&cur), rc);
+  RCGO(rc, finish);
+
+  if (run) { // Last run is kept in memory
+    rc = _jbi_build_run_start(&b, run, false);
+    RCGO(rc, finish);
+  }
+  for (uint32_t i = 0; i < b.runs_num; ++i) {
+    rc = _jbi_build_run_join(b.runs[i]);
+    RCGO(rc, finish);
+  }
+  rc = _jbi_build_merge(&b);
+
+finish:
+  *rnum = b.rnum;
+  for (uint32_t i = 0; i < b.runs_num; ++i) {
+    _jbi_build_run_destroy(b.runs[i]);
+  }
+  free(b.runs);
+  return rc;
+}
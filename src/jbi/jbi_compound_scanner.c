@@ -0,0 +1,201 @@
+#include "ejdb2_internal.h"
+
+// Compound index scanner.
+// Scans index keys within [lo, hi) byte range computed from equality
+// expressions of leading index columns and optional range expressions of the next column.
+
+static int _jbi_ckey_cmp(const void *key, size_t ksz, IWXSTR *bound) {
+  size_t bsz = iwxstr_size(bound);
+  int ret = memcmp(key, iwxstr_ptr(bound), MIN(ksz, bsz));
+  if (ret) {
+    return ret;
+  }
+  return ksz > bsz ? 1 : ksz < bsz ? -1 : 0;
+}
+
+iwrc jbi_compound_bounds(
+  struct _JBEXEC *ctx, struct _JBMIDX *midx,
+  IWXSTR *lo, IWXSTR *hi, bool *hi_inf, bool *empty) {
+
+  iwrc rc = 0;
+  bool added;
+  JBIDX idx = midx->idx;
+  JQP_AUX *aux = ctx->ux->q->aux;
+  static const uint8_t present = 0x01;
+
+  *hi_inf = false;
+  *empty = false;
+  iwxstr_clear(lo);
+  iwxstr_clear(hi);
+
+  // Key prefix matched by equality expressions
+  for (int i = 0; i < midx->neq; ++i) {
+    JQVAL *rv = jql_unit_to_jqval(aux, midx->cexprs[i]->right, &rc);
+    RCRET(rc);
+    rc = jbi_jqval_add_ckey(idx->ctypes[i], rv, lo, &added);
+    RCRET(rc);
+    if (!added) {
+      *empty = true;
+      return 0;
+    }
+  }
+  rc = iwxstr_cat(hi, iwxstr_ptr(lo), iwxstr_size(lo));
+  RCRET(rc);
+
+  if (midx->expr2) {
+    JQVAL *rv = jql_unit_to_jqval(aux, midx->expr2->right, &rc);
+    RCRET(rc);
+    rc = jbi_jqval_add_ckey(idx->ctypes[midx->neq], rv, hi, &added);
+    RCRET(rc);
+    if (added) {
+      if ((midx->expr2->op->value == JQP_OP_LTE) && !jbi_ckey_succ(hi)) {
+        *hi_inf = true;
+      }
+    } else {
+      iwxstr_pop(hi, iwxstr_size(hi) - iwxstr_size(lo));
+    }
+  }
+  if (iwxstr_size(hi) == iwxstr_size(lo)) { // No upper bound: all keys having prefix
+    *hi_inf = !jbi_ckey_succ(hi);
+  }
+
+  if (midx->expr1) {
+    size_t psz = iwxstr_size(lo);
+    JQVAL *rv = jql_unit_to_jqval(aux, midx->expr1->right, &rc);
+    RCRET(rc);
+    rc = jbi_jqval_add_ckey(idx->ctypes[midx->neq], rv, lo, &added);
+    RCRET(rc);
+    if (added && (midx->expr1->op->value == JQP_OP_GT) && !jbi_ckey_succ(lo)) {
+      *empty = true;
+      return 0;
+    }
+    if (!added) {
+      iwxstr_pop(lo, iwxstr_size(lo) - psz);
+    }
+  }
+  if (midx->expr2 && !midx->expr1) {
+    // Skip documents having no value of ranged column
+    rc = iwxstr_cat(lo, &present, 1);
+    RCRET(rc);
+  }
+  if (!*hi_inf && (_jbi_ckey_cmp(iwxstr_ptr(lo), iwxstr_size(lo), hi) >= 0)) {
+    *empty = true;
+  }
+  return rc;
+}
+
+iwrc jbi_compound_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
+  size_t sz;
+  bool hi_inf, empty;
+  char numbuf[JBNUMBUF_SIZE];
+
+  iwrc rc = 0;
+  int64_t step = 1;
+  IWKV_cursor cur = 0;
+  IWKV_val key = { .compound = INT64_MIN };
+  struct _JBMIDX *midx = &ctx->midx;
+  JBIDX idx = midx->idx;
+  bool compound = idx->idbf & IWDB_COMPOUND_KEYS;
+  bool desc = (midx->cursor_step == IWKV_CURSOR_NEXT);
+  IWKV_cursor_op cursor_reverse_step = desc ? IWKV_CURSOR_PREV : IWKV_CURSOR_NEXT;
+  size_t kbufsz = 256;
+  char *kbuf = malloc(kbufsz);
+  IWXSTR *lo = iwxstr_new(), *hi = iwxstr_new();
+
+  if (!kbuf || !lo || !hi) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  rc = jbi_compound_bounds(ctx, midx, lo, hi, &hi_inf, &empty);
+  RCGO(rc, finish);
+  if (empty) {
+    goto finish;
+  }
+
+  if (desc) { // Position cursor before the first key not less than `hi`
+    if (!hi_inf) {
+      key.data = iwxstr_ptr(hi);
+      key.size = iwxstr_size(hi);
+      rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_GE, &key);
+      if (rc == IWKV_ERROR_NOTFOUND) {
+        iwkv_cursor_close(&cur);
+        hi_inf = true;
+      } else {
+        RCGO(rc, finish);
+      }
+    }
+    if (hi_inf) {
+      rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+      RCGO(rc, finish);
+    }
+    rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT);
+    RCGO(rc, finish);
+  } else if (iwxstr_size(lo)) {
+    key.data = iwxstr_ptr(lo);
+    key.size = iwxstr_size(lo);
+    rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_GE, &key);
+    RCGO(rc, finish);
+  } else {
+    rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_AFTER_LAST, 0);
+    RCGO(rc, finish);
+    rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV);
+    RCGO(rc, finish);
+  }
+
+  do {
+    if (step > 0) {
+      --step;
+    } else if (step < 0) {
+      ++step;
+    }
+    if (!step) {
+      int64_t id;
+      bool matched;
+      rc = iwkv_cursor_copy_key(cur, kbuf, kbufsz, &sz, &id);
+      RCGO(rc, finish);
+      if (sz > kbufsz) {
+        char *nbuf = realloc(kbuf, sz);
+        if (!nbuf) {
+          rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+          goto finish;
+        }
+        kbuf = nbuf;
+        kbufsz = sz;
+        rc = iwkv_cursor_copy_key(cur, kbuf, kbufsz, &sz, &id);
+        RCGO(rc, finish);
+      }
+      if (desc ? (_jbi_ckey_cmp(kbuf, sz, lo) < 0) : (!hi_inf && (_jbi_ckey_cmp(kbuf, sz, hi) >= 0))) {
+        break;
+      }
+      if (!compound) {
+        rc = iwkv_cursor_copy_val(cur, &numbuf, IW_VNUMBUFSZ, &sz);
+        RCGO(rc, finish);
+        if (sz > IW_VNUMBUFSZ) {
+          rc = IWKV_ERROR_CORRUPTED;
+          iwlog_ecode_error3(rc);
+          break;
+        }
+        IW_READVNUMBUF64_2(numbuf, id);
+      }
+      step = 1;
+      rc = consumer(ctx, 0, id, &step, &matched, 0);
+      RCGO(rc, finish);
+    }
+  } while (step && !(rc = iwkv_cursor_to(cur, step > 0 ? midx->cursor_step : cursor_reverse_step)));
+
+finish:
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  if (cur) {
+    iwkv_cursor_close(&cur);
+  }
+  free(kbuf);
+  if (lo) {
+    iwxstr_destroy(lo);
+  }
+  if (hi) {
+    iwxstr_destroy(hi);
+  }
+  return consumer(ctx, 0, 0, 0, 0, rc);
+}
@@ -6,14 +6,21 @@ iwrc jbi_consumer(struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id, int64_t *ste
   }
 
   iwrc rc;
-  struct _JBL jbl;
+  struct _JBL jbl, pjbl;
+  bool inplace = false;
   size_t vsz = 0;
   EJDB_EXEC *ux = ctx->ux;
   IWPOOL *pool = ux->pool;
 
 start:
   {
-    if (cur) {
+    if (ctx->covering) { // Document fragment is loaded by scanner from covering index entry
+      vsz = ctx->cvdoc.size;
+      if (vsz <= ctx->jblbufsz) {
+        memcpy(ctx->jblbuf, ctx->cvdoc.data, vsz);
+      }
+      rc = 0;
+    } else if (cur) {
       rc = iwkv_cursor_copy_val(cur, ctx->jblbuf, ctx->jblbufsz, &vsz);
     } else {
       IWKV_val key = {
@@ -53,7 +60,11 @@ start:
   rc = jbl_from_buf_keep_onstack(&jbl, ctx->jblbuf, vsz);
   RCGO(rc, finish);
 
-  rc = jql_matched(ux->q, &jbl, matched);
+  if (ctx->prematched) {
+    *matched = true;
+  } else {
+    rc = jql_matched(ux->q, &jbl, matched);
+  }
   if (rc || !*matched || (ux->skip && (ux->skip-- > 0))) {
     goto finish;
   }
@@ -70,7 +81,31 @@ start:
       .id  = id,
       .raw = &jbl
     };
-    if (aux->apply || aux->apply_placeholder || aux->projection) {
+    if (  (aux->apply || aux->apply_placeholder) && !aux->projection
+       && !(aux->qmode & JQP_QRY_APPLY_DEL)) {
+      pjbl = jbl; // Patched copy, `doc.raw` keeps document as it was before patch
+      rc = jql_apply_inplace(q, &pjbl, &inplace);
+      RCGO(rc, finish);
+    }
+    if (inplace) {
+      if (cur) {
+        rc = jb_cursor_set(ctx->jbc, cur, id, &pjbl);
+      } else {
+        rc = jb_put(ctx->jbc, &pjbl, id);
+      }
+      RCGO(rc, finish);
+      if (!(aux->qmode & JQP_QRY_AGGREGATE)) { // Node of patched document is built only for visitor
+        if (!pool) {
+          pool = iwpool_create(pjbl.bn.size * 2);
+          if (!pool) {
+            rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+            goto finish;
+          }
+        }
+        rc = jbl_to_node(&pjbl, &doc.node, true, pool);
+        RCGO(rc, finish);
+      }
+    } else if (aux->apply || aux->apply_placeholder || aux->projection) {
       JBL_NODE root;
       if (!pool) {
         pool = iwpool_create(jbl.bn.size * 2);
@@ -131,8 +166,28 @@ start:
   }
 
 finish:
+  if (inplace) {
+    binn_free(&pjbl.bn);
+  }
   if (pool && (pool != ctx->ux->pool)) {
     iwpool_destroy(pool);
   }
   return rc;
 }
+
+iwrc jbi_count_consumer(struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id, int64_t *step, bool *matched, iwrc err) {
+  if (!id) { // EOF scan
+    return err;
+  }
+  EJDB_EXEC *ux = ctx->ux;
+  *matched = true;
+  *step = 1;
+  if (ux->skip && (ux->skip-- > 0)) {
+    return 0;
+  }
+  ++ux->cnt;
+  if (--ux->limit < 1) {
+    *step = 0;
+  }
+  return 0;
+}
@@ -19,10 +19,9 @@ static iwrc _jbi_consume_eq(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUMER
     return consumer(ctx, 0, 0, 0, 0, 0);
   }
   rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_GE, &key);
-  if (rc == IWKV_ERROR_NOTFOUND) {
-    return consumer(ctx, 0, 0, 0, 0, 0);
-  } else {
-    RCRET(rc);
+  if (rc) {
+    jbi_ikey_dispose(idx, &key, numbuf);
+    return rc == IWKV_ERROR_NOTFOUND ? consumer(ctx, 0, 0, 0, 0, 0) : rc;
   }
 
   do {
@@ -39,6 +38,10 @@ static iwrc _jbi_consume_eq(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUMER
         break;
       }
       step = 1;
+      if (ctx->covering) {
+        rc = jbi_covering_load(ctx, cur, 0);
+        RCGO(rc, finish);
+      }
       rc = consumer(ctx, 0, id, &step, &matched, 0);
       RCGO(rc, finish);
     }
@@ -51,6 +54,7 @@ finish:
   if (cur) {
     iwkv_cursor_close(&cur);
   }
+  jbi_ikey_dispose(idx, &key, numbuf);
   return consumer(ctx, 0, 0, 0, 0, rc);
 }
 
@@ -102,6 +106,7 @@ static iwrc _jbi_consume_in_node(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONS
 
   for (int c = 0; c < i && !rc; ++c) {
     JQVAL *jqv = &jqvarr[c];
+    jbi_ikey_dispose(idx, &key, numbuf);
     jbi_jqval_fill_ikey(idx, jqv, &key, numbuf);
     if (cur) {
       iwkv_cursor_close(&cur);
@@ -121,6 +126,10 @@ static iwrc _jbi_consume_in_node(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONS
           break;
         }
         step = 1;
+        if (ctx->covering) {
+          rc = jbi_covering_load(ctx, cur, 0);
+          RCGO(rc, finish);
+        }
         rc = consumer(ctx, 0, id, &step, &matched, 0);
         RCGO(rc, finish);
       }
@@ -137,6 +146,7 @@ finish:
   if ((char*) jqvarr != jqvarrbuf) {
     free(jqvarr);
   }
+  jbi_ikey_dispose(idx, &key, numbuf);
   return consumer(ctx, 0, 0, 0, 0, rc);
 }
 
@@ -148,7 +158,7 @@ static iwrc _jbi_consume_scan(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUME
   int64_t step = 1, prev_id = 0;
   struct _JBMIDX *midx = &ctx->midx;
   JBIDX idx = midx->idx;
-  jqp_op_t expr1_op = midx->expr1->op->value;
+  jqp_op_t expr1_op = jbi_op_cased(midx->expr1->op->value);
 
   IWKV_val key;
   jbi_jqval_fill_ikey(idx, jqval, &key, numbuf);
@@ -158,6 +168,7 @@ static iwrc _jbi_consume_scan(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUME
   key.compound = (midx->cursor_step == IWKV_CURSOR_PREV) ? INT64_MIN : INT64_MAX;
 
   iwrc rc = iwkv_cursor_open(idx->idb, &cur, midx->cursor_init, &key);
+  jbi_ikey_dispose(idx, &key, numbuf);
   if ((rc == IWKV_ERROR_NOTFOUND) && ((expr1_op == JQP_OP_LT) || (expr1_op == JQP_OP_LTE))) {
     iwkv_cursor_close(&cur);
     key.compound = INT64_MAX;
@@ -202,6 +213,10 @@ static iwrc _jbi_consume_scan(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUME
       RCGO(rc, finish);
       step = 1;
       if (id != prev_id) {
+        if (ctx->covering) {
+          rc = jbi_covering_load(ctx, cur, 0);
+          RCGO(rc, finish);
+        }
         rc = consumer(ctx, 0, id, &step, &matched, 0);
         RCGO(rc, finish);
         if (!midx->expr1->prematched && matched && (expr1_op != JQP_OP_PREFIX)) {
@@ -250,6 +265,10 @@ static iwrc _jbi_consume_noxpr_scan(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consum
       RCGO(rc, finish);
       step = 1;
       if (id != prev_id) {
+        if (ctx->covering) {
+          rc = jbi_covering_load(ctx, cur, 0);
+          RCGO(rc, finish);
+        }
         rc = consumer(ctx, 0, id, &step, &matched, 0);
         RCGO(rc, finish);
         prev_id = step < 1 ? 0 : id;
@@ -276,7 +295,7 @@ iwrc jbi_dup_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
   JQP_QUERY *qp = ctx->ux->q->qp;
   JQVAL *jqval = jql_unit_to_jqval(qp->aux, midx->expr1->right, &rc);
   RCRET(rc);
-  switch (midx->expr1->op->value) {
+  switch (jbi_op_cased(midx->expr1->op->value)) {
     case JQP_OP_EQ:
       return _jbi_consume_eq(ctx, jqval, consumer);
     case JQP_OP_IN:
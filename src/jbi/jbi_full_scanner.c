@@ -1,9 +1,389 @@
 #include "ejdb2_internal.h"
 
+/** Range of collection document ids scanned by parallel scan worker */
+struct _JBPS_RANGE {
+  int64_t  lo;        /**< Lower id bound, inclusive */
+  int64_t  hi;        /**< Upper id bound, inclusive */
+  int64_t *ids;       /**< Ids of matched documents in ascending order */
+  size_t   num;       /**< Number of matched ids */
+  size_t   asz;       /**< Allocated size of ids array */
+  iwrc     rc;        /**< Range scan error code */
+  bool     done;      /**< Range scan completed */
+  bool     queued;    /**< Range is queued for consumer */
+};
+
+/** Parallel scan context */
+struct _JBPS {
+  JBEXEC *ctx;
+  struct _JBPS_RANGE *ranges;
+  int  ranges_num;
+  int  next;          /**< Next range to be taken by worker */
+  int  active;        /**< Number of active workers */
+  iwrc rc;            /**< First error of workers */
+  volatile bool   stop;
+  pthread_mutex_t mtx;
+  pthread_cond_t  cond;
+};
+
+/** Parallel scan worker */
+struct _JBPS_WORKER {
+  struct _JBPS *ps;
+  JQL       q;        /**< Worker copy of query */
+  uint8_t  *buf;      /**< Document buffer */
+  size_t    bufsz;
+  pthread_t thr;
+  bool      started;
+};
+
+static iwrc _jbi_ps_scan_range(struct _JBPS_WORKER *w, struct _JBPS_RANGE *r) {
+  IWKV_cursor cur;
+  int64_t id = r->lo;
+  IWKV_val key = {
+    .data = &id,
+    .size = sizeof(id)
+  };
+  iwrc rc = iwkv_cursor_open(w->ps->ctx->jbc->cdb, &cur, IWKV_CURSOR_GE, &key);
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    return 0;
+  }
+  RCRET(rc);
+  do {
+    size_t sz, vsz;
+    bool matched;
+    struct _JBL jbl;
+    if (w->ps->stop) {
+      break;
+    }
+    RCC(rc, finish, iwkv_cursor_copy_key(cur, &id, sizeof(id), &sz, 0));
+    if (sz != sizeof(id)) {
+      rc = IWKV_ERROR_CORRUPTED;
+      iwlog_ecode_error3(rc);
+      goto finish;
+    }
+    if (id > r->hi) {
+      break;
+    }
+    RCC(rc, finish, iwkv_cursor_copy_val(cur, w->buf, w->bufsz, &vsz));
+    if (vsz > w->bufsz) {
+      size_t nsize = MAX(vsz, w->bufsz * 2);
+      void *nbuf = realloc(w->buf, nsize);
+      if (!nbuf) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        goto finish;
+      }
+      w->buf = nbuf;
+      w->bufsz = nsize;
+      RCC(rc, finish, iwkv_cursor_copy_val(cur, w->buf, w->bufsz, &vsz));
+    }
+    RCC(rc, finish, jbl_from_buf_keep_onstack(&jbl, w->buf, vsz));
+    RCC(rc, finish, jql_matched(w->q, &jbl, &matched));
+    if (matched) {
+      if (r->num >= r->asz) {
+        size_t nsize = r->asz ? r->asz * 2 : 1024;
+        int64_t *nids = realloc(r->ids, nsize * sizeof(r->ids[0]));
+        if (!nids) {
+          rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+          goto finish;
+        }
+        r->ids = nids;
+        r->asz = nsize;
+      }
+      r->ids[r->num++] = id;
+    }
+  } while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV))); // Ascending ids order
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+
+finish:
+  iwkv_cursor_close(&cur);
+  return rc;
+}
+
+static void *_jbi_ps_worker(void *op) {
+  struct _JBPS_WORKER *w = op;
+  struct _JBPS *ps = w->ps;
+  while (1) {
+    struct _JBPS_RANGE *r = 0;
+    pthread_mutex_lock(&ps->mtx);
+    if (!ps->stop && (ps->next < ps->ranges_num)) {
+      r = &ps->ranges[ps->next++];
+    }
+    pthread_mutex_unlock(&ps->mtx);
+    if (!r) {
+      break;
+    }
+    iwrc rc = _jbi_ps_scan_range(w, r);
+    pthread_mutex_lock(&ps->mtx);
+    r->rc = rc;
+    r->done = true;
+    if (rc) {
+      if (!ps->rc) {
+        ps->rc = rc;
+      }
+      ps->stop = true;
+    }
+    pthread_cond_broadcast(&ps->cond);
+    pthread_mutex_unlock(&ps->mtx);
+  }
+  pthread_mutex_lock(&ps->mtx);
+  --ps->active;
+  pthread_cond_broadcast(&ps->cond);
+  pthread_mutex_unlock(&ps->mtx);
+  return 0;
+}
+
+/**
+ * Waits for the next range to be passed to consumer.
+ * In ordered mode ranges are consumed in the scan order,
+ * otherwise in order of their completion.
+ * Sets `*rp` to zero if no more ranges available.
+ */
+static iwrc _jbi_ps_next_range(struct _JBPS *ps, int idx, bool ordered, struct _JBPS_RANGE **rp) {
+  iwrc rc = 0;
+  *rp = 0;
+  pthread_mutex_lock(&ps->mtx);
+  while (1) {
+    if (ordered) {
+      if (idx < ps->ranges_num) {
+        struct _JBPS_RANGE *r = &ps->ranges[idx];
+        if (r->done) {
+          rc = r->rc;
+          *rp = r;
+          break;
+        }
+      } else {
+        break;
+      }
+    } else {
+      int i = 0;
+      for ( ; i < ps->ranges_num && (!ps->ranges[i].done || ps->ranges[i].queued); ++i) ;
+      if (i < ps->ranges_num) {
+        struct _JBPS_RANGE *r = &ps->ranges[i];
+        r->queued = true;
+        rc = r->rc;
+        *rp = r;
+        break;
+      }
+    }
+    if (!ps->active) {
+      // Workers are gone but not all ranges scanned
+      if (!ps->stop) {
+        for (int i = 0; i < ps->ranges_num; ++i) {
+          if (!ps->ranges[i].done) {
+            rc = IW_ERROR_INVALID_STATE;
+            break;
+          }
+        }
+      } else {
+        rc = ps->rc;
+      }
+      break;
+    }
+    pthread_cond_wait(&ps->cond, &ps->mtx);
+  }
+  pthread_mutex_unlock(&ps->mtx);
+  if (rc) {
+    *rp = 0;
+  }
+  return rc;
+}
+
+static iwrc _jbi_full_scanner_parallel(
+  struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer,
+  int threads, int64_t min_id, int64_t max_id) {
+  iwrc rc = 0;
+  struct JQP_AUX *aux = ctx->ux->q->aux;
+  bool desc = (ctx->cursor_step == IWKV_CURSOR_NEXT);
+  bool ordered = !ctx->sorting && !(aux->qmode & JQP_QRY_AGGREGATE);
+  uint64_t span = (uint64_t) (max_id - min_id) + 1;
+  uint64_t width = span / ((uint64_t) threads * JB_PARALLEL_SCAN_THREAD_RANGES);
+  if (width < 1) {
+    width = 1;
+  }
+  struct _JBPS ps = {
+    .ctx        = ctx,
+    .ranges_num = (int) ((span + width - 1) / width),
+    .mtx        = PTHREAD_MUTEX_INITIALIZER,
+    .cond       = PTHREAD_COND_INITIALIZER
+  };
+  struct _JBPS_WORKER *workers = calloc(threads, sizeof(*workers));
+  struct _JBPS_RANGE **queue = calloc(ps.ranges_num, sizeof(*queue));
+  ps.ranges = calloc(ps.ranges_num, sizeof(*ps.ranges));
+  if (!workers || !queue || !ps.ranges) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  for (int i = 0; i < ps.ranges_num; ++i) {
+    struct _JBPS_RANGE *r = &ps.ranges[i];
+    if (desc) {
+      r->hi = max_id - (int64_t) (i * width);
+      r->lo = MAX(r->hi - (int64_t) width + 1, min_id);
+    } else {
+      r->lo = min_id + (int64_t) (i * width);
+      r->hi = MIN(r->lo + (int64_t) width - 1, max_id);
+    }
+  }
+  for (int i = 0; i < threads; ++i) {
+    struct _JBPS_WORKER *w = &workers[i];
+    w->ps = &ps;
+    w->bufsz = ctx->jblbufsz;
+    w->buf = malloc(w->bufsz);
+    if (!w->buf) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    RCC(rc, finish, jql_clone(ctx->ux->q, &w->q));
+  }
+  for (int i = 0; i < threads; ++i) {
+    struct _JBPS_WORKER *w = &workers[i];
+    pthread_mutex_lock(&ps.mtx);
+    int rci = pthread_create(&w->thr, 0, _jbi_ps_worker, w);
+    if (!rci) {
+      w->started = true;
+      ++ps.active;
+    }
+    pthread_mutex_unlock(&ps.mtx);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      goto finish;
+    }
+  }
+  if (ctx->ux->log) {
+    iwxstr_printf(ctx->ux->log, "[SCANNER] PARALLEL %d %s\n", threads, ordered ? "ORDERED" : "UNORDERED");
+  }
+
+  // Pass matched documents to consumer
+  ctx->prematched = true;
+  int qnum = 0, k = 0;
+  int64_t p = -1, step = 1;
+  while (step) {
+    if (step > 0) {
+      --step;
+      ++p;
+      while (k >= qnum || p >= queue[k]->num) {
+        if (k < qnum) {
+          ++k;
+          p = 0;
+        }
+        if (k == qnum) {
+          struct _JBPS_RANGE *r;
+          RCC(rc, finish, _jbi_ps_next_range(&ps, qnum, ordered, &r));
+          if (!r) {
+            goto finish;
+          }
+          queue[qnum++] = r;
+        }
+      }
+    } else {
+      ++step;
+      --p;
+      while (p < 0) {
+        if (--k < 0) {
+          goto finish;
+        }
+        p = (int64_t) queue[k]->num - 1;
+      }
+    }
+    if (!step) {
+      bool matched = false;
+      struct _JBPS_RANGE *r = queue[k];
+      int64_t id = desc ? r->ids[r->num - p - 1] : r->ids[p];
+      step = 1;
+      RCC(rc, finish, consumer(ctx, 0, id, &step, &matched, 0));
+    }
+  }
+
+finish:
+  ctx->prematched = false;
+  pthread_mutex_lock(&ps.mtx);
+  ps.stop = true;
+  pthread_mutex_unlock(&ps.mtx);
+  if (workers) {
+    for (int i = 0; i < threads; ++i) {
+      struct _JBPS_WORKER *w = &workers[i];
+      if (w->started) {
+        pthread_join(w->thr, 0);
+      }
+      jql_destroy(&w->q);
+      free(w->buf);
+    }
+    free(workers);
+  }
+  if (ps.ranges) {
+    for (int i = 0; i < ps.ranges_num; ++i) {
+      free(ps.ranges[i].ids);
+    }
+    free(ps.ranges);
+  }
+  free(queue);
+  pthread_cond_destroy(&ps.cond);
+  pthread_mutex_destroy(&ps.mtx);
+  return consumer(ctx, 0, 0, 0, 0, rc);
+}
+
+static iwrc _jbi_coll_id_bound(JBCOLL jbc, IWKV_cursor_op op, int64_t *out) {
+  size_t sz;
+  IWKV_cursor cur;
+  *out = 0;
+  iwrc rc = iwkv_cursor_open(jbc->cdb, &cur, op, 0);
+  RCRET(rc);
+  rc = iwkv_cursor_to(cur, op == IWKV_CURSOR_BEFORE_FIRST ? IWKV_CURSOR_NEXT : IWKV_CURSOR_PREV);
+  if (!rc) {
+    rc = iwkv_cursor_copy_key(cur, out, sizeof(*out), &sz, 0);
+    if (!rc && (sz != sizeof(*out))) {
+      rc = IWKV_ERROR_CORRUPTED;
+      iwlog_ecode_error3(rc);
+    }
+  }
+  iwkv_cursor_close(&cur);
+  return rc;
+}
+
+/**
+ * Returns number of threads used to scan collection or zero
+ * if collection should be scanned sequentially.
+ */
+static int _jbi_full_scanner_threads(struct _JBEXEC *ctx) {
+  JBCOLL jbc = ctx->jbc;
+  JQL q = ctx->ux->q;
+  int threads = (int) jbc->db->opts.full_scan_threads;
+  if (  (threads < 2)
+     || (jbc->rnum < JB_PARALLEL_SCAN_MIN_RECORDS)
+     || jql_has_apply(q)
+     || jql_has_apply_delete(q)) {
+    return 0;
+  }
+  JQP_EXPR_NODE *en = q->aux->expr;
+  if (en->chain && !en->chain->next && !en->next && (en->chain->type == JQP_FILTER_TYPE)) {
+    JQP_NODE *n = ((JQP_FILTER*) en->chain)->node;
+    if (n && ((n->ntype == JQP_NODE_ANYS) || (n->ntype == JQP_NODE_ANY)) && !n->next) {
+      return 0; // Query matches everything, nothing to do in parallel
+    }
+  }
+  return threads;
+}
+
 iwrc jbi_full_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
   bool matched;
   IWKV_cursor cur;
   int64_t step = 1;
+
+  int threads = _jbi_full_scanner_threads(ctx);
+  if (threads) {
+    int64_t min_id, max_id;
+    iwrc rc = _jbi_coll_id_bound(ctx->jbc, IWKV_CURSOR_BEFORE_FIRST, &max_id);
+    if (!rc) {
+      rc = _jbi_coll_id_bound(ctx->jbc, IWKV_CURSOR_AFTER_LAST, &min_id);
+    }
+    if (rc == IWKV_ERROR_NOTFOUND) {
+      return consumer(ctx, 0, 0, 0, 0, 0);
+    } else if (rc) {
+      return consumer(ctx, 0, 0, 0, 0, rc);
+    }
+    return _jbi_full_scanner_parallel(ctx, consumer, threads, min_id, max_id);
+  }
+
   iwrc rc = iwkv_cursor_open(ctx->jbc->cdb, &cur, ctx->cursor_init, 0);
   RCRET(rc);
 
@@ -0,0 +1,268 @@
+#include "ejdb2_internal.h"
+
+// External merge of sorted runs shared by query sorter and bulk index build.
+// Runs are stored in temp files as `[uint32 size][record]` sequences,
+// record layout is defined by the caller merging them.
+//
+// At most `JB_SORT_MERGE_FANIN` sources are merged at once so the number
+// of open read buffers is bounded. If there are more sources, groups of them
+// are merged into intermediate runs first, the first pass merges just enough
+// sources so every later pass merges exactly `JB_SORT_MERGE_FANIN` sources.
+
+/** Intermediate run produced by merge pass */
+struct _JBMRUN {
+  struct _JBMSRC src;
+  struct _JBRUNF rf;
+};
+
+iwrc jbi_runf_open(struct _JBRUNF *rf) {
+  IWFS_EXT_OPTS opts = {
+    .rspolicy = iw_exfile_szpolicy_fibo,
+    .file     = {
+      .path   = "jb-",
+      .omode  = IWFS_OTMP | IWFS_OUNLINK
+    }
+  };
+  rf->wbuf = iwxstr_new2(JB_SORT_RUN_BUFSZ);
+  if (!rf->wbuf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  iwrc rc = iwfs_exfile_open(&rf->f, &opts);
+  RCRET(rc);
+  rf->fopen = true;
+  return 0;
+}
+
+iwrc jbi_runf_flush(struct _JBRUNF *rf) {
+  size_t sp;
+  if (!iwxstr_size(rf->wbuf)) {
+    return 0;
+  }
+  iwrc rc = rf->f.write(&rf->f, rf->fsz, iwxstr_ptr(rf->wbuf), iwxstr_size(rf->wbuf), &sp);
+  RCRET(rc);
+  rf->fsz += iwxstr_size(rf->wbuf);
+  iwxstr_clear(rf->wbuf);
+  return 0;
+}
+
+iwrc jbi_runf_put(struct _JBRUNF *rf, uint32_t size) {
+  if (iwxstr_size(rf->wbuf) >= JB_SORT_RUN_BUFSZ) {
+    iwrc rc = jbi_runf_flush(rf);
+    RCRET(rc);
+  }
+  return iwxstr_cat(rf->wbuf, &size, sizeof(size));
+}
+
+iwrc jbi_runf_cat(struct _JBRUNF *rf, const void *buf, size_t len) {
+  return iwxstr_cat(rf->wbuf, buf, len);
+}
+
+static iwrc _jbi_runf_read(struct _JBRUNF *rf, void *buf, size_t len) {
+  uint8_t *wp = buf;
+  while (len) {
+    if (rf->rbuf_pos == rf->rbuf_len) {
+      size_t sp, rsz = MIN(JB_SORT_RUN_BUFSZ, rf->fsz - rf->roff);
+      if (!rsz) {
+        return IW_ERROR_FAIL; // Unexpected end of run file
+      }
+      iwrc rc = rf->f.read(&rf->f, rf->roff, rf->rbuf, rsz, &sp);
+      RCRET(rc);
+      if (!sp) {
+        return IW_ERROR_FAIL;
+      }
+      rf->roff += sp;
+      rf->rbuf_len = sp;
+      rf->rbuf_pos = 0;
+    }
+    size_t n = MIN(len, rf->rbuf_len - rf->rbuf_pos);
+    memcpy(wp, rf->rbuf + rf->rbuf_pos, n);
+    rf->rbuf_pos += n;
+    wp += n;
+    len -= n;
+  }
+  return 0;
+}
+
+iwrc jbi_runf_next(struct _JBRUNF *rf, bool *eof) {
+  iwrc rc;
+  uint32_t size;
+  *eof = (rf->roff >= rf->fsz) && (rf->rbuf_pos == rf->rbuf_len);
+  if (*eof) {
+    return 0;
+  }
+  if (!rf->rbuf) {
+    rf->rbuf = malloc(JB_SORT_RUN_BUFSZ);
+    if (!rf->rbuf) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+  }
+  rc = _jbi_runf_read(rf, &size, sizeof(size));
+  RCRET(rc);
+  if (size > rf->rec_asz) {
+    size_t nsize = MAX(size, rf->rec_asz * 2);
+    uint8_t *nrec = realloc(rf->rec, nsize);
+    if (!nrec) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    rf->rec = nrec;
+    rf->rec_asz = nsize;
+  }
+  return _jbi_runf_read(rf, rf->rec, size);
+}
+
+void jbi_runf_release(struct _JBRUNF *rf) {
+  iwxstr_destroy(rf->wbuf);
+  free(rf->rbuf);
+  free(rf->rec);
+  rf->wbuf = 0;
+  rf->rbuf = 0;
+  rf->rec = 0;
+  rf->rec_asz = 0;
+}
+
+void jbi_runf_close(struct _JBRUNF *rf) {
+  jbi_runf_release(rf);
+  if (rf->fopen) {
+    rf->f.close(&rf->f);
+    rf->fopen = false;
+  }
+}
+
+static iwrc _jbi_mrun_next(struct _JBMSRC *src, bool *eof) {
+  struct _JBMRUN *run = (void*) src;
+  iwrc rc = jbi_runf_next(&run->rf, eof);
+  src->rec = run->rf.rec;
+  return rc;
+}
+
+static void _jbi_mrun_close(struct _JBMSRC *src) {
+  struct _JBMRUN *run = (void*) src;
+  jbi_runf_close(&run->rf);
+}
+
+static void _jbi_merge_sift_down(struct _JBMERGE *m, struct _JBMSRC **h, uint32_t n, uint32_t i) {
+  while (1) {
+    uint32_t c = i, l = 2 * i + 1, r = l + 1;
+    if ((l < n) && (m->cmp(h[l]->rec, h[c]->rec, m->op) < 0)) {
+      c = l;
+    }
+    if ((r < n) && (m->cmp(h[r]->rec, h[c]->rec, m->op) < 0)) {
+      c = r;
+    }
+    if (c == i) {
+      break;
+    }
+    struct _JBMSRC *t = h[i];
+    h[i] = h[c];
+    h[c] = t;
+    i = c;
+  }
+}
+
+/**
+ * Merges `num` sources into `out` run if set, into `m->sink` otherwise.
+ * Sources are closed as soon as they are exhausted.
+ */
+static iwrc _jbi_merge_pass(struct _JBMERGE *m, struct _JBMSRC **srcs, uint32_t num, struct _JBMRUN *out) {
+  iwrc rc = 0;
+  bool eof, stop = false;
+  uint32_t hnum = 0;
+  struct _JBMSRC **heap = malloc(num * sizeof(heap[0]));
+  if (!heap) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (uint32_t i = 0; i < num; ++i) {
+    struct _JBMSRC *src = srcs[i];
+    rc = src->next(src, &eof);
+    RCGO(rc, finish);
+    if (!eof) {
+      heap[hnum++] = src;
+    } else if (src->close) {
+      src->close(src);
+    }
+  }
+  for (int64_t i = (int64_t) hnum / 2 - 1; i >= 0; --i) {
+    _jbi_merge_sift_down(m, heap, hnum, i);
+  }
+  while (hnum && !stop) {
+    struct _JBMSRC *src = heap[0];
+    if (out) {
+      size_t sz = m->size(src->rec, m->op);
+      rc = jbi_runf_put(&out->rf, sz);
+      RCGO(rc, finish);
+      rc = jbi_runf_cat(&out->rf, src->rec, sz);
+    } else {
+      rc = m->sink(src->rec, m->op, &stop);
+    }
+    RCGO(rc, finish);
+    rc = src->next(src, &eof);
+    RCGO(rc, finish);
+    if (eof) {
+      if (src->close) {
+        src->close(src);
+      }
+      heap[0] = heap[--hnum];
+    }
+    _jbi_merge_sift_down(m, heap, hnum, 0);
+  }
+  if (out) {
+    rc = jbi_runf_flush(&out->rf);
+  }
+
+finish:
+  free(heap);
+  return rc;
+}
+
+iwrc jbi_merge(struct _JBMERGE *m) {
+  iwrc rc = 0;
+  uint32_t num = m->srcs_num, pos = 0, tnum = 0;
+  struct _JBMRUN **tmps = 0;
+  struct _JBMSRC **srcs;
+
+  if (!num) {
+    return 0;
+  }
+  // Every intermediate pass replaces at least two sources by one
+  srcs = malloc(2 * num * sizeof(srcs[0]));
+  if (!srcs) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  memcpy(srcs, m->srcs, num * sizeof(srcs[0]));
+  if (num > JB_SORT_MERGE_FANIN) {
+    tmps = calloc(num, sizeof(tmps[0]));
+    if (!tmps) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+  }
+  while (num - pos > JB_SORT_MERGE_FANIN) {
+    uint32_t n = (num - pos - 2) % (JB_SORT_MERGE_FANIN - 1) + 2;
+    struct _JBMRUN *run = calloc(1, sizeof(*run));
+    if (!run) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    tmps[tnum++] = run;
+    run->src.next = _jbi_mrun_next;
+    run->src.close = _jbi_mrun_close;
+    rc = jbi_runf_open(&run->rf);
+    RCGO(rc, finish);
+    rc = _jbi_merge_pass(m, srcs + pos, n, run);
+    RCGO(rc, finish);
+    iwxstr_destroy(run->rf.wbuf);
+    run->rf.wbuf = 0;
+    pos += n;
+    srcs[num++] = &run->src;
+  }
+  rc = _jbi_merge_pass(m, srcs + pos, num - pos, 0);
+
+finish:
+  for (uint32_t i = 0; i < tnum; ++i) {
+    jbi_runf_close(&tmps[i]->rf);
+    free(tmps[i]);
+  }
+  free(tmps);
+  free(srcs);
+  return rc;
+}
@@ -0,0 +1,160 @@
+#include "ejdb2_internal.h"
+
+// Multi-index scanner.
+// Collects document ids by every index scan of `ctx->mplan`,
+// intersects (AND) or unites (OR) sorted id sets then fetches surviving documents.
+
+static iwrc _jbi_mset_add(struct _JBIDSET *set, int64_t id) {
+  if (set->num >= set->cap) {
+    size_t ncap = set->cap ? set->cap * 2 : 1024;
+    int64_t *nids = realloc(set->ids, ncap * sizeof(set->ids[0]));
+    if (!nids) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    set->ids = nids;
+    set->cap = ncap;
+  }
+  set->ids[set->num++] = id;
+  return 0;
+}
+
+static iwrc _jbi_mset_consumer(
+  struct _JBEXEC *ctx, IWKV_cursor cur, int64_t id,
+  int64_t *step, bool *matched, iwrc err) {
+  if (!id) { // EOF scan
+    return err;
+  }
+  *step = 1;
+  *matched = false;
+  return _jbi_mset_add(&ctx->mset, id);
+}
+
+static int _jbi_id_cmp(const void *v1, const void *v2) {
+  int64_t id1 = *(const int64_t*) v1;
+  int64_t id2 = *(const int64_t*) v2;
+  return id1 > id2 ? 1 : id1 < id2 ? -1 : 0;
+}
+
+static void _jbi_mset_sort(struct _JBIDSET *set) {
+  size_t j = 0;
+  if (set->num < 2) {
+    return;
+  }
+  qsort(set->ids, set->num, sizeof(set->ids[0]), _jbi_id_cmp);
+  for (size_t i = 1; i < set->num; ++i) {
+    if (set->ids[i] != set->ids[j]) {
+      set->ids[++j] = set->ids[i];
+    }
+  }
+  set->num = j + 1;
+}
+
+static void _jbi_mset_intersect(struct _JBIDSET *res, const struct _JBIDSET *set) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < res->num && j < set->num) {
+    if (res->ids[i] < set->ids[j]) {
+      ++i;
+    } else if (res->ids[i] > set->ids[j]) {
+      ++j;
+    } else {
+      res->ids[k++] = res->ids[i++];
+      ++j;
+    }
+  }
+  res->num = k;
+}
+
+static iwrc _jbi_mset_unite(struct _JBIDSET *res, const struct _JBIDSET *set) {
+  size_t i = 0, j = 0, k = 0;
+  if (!set->num) {
+    return 0;
+  }
+  size_t cap = res->num + set->num;
+  int64_t *ids = malloc(cap * sizeof(ids[0]));
+  if (!ids) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  while (i < res->num || j < set->num) {
+    if (j >= set->num || (i < res->num && res->ids[i] < set->ids[j])) {
+      ids[k++] = res->ids[i++];
+    } else if (i >= res->num || res->ids[i] > set->ids[j]) {
+      ids[k++] = set->ids[j++];
+    } else {
+      ids[k++] = res->ids[i++];
+      ++j;
+    }
+  }
+  free(res->ids);
+  res->ids = ids;
+  res->num = k;
+  res->cap = cap;
+  return 0;
+}
+
+iwrc jbi_multi_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
+  iwrc rc = 0;
+  bool matched;
+  int64_t step = 1, pos = 0;
+  struct _JBIDSET res = { 0 };
+  struct _JBMIDX midx;
+
+  assert(ctx->mplan && ctx->mplan_num > 0);
+  memcpy(&midx, &ctx->midx, sizeof(midx));
+
+  for (int i = 0; i < ctx->mplan_num; ++i) {
+    memcpy(&ctx->midx, &ctx->mplan[i], sizeof(ctx->midx));
+    ctx->mset.num = 0;
+    if (ctx->midx.idx->ncols) {
+      rc = jbi_compound_scanner(ctx, _jbi_mset_consumer);
+    } else if (ctx->midx.idx->mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM)) {
+      rc = jbi_text_scanner(ctx, _jbi_mset_consumer);
+    } else if (ctx->midx.idx->idbf & IWDB_COMPOUND_KEYS) {
+      rc = jbi_dup_scanner(ctx, _jbi_mset_consumer);
+    } else {
+      rc = jbi_uniq_scanner(ctx, _jbi_mset_consumer);
+    }
+    RCGO(rc, finish);
+    _jbi_mset_sort(&ctx->mset);
+    if (i == 0) {
+      struct _JBIDSET tmp = res;
+      res = ctx->mset;
+      ctx->mset = tmp;
+    } else if (ctx->mplan_or) {
+      rc = _jbi_mset_unite(&res, &ctx->mset);
+      RCGO(rc, finish);
+    } else {
+      _jbi_mset_intersect(&res, &ctx->mset);
+    }
+    if (!res.num && !ctx->mplan_or) {
+      break;
+    }
+  }
+  memcpy(&ctx->midx, &midx, sizeof(ctx->midx));
+
+  // Pass ids to consumer in the collection scan order
+  bool desc = (ctx->cursor_step != IWKV_CURSOR_PREV);
+  while (step && pos >= 0 && pos < (int64_t) res.num) {
+    if (step > 0) {
+      --step;
+    } else if (step < 0) {
+      ++step;
+    }
+    if (!step) {
+      step = 1;
+      rc = consumer(ctx, 0, res.ids[desc ? res.num - pos - 1 : pos], &step, &matched, 0);
+      RCGO(rc, finish);
+    }
+    if (step > 0) {
+      ++pos;
+    } else if (step < 0) {
+      --pos;
+    }
+  }
+
+finish:
+  memcpy(&ctx->midx, &midx, sizeof(ctx->midx));
+  free(res.ids);
+  free(ctx->mset.ids);
+  memset(&ctx->mset, 0, sizeof(ctx->mset));
+  return consumer(ctx, 0, 0, 0, 0, rc);
+}
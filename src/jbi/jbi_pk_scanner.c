@@ -1,6 +1,6 @@
 #include "ejdb2_internal.h"
 
-// Primary key scanner
+// Primary key scanner, ids missed by collection Bloom filter are skipped
 iwrc jbi_pk_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
   iwrc rc = 0;
   int64_t id, step;
@@ -29,12 +29,14 @@ iwrc jbi_pk_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
         }
         if (!step) {
           step = 1;
-          rc = consumer(ctx, 0, id, &step, &matched, 0);
-          RCGO(rc, finish);
+          if (jbi_bloom_may_contain(ctx->jbc->bloom, &id, sizeof(id))) {
+            rc = consumer(ctx, 0, id, &step, &matched, 0);
+            RCGO(rc, finish);
+          }
         }
       }
     } while (step && (step > 0 ? (nv = nv->next) : (nv = nv->prev)));
-  } else if (jql_jqval_as_int(jqvp, &id)) {
+  } else if (jql_jqval_as_int(jqvp, &id) && jbi_bloom_may_contain(ctx->jbc->bloom, &id, sizeof(id))) {
     rc = consumer(ctx, 0, id, &step, &matched, 0);
   }
 
@@ -2,9 +2,42 @@
 
 #define JB_SOLID_EXPRNUM 127
 
+static void _jbi_print_compound_index(struct _JBIDX *idx, IWXSTR *xstr) {
+  if (idx->mode & EJDB_IDX_UNIQUE) {
+    iwxstr_cat2(xstr, "UNIQUE|");
+  }
+  for (int i = 0; i < idx->ncols; ++i) {
+    if (i) {
+      iwxstr_cat2(xstr, ",");
+    }
+    switch (idx->ctypes[i]) {
+      case EJDB_IDX_STR:
+        iwxstr_cat2(xstr, "STR");
+        break;
+      case EJDB_IDX_I64:
+        iwxstr_cat2(xstr, "I64");
+        break;
+      default:
+        iwxstr_cat2(xstr, "F64");
+        break;
+    }
+  }
+  iwxstr_printf(xstr, "|%lld ", idx->rnum);
+  for (int i = 0; i < idx->ncols; ++i) {
+    if (i) {
+      iwxstr_cat2(xstr, ",");
+    }
+    jbl_ptr_serialize(idx->cptrs[i], xstr);
+  }
+}
+
 static void _jbi_print_index(struct _JBIDX *idx, IWXSTR *xstr) {
   int cnt = 0;
   ejdb_idx_mode_t m = idx->mode;
+  if (idx->ncols) {
+    _jbi_print_compound_index(idx, xstr);
+    return;
+  }
   if (m & EJDB_IDX_UNIQUE) {
     cnt++;
     iwxstr_cat2(xstr, "UNIQUE");
@@ -27,6 +60,30 @@ static void _jbi_print_index(struct _JBIDX *idx, IWXSTR *xstr) {
     }
     iwxstr_cat2(xstr, "F64");
   }
+  if (m & EJDB_IDX_TEXT) {
+    if (cnt++) {
+      iwxstr_cat2(xstr, "|");
+    }
+    iwxstr_cat2(xstr, "TEXT");
+  }
+  if (m & EJDB_IDX_TRIGRAM) {
+    if (cnt++) {
+      iwxstr_cat2(xstr, "|");
+    }
+    iwxstr_cat2(xstr, "TRIGRAM");
+  }
+  if (m & EJDB_IDX_NOCASE) {
+    if (cnt++) {
+      iwxstr_cat2(xstr, "|");
+    }
+    iwxstr_cat2(xstr, "NOCASE");
+  }
+  if (m & EJDB_IDX_HASH) {
+    if (cnt++) {
+      iwxstr_cat2(xstr, "|");
+    }
+    iwxstr_cat2(xstr, "HASH");
+  }
   if (cnt++) {
     iwxstr_cat2(xstr, "|");
   }
@@ -59,6 +116,11 @@ static void _jbi_log_cursor_op(IWXSTR *xstr, IWKV_cursor_op op) {
 
 static void _jbi_log_index_rules(IWXSTR *xstr, struct _JBMIDX *mctx) {
   _jbi_print_index(mctx->idx, xstr);
+  for (int i = 0; i < mctx->neq; ++i) {
+    iwxstr_cat2(xstr, " EQ: \'");
+    jqp_print_filter_node_expr(mctx->cexprs[i], jbl_xstr_json_printer, xstr);
+    iwxstr_cat2(xstr, "\'");
+  }
   if (mctx->expr1) {
     iwxstr_cat2(xstr, " EXPR1: \'");
     jqp_print_filter_node_expr(mctx->expr1, jbl_xstr_json_printer, xstr);
@@ -80,15 +142,22 @@ static void _jbi_log_index_rules(IWXSTR *xstr, struct _JBMIDX *mctx) {
   if (mctx->orderby_support) {
     iwxstr_cat2(xstr, " ORDERBY");
   }
+  if (mctx->estimated) {
+    iwxstr_printf(xstr, " EST: %lld COST: %.0f", (long long) mctx->rows, mctx->cost);
+  }
   iwxstr_cat2(xstr, "\n");
 }
 
 IW_INLINE int _jbi_idx_expr_op_weight(struct _JBMIDX *midx) {
-  jqp_op_t op = midx->expr1->op->value;
+  // Compound index may have no start expression
+  JQP_EXPR *expr = midx->neq ? midx->cexprs[0] : midx->expr1 ? midx->expr1 : midx->expr2;
+  jqp_op_t op = jbi_op_cased(expr->op->value);
   switch (op) {
     case JQP_OP_EQ:
       return 10;
     case JQP_OP_IN:
+    case JQP_OP_TEXT:
+    case JQP_OP_RE:
       //case JQP_OP_NI: todo
       return 9;
     default:
@@ -111,13 +180,18 @@ IW_INLINE int _jbi_idx_expr_op_weight(struct _JBMIDX *midx) {
   }
 }
 
-static bool _jbi_is_solid_node_expression(const JQP_NODE *n) {
+static bool _jbi_idx_usable(JBEXEC *ctx, struct _JBIDX *idx);
+
+/**
+ * Checks node expression has no negated conditions, no OR joins and no regexps
+ * (regexps are allowed if `re` is set, they may be served by trigram indexes).
+ */
+static bool _jbi_is_solid_node_expression(const JQP_NODE *n, bool re) {
   JQPUNIT *unit = n->value;
   for (const JQP_EXPR *expr = &unit->expr; expr; expr = expr->next) {
     if (  expr->op->negate
        || (expr->join && (expr->join->negate || (expr->join->value == JQP_JOIN_OR) ))
-       || (expr->op->value == JQP_OP_RE) ) {
-      // No negate conditions, No OR, No regexp
+       || (!re && (expr->op->value == JQP_OP_RE)) ) {
       return false;
     }
     JQPUNIT *left = expr->left;
@@ -129,6 +203,19 @@ static bool _jbi_is_solid_node_expression(const JQP_NODE *n) {
   return true;
 }
 
+/**
+ * Checks if regular expression `rv` has trigrams which can be looked up in trigram index.
+ */
+static iwrc _jbi_trigrams_usable(JBIDX idx, const JQVAL *rv, bool *usable) {
+  struct _JBTXT q;
+  iwrc rc = jbi_text_init(&q);
+  RCRET(rc);
+  rc = jbi_text_add_query(&q, idx, rv);
+  *usable = !rc && q.num > 0;
+  jbi_text_destroy(&q);
+  return rc;
+}
+
 static iwrc _jbi_compute_index_rules(JBEXEC *ctx, struct _JBMIDX *mctx) {
   JQP_EXPR *expr = mctx->nexpr; // Node expression
   if (!expr) {
@@ -141,9 +228,43 @@ static iwrc _jbi_compute_index_rules(JBEXEC *ctx, struct _JBMIDX *mctx) {
     jqp_op_t op = expr->op->value;
     JQVAL *rv = jql_unit_to_jqval(aux, expr->right, &rc);
     RCRET(rc);
-    if (expr->left->type != JQP_STRING_TYPE) {
+    if (  (expr->left->type != JQP_STRING_TYPE)
+       || strcmp(expr->left->string.value, mctx->nexpr->left->string.value)) {
+      continue; // Condition over another field of node expression
+    }
+    if (mctx->idx->mode & EJDB_IDX_TEXT) { // Full-text index is used by `text` operator only
+      if (op == JQP_OP_TEXT) {
+        mctx->cursor_init = IWKV_CURSOR_EQ;
+        mctx->expr1 = expr;
+        mctx->expr2 = 0;
+        mctx->orderby_support = false;
+        return 0;
+      }
+      continue;
+    }
+    if (mctx->idx->mode & EJDB_IDX_TRIGRAM) { // Trigram index is used by `re` operator having literal trigrams
+      if (op == JQP_OP_RE) {
+        bool usable = false;
+        rc = _jbi_trigrams_usable(mctx->idx, rv, &usable);
+        RCRET(rc);
+        if (usable) {
+          mctx->cursor_init = IWKV_CURSOR_EQ;
+          mctx->expr1 = expr;
+          mctx->expr2 = 0;
+          mctx->orderby_support = false;
+          return 0;
+        }
+      }
       continue;
     }
+    // Case insensitive index is used by case insensitive operators only
+    if (jbi_op_nocase(op) != !!(mctx->idx->mode & EJDB_IDX_NOCASE)) {
+      continue;
+    }
+    op = jbi_op_cased(op);
+    if ((mctx->idx->mode & EJDB_IDX_HASH) && (op != JQP_OP_EQ) && (op != JQP_OP_IN)) {
+      continue; // Hash index keys are not ordered
+    }
     switch (rv->type) {
       case JQVAL_NULL:
       case JQVAL_RE:
@@ -297,7 +418,7 @@ static iwrc _jbi_collect_indexes(
         case JQP_NODE_FIELD:
           break;
         case JQP_NODE_EXPR:
-          if (!_jbi_is_solid_node_expression(n)) {
+          if (!_jbi_is_solid_node_expression(n, true)) {
             return 0;
           }
           break;
@@ -310,7 +431,7 @@ static iwrc _jbi_collect_indexes(
     for (struct _JBIDX *idx = ctx->jbc->idx; idx && *snp < JB_SOLID_EXPRNUM; idx = idx->next) {
       struct _JBMIDX mctx = { .filter = f };
       struct _JBL_PTR *ptr = idx->ptr;
-      if (ptr->cnt > fnc) {
+      if (!_jbi_idx_usable(ctx, idx) || idx->ncols || (ptr->cnt > fnc)) {
         continue;
       }
 
@@ -322,10 +443,13 @@ static iwrc _jbi_collect_indexes(
         if (n->ntype == JQP_NODE_FIELD) {
           field = n->value->string.value;
         } else if (n->ntype == JQP_NODE_EXPR) {
-          nexpr = &n->value->expr;
-          JQPUNIT *left = nexpr->left;
-          if (left->type == JQP_STRING_TYPE) {
-            field = left->string.value;
+          // Node expression may join conditions over different fields by `and`
+          for (nexpr = &n->value->expr; nexpr; nexpr = nexpr->next) {
+            JQPUNIT *left = nexpr->left;
+            if ((left->type == JQP_STRING_TYPE) && !strcmp(left->string.value, ptr->n[i])) {
+              field = left->string.value;
+              break;
+            }
           }
         }
         if (!field || (strcmp(field, ptr->n[i]) != 0)) {
@@ -350,12 +474,14 @@ static iwrc _jbi_collect_indexes(
       if ((i == ptr->cnt) && nexpr) {
         mctx.idx = idx;
         mctx.nexpr = nexpr;
-        mctx.orderby_support = (i == j);
+        mctx.orderby_support = (i == j) && !(idx->mode & (EJDB_IDX_NOCASE | EJDB_IDX_HASH));
         rc = _jbi_compute_index_rules(ctx, &mctx);
         RCRET(rc);
         if (!mctx.expr1) { // Cannot find matching expressions
           continue;
         }
+        rc = jbi_stats_estimate(ctx, &mctx);
+        RCRET(rc);
         if (ctx->ux->log) {
           iwxstr_cat2(ctx->ux->log, "[INDEX] MATCHED  ");
           _jbi_log_index_rules(ctx->ux->log, &mctx);
@@ -368,15 +494,338 @@ static iwrc _jbi_collect_indexes(
   return rc;
 }
 
+/** Filter expression over document field used to match compound index columns */
+struct _JBCATOM {
+  JQP_FILTER *filter;
+  JQP_EXPR   *expr;
+};
+
+static void _jbi_collect_catoms(const struct JQP_EXPR_NODE *en, struct _JBCATOM *atoms, int *anum) {
+  if (en->type == JQP_EXPR_NODE_TYPE) {
+    struct JQP_EXPR_NODE *cn = en->chain;
+    for ( ; cn; cn = cn->next) {
+      if (cn->join && (cn->join->value == JQP_JOIN_OR)) {
+        return;
+      }
+    }
+    for (cn = en->chain; cn; cn = cn->next) {
+      if (!cn->join || !cn->join->negate) {
+        _jbi_collect_catoms(cn, atoms, anum);
+      }
+    }
+  } else if (en->type == JQP_FILTER_TYPE) {
+    JQP_FILTER *f = (JQP_FILTER*) en;  // -V1027
+    JQP_NODE *n = f->node;
+    for ( ; n && n->next; n = n->next) {
+      if (n->ntype != JQP_NODE_FIELD) {
+        return;
+      }
+    }
+    if (!n || (n->ntype != JQP_NODE_EXPR) || !_jbi_is_solid_node_expression(n, false)) {
+      return;
+    }
+    for (JQP_EXPR *expr = &n->value->expr; expr && *anum < JB_SOLID_EXPRNUM; expr = expr->next) {
+      if (expr->left->type == JQP_STRING_TYPE) {
+        atoms[*anum].filter = f;
+        atoms[*anum].expr = expr;
+        *anum = *anum + 1;
+      }
+    }
+  }
+}
+
+static bool _jbi_catom_matched(const struct _JBCATOM *atom, const struct _JBL_PTR *ptr) {
+  int i = 0;
+  JQP_NODE *n = atom->filter->node;
+  for ( ; n->next; n = n->next, ++i) {
+    if ((i >= ptr->cnt) || strcmp(n->value->string.value, ptr->n[i])) {
+      return false;
+    }
+  }
+  return (i == ptr->cnt - 1) && !strcmp(atom->expr->left->string.value, ptr->n[i]);
+}
+
+/**
+ * Checks that expression is a conjunction of solid field expressions
+ * with literal values. `cnt` is incremented by the number of field expressions.
+ */
+static bool _jbi_is_conjunction(const struct JQP_EXPR_NODE *en, int *cnt) {
+  if (en->type == JQP_EXPR_NODE_TYPE) {
+    if (en->flags & JQP_EXPR_NODE_FLAG_PK) {
+      return false;
+    }
+    for (struct JQP_EXPR_NODE *cn = en->chain; cn; cn = cn->next) {
+      if (  (cn->join && (cn->join->negate || (cn->join->value == JQP_JOIN_OR)))
+         || !_jbi_is_conjunction(cn, cnt)) {
+        return false;
+      }
+    }
+    return true;
+  } else if (en->type == JQP_FILTER_TYPE) {
+    JQP_NODE *n = ((JQP_FILTER*) en)->node; // -V1027
+    for ( ; n && n->next; n = n->next) {
+      if (n->ntype != JQP_NODE_FIELD) {
+        return false;
+      }
+    }
+    if (!n || (n->ntype != JQP_NODE_EXPR) || !_jbi_is_solid_node_expression(n, false)) {
+      return false;
+    }
+    for (JQP_EXPR *expr = &n->value->expr; expr; expr = expr->next) {
+      if (  (expr->left->type != JQP_STRING_TYPE)
+         || ((expr->right->type == JQP_STRING_TYPE) && (expr->right->string.flavour & JQP_STR_PLACEHOLDER))) {
+        return false;
+      }
+      *cnt = *cnt + 1;
+    }
+    return true;
+  }
+  return false;
+}
+
+iwrc jbi_idx_filter_init(struct _JBIDX *idx) {
+  iwrc rc = 0;
+  int anum = 0, cnt = 0;
+  struct _JBCATOM atoms[JB_SOLID_EXPRNUM];
+  JQP_AUX *aux = idx->filter->aux;
+  if (!_jbi_is_conjunction(aux->expr, &cnt) || (cnt > JB_SOLID_EXPRNUM)) {
+    return EJDB_ERROR_INVALID_INDEX_FILTER;
+  }
+  _jbi_collect_catoms(aux->expr, atoms, &anum);
+  if (!anum || (anum != cnt)) {
+    return EJDB_ERROR_INVALID_INDEX_FILTER;
+  }
+  // Filter values are resolved here once since index filter query
+  // is shared by all queries planned concurrently under collection read lock
+  idx->fvals = iwpool_alloc(anum * sizeof(idx->fvals[0]), aux->pool);
+  if (!idx->fvals) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (int i = 0; i < anum; ++i) {
+    idx->fvals[i] = jql_unit_to_jqval(aux, atoms[i].expr->right, &rc);
+    RCRET(rc);
+  }
+  return rc;
+}
+
+/**
+ * Returns true if both atoms are the same condition over the same field.
+ * `v1` is the value of `a1` resolved in advance, see `jbi_idx_filter_init()`.
+ */
+static bool _jbi_catom_eq(const struct _JBCATOM *a1, const JQVAL *v1, JQL q2, const struct _JBCATOM *a2, iwrc *rcp) {
+  JQP_NODE *n1 = a1->filter->node, *n2 = a2->filter->node;
+  for ( ; n1->next && n2->next; n1 = n1->next, n2 = n2->next) {
+    if (strcmp(n1->value->string.value, n2->value->string.value)) {
+      return false;
+    }
+  }
+  if (  n1->next || n2->next
+     || (a1->expr->op->value != a2->expr->op->value)
+     || strcmp(a1->expr->left->string.value, a2->expr->left->string.value)) {
+    return false;
+  }
+  JQVAL *v2 = jql_unit_to_jqval(q2->aux, a2->expr->right, rcp);
+  if (*rcp) {
+    return false;
+  }
+  return (v1->type == v2->type) && !jql_cmp_jqval_pair(v1, v2, rcp) && !*rcp;
+}
+
+/**
+ * Returns true if index can be used by query:
+ * index is not being built and query implies filter of partial index,
+ * i.e. every filter condition is found among conjunctive query conditions.
+ */
+static bool _jbi_idx_usable(JBEXEC *ctx, struct _JBIDX *idx) {
+  if (idx->building) {
+    return false;
+  }
+  if (!idx->filter) {
+    return true;
+  }
+  iwrc rc = 0;
+  int anum = 0, fnum = 0;
+  JQL q = ctx->ux->q;
+  struct _JBCATOM atoms[JB_SOLID_EXPRNUM], fatoms[JB_SOLID_EXPRNUM];
+
+  _jbi_collect_catoms(q->aux->expr, atoms, &anum);
+  _jbi_collect_catoms(idx->filter->aux->expr, fatoms, &fnum);
+  for (int i = 0; i < fnum; ++i) {
+    int j = 0;
+    for ( ; j < anum && !_jbi_catom_eq(&fatoms[i], idx->fvals[i], q, &atoms[j], &rc); ++j) {
+      if (rc) {
+        return false;
+      }
+    }
+    if (j == anum) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _jbi_ptr_eq(const struct _JBL_PTR *p1, const struct _JBL_PTR *p2) {
+  if (p1->cnt != p2->cnt) {
+    return false;
+  }
+  for (int i = 0; i < p1->cnt; ++i) {
+    if (strcmp(p1->n[i], p2->n[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks if compound index scan produces documents in order-by clauses order:
+ * order-by columns must follow leading columns matched by equality
+ * and have the same sort direction.
+ */
+static void _jbi_compound_orderby(struct JQP_AUX *aux, struct _JBMIDX *mctx) {
+  int c = mctx->neq;
+  bool desc = false;
+  JBIDX idx = mctx->idx;
+  mctx->orderby_support = false;
+  mctx->cursor_step = IWKV_CURSOR_PREV;
+  if (!aux->orderby_num) {
+    return;
+  }
+  for (int i = 0; i < aux->orderby_num; ++i) {
+    struct _JBL_PTR *obp = aux->orderby_ptrs[i];
+    int j = 0;
+    for ( ; j < mctx->neq && !_jbi_ptr_eq(idx->cptrs[j], obp); ++j) ;
+    if (j < mctx->neq) { // Column value is fixed by equality
+      continue;
+    }
+    if ((c >= idx->ncols) || !_jbi_ptr_eq(idx->cptrs[c], obp)) {
+      return;
+    }
+    if (c == mctx->neq) {
+      desc = (obp->op & 1) != 0;
+    } else if (desc != ((obp->op & 1) != 0)) {
+      return;
+    }
+    ++c;
+  }
+  mctx->orderby_support = true;
+  mctx->cursor_step = desc ? IWKV_CURSOR_NEXT : IWKV_CURSOR_PREV;
+}
+
+IW_INLINE bool _jbi_catom_is_scalar(JQP_AUX *aux, JQP_EXPR *expr, iwrc *rcp) {
+  JQVAL *rv = jql_unit_to_jqval(aux, expr->right, rcp);
+  if (*rcp) {
+    return false;
+  }
+  switch (rv->type) {
+    case JQVAL_STR:
+    case JQVAL_I64:
+    case JQVAL_F64:
+    case JQVAL_BOOL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Matches compound indexes: equality expressions over leading columns
+ * followed by optional range expressions over the next column.
+ */
+static iwrc _jbi_collect_compound_indexes(
+  JBEXEC                     *ctx,
+  const struct JQP_EXPR_NODE *en,
+  struct _JBMIDX              marr[static JB_SOLID_EXPRNUM],
+  size_t                     *snp) {
+
+  iwrc rc = 0;
+  int anum = 0;
+  struct _JBCATOM atoms[JB_SOLID_EXPRNUM];
+  struct JQP_AUX *aux = ctx->ux->q->aux;
+
+  _jbi_collect_catoms(en, atoms, &anum);
+  if (!anum) {
+    return 0;
+  }
+  for (struct _JBIDX *idx = ctx->jbc->idx; idx && *snp < JB_SOLID_EXPRNUM; idx = idx->next) {
+    if (!_jbi_idx_usable(ctx, idx) || !idx->ncols) {
+      continue;
+    }
+    struct _JBMIDX mctx = { .idx = idx };
+    for (int c = 0; c < idx->ncols && mctx.neq == c; ++c) {
+      for (int i = 0; i < anum; ++i) {
+        struct _JBCATOM *a = &atoms[i];
+        if (  (a->expr->op->value == JQP_OP_EQ)
+           && _jbi_catom_matched(a, idx->cptrs[c])
+           && _jbi_catom_is_scalar(aux, a->expr, &rc)) {
+          mctx.cexprs[mctx.neq++] = a->expr;
+          if (!mctx.filter) {
+            mctx.filter = a->filter;
+          }
+          break;
+        }
+        RCRET(rc);
+      }
+    }
+    for (int i = 0; i < anum && mctx.neq < idx->ncols; ++i) {
+      struct _JBCATOM *a = &atoms[i];
+      if (!_jbi_catom_matched(a, idx->cptrs[mctx.neq]) || !_jbi_catom_is_scalar(aux, a->expr, &rc)) {
+        RCRET(rc);
+        continue;
+      }
+      switch (a->expr->op->value) {
+        case JQP_OP_GT:
+        case JQP_OP_GTE:
+          if (!mctx.expr1) {
+            mctx.expr1 = a->expr;
+          }
+          break;
+        case JQP_OP_LT:
+        case JQP_OP_LTE:
+          if (!mctx.expr2) {
+            mctx.expr2 = a->expr;
+          }
+          break;
+        default:
+          continue;
+      }
+      if (!mctx.filter) {
+        mctx.filter = a->filter;
+      }
+    }
+    if (!mctx.neq && !mctx.expr1 && !mctx.expr2) {
+      continue;
+    }
+    mctx.nexpr = mctx.neq ? mctx.cexprs[0] : mctx.expr1 ? mctx.expr1 : mctx.expr2;
+    _jbi_compound_orderby(aux, &mctx);
+    rc = jbi_stats_estimate(ctx, &mctx);
+    RCRET(rc);
+    if (ctx->ux->log) {
+      iwxstr_cat2(ctx->ux->log, "[INDEX] MATCHED  ");
+      _jbi_log_index_rules(ctx->ux->log, &mctx);
+    }
+    marr[*snp] = mctx;
+    *snp = *snp + 1;
+  }
+  return rc;
+}
+
 static int _jbi_idx_cmp(const void *o1, const void *o2) {
   struct _JBMIDX *d1 = (struct _JBMIDX*) o1;
   struct _JBMIDX *d2 = (struct _JBMIDX*) o2;
   assert(d1 && d2);
+  if (d1->estimated && d2->estimated && (d1->cost != d2->cost)) { // -V550
+    return d1->cost < d2->cost ? -1 : 1;
+  }
   int w1 = _jbi_idx_expr_op_weight(d1);
   int w2 = _jbi_idx_expr_op_weight(d2);
   if (w2 != w1) {
     return w2 - w1;
   }
+  w1 = d1->neq;
+  w2 = d2->neq;
+  if (w2 != w1) {
+    return w2 - w1;
+  }
   w1 = d1->expr2 != 0;
   w2 = d2->expr2 != 0;
   if (w2 != w1) {
@@ -394,7 +843,8 @@ static struct _JBIDX *_jbi_select_index_for_orderby(JBEXEC *ctx) {
   assert(obp);
   for (struct _JBIDX *idx = ctx->jbc->idx; idx; idx = idx->next) {
     struct _JBL_PTR *ptr = idx->ptr;
-    if (obp->cnt != ptr->cnt) {
+    if (  !_jbi_idx_usable(ctx, idx) || idx->ncols || (idx->mode & (EJDB_IDX_TEXT | EJDB_IDX_TRIGRAM | EJDB_IDX_NOCASE | EJDB_IDX_HASH))
+       || (obp->cnt != ptr->cnt)) {
       continue;
     }
     int i = 0;
@@ -413,10 +863,211 @@ static struct _JBIDX *_jbi_select_index_for_orderby(JBEXEC *ctx) {
       return idx;
     }
   }
+  for (struct _JBIDX *idx = ctx->jbc->idx; idx; idx = idx->next) {
+    if (!_jbi_idx_usable(ctx, idx) || !idx->ncols) {
+      continue;
+    }
+    struct _JBMIDX mctx = { .idx = idx };
+    _jbi_compound_orderby(aux, &mctx);
+    if (mctx.orderby_support) {
+      memcpy(&ctx->midx, &mctx, sizeof(ctx->midx));
+      ctx->sorting = false;
+      return idx;
+    }
+  }
   return 0;
 }
 
-iwrc jbi_selection(JBEXEC *ctx) {
+/**
+ * Returns true if the selected index scan fully decides the query filter
+ * so documents fetched by index don't need to be matched.
+ */
+static bool _jbi_idx_decides_filter(JBEXEC *ctx) {
+  iwrc rc = 0;
+  struct JQP_AUX *aux = ctx->ux->q->aux;
+  struct _JBMIDX *midx = &ctx->midx;
+  JQP_EXPR_NODE *en = aux->expr;
+  JQP_EXPR *expr = midx->expr1;
+
+  if (  !expr || midx->idx->ncols || (midx->idx->mode & EJDB_IDX_HASH)
+     || midx->expr2 || (expr != midx->nexpr) || expr->next
+     || !en->chain || en->chain->next || (en->chain != (JQP_EXPR_NODE*) midx->filter)) {
+    return false;
+  }
+  JQP_NODE *n = midx->filter->node;
+  for ( ; n->next; n = n->next) {
+    if (n->ntype != JQP_NODE_FIELD) {
+      return false;
+    }
+  }
+  if ((n->ntype != JQP_NODE_EXPR) || (&n->value->expr != expr)) {
+    return false;
+  }
+  switch (jbi_op_cased(expr->op->value)) {
+    case JQP_OP_EQ:
+    case JQP_OP_IN:
+      return true;
+    case JQP_OP_GT:
+    case JQP_OP_GTE: {
+      // Index scan starts at `IWKV_CURSOR_GE` so the whole range
+      // matches only if the index key type is the same as value type.
+      JQVAL *rv = jql_unit_to_jqval(aux, expr->right, &rc);
+      if (rc) {
+        return false;
+      }
+      if (midx->idx->mode & EJDB_IDX_I64) {
+        return rv->type == JQVAL_I64;
+      } else if (expr->op->value == JQP_OP_GTE) {
+        return ((midx->idx->mode & EJDB_IDX_STR) && (rv->type == JQVAL_STR))
+               || ((midx->idx->mode & EJDB_IDX_F64) && (rv->type == JQVAL_F64));
+      }
+      return false;
+    }
+    default:
+      return false;
+  }
+}
+
+static iwrc _jbi_set_mplan(JBEXEC *ctx, struct _JBMIDX **plan, int pnum, bool or) {
+  ctx->mplan = malloc(pnum * sizeof(ctx->mplan[0]));
+  if (!ctx->mplan) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (int i = 0; i < pnum; ++i) {
+    memcpy(&ctx->mplan[i], plan[i], sizeof(ctx->mplan[0]));
+  }
+  ctx->mplan_num = pnum;
+  ctx->mplan_or = or;
+  return 0;
+}
+
+/**
+ * Tries to build a plan intersecting document ids matched by indexes
+ * of different conditions joined by `and`: conditions of different filters
+ * or conditions over different fields of the same node expression, e.g. `/[a = 1 and b = 2]`.
+ * Index is added into plan only if it reduces estimated cost of documents fetching.
+ */
+static iwrc _jbi_select_intersection(JBEXEC *ctx, struct _JBMIDX *fctx, size_t snp) {
+  int pnum = 1;
+  struct _JBMIDX *plan[JB_IDX_MULTI_MAX];
+  struct _JBMIDX *m0 = &fctx[0];
+  double rnum = (double) ctx->jbc->rnum;
+
+  if (  (snp < 2) || (rnum < 1) || !m0->estimated || (m0->rows < JB_IDX_MULTI_MIN_ROWS)
+     || (m0->orderby_support && ctx->ux->q->aux->orderby_num)) {
+    return 0;
+  }
+  double scan = (double) m0->rows;
+  double sel = scan / rnum;
+  double cost = scan; // Single index plan: every index entry leads to document fetch
+  plan[0] = m0;
+
+  for (size_t i = 1; i < snp && pnum < JB_IDX_MULTI_MAX; ++i) {
+    struct _JBMIDX *m = &fctx[i];
+    if (!m->estimated) {
+      continue;
+    }
+    int j = 0;
+    for ( ; j < pnum && plan[j]->nexpr != m->nexpr && plan[j]->idx != m->idx; ++j) ;
+    if (j < pnum) {
+      continue;
+    }
+    double nsel = sel * (double) m->rows / rnum; // Assume filters are independent
+    double ncost = (scan + m->rows) * JB_IDX_MULTI_SCAN_RATE + nsel * rnum;
+    if (ncost < cost) {
+      plan[pnum++] = m;
+      scan += m->rows;
+      sel = nsel;
+      cost = ncost;
+    }
+  }
+  if (pnum < 2) {
+    return 0;
+  }
+  return _jbi_set_mplan(ctx, plan, pnum, false);
+}
+
+/**
+ * Tries to build a plan uniting document ids matched by indexes
+ * of every top level expression joined by `or`.
+ */
+static iwrc _jbi_select_union(JBEXEC *ctx) {
+  iwrc rc = 0;
+  int pnum = 0;
+  double rows = 0;
+  bool estimated = true;
+  struct _JBMIDX *plan[JB_IDX_MULTI_MAX];
+  struct _JBMIDX best[JB_IDX_MULTI_MAX];
+  struct _JBMIDX *bctx = 0;
+  struct JQP_EXPR_NODE *en = ctx->ux->q->aux->expr;
+
+  if ((en->type != JQP_EXPR_NODE_TYPE) || !en->chain || !en->chain->next) {
+    return 0;
+  }
+  for (struct JQP_EXPR_NODE *cn = en->chain; cn; cn = cn->next, ++pnum) {
+    if (  (pnum >= JB_IDX_MULTI_MAX)
+       || (cn->join && (cn->join->negate || (cn->join->value != JQP_JOIN_OR)))
+       || (!cn->join && (cn != en->chain))) {
+      return 0;
+    }
+  }
+  bctx = malloc(JB_SOLID_EXPRNUM * sizeof(*bctx));
+  if (!bctx) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  pnum = 0;
+  for (struct JQP_EXPR_NODE *cn = en->chain; cn; cn = cn->next, ++pnum) {
+    size_t snp = 0;
+    rc = _jbi_collect_indexes(ctx, cn, bctx, &snp);
+    RCGO(rc, finish);
+    rc = _jbi_collect_compound_indexes(ctx, cn, bctx, &snp);
+    RCGO(rc, finish);
+    if (!snp) { // Full scan is required anyway
+      goto finish;
+    }
+    qsort(bctx, snp, sizeof(bctx[0]), _jbi_idx_cmp);
+    memcpy(&best[pnum], &bctx[0], sizeof(best[0]));
+    plan[pnum] = &best[pnum];
+    if (plan[pnum]->estimated) {
+      rows += plan[pnum]->rows;
+    } else {
+      estimated = false;
+    }
+  }
+  if (!estimated || (rows <= ctx->jbc->rnum * JB_IDX_MULTI_MAX_UNION_RATIO)) {
+    rc = _jbi_set_mplan(ctx, plan, pnum, true);
+  }
+
+finish:
+  free(bctx);
+  return rc;
+}
+
+/**
+ * Marks index expressions which are always matched by documents fetched by selected indexes.
+ */
+static void _jbi_mark_prematched(JBEXEC *ctx) {
+  if (ctx->mplan) {
+    for (int i = 0; i < ctx->mplan_num && !ctx->mplan_or; ++i) {
+      struct _JBMIDX *midx = &ctx->mplan[i];
+      if (midx->idx->ncols || (midx->idx->mode & EJDB_IDX_HASH)) {
+        continue; // Documents fetched by hash index are verified by filter
+      }
+      jqp_op_t op = jbi_op_cased(midx->expr1->op->value);
+      if ((op == JQP_OP_EQ) || (op == JQP_OP_IN)) {
+        midx->expr1->prematched = true;
+      }
+    }
+  } else if (ctx->midx.expr1 && !ctx->midx.idx->ncols && !(ctx->midx.idx->mode & EJDB_IDX_HASH)) {
+    struct _JBMIDX *midx = &ctx->midx;
+    jqp_op_t op = jbi_op_cased(midx->expr1->op->value);
+    if ((op == JQP_OP_EQ) || (op == JQP_OP_IN) || ((op == JQP_OP_GTE) && (ctx->cursor_init == IWKV_CURSOR_GE))) {
+      midx->expr1->prematched = true;
+    }
+  }
+}
+
+static iwrc _jbi_select(JBEXEC *ctx) {
   iwrc rc = 0;
   size_t snp = 0;
   struct JQP_AUX *aux = ctx->ux->q->aux;
@@ -436,19 +1087,35 @@ iwrc jbi_selection(JBEXEC *ctx) {
   if (!(aux->qmode & JQP_QRY_NOIDX) && ctx->jbc->idx) { // we have indexes associated with collection
     rc = _jbi_collect_indexes(ctx, aux->expr, fctx, &snp);
     RCRET(rc);
-    if (snp) { // Index selected
+    rc = _jbi_collect_compound_indexes(ctx, aux->expr, fctx, &snp);
+    RCRET(rc);
+    if (snp) {
       qsort(fctx, snp, sizeof(fctx[0]), _jbi_idx_cmp);
+      rc = _jbi_select_intersection(ctx, fctx, snp);
+    } else {
+      rc = _jbi_select_union(ctx);
+    }
+    RCRET(rc);
+    if (ctx->mplan) { // Multi-index plan selected
+      memcpy(&ctx->midx, &ctx->mplan[0], sizeof(ctx->midx));
+      for (int i = 0; ctx->ux->log && i < ctx->mplan_num; ++i) {
+        iwxstr_cat2(ctx->ux->log, ctx->mplan_or ? "[INDEX] SELECTED OR " : "[INDEX] SELECTED AND ");
+        _jbi_log_index_rules(ctx->ux->log, &ctx->mplan[i]);
+      }
+      ctx->sorting = aux->orderby_num > 0;
+    } else if (snp) { // Index selected
       memcpy(&ctx->midx, &fctx[0], sizeof(ctx->midx));
       struct _JBMIDX *midx = &ctx->midx;
-      jqp_op_t op = midx->expr1->op->value;
-      if ((op == JQP_OP_EQ) || (op == JQP_OP_IN) || ((op == JQP_OP_GTE) && (ctx->cursor_init == IWKV_CURSOR_GE))) {
-        midx->expr1->prematched = true;
+      if (  (aux->qmode & JQP_QRY_AGGREGATE)
+         && !jql_has_apply(ctx->ux->q)
+         && _jbi_idx_decides_filter(ctx)) {
+        ctx->idx_count = true;
       }
       if (ctx->ux->log) {
         iwxstr_cat2(ctx->ux->log, "[INDEX] SELECTED ");
         _jbi_log_index_rules(ctx->ux->log, &ctx->midx);
       }
-      if (midx->orderby_support && (aux->orderby_num == 1)) {
+      if (midx->orderby_support && ((aux->orderby_num == 1) || midx->idx->ncols)) {
         // Turn off final sorting since it supported by natural index scan order
         ctx->sorting = false;
       } else if (aux->orderby_num) {
@@ -463,3 +1130,182 @@ iwrc jbi_selection(JBEXEC *ctx) {
   }
   return rc;
 }
+
+static iwrc _jbi_plan_store(JBEXEC *ctx, uint64_t idx_gen) {
+  JQL q = ctx->ux->q;
+  JBQPLAN plan = malloc(sizeof(*plan) + ctx->mplan_num * sizeof(plan->mplan[0]));
+  if (!plan) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  plan->idx_gen = idx_gen;
+  plan->jbc = ctx->jbc;
+  plan->cursor_init = ctx->cursor_init;
+  plan->cursor_step = ctx->cursor_step;
+  plan->sorting = ctx->sorting;
+  plan->idx_count = ctx->idx_count;
+  plan->mplan_or = ctx->mplan_or;
+  plan->mplan_num = ctx->mplan_num;
+  memcpy(&plan->midx, &ctx->midx, sizeof(plan->midx));
+  if (ctx->mplan_num) {
+    memcpy(plan->mplan, ctx->mplan, ctx->mplan_num * sizeof(plan->mplan[0]));
+  }
+  free(q->plan);
+  q->plan = plan;
+  return 0;
+}
+
+static iwrc _jbi_plan_restore(JBEXEC *ctx, JBQPLAN plan) {
+  if (plan->mplan_num) {
+    ctx->mplan = malloc(plan->mplan_num * sizeof(ctx->mplan[0]));
+    if (!ctx->mplan) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    memcpy(ctx->mplan, plan->mplan, plan->mplan_num * sizeof(ctx->mplan[0]));
+  }
+  ctx->mplan_num = plan->mplan_num;
+  ctx->mplan_or = plan->mplan_or;
+  ctx->cursor_init = plan->cursor_init;
+  ctx->cursor_step = plan->cursor_step;
+  ctx->sorting = plan->sorting;
+  ctx->idx_count = plan->idx_count;
+  memcpy(&ctx->midx, &plan->midx, sizeof(ctx->midx));
+  return 0;
+}
+
+/**
+ * Checks if path of `n` segments is stored in entries of covering index `idx`,
+ * e.g. indexed or included field pointer is a prefix of path.
+ */
+static bool _jbi_covering_path(JBIDX idx, const char **segs, int n) {
+  for (int i = -1; i < idx->nincl; ++i) {
+    JBL_PTR ptr = i < 0 ? idx->ptr : idx->iptrs[i];
+    int j = 0;
+    if (ptr->cnt > n) {
+      continue;
+    }
+    for ( ; j < ptr->cnt && !strcmp(ptr->n[j], segs[j]); ++j) ;
+    if (j == ptr->cnt) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool _jbi_covering_filters(JBIDX idx, const struct JQP_EXPR_NODE *en) {
+  const char *segs[JB_IDX_COVERING_MAX_PATH];
+  if (en->type == JQP_EXPR_NODE_TYPE) {
+    for (struct JQP_EXPR_NODE *cn = en->chain; cn; cn = cn->next) {
+      if (!_jbi_covering_filters(idx, cn)) {
+        return false;
+      }
+    }
+    return true;
+  } else if (en->type != JQP_FILTER_TYPE) {
+    return false;
+  }
+  int n = 0;
+  JQP_NODE *node = ((JQP_FILTER*) en)->node; // -V1027
+  for ( ; node && node->next; node = node->next) {
+    if ((node->ntype != JQP_NODE_FIELD) || (n >= JB_IDX_COVERING_MAX_PATH - 1)) {
+      return false;
+    }
+    segs[n++] = node->value->string.value;
+  }
+  if (!node) {
+    return _jbi_covering_path(idx, segs, n);
+  } else if (node->ntype == JQP_NODE_FIELD) {
+    segs[n++] = node->value->string.value;
+    return _jbi_covering_path(idx, segs, n);
+  } else if (node->ntype != JQP_NODE_EXPR) {
+    return false;
+  }
+  for (JQP_EXPR *expr = &node->value->expr; expr; expr = expr->next) {
+    if (  (expr->left->type != JQP_STRING_TYPE)
+       || (expr->left->string.flavour & (JQP_STR_STAR | JQP_STR_DBL_STAR))) {
+      return false;
+    }
+    segs[n] = expr->left->string.value;
+    if (!_jbi_covering_path(idx, segs, n + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _jbi_covering_projection(JBIDX idx, JQP_STRING *ps, const char **segs, int n) {
+  if (!ps) {
+    return n > 0 && _jbi_covering_path(idx, segs, n);
+  }
+  if (  (n >= JB_IDX_COVERING_MAX_PATH)
+     || (ps->flavour & (JQP_STR_PROJALIAS | JQP_STR_PROJOIN | JQP_STR_STAR | JQP_STR_DBL_STAR))) {
+    return false;
+  }
+  for (JQP_STRING *sn = ps; sn; sn = (ps->flavour & JQP_STR_PROJFIELD) ? sn->subnext : 0) {
+    if ((sn->value[0] == '*') && (sn->value[1] == '\0')) {
+      return false;
+    }
+    segs[n] = sn->value;
+    if (!_jbi_covering_projection(idx, ps->next, segs, n + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks if query can be answered by document fragments stored in entries
+ * of the selected covering index: query doesn't modify documents,
+ * its filters, order-by clauses and keep-only projections touch only stored fields.
+ */
+static bool _jbi_is_covering(JBEXEC *ctx) {
+  const char *segs[JB_IDX_COVERING_MAX_PATH];
+  struct JQP_AUX *aux = ctx->ux->q->aux;
+  JBIDX idx = ctx->midx.idx;
+
+  if (  !idx || !idx->ipaths || ctx->mplan || ctx->idx_count
+     || aux->apply || aux->apply_placeholder || (aux->qmode & (JQP_QRY_APPLY_DEL | JQP_QRY_APPLY_UPSERT))) {
+    return false;
+  }
+  if (aux->projection) {
+    for (JQP_PROJECTION *p = aux->projection; p; p = p->next) {
+      if (  (p->flags != JQP_PROJECTION_FLAG_INCLUDE)
+         || !_jbi_covering_projection(idx, p->value, segs, 0)) {
+        return false;
+      }
+    }
+  } else if (!(aux->qmode & JQP_QRY_AGGREGATE)) {
+    return false; // Whole documents are requested
+  }
+  for (int i = 0; i < aux->orderby_num; ++i) {
+    JBL_PTR obp = aux->orderby_ptrs[i];
+    if ((obp->cnt > JB_IDX_COVERING_MAX_PATH) || !_jbi_covering_path(idx, (const char**) obp->n, obp->cnt)) {
+      return false;
+    }
+  }
+  return _jbi_covering_filters(idx, aux->expr);
+}
+
+iwrc jbi_selection(JBEXEC *ctx) {
+  iwrc rc;
+  JQL q = ctx->ux->q;
+  // Index selection of reused query is cached unless it depends on placeholder values
+  bool cacheable = q->cache_plan && !ctx->ux->log && !q->aux->start_placeholder;
+  uint64_t idx_gen = ctx->jbc->db->idx_gen;
+  JBQPLAN plan = q->plan;
+
+  if (cacheable && plan && (plan->idx_gen == idx_gen) && (plan->jbc == ctx->jbc)) {
+    rc = _jbi_plan_restore(ctx, plan);
+  } else {
+    rc = _jbi_select(ctx);
+    if (!rc && cacheable) {
+      rc = _jbi_plan_store(ctx, idx_gen);
+    }
+  }
+  RCRET(rc);
+  _jbi_mark_prematched(ctx);
+  ctx->covering = _jbi_is_covering(ctx);
+  if (ctx->covering && ctx->ux->log) {
+    iwxstr_cat2(ctx->ux->log, "[INDEX] COVERING\n");
+  }
+  return 0;
+}
@@ -1,57 +1,336 @@
 #include "ejdb2_internal.h"
 #include "sort_r.h"
 
+// Sort keys are built once per collected document from its order-by values.
+// Every key is stored as `[uint32 length][key bytes]` and compared by `memcmp`
+// so key order matches `_jbl_cmp_atomic_values()` applied clause by clause.
+//
+// If collected documents exceed `sort_buffer_sz` they are sorted by runs:
+// every buffer-sized run is sorted and written sequentially into its own temp file
+// as `[key][uint32 size][id + document]` records, then runs are merged into visitor by `jbi_merge()`.
+
+static void _jbi_scan_sorter_run_destroy(struct _JBSRUN *run) {
+  if (run->thr_active) {
+    pthread_join(run->thr, 0);
+  }
+  jbi_runf_close(&run->rf);
+  free(run->refs);
+  free(run->docs);
+  iwxstr_destroy(run->keys);
+  free(run);
+}
+
 static void _jbi_scan_sorter_release(struct _JBEXEC *ctx) {
   struct _JBSSC *ssc = &ctx->ssc;
   free(ssc->refs);
-  if (ssc->sof_active) {
-    ssc->sof.close(&ssc->sof);
-  } else {
-    free(ssc->docs);
+  for (uint32_t i = 0; i < ssc->topk_num; ++i) {
+    free(ssc->topk[i]);
+  }
+  free(ssc->topk);
+  for (uint32_t i = 0; i < ssc->runs_num; ++i) {
+    _jbi_scan_sorter_run_destroy(ssc->runs[i]);
   }
+  free(ssc->runs);
+  iwxstr_destroy(ssc->keys);
+  free(ssc->docs);
   memset(ssc, 0, sizeof(*ssc));
 }
 
+IW_INLINE void _jbi_key_put_u64(uint8_t *out, uint64_t v) {
+  for (int i = 7; i >= 0; --i) {
+    out[i] = v & 0xff;
+    v >>= 8;
+  }
+}
+
+IW_INLINE uint64_t _jbi_key_get_u64(const uint8_t *p, uint32_t len) {
+  uint64_t v = 0;
+  for (uint32_t i = 0; i < 8; ++i) {
+    v = (v << 8) | (i < len ? p[i] : 0);
+  }
+  return v;
+}
+
+/**
+ * Appends sort key of `jbl` document to `xstr`.
+ * `ktype` is set to the type of the first order-by value.
+ */
+static iwrc _jbi_scan_sorter_key(struct JQP_AUX *aux, JBL jbl, IWXSTR *xstr, jbl_type_t *ktype) {
+  iwrc rc;
+  uint32_t len = 0;
+  size_t start = iwxstr_size(xstr);
+  rc = iwxstr_cat(xstr, &len, sizeof(len));
+  RCRET(rc);
+
+  for (int i = 0; i < aux->orderby_num; ++i) {
+    struct _JBL v = { 0 };
+    uint8_t buf[9];
+    size_t sz = 1, sstart = iwxstr_size(xstr);
+    JBL_PTR ptr = aux->orderby_ptrs[i];
+    _jbl_at(jbl, ptr, &v);
+    jbl_type_t t = jbl_type(&v);
+    if (i == 0) {
+      *ktype = t;
+    }
+    buf[0] = (uint8_t) t;
+    switch (t) {
+      case JBV_BOOL:
+      case JBV_I64:
+        _jbi_key_put_u64(buf + 1, (uint64_t) jbl_get_i64(&v) ^ (1ULL << 63));
+        sz += 8;
+        break;
+      case JBV_F64: {
+        double d = jbl_get_f64(&v);
+        uint64_t u;
+        if (d == 0.0) {
+          d = 0.0; // Normalize -0.0
+        }
+        memcpy(&u, &d, sizeof(u));
+        u = (u & (1ULL << 63)) ? ~u : (u | (1ULL << 63));
+        _jbi_key_put_u64(buf + 1, u);
+        sz += 8;
+        break;
+      }
+      case JBV_STR: {
+        // Zero terminated string keeps key prefix free
+        const char *str = jbl_get_str(&v);
+        rc = iwxstr_cat(xstr, buf, 1);
+        RCRET(rc);
+        rc = iwxstr_cat(xstr, str, strlen(str) + 1);
+        RCRET(rc);
+        sz = 0;
+        break;
+      }
+      default:
+        break;
+    }
+    if (sz) {
+      rc = iwxstr_cat(xstr, buf, sz);
+      RCRET(rc);
+    }
+    if (ptr->op & 1) { // Desc sorting, invert clause bytes
+      uint8_t *p = (uint8_t*) iwxstr_ptr(xstr);
+      for (size_t j = sstart, l = iwxstr_size(xstr); j < l; ++j) {
+        p[j] = ~p[j];
+      }
+    }
+  }
+  len = iwxstr_size(xstr) - start - sizeof(len);
+  memcpy(iwxstr_ptr(xstr) + start, &len, sizeof(len));
+  return 0;
+}
+
+static int _jbi_scan_sorter_key_cmp(const uint8_t *k1, const uint8_t *k2) {
+  uint32_t l1, l2;
+  memcpy(&l1, k1, sizeof(l1));
+  memcpy(&l2, k2, sizeof(l2));
+  int rv = memcmp(k1 + sizeof(l1), k2 + sizeof(l2), MIN(l1, l2));
+  if (rv) {
+    return rv;
+  }
+  return l1 > l2 ? 1 : l1 < l2 ? -1 : 0;
+}
+
 static int _jbi_scan_sorter_cmp(const void *o1, const void *o2, void *op) {
-  int rv = 0;
-  uint32_t r1, r2;
-  struct _JBL d1, d2;
-  struct _JBEXEC *ctx = op;
-  struct _JBSSC *ssc = &ctx->ssc;
-  struct JQP_AUX *aux = ctx->ux->q->aux;
-  uint8_t *p1, *p2;
-  assert(aux->orderby_num > 0);
+  const struct _JBSREF *r1 = o1, *r2 = o2;
+  const uint8_t *keys = op;
+  if (r1->kp != r2->kp) {
+    return r1->kp > r2->kp ? 1 : -1;
+  }
+  return _jbi_scan_sorter_key_cmp(keys + r1->key, keys + r2->key);
+}
+
+
+static int _jbi_scan_sorter_topk_cmp(const void *o1, const void *o2) {
+  const uint8_t *p1, *p2;
+  memcpy(&p1, o1, sizeof(p1));
+  memcpy(&p2, o2, sizeof(p2));
+  return _jbi_scan_sorter_key_cmp(p1, p2);
+}
 
-  memcpy(&r1, o1, sizeof(r1));
-  memcpy(&r2, o2, sizeof(r2));
+/**
+ * LSD radix sort of references by `kp`.
+ * Used when every key is a single numeric value of the same type so `kp` holds the whole key.
+ */
+static iwrc _jbi_scan_sorter_radix(struct _JBSREF **refsp, uint32_t n) {
+  size_t cnt[256];
+  struct _JBSREF *src = *refsp;
+  struct _JBSREF *dst = malloc(n * sizeof(*dst));
+  if (!dst) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  for (int shift = 0; shift < 64; shift += 8) {
+    memset(cnt, 0, sizeof(cnt));
+    for (uint32_t i = 0; i < n; ++i) {
+      ++cnt[(src[i].kp >> shift) & 0xff];
+    }
+    if (cnt[(src[0].kp >> shift) & 0xff] == n) {
+      continue; // All keys have the same byte at this position
+    }
+    for (size_t i = 0, pos = 0; i < 256; ++i) {
+      size_t c = cnt[i];
+      cnt[i] = pos;
+      pos += c;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+      dst[cnt[(src[i].kp >> shift) & 0xff]++] = src[i];
+    }
+    struct _JBSREF *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  *refsp = src;
+  free(dst);
+  return 0;
+}
+
+static iwrc _jbi_scan_sorter_sort(struct _JBSREF **refsp, uint32_t n, IWXSTR *kxstr, bool kradix) {
+  struct _JBSREF *refs = *refsp;
+  const uint8_t *keys = (const uint8_t*) iwxstr_ptr(kxstr);
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t len;
+    const uint8_t *kp = keys + refs[i].key;
+    memcpy(&len, kp, sizeof(len));
+    kp += sizeof(len);
+    if (kradix) {
+      // Skip the same type byte of all keys
+      refs[i].kp = _jbi_key_get_u64(kp + 1, len - 1);
+    } else {
+      refs[i].kp = _jbi_key_get_u64(kp, len);
+    }
+  }
+  if (kradix && (n >= JB_SORT_RADIX_MIN)) {
+    return _jbi_scan_sorter_radix(refsp, n);
+  }
+  sort_r(refs, n, sizeof(refs[0]), _jbi_scan_sorter_cmp, (void*) keys);
+  return 0;
+}
 
-  p1 = ssc->docs + r1 + sizeof(uint64_t) /*id*/;
-  p2 = ssc->docs + r2 + sizeof(uint64_t) /*id*/;
+/**
+ * Sorts run documents and writes them sequentially into run file.
+ * Run documents buffers are released afterwards.
+ */
+static iwrc _jbi_scan_sorter_run_write(struct _JBSRUN *run) {
+  struct _JBL jbl;
+  const uint8_t *keys;
 
-  iwrc rc = jbl_from_buf_keep_onstack2(&d1, p1);
+  iwrc rc = _jbi_scan_sorter_sort(&run->refs, run->refs_num, run->keys, run->kradix);
   RCGO(rc, finish);
-  rc = jbl_from_buf_keep_onstack2(&d2, p2);
+  rc = jbi_runf_open(&run->rf);
   RCGO(rc, finish);
 
-  for (int i = 0; i < aux->orderby_num; ++i) {
-    struct _JBL v1 = { 0 };
-    struct _JBL v2 = { 0 };
-    JBL_PTR ptr = aux->orderby_ptrs[i];
-    int desc = (ptr->op & 1) ? -1 : 1; // If `-1` do desc sorting
-    _jbl_at(&d1, ptr, &v1);
-    _jbl_at(&d2, ptr, &v2);
-    rv = _jbl_cmp_atomic_values(&v1, &v2) * desc;
-    if (rv) {
-      break;
-    }
+  keys = (const uint8_t*) iwxstr_ptr(run->keys);
+  for (uint32_t i = 0; i < run->refs_num; ++i) {
+    uint32_t klen, dsz;
+    const uint8_t *kp = keys + run->refs[i].key;
+    uint8_t *dp = run->docs + run->refs[i].doc;
+    memcpy(&klen, kp, sizeof(klen));
+    rc = jbl_from_buf_keep_onstack2(&jbl, dp + sizeof(int64_t) /*id*/);
+    RCGO(rc, finish);
+    dsz = sizeof(int64_t) + jbl_size(&jbl);
+    rc = jbi_runf_put(&run->rf, sizeof(klen) + klen + sizeof(dsz) + dsz);
+    RCGO(rc, finish);
+    rc = jbi_runf_cat(&run->rf, kp, sizeof(klen) + klen);
+    RCGO(rc, finish);
+    rc = jbi_runf_cat(&run->rf, &dsz, sizeof(dsz));
+    RCGO(rc, finish);
+    rc = jbi_runf_cat(&run->rf, dp, dsz);
+    RCGO(rc, finish);
   }
+  rc = jbi_runf_flush(&run->rf);
 
 finish:
-  if (rc) {
-    ssc->rc = rc;
-    longjmp(ssc->fatal_jmp, 1);
+  jbi_runf_release(&run->rf);
+  free(run->refs);
+  free(run->docs);
+  iwxstr_destroy(run->keys);
+  run->refs = 0;
+  run->docs = 0;
+  run->keys = 0;
+  return rc;
+}
+
+static void *_jbi_scan_sorter_run_worker(void *op) {
+  struct _JBSRUN *run = op;
+  run->rc = _jbi_scan_sorter_run_write(run);
+  return 0;
+}
+
+static iwrc _jbi_scan_sorter_run_join(struct _JBSRUN *run) {
+  if (run->thr_active) {
+    pthread_join(run->thr, 0);
+    run->thr_active = false;
   }
-  return rv;
+  return run->rc;
+}
+
+/**
+ * Moves collected documents into a new sorted run.
+ * Run is sorted and written by a separate thread if `sort_threads` option is set.
+ */
+static iwrc _jbi_scan_sorter_run_add(struct _JBEXEC *ctx) {
+  iwrc rc;
+  struct _JBSSC *ssc = &ctx->ssc;
+  uint32_t threads = ctx->jbc->db->opts.sort_threads;
+  struct _JBSRUN **nruns = realloc(ssc->runs, (ssc->runs_num + 1) * sizeof(ssc->runs[0]));
+  if (!nruns) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  ssc->runs = nruns;
+  struct _JBSRUN *run = calloc(1, sizeof(*run));
+  if (!run) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  ssc->runs[ssc->runs_num++] = run;
+  run->refs = ssc->refs;
+  run->refs_num = ssc->refs_num;
+  run->docs = ssc->docs;
+  run->keys = ssc->keys;
+  run->kradix = ssc->kradix;
+  ssc->refs = 0;
+  ssc->refs_asz = 0;
+  ssc->refs_num = 0;
+  ssc->docs = 0;
+  ssc->docs_asz = 0;
+  ssc->docs_npos = 0;
+  ssc->keys = 0;
+
+  if (threads) {
+    // Keep at most `threads` runs sorted concurrently
+    while (ssc->runs_num - 1 - ssc->runs_joined >= threads) {
+      rc = _jbi_scan_sorter_run_join(ssc->runs[ssc->runs_joined++]);
+      RCRET(rc);
+    }
+    if (!pthread_create(&run->thr, 0, _jbi_scan_sorter_run_worker, run)) {
+      run->thr_active = true;
+      return 0;
+    }
+    // Sort run in the current thread if worker cannot be started
+  }
+  return _jbi_scan_sorter_run_write(run);
+}
+
+static iwrc _jbi_scan_sorter_run_next(struct _JBMSRC *src, bool *eof) {
+  struct _JBSRUN *run = (void*) src;
+  iwrc rc = jbi_runf_next(&run->rf, eof);
+  src->rec = run->rf.rec;
+  return rc;
+}
+
+static void _jbi_scan_sorter_run_close(struct _JBMSRC *src) {
+  struct _JBSRUN *run = (void*) src;
+  jbi_runf_release(&run->rf);
+}
+
+static int _jbi_scan_sorter_rec_cmp(const uint8_t *r1, const uint8_t *r2, void *op) {
+  return _jbi_scan_sorter_key_cmp(r1, r2);
+}
+
+static size_t _jbi_scan_sorter_rec_size(const uint8_t *rec, void *op) {
+  uint32_t klen, dsz;
+  memcpy(&klen, rec, sizeof(klen));
+  memcpy(&dsz, rec + sizeof(klen) + klen, sizeof(dsz));
+  return sizeof(klen) + klen + sizeof(dsz) + dsz;
 }
 
 static iwrc _jbi_scan_sorter_apply(IWPOOL *pool, struct _JBEXEC *ctx, JQL q, struct _EJDB_DOC *doc) {
@@ -80,96 +359,245 @@ static iwrc _jbi_scan_sorter_apply(IWPOOL *pool, struct _JBEXEC *ctx, JQL q, str
   return rc;
 }
 
-static iwrc _jbi_scan_sorter_do(struct _JBEXEC *ctx) {
-  iwrc rc = 0;
-  int64_t step = 1, id;
+/**
+ * Passes sorted document to query visitor.
+ * `rp` points to document `id` followed by document data.
+ */
+static iwrc _jbi_scan_sorter_visit(struct _JBEXEC *ctx, uint8_t *rp, int64_t *step) {
+  iwrc rc;
+  int64_t id;
   struct _JBL jbl;
   EJDB_EXEC *ux = ctx->ux;
-  struct _JBSSC *ssc = &ctx->ssc;
-  uint32_t rnum = ssc->refs_num;
   struct JQP_AUX *aux = ux->q->aux;
   IWPOOL *pool = ux->pool;
 
-  if (rnum) {
-    if (setjmp(ssc->fatal_jmp)) { // Init error jump
-      rc = ssc->rc;
-      goto finish;
+  memcpy(&id, rp, sizeof(id));
+  rp += sizeof(id);
+  rc = jbl_from_buf_keep_onstack2(&jbl, rp);
+  RCRET(rc);
+  struct _EJDB_DOC doc = {
+    .id  = id,
+    .raw = &jbl
+  };
+  if (aux->apply || aux->projection) {
+    if (!pool) {
+      pool = iwpool_create(jbl.bn.size * 2);
+      if (!pool) {
+        return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      }
     }
-    if (!ssc->docs) {
-      size_t sp;
-      rc = ssc->sof.probe_mmap(&ssc->sof, 0, &ssc->docs, &sp);
+    rc = _jbi_scan_sorter_apply(pool, ctx, ux->q, &doc);
+    RCGO(rc, finish);
+  } else if (aux->qmode & JQP_QRY_APPLY_DEL) {
+    rc = jb_del(ctx->jbc, &jbl, id);
+    RCGO(rc, finish);
+  }
+  if (!(aux->qmode & JQP_QRY_AGGREGATE)) {
+    do {
+      *step = 1;
+      rc = ux->visitor(ux, &doc, step);
       RCGO(rc, finish);
-    }
+    } while (*step == -1);
+  }
+  ++ux->cnt;
 
-    sort_r(ssc->refs, rnum, sizeof(ssc->refs[0]), _jbi_scan_sorter_cmp, ctx);
+finish:
+  if (pool != ux->pool) {
+    iwpool_destroy(pool);
   }
+  return rc;
+}
 
-  for (int64_t i = ux->skip; step && i < rnum && i >= 0; ) {
-    uint8_t *rp = ssc->docs + ssc->refs[i];
-    memcpy(&id, rp, sizeof(id));
-    rp += sizeof(id);
-    rc = jbl_from_buf_keep_onstack2(&jbl, rp);
+/** State of sorted runs merge streamed into query visitor */
+struct _JBSMERGE {
+  struct _JBEXEC *ctx;
+  int64_t pos;                /**< Position of the next merged record */
+  int64_t next;               /**< Position of the next record to visit */
+};
+
+static iwrc _jbi_scan_sorter_merge_sink(const uint8_t *rec, void *op, bool *stop) {
+  uint32_t klen;
+  int64_t step = 1;
+  struct _JBSMERGE *sm = op;
+  EJDB_EXEC *ux = sm->ctx->ux;
+  if (sm->pos++ != sm->next) {
+    return 0;
+  }
+  memcpy(&klen, rec, sizeof(klen));
+  iwrc rc = _jbi_scan_sorter_visit(sm->ctx, (uint8_t*) rec + sizeof(klen) + klen + sizeof(uint32_t), &step);
+  RCRET(rc);
+  if ((--ux->limit < 1) || !step) {
+    *stop = true;
+    return 0;
+  }
+  if (step < 0) {
+    // Merged records are streamed forward only
+    return EJDB_ERROR_SORT_STEP_BACKWARD;
+  }
+  sm->next = sm->pos - 1 + step;
+  return 0;
+}
+
+/**
+ * Merge of sorted runs streamed into query visitor.
+ * Merged records are read sequentially so visitor can only move forward.
+ */
+static iwrc _jbi_scan_sorter_merge(struct _JBEXEC *ctx) {
+  iwrc rc = 0;
+  struct _JBSSC *ssc = &ctx->ssc;
+  struct _JBSMERGE sm = {
+    .ctx  = ctx,
+    .next = ctx->ux->skip
+  };
+
+  if (ssc->refs_num) {
+    rc = _jbi_scan_sorter_run_add(ctx);
+    RCRET(rc);
+  }
+  struct _JBMSRC **srcs = malloc(ssc->runs_num * sizeof(srcs[0]));
+  if (!srcs) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  struct _JBMERGE m = {
+    .srcs     = srcs,
+    .srcs_num = ssc->runs_num,
+    .cmp      = _jbi_scan_sorter_rec_cmp,
+    .size     = _jbi_scan_sorter_rec_size,
+    .sink     = _jbi_scan_sorter_merge_sink,
+    .op       = &sm
+  };
+  for (uint32_t i = 0; i < ssc->runs_num; ++i) {
+    struct _JBSRUN *run = ssc->runs[i];
+    rc = _jbi_scan_sorter_run_join(run);
     RCGO(rc, finish);
-    struct _EJDB_DOC doc = {
-      .id  = id,
-      .raw = &jbl
-    };
-    if (aux->apply || aux->projection) {
-      if (!pool) {
-        pool = iwpool_create(jbl.bn.size * 2);
-        if (!pool) {
-          rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
-          goto finish;
-        }
-      }
-      rc = _jbi_scan_sorter_apply(pool, ctx, ux->q, &doc);
-      RCGO(rc, finish);
-    } else if (aux->qmode & JQP_QRY_APPLY_DEL) {
-      rc = jb_del(ctx->jbc, &jbl, id);
-      RCGO(rc, finish);
-    }
-    if (!(aux->qmode & JQP_QRY_AGGREGATE)) {
-      do {
-        step = 1;
-        rc = ux->visitor(ux, &doc, &step);
-        RCGO(rc, finish);
-      } while (step == -1);
+    run->src.next = _jbi_scan_sorter_run_next;
+    run->src.close = _jbi_scan_sorter_run_close;
+    srcs[i] = &run->src;
+  }
+  rc = jbi_merge(&m);
+
+finish:
+  free(srcs);
+  return rc;
+}
+
+static iwrc _jbi_scan_sorter_do(struct _JBEXEC *ctx) {
+  iwrc rc = 0;
+  int64_t step = 1;
+  EJDB_EXEC *ux = ctx->ux;
+  struct _JBSSC *ssc = &ctx->ssc;
+  uint32_t rnum = ssc->topk ? ssc->topk_num : ssc->refs_num;
+
+  if (ssc->runs_num) {
+    rc = _jbi_scan_sorter_merge(ctx);
+    goto finish;
+  }
+  if (ssc->topk) {
+    // Heap contains top `skip + limit` documents, sort them in the final order
+    qsort(ssc->topk, rnum, sizeof(ssc->topk[0]), _jbi_scan_sorter_topk_cmp);
+  } else if (rnum) {
+    rc = _jbi_scan_sorter_sort(&ssc->refs, rnum, ssc->keys, ssc->kradix);
+    RCGO(rc, finish);
+  }
+
+  for (int64_t i = ux->skip; step && i < rnum && i >= 0; ) {
+    uint8_t *rp;
+    if (ssc->topk) {
+      uint32_t klen;
+      memcpy(&klen, ssc->topk[i], sizeof(klen));
+      rp = ssc->topk[i] + sizeof(klen) + klen;
+    } else {
+      rp = ssc->docs + ssc->refs[i].doc;
     }
-    ++ux->cnt;
+    rc = _jbi_scan_sorter_visit(ctx, rp, &step);
+    RCGO(rc, finish);
     i += step;
-    if (pool != ux->pool) {
-      iwpool_destroy(pool);
-      pool = 0;
-    }
     if (--ux->limit < 1) {
       break;
     }
   }
 
 finish:
-  if (pool != ux->pool) {
-    iwpool_destroy(pool);
-  }
   _jbi_scan_sorter_release(ctx);
   return rc;
 }
 
-static iwrc _jbi_scan_sorter_init(struct _JBSSC *ssc, off_t initial_size) {
-  IWFS_EXT_OPTS opts = {
-    .initial_size = initial_size,
-    .rspolicy     = iw_exfile_szpolicy_fibo,
-    .file         = {
-      .path       = "jb-",
-      .omode      = IWFS_OTMP | IWFS_OUNLINK
+static void _jbi_topk_sift_down(struct _JBSSC *ssc, uint32_t i) {
+  uint8_t **h = ssc->topk;
+  uint32_t n = ssc->topk_num;
+  while (1) {
+    uint32_t m = i, l = 2 * i + 1, r = l + 1;
+    if ((l < n) && (_jbi_scan_sorter_key_cmp(h[l], h[m]) > 0)) {
+      m = l;
     }
-  };
-  iwrc rc = iwfs_exfile_open(&ssc->sof, &opts);
-  RCRET(rc);
-  rc = ssc->sof.add_mmap(&ssc->sof, 0, SIZE_T_MAX, 0);
-  if (rc) {
-    ssc->sof.close(&ssc->sof);
+    if ((r < n) && (_jbi_scan_sorter_key_cmp(h[r], h[m]) > 0)) {
+      m = r;
+    }
+    if (m == i) {
+      break;
+    }
+    uint8_t *t = h[i];
+    h[i] = h[m];
+    h[m] = t;
+    i = m;
   }
-  return rc;
+}
+
+static void _jbi_topk_sift_up(struct _JBSSC *ssc, uint32_t i) {
+  uint8_t **h = ssc->topk;
+  while (i > 0) {
+    uint32_t p = (i - 1) / 2;
+    if (_jbi_scan_sorter_key_cmp(h[i], h[p]) <= 0) {
+      break;
+    }
+    uint8_t *t = h[i];
+    h[i] = h[p];
+    h[p] = t;
+    i = p;
+  }
+}
+
+/**
+ * Keeps `ssc->topk_max` first documents of sort order in max-heap
+ * so the worst of them is always on top and can be evicted by a better candidate.
+ * Heap entry is the document sort `key` followed by `buf` containing
+ * document id and document data of `vsz` total size.
+ */
+static iwrc _jbi_topk_add(struct _JBSSC *ssc, const uint8_t *key, uint8_t *buf, size_t vsz) {
+  uint32_t klen;
+  memcpy(&klen, key, sizeof(klen));
+  size_t esz = sizeof(klen) + klen + vsz;
+
+  if (!ssc->topk) {
+    ssc->topk = malloc(ssc->topk_max * sizeof(ssc->topk[0]));
+    if (!ssc->topk) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+  }
+  if (ssc->topk_num < ssc->topk_max) {
+    uint8_t *e = malloc(esz);
+    if (!e) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    memcpy(e, key, sizeof(klen) + klen);
+    memcpy(e + sizeof(klen) + klen, buf, vsz);
+    ssc->topk[ssc->topk_num++] = e;
+    _jbi_topk_sift_up(ssc, ssc->topk_num - 1);
+    return 0;
+  }
+  // Heap is full: candidate must be strictly better than the worst kept document
+  if (_jbi_scan_sorter_key_cmp(key, ssc->topk[0]) >= 0) {
+    return 0;
+  }
+  uint8_t *e = realloc(ssc->topk[0], esz);
+  if (!e) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  memcpy(e, key, sizeof(klen) + klen);
+  memcpy(e + sizeof(klen) + klen, buf, vsz);
+  ssc->topk[0] = e;
+  _jbi_topk_sift_down(ssc, 0);
+  return 0;
 }
 
 iwrc jbi_sorter_consumer(
@@ -191,11 +619,19 @@ iwrc jbi_sorter_consumer(
   struct _JBL jbl;
   struct _JBSSC *ssc = &ctx->ssc;
   EJDB db = ctx->jbc->db;
-  IWFS_EXT *sof = &ssc->sof;
+  struct JQP_AUX *aux = ctx->ux->q->aux;
+  jbl_type_t ktype;
+  uint32_t koff;
 
 start:
   {
-    if (cur) {
+    if (ctx->covering) { // Document fragment is loaded by scanner from covering index entry
+      vsz = ctx->cvdoc.size;
+      if (vsz + sizeof(id) <= ctx->jblbufsz) {
+        memcpy(ctx->jblbuf + sizeof(id), ctx->cvdoc.data, vsz);
+      }
+      rc = 0;
+    } else if (cur) {
       rc = iwkv_cursor_copy_val(cur, ctx->jblbuf + sizeof(id), ctx->jblbufsz - sizeof(id), &vsz);
     } else {
       IWKV_val key = {
@@ -224,14 +660,37 @@ start:
   rc = jbl_from_buf_keep_onstack(&jbl, ctx->jblbuf + sizeof(id), vsz);
   RCRET(rc);
 
-  rc = jql_matched(ctx->ux->q, &jbl, matched);
+  if (ctx->prematched) {
+    *matched = true;
+  } else {
+    rc = jql_matched(ctx->ux->q, &jbl, matched);
+  }
   if (!*matched) {
     return 0;
   }
 
+  if (ssc->refs_num && (ssc->docs_npos + vsz + sizeof(id) + iwxstr_size(ssc->keys) > db->opts.sort_buffer_sz)) {
+    // Sort buffer is full, move collected documents into sorted run
+    rc = _jbi_scan_sorter_run_add(ctx);
+    RCRET(rc);
+  }
+  if (!ssc->keys) {
+    ssc->keys = iwxstr_new();
+    if (!ssc->keys) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+  }
+  if (ssc->topk_max) {
+    iwxstr_clear(ssc->keys);
+    rc = _jbi_scan_sorter_key(aux, &jbl, ssc->keys, &ktype);
+    RCRET(rc);
+    memcpy(ctx->jblbuf, &id, sizeof(id));
+    return _jbi_topk_add(ssc, (uint8_t*) iwxstr_ptr(ssc->keys), ctx->jblbuf, vsz + sizeof(id));
+  }
+
   if (!ssc->refs) {
     ssc->refs_asz = 64 * 1024; // 64K
-    ssc->refs = malloc(db->opts.document_buffer_sz);
+    ssc->refs = malloc(ssc->refs_asz);
     if (!ssc->refs) {
       return iwrc_set_errno(IW_ERROR_ALLOC, errno);
     }
@@ -242,49 +701,42 @@ start:
     }
   } else if (ssc->refs_asz <= (ssc->refs_num + 1) * sizeof(ssc->refs[0])) {
     ssc->refs_asz *= 2;
-    uint32_t *nrefs = realloc(ssc->refs, ssc->refs_asz);
+    struct _JBSREF *nrefs = realloc(ssc->refs, ssc->refs_asz);
     if (!nrefs) {
       return iwrc_set_errno(IW_ERROR_ALLOC, errno);
     }
     ssc->refs = nrefs;
   }
 
+  koff = iwxstr_size(ssc->keys);
+  rc = _jbi_scan_sorter_key(aux, &jbl, ssc->keys, &ktype);
+  RCRET(rc);
+  if (!ssc->refs_num) {
+    ssc->ktype = ktype;
+    ssc->kradix = (aux->orderby_num == 1) && (ktype == JBV_BOOL || ktype == JBV_I64 || ktype == JBV_F64);
+  } else if (ktype != ssc->ktype) {
+    ssc->kradix = false;
+  }
+
   vsz += sizeof(id);
   memcpy(ctx->jblbuf, &id, sizeof(id));
 
-start2:
-  {
-    if (ssc->docs) {
-      uint32_t rsize = ssc->docs_npos + vsz;
-      if (rsize > ssc->docs_asz) {
-        ssc->docs_asz = MIN(rsize * 2, db->opts.sort_buffer_sz);
-        if (rsize > ssc->docs_asz) {
-          size_t sz;
-          rc = _jbi_scan_sorter_init(ssc, (ssc->docs_npos + vsz) * 2);
-          RCRET(rc);
-          rc = sof->write(sof, 0, ssc->docs, ssc->docs_npos, &sz);
-          RCRET(rc);
-          free(ssc->docs);
-          ssc->docs = 0;
-          ssc->sof_active = true;
-          goto start2;
-        } else {
-          void *nbuf = realloc(ssc->docs, ssc->docs_asz);
-          if (!nbuf) {
-            return iwrc_set_errno(IW_ERROR_ALLOC, errno);
-          }
-          ssc->docs = nbuf;
-        }
-      }
-      memcpy(ssc->docs + ssc->docs_npos, ctx->jblbuf, vsz);
-    } else {
-      size_t sz;
-      rc = sof->write(sof, ssc->docs_npos, ctx->jblbuf, vsz, &sz);
-      RCRET(rc);
+  if (ssc->docs_npos + vsz > ssc->docs_asz) {
+    uint32_t rsize = ssc->docs_npos + vsz;
+    void *nbuf;
+    ssc->docs_asz = MAX(rsize, MIN(rsize * 2, db->opts.sort_buffer_sz));
+    nbuf = realloc(ssc->docs, ssc->docs_asz);
+    if (!nbuf) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
     }
-    ssc->refs[ssc->refs_num++] = ssc->docs_npos;
-    ssc->docs_npos += vsz;
+    ssc->docs = nbuf;
   }
-
-  return rc;
+  memcpy(ssc->docs + ssc->docs_npos, ctx->jblbuf, vsz);
+  ssc->refs[ssc->refs_num++] = (struct _JBSREF) {
+    .doc = ssc->docs_npos,
+    .key = koff
+  };
+  ssc->docs_npos += vsz;
+  return 0;
 }
+
@@ -0,0 +1,520 @@
+#include "ejdb2_internal.h"
+#include "convert.h"
+#include <math.h>
+
+// ---------------------------------------------------------------------------
+//                       Index statistics
+//
+// Statistics is stored in NUMRECSDB_ID under `KEY_IDXSTATS(<idxdbid>)` key
+// as binn object:
+//
+//  n:  Number of index entries
+//  d:  Number of distinct keys
+//  w:  Number of index entries per histogram bucket
+//  nf: Null fraction
+//  b:  List of histogram bounds (raw index keys) in ascending order:
+//      minimal key followed by upper bounds of buckets
+// ---------------------------------------------------------------------------
+
+IW_INLINE void _jbi_stats_key(JBIDX idx, uint64_t *llv, IWKV_val *key) {
+  *llv = IW_HTOILL(KEY_IDXSTATS(idx->dbid));
+  key->data = llv;
+  key->size = sizeof(*llv);
+}
+
+static iwrc _jbi_stats_from_binn(void *data, JBIDX_STATS *statsp) {
+  binn_iter iter;
+  binn bv;
+  void *bl;
+  int64_t nkeys, ndistinct, depth;
+  double null_frac;
+  size_t sz = 0;
+  int nbounds = 0;
+
+  *statsp = 0;
+  if (  !binn_object_get_int64(data, "n", &nkeys)
+     || !binn_object_get_int64(data, "d", &ndistinct)
+     || !binn_object_get_int64(data, "w", &depth)
+     || !binn_object_get_double(data, "nf", &null_frac)
+     || !binn_object_get_list(data, "b", &bl)) {
+    return EJDB_ERROR_INVALID_COLLECTION_INDEX_META;
+  }
+  binn_list_foreach(bl, bv) {
+    if (bv.type != BINN_BLOB) {
+      return EJDB_ERROR_INVALID_COLLECTION_INDEX_META;
+    }
+    sz += bv.size;
+    ++nbounds;
+  }
+  JBIDX_STATS stats = malloc(sizeof(*stats) + nbounds * sizeof(stats->bounds[0]) + sz);
+  if (!stats) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  stats->nkeys = nkeys;
+  stats->ndistinct = ndistinct;
+  stats->depth = depth > 0 ? depth : 1;
+  stats->null_frac = null_frac;
+  stats->nbounds = nbounds;
+
+  char *wp = (char*) &stats->bounds[nbounds];
+  IWKV_val *bound = stats->bounds;
+  binn_list_foreach(bl, bv) {
+    memcpy(wp, bv.ptr, bv.size);
+    bound->data = wp;
+    bound->size = bv.size;
+    wp += bv.size;
+    ++bound;
+  }
+  *statsp = stats;
+  return 0;
+}
+
+static iwrc _jbi_stats_add_bound(binn *bl, const char *buf, size_t sz) {
+  if (!binn_list_add_blob(bl, (void*) buf, (int) sz)) {
+    return JBL_ERROR_CREATION;
+  }
+  return 0;
+}
+
+iwrc jbi_stats_collect(JBIDX idx) {
+  size_t sz, psz = 0, bufsz = 256;
+  int64_t n = 0, ndistinct = 0, rnum = idx->jbc->rnum;
+  int64_t depth = idx->rnum / JB_IDX_STATS_BUCKETS;
+  uint64_t llv;
+  IWKV_val key, val;
+  IWKV_cursor cur = 0;
+  JBIDX_STATS stats = 0;
+  binn *bl = 0, *bo = 0;
+  char *buf = malloc(bufsz), *pbuf = malloc(bufsz);
+
+  iwrc rc = 0;
+  if (!buf || !pbuf) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  if (depth < 1) {
+    depth = 1;
+  }
+  bl = binn_list();
+  bo = binn_object();
+  if (!bl || !bo) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+
+  // Walk the index in ascending keys order
+  rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_AFTER_LAST, 0);
+  RCGO(rc, finish);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV))) {
+    rc = iwkv_cursor_copy_key(cur, buf, bufsz, &sz, 0);
+    RCGO(rc, finish);
+    if (sz > bufsz) {
+      char *nbuf = realloc(buf, sz);
+      if (!nbuf) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        goto finish;
+      }
+      buf = nbuf;
+      nbuf = realloc(pbuf, sz);
+      if (!nbuf) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        goto finish;
+      }
+      pbuf = nbuf;
+      bufsz = sz;
+      rc = iwkv_cursor_copy_key(cur, buf, bufsz, &sz, 0);
+      RCGO(rc, finish);
+    }
+    ++n;
+    if ((n == 1) || (sz != psz) || memcmp(buf, pbuf, sz)) {
+      ++ndistinct;
+      memcpy(pbuf, buf, sz);
+      psz = sz;
+    }
+    if (n == 1) { // Minimal key
+      rc = _jbi_stats_add_bound(bl, buf, sz);
+      RCGO(rc, finish);
+    }
+    if (!(n % depth)) { // Upper bound of bucket
+      rc = _jbi_stats_add_bound(bl, buf, sz);
+      RCGO(rc, finish);
+    }
+  }
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  RCGO(rc, finish);
+  if (n % depth) { // Upper bound of the last incomplete bucket
+    rc = _jbi_stats_add_bound(bl, pbuf, psz);
+    RCGO(rc, finish);
+  }
+
+  if (  !binn_object_set_int64(bo, "n", n)
+     || !binn_object_set_int64(bo, "d", ndistinct)
+     || !binn_object_set_int64(bo, "w", depth)
+     || !binn_object_set_double(bo, "nf", (rnum > n) ? 1.0 - (double) n / rnum : 0.0)
+     || !binn_object_set_list(bo, "b", bl)) {
+    rc = JBL_ERROR_CREATION;
+    goto finish;
+  }
+  rc = _jbi_stats_from_binn(binn_ptr(bo), &stats);
+  RCGO(rc, finish);
+
+  _jbi_stats_key(idx, &llv, &key);
+  val.data = binn_ptr(bo);
+  val.size = binn_size(bo);
+  rc = iwkv_put(idx->jbc->db->nrecdb, &key, &val, 0);
+  RCGO(rc, finish);
+
+  jbi_stats_release(idx);
+  idx->stats = stats;
+  stats = 0;
+
+finish:
+  if (cur) {
+    IWRC(iwkv_cursor_close(&cur), rc);
+  }
+  free(stats);
+  free(buf);
+  free(pbuf);
+  binn_free(bl);
+  binn_free(bo);
+  return rc;
+}
+
+iwrc jbi_stats_load(JBIDX idx) {
+  uint64_t llv;
+  IWKV_val key, val;
+  JBIDX_STATS stats;
+  _jbi_stats_key(idx, &llv, &key);
+  iwrc rc = iwkv_get(idx->jbc->db->nrecdb, &key, &val);
+  if (rc == IWKV_ERROR_NOTFOUND) { // No statistics collected
+    return 0;
+  }
+  RCRET(rc);
+  rc = _jbi_stats_from_binn(val.data, &stats);
+  iwkv_val_dispose(&val);
+  RCRET(rc);
+  jbi_stats_release(idx);
+  idx->stats = stats;
+  return 0;
+}
+
+iwrc jbi_stats_remove(JBIDX idx) {
+  uint64_t llv;
+  IWKV_val key;
+  _jbi_stats_key(idx, &llv, &key);
+  iwrc rc = iwkv_del(idx->jbc->db->nrecdb, &key, 0);
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  jbi_stats_release(idx);
+  return rc;
+}
+
+void jbi_stats_release(JBIDX idx) {
+  free(idx->stats);
+  idx->stats = 0;
+}
+
+// ---------------------------------------------------------------------------
+//                       Rows estimation
+// ---------------------------------------------------------------------------
+
+static double _jbi_stats_key_num(JBIDX idx, const IWKV_val *key) {
+  if (idx->mode & EJDB_IDX_I64) {
+    int64_t llv;
+    memcpy(&llv, key->data, sizeof(llv));
+    return (double) llv;
+  } else if (!(idx->idbf & IWDB_REALNUM_KEYS)) {
+    return jbi_f64_key_value(key->data);
+  } else {
+    char nbuf[JBNUMBUF_SIZE];
+    size_t sz = MIN(key->size, sizeof(nbuf) - 1);
+    memcpy(nbuf, key->data, sz);
+    nbuf[sz] = '\0';
+    return (double) iwatof(nbuf);
+  }
+}
+
+/**
+ * Compares index keys the same way as they are ordered in index database.
+ */
+static int _jbi_stats_key_cmp(JBIDX idx, const IWKV_val *k1, const IWKV_val *k2) {
+  if (idx->mode & EJDB_IDX_I64) {
+    int64_t v1, v2;
+    memcpy(&v1, k1->data, sizeof(v1));
+    memcpy(&v2, k2->data, sizeof(v2));
+    return v1 > v2 ? 1 : v1 < v2 ? -1 : 0;
+  } else if (idx->mode & EJDB_IDX_F64) {
+    double v1 = _jbi_stats_key_num(idx, k1);
+    double v2 = _jbi_stats_key_num(idx, k2);
+    return v1 > v2 ? 1 : v1 < v2 ? -1 : 0;
+  }
+  int ret = memcmp(k1->data, k2->data, MIN(k1->size, k2->size));
+  if (ret) {
+    return ret;
+  }
+  return k1->size > k2->size ? 1 : k1->size < k2->size ? -1 : 0;
+}
+
+/**
+ * Estimates number of index entries having keys
+ * less than (or equal if `inclusive`) to the given `key`.
+ */
+static double _jbi_stats_below(JBIDX idx, JBIDX_STATS st, const IWKV_val *key, bool inclusive) {
+  int cv = _jbi_stats_key_cmp(idx, &st->bounds[0], key);
+  if ((cv > 0) || ((cv == 0) && !inclusive)) {
+    return 0;
+  }
+  for (int i = 1; i < st->nbounds; ++i) {
+    cv = _jbi_stats_key_cmp(idx, &st->bounds[i], key);
+    if ((cv < 0) || ((cv == 0) && inclusive)) {
+      continue;
+    }
+    // Key is within bucket `i`
+    double lo = (double) (i - 1) * st->depth;
+    double hi = (double) MIN(i * st->depth, st->nkeys);
+    double part = 0.5;
+    if (idx->mode & (EJDB_IDX_I64 | EJDB_IDX_F64)) {
+      double lv = _jbi_stats_key_num(idx, &st->bounds[i - 1]);
+      double hv = _jbi_stats_key_num(idx, &st->bounds[i]);
+      double v = _jbi_stats_key_num(idx, key);
+      part = (hv > lv) ? (v - lv) / (hv - lv) : 0.0;
+      part = part < 0.0 ? 0.0 : part > 1.0 ? 1.0 : part;
+    }
+    return lo + part * (hi - lo);
+  }
+  return (double) st->nkeys;
+}
+
+/**
+ * Estimates number of index entries equal to the given `key`.
+ */
+static double _jbi_stats_eq(JBIDX idx, JBIDX_STATS st, const IWKV_val *key) {
+  if (  (_jbi_stats_key_cmp(idx, &st->bounds[0], key) > 0)
+     || (_jbi_stats_key_cmp(idx, &st->bounds[st->nbounds - 1], key) < 0)) {
+    return 0;
+  }
+  double ret = (double) st->nkeys / (st->ndistinct > 0 ? st->ndistinct : 1);
+  int cnt = 0;
+  for (int i = 1; i < st->nbounds; ++i) {
+    if (!_jbi_stats_key_cmp(idx, &st->bounds[i], key)) {
+      ++cnt;
+    }
+  }
+  if (cnt > 1) { // Frequent key spans over several buckets
+    ret = MAX(ret, (double) (cnt - 1) * st->depth);
+  }
+  return ret;
+}
+
+double jbi_stats_key_rows(JBIDX idx, const IWKV_val *key) {
+  JBIDX_STATS st = idx->stats;
+  if (!st || (st->nkeys < 1) || (st->nbounds < 1)) {
+    return -1;
+  }
+  return _jbi_stats_eq(idx, st, key) * (double) idx->rnum / (double) st->nkeys;
+}
+
+/**
+ * Estimates full-text index entries of the rarest term of text query,
+ * documents having all query terms are within posting list of this term.
+ */
+static iwrc _jbi_stats_text(JBIDX idx, JBIDX_STATS st, JQVAL *rv, double *eq) {
+  IWKV_val ikey;
+  struct _JBTXT q;
+  double rows = -1;
+  iwrc rc = jbi_text_init(&q);
+  RCRET(rc);
+  rc = jbi_text_add_query(&q, idx, rv);
+  RCGO(rc, finish);
+  jbi_text_distinct(&q);
+  for (int i = 0; i < q.num; ++i) {
+    ikey.data = (void*) jbi_text_term(&q, i);
+    ikey.size = strlen(ikey.data);
+    double r = _jbi_stats_eq(idx, st, &ikey);
+    if ((rows < 0) || (r < rows)) {
+      rows = r;
+    }
+  }
+  if (rows > 0) {
+    *eq += rows;
+  }
+
+finish:
+  jbi_text_destroy(&q);
+  return rc;
+}
+
+static iwrc _jbi_stats_expr(
+  JBEXEC *ctx, JBIDX idx, JQP_EXPR *expr,
+  double *eq, double *lower, double *upper, bool *ok) {
+
+  iwrc rc = 0;
+  IWKV_val ikey;
+  char numbuf[JBNUMBUF_SIZE];
+  JBIDX_STATS st = idx->stats;
+  JQVAL *rv = jql_unit_to_jqval(ctx->ux->q->aux, expr->right, &rc);
+  RCRET(rc);
+  jqp_op_t op = jbi_op_cased(expr->op->value);
+
+  switch (op) {
+    case JQP_OP_TEXT:
+    case JQP_OP_RE:
+      return _jbi_stats_text(idx, st, rv, eq);
+    case JQP_OP_IN:
+      if (rv->type == JQVAL_JBLNODE) {
+        for (JBL_NODE n = rv->vnode->child; n; n = n->next) {
+          JQVAL qv;
+          jql_node_to_jqval(n, &qv);
+          jbi_jqval_fill_ikey(idx, &qv, &ikey, numbuf);
+          if (ikey.size) {
+            *eq += _jbi_stats_eq(idx, st, &ikey);
+          }
+          jbi_ikey_dispose(idx, &ikey, numbuf);
+        }
+      } else {
+        *ok = false;
+      }
+      return 0;
+    default:
+      break;
+  }
+
+  jbi_jqval_fill_ikey(idx, rv, &ikey, numbuf);
+  if (!ikey.size) {
+    *ok = false;
+    return 0;
+  }
+  switch (op) {
+    case JQP_OP_EQ:
+      *eq += _jbi_stats_eq(idx, st, &ikey);
+      break;
+    case JQP_OP_GT:
+      *lower = MAX(*lower, _jbi_stats_below(idx, st, &ikey, true));
+      break;
+    case JQP_OP_GTE:
+      *lower = MAX(*lower, _jbi_stats_below(idx, st, &ikey, false));
+      break;
+    case JQP_OP_LT:
+      *upper = MIN(*upper, _jbi_stats_below(idx, st, &ikey, false));
+      break;
+    case JQP_OP_LTE:
+      *upper = MIN(*upper, _jbi_stats_below(idx, st, &ikey, true));
+      break;
+    case JQP_OP_PREFIX: {
+      // Keys with prefix are within [prefix, prefix + '\xff')
+      IWKV_val ukey;
+      char *ubuf = malloc(ikey.size + 1);
+      if (!ubuf) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        break;
+      }
+      memcpy(ubuf, ikey.data, ikey.size);
+      ubuf[ikey.size] = (char) 0xff;
+      ukey.data = ubuf;
+      ukey.size = ikey.size + 1;
+      *lower = MAX(*lower, _jbi_stats_below(idx, st, &ikey, false));
+      *upper = MIN(*upper, _jbi_stats_below(idx, st, &ukey, false));
+      free(ubuf);
+      break;
+    }
+    default:
+      *ok = false;
+      break;
+  }
+  jbi_ikey_dispose(idx, &ikey, numbuf);
+  return rc;
+}
+
+/**
+ * Estimates rows of compound index scan within key range computed by `jbi_compound_bounds()`.
+ */
+static iwrc _jbi_stats_compound_rows(JBEXEC *ctx, struct _JBMIDX *midx, double *rows) {
+  bool hi_inf, empty;
+  JBIDX idx = midx->idx;
+  JBIDX_STATS st = idx->stats;
+  IWXSTR *lo = iwxstr_new(), *hi = iwxstr_new();
+
+  iwrc rc = 0;
+  if (!lo || !hi) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  rc = jbi_compound_bounds(ctx, midx, lo, hi, &hi_inf, &empty);
+  RCGO(rc, finish);
+  if (empty) {
+    *rows = 0;
+    goto finish;
+  }
+  IWKV_val lkey = { .data = iwxstr_ptr(lo), .size = iwxstr_size(lo) };
+  IWKV_val hkey = { .data = iwxstr_ptr(hi), .size = iwxstr_size(hi) };
+  if (midx->neq == idx->ncols) {
+    *rows = _jbi_stats_eq(idx, st, &lkey);
+  } else {
+    double upper = hi_inf ? (double) st->nkeys : _jbi_stats_below(idx, st, &hkey, false);
+    double lower = _jbi_stats_below(idx, st, &lkey, false);
+    *rows = upper - lower;
+    if (*rows < 1.0) { // Range is within single histogram bucket
+      *rows = MIN((double) st->depth, (double) st->nkeys / (st->ndistinct > 0 ? st->ndistinct : 1));
+    }
+  }
+
+finish:
+  if (lo) {
+    iwxstr_destroy(lo);
+  }
+  if (hi) {
+    iwxstr_destroy(hi);
+  }
+  return rc;
+}
+
+iwrc jbi_stats_estimate(JBEXEC *ctx, struct _JBMIDX *midx) {
+  iwrc rc = 0;
+  bool ok = true;
+  JBIDX idx = midx->idx;
+  JBIDX_STATS st = idx->stats;
+  struct JQP_AUX *aux = ctx->ux->q->aux;
+  double rows, eq = 0, lower = 0, upper;
+
+  midx->estimated = false;
+  if (!st || (st->nkeys < 1) || (st->nbounds < 1)) {
+    return 0;
+  }
+  if (idx->ncols) {
+    rc = _jbi_stats_compound_rows(ctx, midx, &rows);
+    RCRET(rc);
+    goto scale;
+  }
+  if (!midx->expr1) {
+    return 0;
+  }
+  upper = (double) st->nkeys;
+  rc = _jbi_stats_expr(ctx, idx, midx->expr1, &eq, &lower, &upper, &ok);
+  RCRET(rc);
+  if (midx->expr2) {
+    rc = _jbi_stats_expr(ctx, idx, midx->expr2, &eq, &lower, &upper, &ok);
+    RCRET(rc);
+  }
+  if (!ok) {
+    return 0;
+  }
+  if (midx->cursor_init == IWKV_CURSOR_EQ) {
+    rows = eq;
+  } else {
+    rows = upper > lower ? upper - lower : 0;
+  }
+
+scale:
+  // Scale to the actual number of index entries
+  rows = rows * (double) idx->rnum / (double) st->nkeys;
+  midx->rows = (int64_t) (rows + 0.5);
+  midx->cost = (double) midx->rows;
+  if (aux->orderby_num && !midx->orderby_support) {
+    midx->cost += midx->rows * log2(midx->rows + 1.0) * JB_IDX_COST_SORT_RATE;
+  }
+  midx->estimated = true;
+  return 0;
+}
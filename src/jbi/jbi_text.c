@@ -0,0 +1,383 @@
+#include "ejdb2_internal.h"
+#include "convert.h"
+#include "utf8proc.h"
+#include "sort_r.h"
+#include "lwre.h"
+
+// Text is split into terms: maximal runs of letters, digits and combining marks
+// of text normalized to NFKC form and case folded by utf8proc.
+// Terms of different strings (phrases) are separated by empty term
+// so phrase never spans adjacent strings of array.
+//
+// Terms of `EJDB_IDX_TRIGRAM` index are all three byte substrings of strings as is.
+// Trigrams of regular expression are taken from its literal runs every matched string contains.
+
+IW_INLINE bool _jbi_text_is_term_char(utf8proc_int32_t cp) {
+  utf8proc_category_t c = utf8proc_category(cp);
+  return (c >= UTF8PROC_CATEGORY_LU) && (c <= UTF8PROC_CATEGORY_NO);
+}
+
+iwrc jbi_text_init(struct _JBTXT *t) {
+  memset(t, 0, sizeof(*t));
+  t->buf = iwxstr_new();
+  if (!t->buf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  return 0;
+}
+
+void jbi_text_destroy(struct _JBTXT *t) {
+  iwxstr_destroy(t->buf);
+  free(t->offs);
+  memset(t, 0, sizeof(*t));
+}
+
+static iwrc _jbi_text_term_add(struct _JBTXT *t, const char *term, size_t len) {
+  if (t->num >= t->asz) {
+    int nsz = t->asz ? t->asz * 2 : 16;
+    size_t *noffs = realloc(t->offs, nsz * sizeof(t->offs[0]));
+    if (!noffs) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    t->offs = noffs;
+    t->asz = nsz;
+  }
+  size_t off = iwxstr_size(t->buf);
+  iwrc rc = iwxstr_cat(t->buf, term, len);
+  RCRET(rc);
+  rc = iwxstr_cat(t->buf, "\0", 1);
+  RCRET(rc);
+  t->offs[t->num++] = off;
+  return 0;
+}
+
+static iwrc _jbi_text_add_trigrams(struct _JBTXT *t, const char *text, size_t len) {
+  for (size_t i = 0; i + 3 <= len; ++i) {
+    if (memchr(text + i, '\0', 3)) {
+      continue;
+    }
+    iwrc rc = _jbi_text_term_add(t, text + i, 3);
+    RCRET(rc);
+  }
+  return 0;
+}
+
+iwrc jbi_text_add(struct _JBTXT *t, const char *text, size_t len) {
+  iwrc rc = 0;
+  size_t nlen;
+  if (!len) {
+    return 0;
+  }
+  if (t->trigrams) {
+    return _jbi_text_add_trigrams(t, text, len);
+  }
+  utf8proc_uint8_t *nstr = (utf8proc_uint8_t*) jbi_nocase(text, len, &nlen);
+  if (!nstr) { // Not a valid UTF-8 text has no terms
+    return 0;
+  }
+  if (t->num && *jbi_text_term(t, t->num - 1) != '\0') {
+    rc = _jbi_text_term_add(t, "", 0);
+    RCGO(rc, finish);
+  }
+  for (utf8proc_ssize_t i = 0, s = -1, e = 0; i <= (utf8proc_ssize_t) nlen; ) {
+    utf8proc_int32_t cp = -1;
+    utf8proc_ssize_t sz = i < (utf8proc_ssize_t) nlen ? utf8proc_iterate(nstr + i, nlen - i, &cp) : 1;
+    if (sz < 1) {
+      break;
+    }
+    if ((cp >= 0) && _jbi_text_is_term_char(cp)) {
+      if (s < 0) {
+        s = i;
+      }
+      if (i + sz - s <= JB_TEXT_TERM_MAX) { // Long term is truncated on code point boundary
+        e = i + sz;
+      }
+    } else if (s >= 0) {
+      rc = _jbi_text_term_add(t, (const char*) nstr + s, e - s);
+      RCGO(rc, finish);
+      s = -1;
+    }
+    i += sz;
+  }
+
+finish:
+  free(nstr);
+  return rc;
+}
+
+/**
+ * Adds trigrams of number or boolean `bv` converted to string
+ * exactly as it is seen by `re` query operator.
+ */
+static iwrc _jbi_text_add_scalar(struct _JBTXT *t, binn *bv) {
+  JQVAL qv;
+  size_t len;
+  const char *str;
+  char nbuf[JBNUMBUF_SIZE];
+  switch (jql_binn_to_jqval(bv, &qv)) {
+    case JQVAL_I64:
+      iwitoa(qv.vi64, nbuf, JBNUMBUF_SIZE);
+      str = nbuf;
+      len = strlen(nbuf);
+      break;
+    case JQVAL_F64:
+      jbi_ftoa(qv.vf64, nbuf, &len);
+      str = nbuf;
+      break;
+    case JQVAL_BOOL:
+      str = qv.vbool ? "true" : "false";
+      len = strlen(str);
+      break;
+    default:
+      return 0;
+  }
+  return jbi_text_add(t, str, len);
+}
+
+static iwrc _jbi_text_add_binn(struct _JBTXT *t, binn *bv) {
+  binn iv;
+  binn_iter iter;
+  if (bv->type == BINN_STRING) {
+    return jbi_text_add(t, bv->ptr, strlen(bv->ptr));
+  } else if (bv->type != BINN_LIST) {
+    return t->trigrams ? _jbi_text_add_scalar(t, bv) : 0;
+  }
+  if (!binn_iter_init(&iter, bv, bv->type)) {
+    return JBL_ERROR_INVALID;
+  }
+  while (binn_list_next(&iter, &iv)) {
+    iwrc rc = 0;
+    if (iv.type == BINN_STRING) {
+      rc = jbi_text_add(t, iv.ptr, strlen(iv.ptr));
+    } else if (t->trigrams) {
+      rc = _jbi_text_add_scalar(t, &iv);
+    }
+    RCRET(rc);
+  }
+  return 0;
+}
+
+static iwrc _jbi_text_add_node(struct _JBTXT *t, JBL_NODE n) {
+  if (n->type == JBV_STR) {
+    return jbi_text_add(t, n->vptr, n->vsize);
+  } else if (n->type != JBV_ARRAY) {
+    return 0;
+  }
+  for (n = n->child; n; n = n->next) {
+    if (n->type == JBV_STR) {
+      iwrc rc = jbi_text_add(t, n->vptr, n->vsize);
+      RCRET(rc);
+    }
+  }
+  return 0;
+}
+
+iwrc jbi_text_add_jqval(struct _JBTXT *t, const JQVAL *jqval) {
+  switch (jqval->type) {
+    case JQVAL_STR:
+      return jbi_text_add(t, jqval->vstr, strlen(jqval->vstr));
+    case JQVAL_JBLNODE:
+      return _jbi_text_add_node(t, jqval->vnode);
+    case JQVAL_BINN:
+      return _jbi_text_add_binn(t, jqval->vbinn);
+    default:
+      return 0;
+  }
+}
+
+iwrc jbi_text_add_doc(struct _JBTXT *t, JBIDX idx, JBL jbl) {
+  struct _JBL jbv;
+  t->trigrams = (idx->mode & EJDB_IDX_TRIGRAM) != 0;
+  if (!jbl || !_jbl_at(jbl, idx->ptr, &jbv)) {
+    return 0;
+  }
+  switch (jbl_type(&jbv)) {
+    case JBV_STR:
+      return jbi_text_add(t, jbl_get_str(&jbv), jbl_size(&jbv));
+    case JBV_ARRAY:
+      return _jbi_text_add_binn(t, &jbv.bn);
+    case JBV_I64:
+    case JBV_F64:
+    case JBV_BOOL:
+      return t->trigrams ? _jbi_text_add_scalar(t, &jbv.bn) : 0;
+    default:
+      return 0;
+  }
+}
+
+static const char *_jbi_text_re_skip_class(const char *p, const char *ep) {
+  while (p < ep && *p != ']') {
+    if ((*p == '\\') && (p + 1 < ep)) {
+      ++p;
+    }
+    ++p;
+  }
+  return p < ep ? p + 1 : p;
+}
+
+/**
+ * Adds trigrams of literal runs of `lwre` regular expression `re`.
+ * Nothing is added if expression has top level alternation.
+ * Leading `^` and trailing `$` are stripped if `anchors` is set as JQL `re` operator does.
+ */
+static iwrc _jbi_text_add_regex(struct _JBTXT *t, const char *re, bool anchors) {
+  iwrc rc = 0;
+  bool alt = false;
+  int num = t->num;
+  size_t bsz = iwxstr_size(t->buf);
+  size_t len = strlen(re);
+  IWXSTR *run = iwxstr_new();
+  if (!run) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  if (anchors) {
+    if (*re == '^') {
+      ++re;
+      --len;
+    }
+    if (len && (re[len - 1] == '$')) {
+      --len;
+    }
+  }
+  for (const char *p = re, *ep = re + len; p < ep && !alt; ) {
+    char c = *p++;
+    bool flush = true;
+    switch (c) {
+      case '.':
+        break;
+      case '[':
+        p = _jbi_text_re_skip_class(p, ep);
+        break;
+      case '(':
+      case '{':
+        for (int depth = 1; p < ep && depth; ) {
+          c = *p++;
+          if ((c == '\\') && (p < ep)) {
+            ++p;
+          } else if (c == '[') {
+            p = _jbi_text_re_skip_class(p, ep);
+          } else if ((c == '(') || (c == '{')) {
+            ++depth;
+          } else if ((c == ')') || (c == '}')) {
+            --depth;
+          }
+        }
+        break;
+      case '?':
+      case '*': // Previous character is optional
+        if (iwxstr_size(run)) {
+          iwxstr_pop(run, 1);
+        }
+      // fallthrough
+      case '+':
+        if ((p < ep) && (*p == '?')) { // Lazy quantifier
+          ++p;
+        }
+        break;
+      case '|':
+      case ')':
+      case '}':
+      case '>':
+        alt = true;
+        break;
+      case '\\':
+        if (p < ep) {
+          c = *p++;
+        }
+      // fallthrough
+      default:
+        flush = false;
+        rc = iwxstr_cat(run, &c, 1);
+        break;
+    }
+    if (!rc && flush) {
+      rc = _jbi_text_add_trigrams(t, iwxstr_ptr(run), iwxstr_size(run));
+      iwxstr_clear(run);
+    }
+    RCGO(rc, finish);
+  }
+  if (!alt) {
+    rc = _jbi_text_add_trigrams(t, iwxstr_ptr(run), iwxstr_size(run));
+  }
+
+finish:
+  if (alt || rc) { // Regexp alternatives have no common trigrams
+    iwxstr_pop(t->buf, iwxstr_size(t->buf) - bsz);
+    t->num = num;
+  }
+  iwxstr_destroy(run);
+  return rc;
+}
+
+iwrc jbi_text_add_query(struct _JBTXT *t, JBIDX idx, const JQVAL *jqval) {
+  if (!(idx->mode & EJDB_IDX_TRIGRAM)) {
+    return jbi_text_add_jqval(t, jqval);
+  }
+  t->trigrams = true;
+  switch (jqval->type) {
+    case JQVAL_STR:
+      return _jbi_text_add_regex(t, jqval->vstr, true);
+    case JQVAL_RE:
+      return _jbi_text_add_regex(t, jqval->vre->expression, false);
+    default:
+      return 0;
+  }
+}
+
+static int _jbi_text_term_cmp(const void *o1, const void *o2, void *op) {
+  const char *buf = op;
+  return strcmp(buf + *(const size_t*) o1, buf + *(const size_t*) o2);
+}
+
+void jbi_text_distinct(struct _JBTXT *t) {
+  const char *buf = iwxstr_ptr(t->buf);
+  int j = 0;
+  for (int i = 0; i < t->num; ++i) { // Drop phrase separators
+    if (buf[t->offs[i]] != '\0') {
+      t->offs[j++] = t->offs[i];
+    }
+  }
+  t->num = j;
+  if (t->num < 2) {
+    return;
+  }
+  sort_r(t->offs, t->num, sizeof(t->offs[0]), _jbi_text_term_cmp, (void*) buf);
+  j = 1;
+  for (int i = 1; i < t->num; ++i) {
+    if (strcmp(buf + t->offs[i], buf + t->offs[j - 1])) {
+      t->offs[j++] = t->offs[i];
+    }
+  }
+  t->num = j;
+}
+
+/**
+ * Returns true if `phrase` terms of `len` are found as adjacent terms of `t`.
+ */
+static bool _jbi_text_phrase_found(const struct _JBTXT *t, const struct _JBTXT *q, int phrase, int len) {
+  for (int i = 0; i + len <= t->num; ++i) {
+    int j = 0;
+    for ( ; j < len && !strcmp(jbi_text_term(t, i + j), jbi_text_term(q, phrase + j)); ++j) ;
+    if (j == len) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool jbi_text_matched(const struct _JBTXT *t, const struct _JBTXT *q) {
+  bool found = false;
+  for (int i = 0, s = 0; i <= q->num; ++i) {
+    if ((i < q->num) && (*jbi_text_term(q, i) != '\0')) {
+      continue;
+    }
+    if (i > s) {
+      if (!_jbi_text_phrase_found(t, q, s, i - s)) {
+        return false;
+      }
+      found = true;
+    }
+    s = i + 1;
+  }
+  return found;
+}
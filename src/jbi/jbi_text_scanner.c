@@ -0,0 +1,119 @@
+#include "ejdb2_internal.h"
+
+// Full-text query is served by scan of posting list of the rarest query term
+// estimated by index statistics (the longest term if index has no statistics).
+// Documents missing other query terms are skipped by lookups in their posting lists,
+// phrases adjacency and regular expressions of trigram index are checked
+// by query filter on fetched documents.
+
+static iwrc _jbi_text_has_term(JBIDX idx, const char *term, int64_t id, bool *found) {
+  IWKV_val val;
+  IWKV_val key = {
+    .data     = (void*) term,
+    .size     = strlen(term),
+    .compound = id
+  };
+  iwrc rc = iwkv_get(idx->idb, &key, &val);
+  if (!rc) {
+    iwkv_val_dispose(&val);
+    *found = true;
+  } else if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+    *found = false;
+  }
+  return rc;
+}
+
+static int _jbi_text_scan_term(JBIDX idx, const struct _JBTXT *q) {
+  int ret = 0;
+  double rows = -1;
+  for (int i = 0; i < q->num; ++i) {
+    const char *term = jbi_text_term(q, i);
+    if (idx->stats) {
+      IWKV_val key = {
+        .data = (void*) term,
+        .size = strlen(term)
+      };
+      double r = jbi_stats_key_rows(idx, &key);
+      if ((r >= 0) && ((rows < 0) || (r < rows))) {
+        rows = r;
+        ret = i;
+      }
+    } else if (strlen(term) > strlen(jbi_text_term(q, ret))) {
+      ret = i;
+    }
+  }
+  return ret;
+}
+
+iwrc jbi_text_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
+  iwrc rc;
+  bool matched;
+  struct _JBTXT q;
+  IWKV_cursor cur = 0;
+  int64_t step = 1, dir = 1;
+  struct _JBMIDX *midx = &ctx->midx;
+  JBIDX idx = midx->idx;
+
+  JQVAL *jqval = jql_unit_to_jqval(ctx->ux->q->aux, midx->expr1->right, &rc);
+  RCRET(rc);
+  rc = jbi_text_init(&q);
+  RCRET(rc);
+  rc = jbi_text_add_query(&q, idx, jqval);
+  RCGO(rc, finish);
+  jbi_text_distinct(&q);
+  if (!q.num) {
+    goto finish;
+  }
+
+  int sterm = _jbi_text_scan_term(idx, &q);
+  IWKV_val key = {
+    .data     = (void*) jbi_text_term(&q, sterm),
+    .size     = strlen(jbi_text_term(&q, sterm)),
+    .compound = INT64_MIN
+  };
+  midx->cursor_step = IWKV_CURSOR_PREV;
+  rc = iwkv_cursor_open(idx->idb, &cur, IWKV_CURSOR_GE, &key);
+  RCGO(rc, finish);
+
+  do {
+    if (step > 0) {
+      --step;
+    } else if (step < 0) {
+      ++step;
+    }
+    if (!step) {
+      int64_t id;
+      bool found = true;
+      rc = iwkv_cursor_is_matched_key(cur, &key, &matched, &id);
+      RCGO(rc, finish);
+      if (!matched) {
+        break;
+      }
+      for (int i = 0; i < q.num && found; ++i) {
+        if (i != sterm) {
+          rc = _jbi_text_has_term(idx, jbi_text_term(&q, i), id, &found);
+          RCGO(rc, finish);
+        }
+      }
+      step = dir; // Skipped document keeps scan direction
+      if (found) {
+        rc = consumer(ctx, 0, id, &step, &matched, 0);
+        RCGO(rc, finish);
+        if (step) {
+          dir = step > 0 ? 1 : -1;
+        }
+      }
+    }
+  } while (step && !(rc = iwkv_cursor_to(cur, step > 0 ? IWKV_CURSOR_PREV : IWKV_CURSOR_NEXT)));
+
+finish:
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  if (cur) {
+    iwkv_cursor_close(&cur);
+  }
+  jbi_text_destroy(&q);
+  return consumer(ctx, 0, 0, 0, 0, rc);
+}
@@ -15,7 +15,15 @@ static iwrc _jbi_consume_eq(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUMER
   if (!key.size) {
     return consumer(ctx, 0, 0, 0, 0, 0);
   }
-  iwrc rc = iwkv_get_copy(midx->idx->idb, &key, numbuf, sizeof(numbuf), &sz);
+  iwrc rc;
+  if (!jbi_bloom_may_contain(midx->idx->bloom, key.data, key.size)) {
+    rc = IWKV_ERROR_NOTFOUND;
+  } else if (ctx->covering) {
+    rc = jbi_covering_load(ctx, 0, &key);
+  } else {
+    rc = iwkv_get_copy(midx->idx->idb, &key, numbuf, sizeof(numbuf), &sz);
+  }
+  jbi_ikey_dispose(midx->idx, &key, numbuf);
   if (rc) {
     if (rc == IWKV_ERROR_NOTFOUND) {
       return consumer(ctx, 0, 0, 0, 0, 0);
@@ -23,7 +31,7 @@ static iwrc _jbi_consume_eq(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUMER
       return rc;
     }
   }
-  IW_READVNUMBUF64_2(numbuf, id);
+  IW_READVNUMBUF64_2(ctx->covering ? (char*) ctx->cvbuf : numbuf, id);
   rc = consumer(ctx, 0, id, &step, &matched, 0);
   return consumer(ctx, 0, 0, 0, 0, rc);
 }
@@ -50,7 +58,14 @@ static iwrc _jbi_consume_in_node(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONS
     if (!key.size) {
       continue;
     }
-    rc = iwkv_get_copy(midx->idx->idb, &key, numbuf, sizeof(numbuf), &sz);
+    if (!jbi_bloom_may_contain(midx->idx->bloom, key.data, key.size)) {
+      rc = IWKV_ERROR_NOTFOUND;
+    } else if (ctx->covering) {
+      rc = jbi_covering_load(ctx, 0, &key);
+    } else {
+      rc = iwkv_get_copy(midx->idx->idb, &key, numbuf, sizeof(numbuf), &sz);
+    }
+    jbi_ikey_dispose(midx->idx, &key, numbuf);
     if (rc) {
       if (rc == IWKV_ERROR_NOTFOUND) {
         rc = 0;
@@ -65,7 +80,7 @@ static iwrc _jbi_consume_in_node(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONS
       ++step;
     }
     if (!step) {
-      IW_READVNUMBUF64_2(numbuf, id);
+      IW_READVNUMBUF64_2(ctx->covering ? (char*) ctx->cvbuf : numbuf, id);
       step = 1;
       rc = consumer(ctx, 0, id, &step, &matched, 0);
       RCGO(rc, finish);
@@ -84,12 +99,13 @@ static iwrc _jbi_consume_scan(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUME
   int64_t step = 1;
   struct _JBMIDX *midx = &ctx->midx;
   JBIDX idx = midx->idx;
-  jqp_op_t expr1_op = midx->expr1->op->value;
+  jqp_op_t expr1_op = jbi_op_cased(midx->expr1->op->value);
 
   IWKV_val key;
   jbi_jqval_fill_ikey(idx, jqval, &key, numbuf);
 
   iwrc rc = iwkv_cursor_open(idx->idb, &cur, midx->cursor_init, &key);
+  jbi_ikey_dispose(idx, &key, numbuf);
   if ((rc == IWKV_ERROR_NOTFOUND) && ((expr1_op == JQP_OP_LT) || (expr1_op == JQP_OP_LTE))) {
     iwkv_cursor_close(&cur);
     midx->cursor_init = IWKV_CURSOR_BEFORE_FIRST;
@@ -121,7 +137,7 @@ static iwrc _jbi_consume_scan(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUME
       bool matched = false;
       rc = iwkv_cursor_copy_val(cur, &numbuf, IW_VNUMBUFSZ, &sz);
       RCGO(rc, finish);
-      if (sz > IW_VNUMBUFSZ) {
+      if ((sz > IW_VNUMBUFSZ) && !midx->idx->ipaths) {
         rc = IWKV_ERROR_CORRUPTED;
         iwlog_ecode_error3(rc);
         break;
@@ -139,6 +155,10 @@ static iwrc _jbi_consume_scan(struct _JBEXEC *ctx, JQVAL *jqval, JB_SCAN_CONSUME
       RCGO(rc, finish);
 
       step = 1;
+      if (ctx->covering) {
+        rc = jbi_covering_load(ctx, cur, 0);
+        RCGO(rc, finish);
+      }
       rc = consumer(ctx, 0, id, &step, &matched, 0);
       RCGO(rc, finish);
       if (!midx->expr1->prematched && matched && (expr1_op != JQP_OP_PREFIX)) {
@@ -184,7 +204,7 @@ iwrc _jbi_consume_noxpr_scan(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
       bool matched;
       rc = iwkv_cursor_copy_val(cur, &numbuf, IW_VNUMBUFSZ, &sz);
       RCGO(rc, finish);
-      if (sz > IW_VNUMBUFSZ) {
+      if ((sz > IW_VNUMBUFSZ) && !midx->idx->ipaths) {
         rc = IWKV_ERROR_CORRUPTED;
         iwlog_ecode_error3(rc);
         break;
@@ -192,6 +212,10 @@ iwrc _jbi_consume_noxpr_scan(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
       IW_READVNUMBUF64_2(numbuf, id);
       RCGO(rc, finish);
       step = 1;
+      if (ctx->covering) {
+        rc = jbi_covering_load(ctx, cur, 0);
+        RCGO(rc, finish);
+      }
       rc = consumer(ctx, 0, id, &step, &matched, 0);
       RCGO(rc, finish);
     }
@@ -216,7 +240,7 @@ iwrc jbi_uniq_scanner(struct _JBEXEC *ctx, JB_SCAN_CONSUMER consumer) {
   JQP_QUERY *qp = ctx->ux->q->qp;
   JQVAL *jqval = jql_unit_to_jqval(qp->aux, midx->expr1->right, &rc);
   RCRET(rc);
-  switch (midx->expr1->op->value) {
+  switch (jbi_op_cased(midx->expr1->op->value)) {
     case JQP_OP_EQ:
       return _jbi_consume_eq(ctx, jqval, consumer);
     case JQP_OP_IN:
@@ -1,14 +1,126 @@
 #include "ejdb2_internal.h"
 #include "convert.h"
+#include "utf8proc.h"
 #include <ejdb2/iowow/iwutils.h>
 
 // ---------------------------------------------------------------------------
 
+void jbi_f64_key(double v, uint8_t key[static JB_IDX_F64_KEY_SIZE]) {
+  uint64_t u;
+  if (v == 0.0) { // -V550
+    v = 0.0; // Normalize negative zero
+  }
+  memcpy(&u, &v, sizeof(u));
+  // Flip all bits of negative numbers and sign bit of positive ones
+  // so big endian bytes are ordered the same way as numbers
+  u = (u & 0x8000000000000000ULL) ? ~u : (u | 0x8000000000000000ULL);
+  for (int i = JB_IDX_F64_KEY_SIZE - 1; i >= 0; --i) {
+    key[i] = (uint8_t) u;
+    u >>= 8;
+  }
+}
+
+double jbi_f64_key_value(const void *key) {
+  double v;
+  uint64_t u = 0;
+  const uint8_t *kp = key;
+  for (int i = 0; i < JB_IDX_F64_KEY_SIZE; ++i) {
+    u = (u << 8) | kp[i];
+  }
+  u = (u & 0x8000000000000000ULL) ? (u & ~0x8000000000000000ULL) : ~u;
+  memcpy(&v, &u, sizeof(v));
+  return v;
+}
+
+static void _jbi_f64_fill_ikey(JBIDX idx, double v, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]) {
+  ikey->data = numbuf;
+  if (idx->idbf & IWDB_REALNUM_KEYS) { // Legacy decimal keys of index not rebuilt by `ejdb_rebuild_index()`
+    jbi_ftoa(v, numbuf, &ikey->size);
+  } else {
+    jbi_f64_key(v, (uint8_t*) numbuf);
+    ikey->size = JB_IDX_F64_KEY_SIZE;
+  }
+}
+
+uint64_t jbi_hash64(const void *buf, size_t len) {
+  // FNV-1a followed by avalanche mixing of splitmix64 finalizer
+  const uint8_t *p = buf;
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+char *jbi_nocase(const char *str, size_t len, size_t *olen) {
+  utf8proc_uint8_t *ret = 0;
+  utf8proc_ssize_t rlen = utf8proc_map(
+    (const utf8proc_uint8_t*) str, len, &ret,
+    UTF8PROC_STABLE | UTF8PROC_COMPAT | UTF8PROC_COMPOSE | UTF8PROC_IGNORE | UTF8PROC_CASEFOLD);
+  if (rlen < 0) {
+    *olen = 0;
+    return 0;
+  }
+  *olen = (size_t) rlen;
+  return (char*) ret;
+}
+
+/**
+ * Replaces string key of `EJDB_IDX_NOCASE` index by its NFKC case folded form.
+ * Folded key is placed into `numbuf` if fits, otherwise it is allocated and
+ * must be released by `jbi_ikey_dispose()`. Not a valid UTF-8 string is not indexed.
+ */
+static void _jbi_nocase_ikey(JBIDX idx, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]) {
+  size_t len;
+  if (!(idx->mode & EJDB_IDX_NOCASE) || !ikey->size || (ikey->data == numbuf)) {
+    return;
+  }
+  char *fstr = jbi_nocase(ikey->data, ikey->size, &len);
+  if (!fstr || !len) {
+    free(fstr);
+    ikey->size = 0;
+    ikey->data = 0;
+  } else if (len < JBNUMBUF_SIZE) {
+    memcpy(numbuf, fstr, len);
+    free(fstr);
+    ikey->size = len;
+    ikey->data = numbuf;
+  } else {
+    ikey->size = len;
+    ikey->data = fstr;
+  }
+}
+
+/**
+ * Replaces string key of `EJDB_IDX_HASH` index by its big endian 64 bit hash placed into `numbuf`.
+ */
+static void _jbi_hash_ikey(JBIDX idx, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]) {
+  if (!(idx->mode & EJDB_IDX_HASH) || !ikey->size) {
+    return;
+  }
+  uint64_t h = jbi_hash64(ikey->data, ikey->size);
+  if ((idx->mode & EJDB_IDX_NOCASE) && (ikey->data != numbuf)) {
+    free(ikey->data);
+  }
+  for (int i = JB_IDX_HASH_KEY_SIZE - 1; i >= 0; --i) {
+    numbuf[i] = (char) (uint8_t) h;
+    h >>= 8;
+  }
+  ikey->size = JB_IDX_HASH_KEY_SIZE;
+  ikey->data = numbuf;
+}
+
 // fixme: code duplication below
 void jbi_jbl_fill_ikey(JBIDX idx, JBL jbv, IWKV_val *ikey, char numbuf[static JBNUMBUF_SIZE]) {
   int64_t *llv = (void*) numbuf;
   jbl_type_t jbvt = jbl_type(jbv);
-  ejdb_idx_mode_t itype = (idx->mode & ~(EJDB_IDX_UNIQUE));
+  ejdb_idx_mode_t itype = (idx->mode & ~(EJDB_IDX_UNIQUE | EJDB_IDX_NOCASE | EJDB_IDX_HASH));
   ikey->size = 0;
   ikey->data = 0;
 
@@ -39,6 +151,8 @@ void jbi_jbl_fill_ikey(JBIDX idx, JBL jbv, IWKV_val *ikey, char numbuf[static JB
         default:
           break;
       }
+      _jbi_nocase_ikey(idx, ikey, numbuf);
+      _jbi_hash_ikey(idx, ikey, numbuf);
       break;
     case EJDB_IDX_I64:
       ikey->size = sizeof(*llv);
@@ -64,10 +178,10 @@ void jbi_jbl_fill_ikey(JBIDX idx, JBL jbv, IWKV_val *ikey, char numbuf[static JB
         case JBV_F64:
         case JBV_I64:
         case JBV_BOOL:
-          jbi_ftoa(jbl_get_f64(jbv), numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, jbl_get_f64(jbv), ikey, numbuf);
           break;
         case JBV_STR:
-          jbi_ftoa(iwatof(jbl_get_str(jbv)), numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, (double) iwatof(jbl_get_str(jbv)), ikey, numbuf);
           break;
         default:
           ikey->size = 0; // -V1048
@@ -84,7 +198,7 @@ void jbi_jqval_fill_ikey(JBIDX idx, const JQVAL *jqval, IWKV_val *ikey, char num
   int64_t *llv = (void*) numbuf;
   ikey->size = 0;
   ikey->data = numbuf;
-  ejdb_idx_mode_t itype = (idx->mode & ~(EJDB_IDX_UNIQUE));
+  ejdb_idx_mode_t itype = (idx->mode & ~(EJDB_IDX_UNIQUE | EJDB_IDX_NOCASE | EJDB_IDX_HASH));
   jqval_type_t jqvt = jqval->type;
 
   switch (itype) {
@@ -112,6 +226,8 @@ void jbi_jqval_fill_ikey(JBIDX idx, const JQVAL *jqval, IWKV_val *ikey, char num
         default:
           break;
       }
+      _jbi_nocase_ikey(idx, ikey, numbuf);
+      _jbi_hash_ikey(idx, ikey, numbuf);
       break;
     case EJDB_IDX_I64:
       ikey->size = sizeof(*llv);
@@ -136,16 +252,16 @@ void jbi_jqval_fill_ikey(JBIDX idx, const JQVAL *jqval, IWKV_val *ikey, char num
     case EJDB_IDX_F64:
       switch (jqvt) {
         case JQVAL_F64:
-          jbi_ftoa(jqval->vf64, numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, jqval->vf64, ikey, numbuf);
           break;
         case JQVAL_I64:
-          jbi_ftoa(jqval->vi64, numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, (double) jqval->vi64, ikey, numbuf);
           break;
         case JQVAL_BOOL:
-          jbi_ftoa(jqval->vbool, numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, jqval->vbool, ikey, numbuf);
           break;
         case JQVAL_STR:
-          jbi_ftoa(iwatof(jqval->vstr), numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, (double) iwatof(jqval->vstr), ikey, numbuf);
           break;
         default:
           ikey->data = 0;
@@ -161,7 +277,7 @@ void jbi_node_fill_ikey(JBIDX idx, JBL_NODE node, IWKV_val *ikey, char numbuf[st
   int64_t *llv = (void*) numbuf;
   ikey->size = 0;
   ikey->data = numbuf;
-  ejdb_idx_mode_t itype = (idx->mode & ~(EJDB_IDX_UNIQUE));
+  ejdb_idx_mode_t itype = (idx->mode & ~(EJDB_IDX_UNIQUE | EJDB_IDX_NOCASE | EJDB_IDX_HASH));
   jbl_type_t jbvt = node->type;
 
   switch (itype) {
@@ -189,6 +305,8 @@ void jbi_node_fill_ikey(JBIDX idx, JBL_NODE node, IWKV_val *ikey, char numbuf[st
         default:
           break;
       }
+      _jbi_nocase_ikey(idx, ikey, numbuf);
+      _jbi_hash_ikey(idx, ikey, numbuf);
       break;
     case EJDB_IDX_I64:
       ikey->size = sizeof(*llv);
@@ -214,16 +332,16 @@ void jbi_node_fill_ikey(JBIDX idx, JBL_NODE node, IWKV_val *ikey, char numbuf[st
     case EJDB_IDX_F64:
       switch (jbvt) {
         case JBV_F64:
-          jbi_ftoa(node->vf64, numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, node->vf64, ikey, numbuf);
           break;
         case JBV_I64:
-          jbi_ftoa(node->vi64, numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, (double) node->vi64, ikey, numbuf);
           break;
         case JBV_BOOL:
-          jbi_ftoa(node->vbool, numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, node->vbool, ikey, numbuf);
           break;
         case JBV_STR:
-          jbi_ftoa(iwatof(node->vptr), numbuf, &ikey->size);
+          _jbi_f64_fill_ikey(idx, (double) iwatof(node->vptr), ikey, numbuf);
           break;
         default:
           ikey->data = 0;
@@ -267,9 +385,13 @@ bool jbi_node_expr_matched(JQP_AUX *aux, JBIDX idx, IWKV_cursor cur, JQP_EXPR *e
     memcpy(&lv.vi64, kbuf, sizeof(lv.vi64));
     lv.type = JQVAL_I64;
   } else if (idx->mode & EJDB_IDX_F64) {
-    kbuf[sz] = '\0';
     lv.type = JQVAL_F64;
-    lv.vf64 = (double) iwatof(kbuf);
+    if (idx->idbf & IWDB_REALNUM_KEYS) {
+      kbuf[sz] = '\0';
+      lv.vf64 = (double) iwatof(kbuf);
+    } else {
+      lv.vf64 = jbi_f64_key_value(kbuf);
+    }
   }
 
   ret = jql_match_jqval_pair(aux, &lv, expr->op, rv, &rc);
@@ -281,3 +403,195 @@ finish:
   *rcp = rc;
   return ret;
 }
+
+// ---------------------------------------------------------------------------
+//                       Compound index keys
+//
+// Compound index key is a concatenation of column values encoded in order preserving way
+// so keys compared as byte strings are ordered the same way as tuples of column values:
+//
+//  0x00                             Absent column value
+//  0x01 <8 bytes big endian>        I64 value with flipped sign bit
+//  0x01 <8 bytes big endian>        F64 value bits ordered as unsigned number
+//  0x01 <escaped bytes> 0x00 0x01   STR value, 0x00 bytes are escaped as 0x00 0xff
+// ---------------------------------------------------------------------------
+
+static iwrc _jbi_ckey_add_u64(IWXSTR *ckey, uint64_t v) {
+  uint8_t buf[9] = { 0x01 };
+  for (int i = 8; i > 0; --i) {
+    buf[i] = (uint8_t) v;
+    v >>= 8;
+  }
+  return iwxstr_cat(ckey, buf, sizeof(buf));
+}
+
+static iwrc _jbi_ckey_add_f64(IWXSTR *ckey, double v) {
+  uint8_t buf[1 + JB_IDX_F64_KEY_SIZE] = { 0x01 };
+  jbi_f64_key(v, buf + 1);
+  return iwxstr_cat(ckey, buf, sizeof(buf));
+}
+
+static iwrc _jbi_ckey_add_str(IWXSTR *ckey, const char *str, size_t len) {
+  static const uint8_t tag = 0x01, esc[] = { 0x00, 0xff }, term[] = { 0x00, 0x01 };
+  iwrc rc = iwxstr_cat(ckey, &tag, 1);
+  RCRET(rc);
+  for (const char *ep; len > 0; len -= (ep - str) + 1, str = ep + 1) {
+    ep = memchr(str, '\0', len);
+    if (!ep) {
+      rc = iwxstr_cat(ckey, str, len);
+      RCRET(rc);
+      break;
+    }
+    rc = iwxstr_cat(ckey, str, ep - str);
+    RCRET(rc);
+    rc = iwxstr_cat(ckey, esc, sizeof(esc));
+    RCRET(rc);
+  }
+  return iwxstr_cat(ckey, term, sizeof(term));
+}
+
+iwrc jbi_jqval_add_ckey(ejdb_idx_mode_t type, const JQVAL *jqval, IWXSTR *ckey, bool *added) {
+  size_t sz;
+  char numbuf[JBNUMBUF_SIZE];
+  jqval_type_t jqvt = jqval->type;
+
+  *added = false;
+  switch (jqvt) {
+    case JQVAL_STR:
+    case JQVAL_I64:
+    case JQVAL_F64:
+    case JQVAL_BOOL:
+      break;
+    default:
+      return 0;
+  }
+  *added = true;
+  switch (type) {
+    case EJDB_IDX_STR:
+      switch (jqvt) {
+        case JQVAL_STR:
+          return _jbi_ckey_add_str(ckey, jqval->vstr, strlen(jqval->vstr));
+        case JQVAL_I64:
+          sz = (size_t) iwitoa(jqval->vi64, numbuf, JBNUMBUF_SIZE);
+          return _jbi_ckey_add_str(ckey, numbuf, sz);
+        case JQVAL_F64:
+          jbi_ftoa(jqval->vf64, numbuf, &sz);
+          return _jbi_ckey_add_str(ckey, numbuf, sz);
+        default:
+          return jqval->vbool ? _jbi_ckey_add_str(ckey, "true", 4) : _jbi_ckey_add_str(ckey, "false", 5);
+      }
+    case EJDB_IDX_I64:
+      switch (jqvt) {
+        case JQVAL_STR:
+          return _jbi_ckey_add_u64(ckey, (uint64_t) iwatoi(jqval->vstr) ^ 0x8000000000000000ULL);
+        case JQVAL_I64:
+          return _jbi_ckey_add_u64(ckey, (uint64_t) jqval->vi64 ^ 0x8000000000000000ULL);
+        case JQVAL_F64:
+          return _jbi_ckey_add_u64(ckey, (uint64_t) (int64_t) jqval->vf64 ^ 0x8000000000000000ULL);
+        default:
+          return _jbi_ckey_add_u64(ckey, (uint64_t) jqval->vbool ^ 0x8000000000000000ULL);
+      }
+    case EJDB_IDX_F64:
+      switch (jqvt) {
+        case JQVAL_STR:
+          return _jbi_ckey_add_f64(ckey, (double) iwatof(jqval->vstr));
+        case JQVAL_I64:
+          return _jbi_ckey_add_f64(ckey, (double) jqval->vi64);
+        case JQVAL_F64:
+          return _jbi_ckey_add_f64(ckey, jqval->vf64);
+        default:
+          return _jbi_ckey_add_f64(ckey, jqval->vbool);
+      }
+    default:
+      *added = false;
+      return 0;
+  }
+}
+
+iwrc jbi_jbl_fill_ckey(JBIDX idx, JBL jbl, IWXSTR *ckey, bool *found) {
+  static const uint8_t absent = 0x00;
+  iwrc rc = 0;
+  *found = false;
+  iwxstr_clear(ckey);
+  if (!jbl) {
+    return 0;
+  }
+  for (int i = 0; i < idx->ncols; ++i) {
+    JQVAL qv;
+    struct _JBL jbv;
+    bool added = false;
+    if (_jbl_at(jbl, idx->cptrs[i], &jbv)) {
+      jql_binn_to_jqval(&jbv.bn, &qv);
+      rc = jbi_jqval_add_ckey(idx->ctypes[i], &qv, ckey, &added);
+      RCRET(rc);
+    }
+    if (!added) {
+      if (i == 0) { // Documents without the first column value are not indexed
+        return 0;
+      }
+      rc = iwxstr_cat(ckey, &absent, 1);
+      RCRET(rc);
+    }
+  }
+  *found = true;
+  return 0;
+}
+
+bool jbi_ckey_succ(IWXSTR *ckey) {
+  uint8_t *p = (uint8_t*) iwxstr_ptr(ckey);
+  size_t sz = iwxstr_size(ckey);
+  while (sz && p[sz - 1] == 0xff) {
+    --sz;
+  }
+  if (!sz) {
+    return false;
+  }
+  iwxstr_pop(ckey, iwxstr_size(ckey) - sz);
+  ++p[sz - 1];
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+//                       Covering index entries
+//
+// Entry value of covering index keeps document fragment: binn object of indexed and included fields.
+// Entry value of unique covering index is a varint encoded document id followed by fragment.
+//
+
+iwrc jbi_covering_load(struct _JBEXEC *ctx, IWKV_cursor cur, const IWKV_val *key) {
+  iwrc rc;
+  int step = 0;
+  size_t vsz = 0;
+  JBIDX idx = ctx->midx.idx;
+
+  while (1) {
+    if (cur) {
+      rc = iwkv_cursor_copy_val(cur, ctx->cvbuf, ctx->cvbufsz, &vsz);
+    } else {
+      rc = iwkv_get_copy(idx->idb, key, ctx->cvbuf, ctx->cvbufsz, &vsz);
+    }
+    RCRET(rc);
+    if (vsz <= ctx->cvbufsz) {
+      break;
+    }
+    size_t nsize = MAX(vsz, ctx->cvbufsz * 2);
+    uint8_t *nbuf = realloc(ctx->cvbuf, nsize);
+    if (!nbuf) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    ctx->cvbuf = nbuf;
+    ctx->cvbufsz = nsize;
+  }
+  if (!(idx->idbf & IWDB_COMPOUND_KEYS) && vsz) {
+    int64_t llv;
+    IW_READVNUMBUF64(ctx->cvbuf, llv, step);
+  }
+  if ((size_t) step >= vsz) {
+    rc = IWKV_ERROR_CORRUPTED;
+    iwlog_ecode_error3(rc);
+    return rc;
+  }
+  ctx->cvdoc.data = ctx->cvbuf + step;
+  ctx->cvdoc.size = vsz - step;
+  return 0;
+}
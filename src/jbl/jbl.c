@@ -2891,6 +2891,451 @@ iwrc jbn_merge_patch(JBL_NODE root, JBL_NODE patch, IWPOOL *pool) {
   return rc;
 }
 
+//--- IN-PLACE PATCHING
+
+// Object members are replaced, added and removed by splicing of document buffer,
+// sizes and counts of enclosing containers are rewritten up to document root.
+// Patches restructuring document (root and array operations, copy, move, swap, test,
+// creation of missing parents) are not applied in place: caller applies them on `JBL_NODE` tree.
+
+#define _JBL_BP_MAX_LEVELS 32
+
+typedef struct _JBLBP {
+  uint8_t *buf;
+  size_t   size;                         /**< Document size */
+  size_t   asize;                        /**< Allocated size of `buf` */
+  int      nlevels;                      /**< Number of containers in `levels` chain */
+  size_t   levels[_JBL_BP_MAX_LEVELS];   /**< Offsets of containers from root to the patched one */
+} JBLBP;
+
+static int _jbl_bp_index(const char *key, size_t klen) {
+  int64_t idx = 0;
+  if (!klen || (klen > 10)) {
+    return -1;
+  }
+  for (size_t i = 0; i < klen; ++i) {
+    if ((key[i] < '0') || (key[i] > '9')) {
+      return -1;
+    }
+    idx = idx * 10 + (key[i] - '0');
+  }
+  return idx > INT32_MAX ? -1 : (int) idx;
+}
+
+/**
+ * Finds member `key` of object (or list element indexed by `key`) stored at `off`.
+ * Returns `1` and offsets of item, its value and item end if found,
+ * `0` if not found, `-1` if buffer is not valid.
+ */
+static int _jbl_bp_find(
+  JBLBP *bp, size_t off, const char *key, size_t klen,
+  size_t *ioff, size_t *voff, size_t *eoff, binn *bv) {
+  char *ikey;
+  int i, klidx, idx = -1;
+  binn_iter iter;
+  uint8_t *cp = bp->buf + off;
+  int type = binn_buf_type(cp), size = binn_buf_size(cp);
+
+  if ((off + size > bp->size) || !binn_iter_init(&iter, cp, type)) {
+    return -1;
+  }
+  if (type == BINN_LIST) {
+    idx = _jbl_bp_index(key, klen);
+    if (idx < 0) {
+      return 0;
+    }
+  } else if (type != BINN_OBJECT) {
+    return 0;
+  }
+  for (i = 0; ; ++i) {
+    bool found;
+    uint8_t *ip = iter.pnext, *vp = ip;
+    if (type == BINN_OBJECT) {
+      if (!binn_object_next2(&iter, &ikey, &klidx, bv)) {
+        break;
+      }
+      vp = ip + 1 + klidx;
+      found = ((size_t) klidx == klen) && !memcmp(ikey, key, klen);
+    } else {
+      if (!binn_list_next(&iter, bv)) {
+        break;
+      }
+      found = (i == idx);
+    }
+    if (found) {
+      *ioff = ip - bp->buf;
+      *voff = vp - bp->buf;
+      // Iterator has no next position after the last item
+      *eoff = (iter.current < iter.count ? iter.pnext : cp + size) - bp->buf;
+      return 1;
+    }
+  }
+  return i == iter.count ? 0 : -1;
+}
+
+/**
+ * Replaces `len` bytes at `off` by `dlen` bytes of `data`.
+ */
+static iwrc _jbl_bp_splice(JBLBP *bp, size_t off, size_t len, const void *data, size_t dlen) {
+  size_t nsize = bp->size - len + dlen;
+  if (nsize > INT32_MAX) {
+    return IW_ERROR_OVERFLOW;
+  }
+  if (nsize > bp->asize) {
+    size_t asize = MAX(nsize, bp->asize + bp->asize / 2);
+    uint8_t *nbuf = realloc(bp->buf, asize);
+    if (!nbuf) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    bp->buf = nbuf;
+    bp->asize = asize;
+  }
+  memmove(bp->buf + off + dlen, bp->buf + off + len, bp->size - off - len);
+  if (dlen) {
+    memcpy(bp->buf + off, data, dlen);
+  }
+  bp->size = nsize;
+  return 0;
+}
+
+static void _jbl_bp_write32(uint8_t *p, uint32_t v) {
+  v |= 0x80000000U;
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/**
+ * Rewrites headers of containers chain after the last container data size
+ * is changed by `delta` and its items count by `dcount`.
+ * Header is encoded the same way as `binn_save_header()` does.
+ */
+static iwrc _jbl_bp_fix(JBLBP *bp, int64_t delta, int dcount) {
+  for (int i = bp->nlevels - 1; i >= 0; --i) {
+    uint8_t hdr[9], *p = hdr;
+    int type, count, size = 0, hsize;
+    size_t off = bp->levels[i];
+    if (!binn_is_valid_header(bp->buf + off, &type, &count, &size, &hsize)) {
+      return JBL_ERROR_INVALID_BUFFER;
+    }
+    if (i == bp->nlevels - 1) {
+      count += dcount;
+    }
+    int64_t nsize = size - hsize + delta + 3;
+    if (count > 127) {
+      nsize += 3;
+    }
+    if (nsize > 127) {
+      nsize += 3;
+    }
+    if (nsize > INT32_MAX) {
+      return IW_ERROR_OVERFLOW;
+    }
+    *p++ = type;
+    if (nsize > 127) {
+      _jbl_bp_write32(p, nsize);
+      p += 4;
+    } else {
+      *p++ = nsize;
+    }
+    if (count > 127) {
+      _jbl_bp_write32(p, count);
+      p += 4;
+    } else {
+      *p++ = count;
+    }
+    iwrc rc = _jbl_bp_splice(bp, off, hsize, hdr, p - hdr);
+    RCRET(rc);
+    for (int j = i + 1; j < bp->nlevels; ++j) { // Nested containers are moved by header size change
+      bp->levels[j] += (p - hdr) - hsize;
+    }
+    delta = nsize - size;
+  }
+  return 0;
+}
+
+/**
+ * Encodes `value` as object member `key` or as list item if `key` is zero
+ * exactly as it is stored by `jbl_fill_from_node()`.
+ * Encoded data are kept by `bn` container.
+ */
+static iwrc _jbl_bp_encode(
+  const char *key, int klidx, JBL_NODE value, binn *bn,
+  const uint8_t **datap, size_t *lenp) {
+  binn bv;
+  int type, count, size = 0, hsize;
+  if (!binn_create(bn, key ? BINN_OBJECT : BINN_LIST, 0, 0)) {
+    return JBL_ERROR_CREATION;
+  }
+  iwrc rc = _jbl_binn_from_node(&bv, value);
+  if (!rc) {
+    if (key ? !binn_object_set_value2(bn, key, klidx, &bv) : !binn_list_add_value(bn, &bv)) {
+      rc = JBL_ERROR_CREATION;
+    }
+    binn_free(&bv);
+  }
+  if (!rc) {
+    const uint8_t *ptr = binn_ptr(bn);
+    if (binn_is_valid_header(ptr, &type, &count, &size, &hsize)) {
+      *datap = ptr + hsize;
+      *lenp = size - hsize;
+    } else {
+      rc = JBL_ERROR_CREATION;
+    }
+  }
+  if (rc) {
+    binn_free(bn);
+  }
+  return rc;
+}
+
+/**
+ * Replaces value stored at `[voff, eoff)` of the last container by `value`.
+ */
+static iwrc _jbl_bp_set(JBLBP *bp, size_t voff, size_t eoff, JBL_NODE value) {
+  binn bn;
+  size_t len;
+  const uint8_t *data;
+  iwrc rc = _jbl_bp_encode(0, 0, value, &bn, &data, &len);
+  RCRET(rc);
+  rc = _jbl_bp_splice(bp, voff, eoff - voff, data, len);
+  binn_free(&bn);
+  RCRET(rc);
+  return _jbl_bp_fix(bp, (int64_t) len - (int64_t) (eoff - voff), 0);
+}
+
+/**
+ * Appends member `key` with `value` to the last container.
+ */
+static iwrc _jbl_bp_append(JBLBP *bp, const char *key, int klidx, JBL_NODE value) {
+  binn bn;
+  size_t len;
+  const uint8_t *data;
+  size_t off = bp->levels[bp->nlevels - 1];
+  iwrc rc = _jbl_bp_encode(key, klidx, value, &bn, &data, &len);
+  RCRET(rc);
+  rc = _jbl_bp_splice(bp, off + binn_buf_size(bp->buf + off), 0, data, len);
+  binn_free(&bn);
+  RCRET(rc);
+  return _jbl_bp_fix(bp, len, 1);
+}
+
+static iwrc _jbl_bp_remove(JBLBP *bp, size_t ioff, size_t eoff) {
+  iwrc rc = _jbl_bp_splice(bp, ioff, eoff - ioff, 0, 0);
+  RCRET(rc);
+  return _jbl_bp_fix(bp, -(int64_t) (eoff - ioff), -1);
+}
+
+static bool _jbl_bp_number(binn *bv, JBL_NODE n) {
+  switch (bv->type) {
+    case BINN_UINT8:
+    case BINN_UINT16:
+    case BINN_UINT32:
+    case BINN_UINT64:
+    case BINN_INT8:
+    case BINN_INT16:
+    case BINN_INT32:
+    case BINN_INT64:
+      n->type = JBV_I64;
+      return binn_get_int64(bv, (int64*) &n->vi64);
+    case BINN_FLOAT32:
+    case BINN_FLOAT64:
+      n->type = JBV_F64;
+      n->vf64 = bv->vdouble;
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Applies merge `patch` to the last object of containers chain
+ * the same way as `_jbl_merge_patch_node()` does.
+ */
+static iwrc _jbl_bp_merge(JBLBP *bp, JBL_NODE patch) {
+  binn bv;
+  iwrc rc = 0;
+  size_t ioff, voff, eoff;
+  int nlevels = bp->nlevels;
+
+  for (JBL_NODE n = patch->child; n && !rc; n = n->next) {
+    int found = _jbl_bp_find(bp, bp->levels[nlevels - 1], n->key, n->klidx, &ioff, &voff, &eoff, &bv);
+    if (found < 0) {
+      return JBL_ERROR_INVALID_BUFFER;
+    }
+    if (n->type == JBV_NULL) {
+      if (found) {
+        rc = _jbl_bp_remove(bp, ioff, eoff);
+      }
+    } else if (n->type == JBV_OBJECT) {
+      // New members are not created from patch objects since their null members are dropped
+      if (!found || (bv.type != BINN_OBJECT) || (nlevels >= _JBL_BP_MAX_LEVELS)) {
+        return IW_ERROR_NOT_IMPLEMENTED;
+      }
+      bp->levels[bp->nlevels++] = voff;
+      rc = _jbl_bp_merge(bp, n);
+      bp->nlevels = nlevels;
+    } else if (found) {
+      rc = _jbl_bp_set(bp, voff, eoff, n);
+    } else {
+      rc = _jbl_bp_append(bp, n->key, n->klidx, n);
+    }
+  }
+  return rc;
+}
+
+/**
+ * Fills containers chain by containers of `path` nodes except the last one.
+ */
+static bool _jbl_bp_path(JBLBP *bp, JBL_PTR path) {
+  binn bv;
+  size_t ioff, voff, eoff;
+  bp->nlevels = 1;
+  if (path->cnt > _JBL_BP_MAX_LEVELS) {
+    return false;
+  }
+  for (int i = 0; i < path->cnt - 1; ++i) {
+    if (_jbl_bp_find(bp, bp->levels[i], path->n[i], strlen(path->n[i]), &ioff, &voff, &eoff, &bv) < 1) {
+      return false;
+    }
+    bp->levels[bp->nlevels++] = voff;
+  }
+  return binn_buf_type(bp->buf + bp->levels[bp->nlevels - 1]) == BINN_OBJECT;
+}
+
+/**
+ * Applies JSON patch operation `p` on object member
+ * the same way as `_jbl_target_apply_patch()` does.
+ */
+static iwrc _jbl_bp_apply(JBLBP *bp, const JBL_PATCH *p, IWPOOL *pool) {
+  binn bv;
+  JBL_PTR path;
+  size_t ioff, voff, eoff;
+  jbp_patch_t op = p->op;
+  JBL_NODE value = p->vnode;
+
+  switch (op) {
+    case JBP_ADD:
+    case JBP_ADD_CREATE:
+    case JBP_REPLACE:
+    case JBP_INCREMENT:
+      if (!value) {
+        return IW_ERROR_NOT_IMPLEMENTED;
+      }
+      break;
+    case JBP_REMOVE:
+      break;
+    default:
+      return IW_ERROR_NOT_IMPLEMENTED;
+  }
+  if (!p->path) {
+    return IW_ERROR_NOT_IMPLEMENTED;
+  }
+  iwrc rc = _jbl_ptr_pool(p->path, &path, pool);
+  RCRET(rc);
+  if (((path->cnt == 1) && (*path->n[0] == '\0')) || !_jbl_bp_path(bp, path)) {
+    return IW_ERROR_NOT_IMPLEMENTED;
+  }
+  const char *key = path->n[path->cnt - 1];
+  int klidx = (int) strlen(key);
+  int found = _jbl_bp_find(bp, bp->levels[bp->nlevels - 1], key, klidx, &ioff, &voff, &eoff, &bv);
+  if (found < 0) {
+    return JBL_ERROR_INVALID_BUFFER;
+  }
+  if (op == JBP_INCREMENT) {
+    struct _JBL_NODE n = { 0 };
+    if (!found || !_jbl_bp_number(&bv, &n)) {
+      return IW_ERROR_NOT_IMPLEMENTED;
+    }
+    rc = _jbl_increment_node_data(&n, value);
+    RCRET(rc);
+    return _jbl_bp_set(bp, voff, eoff, &n);
+  } else if ((op == JBP_REMOVE) || (op == JBP_REPLACE)) {
+    if (found) {
+      rc = _jbl_bp_remove(bp, ioff, eoff);
+      RCRET(rc);
+    }
+    if (op == JBP_REPLACE) {
+      rc = _jbl_bp_append(bp, key, klidx, value);
+    }
+    return rc;
+  } else if (found) {
+    return _jbl_bp_set(bp, voff, eoff, value);
+  } else {
+    return _jbl_bp_append(bp, key, klidx, value);
+  }
+}
+
+iwrc jbl_patch_inplace(JBL jbl, JBL_NODE patch, bool *applied) {
+  if (!jbl || !patch || !applied) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  *applied = false;
+  if (  (jbl->bn.type != BINN_OBJECT)
+     || ((patch->type != JBV_OBJECT) && (patch->type != JBV_ARRAY))) {
+    return 0;
+  }
+  iwrc rc = 0;
+  IWPOOL *pool = 0;
+  int type, count, size = binn_size(&jbl->bn);
+  JBLBP bp = {
+    .size    = size,
+    .asize   = size + 64, // Room for small additions
+    .nlevels = 1
+  };
+  bp.buf = malloc(bp.asize);
+  if (!bp.buf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  memcpy(bp.buf, binn_ptr(&jbl->bn), size);
+
+  if (patch->type == JBV_OBJECT) {
+    rc = _jbl_bp_merge(&bp, patch);
+  } else {
+    int cnt;
+    JBL_PATCH *p;
+    pool = iwpool_create(1024);
+    if (!pool) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    rc = _jbl_create_patch(patch, &p, &cnt, pool);
+    for (int i = 0; !rc && i < cnt; ++i) {
+      rc = _jbl_bp_apply(&bp, p + i, pool);
+    }
+  }
+  RCGO(rc, finish);
+
+  size = 0;
+  if (!binn_is_valid_header(bp.buf, &type, &count, &size, 0)) {
+    rc = JBL_ERROR_INVALID_BUFFER;
+    goto finish;
+  }
+  binn_free(&jbl->bn);
+  memset(&jbl->bn, 0, sizeof(jbl->bn));
+  jbl->bn.header = BINN_MAGIC;
+  jbl->bn.type = type;
+  jbl->bn.ptr = bp.buf;
+  jbl->bn.size = size;
+  jbl->bn.count = count;
+  jbl->bn.freefn = free;
+  jbl->node = 0;
+  *applied = true;
+
+finish:
+  if (pool) {
+    iwpool_destroy(pool);
+  }
+  if (rc) {
+    free(bp.buf);
+    if (rc == IW_ERROR_NOT_IMPLEMENTED) { // Patch is not applicable in place
+      rc = 0;
+    }
+  }
+  return rc;
+}
+
 static const char *_jbl_ecodefn(locale_t locale, uint32_t ecode) {
   if (!((ecode > _JBL_ERROR_START) && (ecode < _JBL_ERROR_END))) {
     return 0;
@@ -887,6 +887,20 @@ IW_EXPORT iwrc jbl_merge_patch(JBL jbl, const char *patchjson);
 
 IW_EXPORT iwrc jbl_merge_patch_jbl(JBL jbl, JBL patch);
 
+/**
+ * @brief Applies JSON `patch` (rfc6902 or rfc7396 merge patch) to `jbl` object
+ * by editing of its binary buffer without conversion to `JBL_NODE` tree.
+ *
+ * Replacement, addition, removal and increment of object members are applied in place,
+ * `applied` is set to `false` and `jbl` is left untouched if patch requires
+ * structural rewrite of document, in this case patch should be applied by `jbn_patch_auto()`.
+ *
+ * @param jbl JBL object to patch, its buffer is replaced by newly allocated one on success.
+ * @param patch Patch rfc6902 array or rfc7396 merge patch object.
+ * @param [out] applied Set to `true` if patch has been applied in place.
+ */
+IW_EXPORT iwrc jbl_patch_inplace(JBL jbl, JBL_NODE patch, bool *applied);
+
 
 IW_EXPORT iwrc jbl_init(void);
 
@@ -865,7 +865,106 @@ void jbl_test1_11(void) {
   iwxstr_destroy(xstr);
 }
 
+void apply_patch_inplace(const char *data, const char *patch, const char *result, IWXSTR *xstr, iwrc *rcp) {
+  CU_ASSERT_TRUE_FATAL(data && patch && xstr && rcp);
+  JBL jbl = 0, jbl2 = 0;
+  JBL_NODE pn, root;
+  bool applied = false;
+  IWPOOL *pool = iwpool_create(512);
+  char *data2 = iwu_replace_char(strdup(data), '\'', '"');
+  char *patch2 = iwu_replace_char(strdup(patch), '\'', '"');
+  char *result2 = result ? iwu_replace_char(strdup(result), '\'', '"') : 0;
+  CU_ASSERT_TRUE_FATAL(pool && data2 && patch2);
+
+  iwrc rc = jbl_from_json(&jbl, data2);
+  RCGO(rc, finish);
+  rc = jbn_from_json(patch2, &pn, pool);
+  RCGO(rc, finish);
+
+  rc = jbl_patch_inplace(jbl, pn, &applied);
+  RCGO(rc, finish);
+  CU_ASSERT_EQUAL(applied, result2 != 0);
+  if (!applied) {
+    goto finish;
+  }
+  rc = jbl_as_json(jbl, jbl_xstr_json_printer, xstr, false);
+  RCGO(rc, finish);
+  CU_ASSERT_STRING_EQUAL(result2, iwxstr_ptr(xstr));
+
+  // Document patched in place is the same as stored by node patch
+  rc = jbn_from_json(data2, &root, pool);
+  RCGO(rc, finish);
+  rc = jbn_patch_auto(root, pn, pool);
+  RCGO(rc, finish);
+  rc = jbl_from_node(&jbl2, root);
+  RCGO(rc, finish);
+  CU_ASSERT_EQUAL(jbl_size(jbl), jbl_size(jbl2));
+  CU_ASSERT_FALSE(memcmp(binn_ptr(&jbl->bn), binn_ptr(&jbl2->bn), jbl_size(jbl)));
+
+finish:
+  free(data2);
+  free(patch2);
+  free(result2);
+  jbl_destroy(&jbl);
+  jbl_destroy(&jbl2);
+  iwpool_destroy(pool);
+  *rcp = rc;
+}
+
 void jbl_test1_12(void) {
+  iwrc rc;
+  char data[2048];
+  IWXSTR *xstr = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(xstr);
+
+  apply_patch_inplace("{'foo':'bar','num':1,'obj':{'a':{'b':2},'c':'d'}}",
+                      "{'foo':'baz','num':null,'obj':{'a':{'b':[1,2]},'e':true}}",
+                      "{'foo':'baz','obj':{'a':{'b':[1,2]},'c':'d','e':true}}", xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_clear(xstr);
+
+  apply_patch_inplace("{'foo':'bar','num':1,'obj':{'a':{'b':2},'c':'d'}}",
+                      "[{'op':'increment','path':'/obj/a/b','value':40},"
+                      "{'op':'replace','path':'/foo','value':{'x':[null]}},"
+                      "{'op':'add','path':'/obj/c','value':1.5},"
+                      "{'op':'add','path':'/obj/f','value':'g'},"
+                      "{'op':'remove','path':'/num'}]",
+                      "{'obj':{'a':{'b':42},'c':1.5,'f':'g'},'foo':{'x':[null]}}", xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_clear(xstr);
+
+  // Object member of array element
+  apply_patch_inplace("{'list':[{'a':1},{'a':2}]}",
+                      "[{'op':'increment','path':'/list/1/a','value':1}]",
+                      "{'list':[{'a':1},{'a':3}]}", xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_clear(xstr);
+
+  // Container sizes grown beyond one byte header fields
+  strcpy(data, "{'obj':{'s':'");
+  for (int i = 0; i < 120; ++i) {
+    strcat(data, "s");
+  }
+  strcat(data, "'},'n':1}");
+  apply_patch_inplace(data, "{'obj':{'s':null,'t':'tttttttttttttttttttttttttttttttttttttttt'},'n':2}",
+                      "{'obj':{'t':'tttttttttttttttttttttttttttttttttttttttt'},'n':2}", xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_clear(xstr);
+
+  // Structural patches are not applied in place
+  apply_patch_inplace("{'list':[1,2]}", "[{'op':'add','path':'/list/1','value':3}]", 0, xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  apply_patch_inplace("{'a':1}", "[{'op':'move','from':'/a','path':'/b'}]", 0, xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  apply_patch_inplace("{'a':1}", "{'b':{'c':null}}", 0, xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  apply_patch_inplace("{'a':'s'}", "[{'op':'increment','path':'/a','value':1}]", 0, xstr, &rc);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  apply_patch_inplace("{'a':1}", "[{'op':'increment','path':'/a','value':'s'}]", 0, xstr, &rc);
+  CU_ASSERT_EQUAL(rc, JBL_ERROR_PATCH_INVALID_VALUE);
+
+  iwxstr_destroy(xstr);
 }
 
 int main() {
@@ -888,7 +987,8 @@ int main() {
      || (NULL == CU_add_test(pSuite, "jbl_test1_8", jbl_test1_8))
      || (NULL == CU_add_test(pSuite, "jbl_test1_9", jbl_test1_9))
      || (NULL == CU_add_test(pSuite, "jbl_test1_10", jbl_test1_10))
-     || (NULL == CU_add_test(pSuite, "jbl_test1_11", jbl_test1_11))) {
+     || (NULL == CU_add_test(pSuite, "jbl_test1_11", jbl_test1_11))
+     || (NULL == CU_add_test(pSuite, "jbl_test1_12", jbl_test1_12))) {
     CU_cleanup_registry();
     return CU_get_error();
   }
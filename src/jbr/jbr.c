@@ -14,6 +14,8 @@
 #define JBR_MAX_KEY_LEN          36
 #define JBR_HTTP_CHUNK_SIZE      4096
 #define JBR_WS_STR_PREMATURE_END "Premature end of message"
+#define JBR_QCACHE_SIZE          256 // Max number of query texts kept by prepared queries cache
+#define JBR_QCACHE_POOL_SIZE     8   // Max number of idle prepared queries per query text
 
 static uint64_t k_header_x_access_token_hash;
 static uint64_t k_header_x_hints_hash;
@@ -30,6 +32,17 @@ typedef enum {
   JBR_OPTIONS,
 } jbr_method_t;
 
+/** Prepared queries cache entry */
+typedef struct _JBRQCE {
+  char    *key;                        /**< Cache key: <collection>\x01<query> */
+  uint64_t atime;                      /**< Last access tick */
+  int      num;                        /**< Number of idle prepared queries */
+  JQL      pool[JBR_QCACHE_POOL_SIZE]; /**< Idle prepared queries */
+} *JBRQCE;
+
+// -V:KHASH_MAP_INIT_STR:522
+KHASH_MAP_INIT_STR(JBRQC, JBRQCE)
+
 struct _JBR {
   volatile bool terminated;
   volatile iwrc rc;
@@ -37,6 +50,9 @@ struct _JBR {
   pthread_barrier_t start_barrier;
   const EJDB_HTTP  *http;
   EJDB db;
+  khash_t(JBRQC) * qcache;  /**< Prepared queries cache */
+  pthread_mutex_t qcache_mtx;
+  uint64_t qcache_tick;
 };
 
 typedef struct _JBRCTX {
@@ -182,6 +198,146 @@ static iwrc _jbr_query_visitor(EJDB_EXEC *ux, EJDB_DOC doc, int64_t *step) {
   return _jbr_flush_chunk(rctx, false);
 }
 
+//---------------- Prepared queries cache ---------------------
+
+static char *_jbr_qcache_key(const char *coll, const char *query) {
+  size_t clen = coll ? strlen(coll) : 0;
+  size_t qlen = strlen(query);
+  char *key = malloc(clen + qlen + 2);
+  if (!key) {
+    return 0;
+  }
+  if (clen) {
+    memcpy(key, coll, clen);
+  }
+  key[clen] = '\x01';
+  memcpy(key + clen + 1, query, qlen + 1);
+  return key;
+}
+
+static void _jbr_qcache_entry_destroy(JBRQCE ce) {
+  for (int i = 0; i < ce->num; ++i) {
+    jql_destroy(&ce->pool[i]);
+  }
+  free(ce->key);
+  free(ce);
+}
+
+static void _jbr_qcache_evict_lru(JBR jbr) {
+  khiter_t lk = kh_end(jbr->qcache);
+  for (khiter_t k = kh_begin(jbr->qcache); k != kh_end(jbr->qcache); ++k) {
+    if (  kh_exist(jbr->qcache, k)
+       && ((lk == kh_end(jbr->qcache)) || (kh_value(jbr->qcache, k)->atime < kh_value(jbr->qcache, lk)->atime))) {
+      lk = k;
+    }
+  }
+  if (lk != kh_end(jbr->qcache)) {
+    JBRQCE ce = kh_value(jbr->qcache, lk);
+    kh_del(JBRQC, jbr->qcache, lk);
+    _jbr_qcache_entry_destroy(ce);
+  }
+}
+
+/**
+ * Returns prepared query for the given collection and query text.
+ * Query is taken from cache if available otherwise a new query is created.
+ */
+static iwrc _jbr_query_acquire(JBR jbr, const char *coll, const char *query, JQL *qptr) {
+  *qptr = 0;
+  char *key = _jbr_qcache_key(coll, query);
+  if (!key) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  pthread_mutex_lock(&jbr->qcache_mtx);
+  khiter_t k = kh_get(JBRQC, jbr->qcache, key);
+  if (k != kh_end(jbr->qcache)) {
+    JBRQCE ce = kh_value(jbr->qcache, k);
+    ce->atime = ++jbr->qcache_tick;
+    if (ce->num > 0) {
+      *qptr = ce->pool[--ce->num];
+    }
+  }
+  pthread_mutex_unlock(&jbr->qcache_mtx);
+  free(key);
+  if (*qptr) {
+    return 0;
+  }
+  iwrc rc = jql_create2(qptr, coll, query, JQL_SILENT_ON_PARSE_ERROR | JQL_KEEP_QUERY_ON_PARSE_ERROR);
+  if (!rc) {
+    (*qptr)->cache_plan = true;
+  }
+  return rc;
+}
+
+/**
+ * Returns query acquired by `_jbr_query_acquire()` back to cache.
+ * Query is destroyed if it was failed or cache is full.
+ */
+static void _jbr_query_release(JBR jbr, const char *coll, const char *query, JQL *qptr, iwrc qrc) {
+  JQL q = *qptr;
+  if (!q) {
+    return;
+  }
+  *qptr = 0;
+  if (qrc || !q->cache_plan) {
+    jql_destroy(&q);
+    return;
+  }
+  jql_reset(q, true, true);
+  char *key = _jbr_qcache_key(coll, query);
+  if (!key) {
+    jql_destroy(&q);
+    return;
+  }
+  pthread_mutex_lock(&jbr->qcache_mtx);
+  JBRQCE ce = 0;
+  khiter_t k = kh_get(JBRQC, jbr->qcache, key);
+  if (k != kh_end(jbr->qcache)) {
+    ce = kh_value(jbr->qcache, k);
+  } else {
+    if (kh_size(jbr->qcache) >= JBR_QCACHE_SIZE) {
+      _jbr_qcache_evict_lru(jbr);
+    }
+    ce = calloc(1, sizeof(*ce));
+    if (ce) {
+      int rci;
+      k = kh_put(JBRQC, jbr->qcache, key, &rci);
+      if (rci != -1) {
+        ce->key = key;
+        kh_value(jbr->qcache, k) = ce;
+        key = 0;
+      } else {
+        free(ce);
+        ce = 0;
+      }
+    }
+  }
+  if (ce && (ce->num < JBR_QCACHE_POOL_SIZE)) {
+    ce->atime = ++jbr->qcache_tick;
+    ce->pool[ce->num++] = q;
+    q = 0;
+  }
+  pthread_mutex_unlock(&jbr->qcache_mtx);
+  free(key);
+  if (q) {
+    jql_destroy(&q);
+  }
+}
+
+static void _jbr_qcache_destroy(JBR jbr) {
+  if (!jbr->qcache) {
+    return;
+  }
+  for (khiter_t k = kh_begin(jbr->qcache); k != kh_end(jbr->qcache); ++k) {
+    if (kh_exist(jbr->qcache, k)) {
+      _jbr_qcache_entry_destroy(kh_value(jbr->qcache, k));
+    }
+  }
+  kh_destroy(JBRQC, jbr->qcache);
+  jbr->qcache = 0;
+  pthread_mutex_destroy(&jbr->qcache_mtx);
+}
+
 static void _jbr_on_query(JBRCTX *rctx) {
   http_s *req = rctx->req;
   fio_str_info_s data = fiobj_data_read(req->body, 0);
@@ -196,11 +352,11 @@ static void _jbr_on_query(JBRCTX *rctx) {
   };
 
   // Collection name must be encoded in query
-  iwrc rc = jql_create2(&ux.q, 0, data.data, JQL_SILENT_ON_PARSE_ERROR | JQL_KEEP_QUERY_ON_PARSE_ERROR);
+  iwrc rc = _jbr_query_acquire(rctx->jbr, 0, data.data, &ux.q);
   RCGO(rc, finish);
   if (rctx->read_anon && jql_has_apply(ux.q)) {
     // We have not permitted data modification request
-    jql_destroy(&ux.q);
+    _jbr_query_release(rctx->jbr, 0, data.data, &ux.q, 0);
     _jbr_http_error_send(rctx->req, 403);
     return;
   }
@@ -208,7 +364,7 @@ static void _jbr_on_query(JBRCTX *rctx) {
   FIOBJ h = fiobj_hash_get2(req->headers, k_header_x_hints_hash);
   if (h) {
     if (!fiobj_type_is(h, FIOBJ_T_STRING)) {
-      jql_destroy(&ux.q);
+      _jbr_query_release(rctx->jbr, 0, data.data, &ux.q, 0);
       _jbr_http_error_send(req, 400);
       return;
     }
@@ -271,9 +427,7 @@ finish:
       _jbr_http_send(req, 200, 0, 0, 0);
     }
   }
-  if (ux.q) {
-    jql_destroy(&ux.q);
-  }
+  _jbr_query_release(rctx->jbr, 0, data.data, &ux.q, rc);
   if (ux.log) {
     iwxstr_destroy(ux.log);
   }
@@ -685,6 +839,7 @@ typedef enum {
 
 typedef struct _JBWCTX {
   bool  read_anon;
+  JBR   jbr;
   EJDB  db;
   ws_s *ws;
 } JBWCTX;
@@ -938,7 +1093,7 @@ static void _jbr_ws_query(JBWCTX *wctx, const char *key, const char *coll, const
     .visitor = _jbr_ws_query_visitor,
   };
 
-  iwrc rc = jql_create2(&ux.q, coll, query, JQL_SILENT_ON_PARSE_ERROR | JQL_KEEP_QUERY_ON_PARSE_ERROR);
+  iwrc rc = _jbr_query_acquire(wctx->jbr, coll, query, &ux.q);
   RCGO(rc, finish);
 
   if (wctx->read_anon && jql_has_apply(ux.q)) {
@@ -990,9 +1145,7 @@ finish:
     }
     _jbr_ws_write_text(wctx->ws, key, (int) strlen(key));
   }
-  if (ux.q) {
-    jql_destroy(&ux.q);
-  }
+  _jbr_query_release(wctx->jbr, coll, query, &ux.q, rc);
   if (ux.log) {
     iwxstr_destroy(ux.log);
   }
@@ -1265,6 +1418,7 @@ static void _jbr_on_http_upgrade(http_s *req, char *requested_protocol, size_t l
     http_send_error(req, 500);
     return;
   }
+  wctx->jbr = jbr;
   wctx->db = jbr->db;
 
   if (http->access_token) {
@@ -1340,6 +1494,7 @@ static void *_jbr_start_thread(void *op) {
 
 static void _jbr_release(JBR *pjbr) {
   JBR jbr = *pjbr;
+  _jbr_qcache_destroy(jbr);
   free(jbr);
   *pjbr = 0;
 }
@@ -1357,6 +1512,12 @@ iwrc jbr_start(EJDB db, const EJDB_OPTS *opts, JBR *pjbr) {
   jbr->db = db;
   jbr->terminated = true;
   jbr->http = &opts->http;
+  jbr->qcache = kh_init(JBRQC);
+  if (!jbr->qcache) {
+    free(jbr);
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  pthread_mutex_init(&jbr->qcache_mtx, 0);
 
   if (!jbr->http->blocking) {
     int rci = pthread_barrier_init(&jbr->start_barrier, 0, 2);
@@ -481,6 +481,14 @@ static JQPUNIT *_jqp_unit_op(yycontext *yy, const char *text) {
     unit->op.value = JQP_OP_RE;
   } else if (!(strcmp(text, "~"))) {
     unit->op.value = JQP_OP_PREFIX;
+  } else if (!strcmp(text, "text")) {
+    unit->op.value = JQP_OP_TEXT;
+  } else if (!strcmp(text, "ieq")) {
+    unit->op.value = JQP_OP_IEQ;
+  } else if (!strcmp(text, "iin")) {
+    unit->op.value = JQP_OP_IIN;
+  } else if (!strcmp(text, "i~")) {
+    unit->op.value = JQP_OP_IPREFIX;
   } else {
     iwlog_error("Invalid operation: %s", text);
     JQRC(yy, JQL_ERROR_QUERY_PARSE);
@@ -1172,6 +1180,18 @@ static iwrc _jqp_print_join(jqp_op_t jqop, bool negate, jbl_json_printer pt, voi
     case JQP_OP_PREFIX:
       PT(0, 0, '~', 1);
       break;
+    case JQP_OP_TEXT:
+      PT("text", 4, 0, 0);
+      break;
+    case JQP_OP_IEQ:
+      PT("ieq", 3, 0, 0);
+      break;
+    case JQP_OP_IIN:
+      PT("iin", 3, 0, 0);
+      break;
+    case JQP_OP_IPREFIX:
+      PT("i~", 2, 0, 0);
+      break;
     default:
       iwlog_ecode_error3(IW_ERROR_ASSERTION);
       rc = IW_ERROR_ASSERTION;
@@ -351,6 +351,56 @@ iwrc jql_create(JQL *qptr, const char *coll, const char *query) {
   return jql_create2(qptr, coll, query, 0);
 }
 
+iwrc jql_clone(JQL q, JQL *qptr) {
+  if (!q || !qptr) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  JQL nq;
+  *qptr = 0;
+  iwrc rc = jql_create2(&nq, q->coll, q->aux->buf, q->aux->mode);
+  RCRET(rc);
+  for (JQP_STRING *pv = q->aux->start_placeholder; pv; pv = pv->placeholder_next) {
+    JQVAL *sv = pv->opaque;
+    if (!sv) {
+      continue;
+    }
+    JQVAL *qv = malloc(sizeof(*qv));
+    if (!qv) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    // Placeholder values are borrowed from source query,
+    // compiled regexps keep matching state so they are recompiled.
+    memcpy(qv, sv, sizeof(*qv));
+    qv->freefn = 0;
+    qv->freefn_op = 0;
+    if (sv->type == JQVAL_RE) {
+      qv->vre = lwre_new(sv->vre->expression);
+      if (!qv->vre) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        free(qv);
+        goto finish;
+      }
+    }
+    rc = _jql_set_placeholder(nq, pv->value, 0, qv);
+    if (rc) {
+      if (qv->type == JQVAL_RE) {
+        lwre_free(qv->vre);
+      }
+      free(qv);
+      goto finish;
+    }
+  }
+
+finish:
+  if (rc) {
+    jql_destroy(&nq);
+  } else {
+    *qptr = nq;
+  }
+  return rc;
+}
+
 size_t jql_estimate_allocated_size(JQL q) {
   size_t ret = sizeof(struct _JQL);
   if (q->aux && q->aux->pool) {
@@ -392,6 +442,7 @@ void jql_destroy(JQL *qptr) {
         }
       }
     }
+    free(q->plan);
     jqp_aux_destroy(&aux);
   }
   *qptr = 0;
@@ -875,6 +926,27 @@ static bool _jql_match_ni(
   return false;
 }
 
+/**
+ * Compares NFKC case folded forms of strings, see `jbi_nocase()`.
+ * Returns true if `str` is equal to `str2` or if `str` starts with `str2` in `prefix` mode.
+ */
+static bool _jql_nocase_eq(const char *str, const char *str2, bool prefix) {
+  size_t len, len2;
+  bool ret = false;
+  char *fstr = jbi_nocase(str, strlen(str), &len);
+  char *fstr2 = jbi_nocase(str2, strlen(str2), &len2);
+  if (fstr && fstr2) {
+    if (prefix) {
+      ret = (len >= len2) && !memcmp(fstr, fstr2, len2);
+    } else {
+      ret = (len == len2) && !memcmp(fstr, fstr2, len);
+    }
+  }
+  free(fstr);
+  free(fstr2);
+  return ret;
+}
+
 static bool _jql_match_starts(
   JQVAL *left, JQP_OP *jqop, JQVAL *right,
   iwrc *rcp) {
@@ -934,6 +1006,9 @@ static bool _jql_match_starts(
       *rcp = _JQL_ERROR_UNMATCHED;
       return false;
   }
+  if (jqop->value == JQP_OP_IPREFIX) {
+    return _jql_nocase_eq(input, prefix, true);
+  }
   size_t plen = strlen(prefix);
   if (plen > 0) {
     return strncmp(input, prefix, plen) == 0;
@@ -942,6 +1017,90 @@ static bool _jql_match_starts(
   }
 }
 
+/**
+ * Case insensitive equality of strings, other values are compared as is.
+ */
+static bool _jql_match_ieq(
+  JQVAL *left, JQP_OP *jqop, JQVAL *right,
+  iwrc *rcp) {
+
+  JQVAL sleft, sright; // Stack allocated left/right converted values
+  JQVAL *lv = left, *rv = right;
+  if (lv->type == JQVAL_JBLNODE) {
+    _jql_node_to_jqval(lv->vnode, &sleft);
+    lv = &sleft;
+  } else if (lv->type == JQVAL_BINN) {
+    _jql_binn_to_jqval(lv->vbinn, &sleft);
+    lv = &sleft;
+  }
+  if (rv->type == JQVAL_JBLNODE) {
+    _jql_node_to_jqval(rv->vnode, &sright);
+    rv = &sright;
+  }
+  if ((lv->type == JQVAL_STR) && (rv->type == JQVAL_STR)) {
+    return _jql_nocase_eq(lv->vstr, rv->vstr, false);
+  }
+  return _jql_cmp_jqval_pair(left, right, rcp) == 0;
+}
+
+static bool _jql_match_iin(
+  JQVAL *left, JQP_OP *jqop, JQVAL *right,
+  iwrc *rcp) {
+
+  if ((right->type != JQVAL_JBLNODE) || (right->vnode->type != JBV_ARRAY)) {
+    *rcp = _JQL_ERROR_UNMATCHED;
+    return false;
+  }
+  for (JBL_NODE n = right->vnode->child; n; n = n->next) {
+    JQVAL qv = {
+      .type  = JQVAL_JBLNODE,
+      .vnode = n
+    };
+    if (_jql_match_ieq(left, jqop, &qv, rcp)) {
+      return true;
+    }
+    if (*rcp) {
+      return false;
+    }
+  }
+  return false;
+}
+
+/**
+ * Full-text matching: every phrase of `right` should be found in text of `left`
+ * string or in one of string elements of `left` array.
+ */
+static bool _jql_match_text(
+  JQVAL *left, JQP_OP *jqop, JQVAL *right,
+  iwrc *rcp) {
+
+  bool match = false;
+  struct _JBTXT t, q;
+  *rcp = jbi_text_init(&t);
+  if (*rcp) {
+    return false;
+  }
+  *rcp = jbi_text_init(&q);
+  if (*rcp) {
+    jbi_text_destroy(&t);
+    return false;
+  }
+  *rcp = jbi_text_add_jqval(&q, right);
+  if (*rcp || !q.num) {
+    goto finish;
+  }
+  *rcp = jbi_text_add_jqval(&t, left);
+  if (*rcp) {
+    goto finish;
+  }
+  match = jbi_text_matched(&t, &q);
+
+finish:
+  jbi_text_destroy(&t);
+  jbi_text_destroy(&q);
+  return match;
+}
+
 static bool _jql_match_jqval_pair(
   JQP_AUX *aux,
   JQVAL *left, JQP_OP *jqop, JQVAL *right,
@@ -984,7 +1143,18 @@ static bool _jql_match_jqval_pair(
         match = _jql_match_ni(right, jqop, left, rcp);
         break;
       case JQP_OP_PREFIX:
+      case JQP_OP_IPREFIX:
         match = _jql_match_starts(left, jqop, right, rcp);
+        break;
+      case JQP_OP_IEQ:
+        match = _jql_match_ieq(left, jqop, right, rcp);
+        break;
+      case JQP_OP_IIN:
+        match = _jql_match_iin(left, jqop, right, rcp);
+        break;
+      case JQP_OP_TEXT:
+        match = _jql_match_text(left, jqop, right, rcp);
+        break;
       default:
         break;
     }
@@ -1753,6 +1923,21 @@ iwrc jql_apply(JQL q, JBL_NODE root, IWPOOL *pool) {
   }
 }
 
+iwrc jql_apply_inplace(JQL q, JBL jbl, bool *applied) {
+  *applied = false;
+  if (q->aux->apply_placeholder) {
+    JQVAL *pv = _jql_find_placeholder(q, q->aux->apply_placeholder);
+    if (!pv || (pv->type != JQVAL_JBLNODE) || !pv->vnode) {
+      return JQL_ERROR_INVALID_PLACEHOLDER_VALUE_TYPE;
+    }
+    return jbl_patch_inplace(jbl, pv->vnode, applied);
+  } else if (q->aux->apply) {
+    return jbl_patch_inplace(jbl, q->aux->apply, applied);
+  } else {
+    return 0;
+  }
+}
+
 iwrc jql_project(JQL q, JBL_NODE root, IWPOOL *pool, void *exec_ctx) {
   if (q->aux->projection) {
     return _jql_project(root, q, pool, exec_ctx);
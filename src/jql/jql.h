@@ -168,6 +168,15 @@ IW_EXPORT iwrc jql_get_limit(JQL q, int64_t *out);
 
 IW_EXPORT WUR iwrc jql_apply(JQL q, JBL_NODE root, IWPOOL *pool);
 
+/**
+ * @brief Applies query `apply` patch to binary document `jbl` in place.
+ *
+ * `applied` is set to `false` if patch cannot be applied in place,
+ * in this case `jql_apply()` should be used on document node tree.
+ * @see jbl_patch_inplace()
+ */
+IW_EXPORT WUR iwrc jql_apply_inplace(JQL q, JBL jbl, bool *applied);
+
 IW_EXPORT WUR iwrc jql_project(JQL q, JBL_NODE root, IWPOOL *pool, void *exec_ctx);
 
 IW_EXPORT WUR iwrc jql_apply_and_project(JQL q, JBL jbl, JBL_NODE *out, void *exec_ctx, IWPOOL *pool);
@@ -15,6 +15,8 @@ struct _JQL {
   JQP_AUX   *aux;
   const char *coll;
   void       *opaque;
+  void       *plan;        // Cached query execution plan, freed along with query
+  bool        cache_plan;  // Query is reused so its execution plan can be cached
 };
 
 /** Placeholder value type */
@@ -47,6 +49,14 @@ typedef struct {
 
 JQVAL *jql_find_placeholder(JQL q, const char *name);
 
+/**
+ * @brief Creates a copy of query `q` with its own matching state.
+ *
+ * Placeholder values are shared with the source query so `q`
+ * must outlive the created copy.
+ */
+iwrc jql_clone(JQL q, JQL *qptr);
+
 JQVAL *jql_unit_to_jqval(JQP_AUX *aux, JQPUNIT *unit, iwrc *rcp);
 
 bool jql_jqval_as_int(JQVAL *jqval, int64_t *out);
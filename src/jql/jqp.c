@@ -2227,7 +2227,9 @@ if (!(YY_BEGIN)) goto l58;
   }
   {  int yypos61= yy->__pos, yythunkpos61= yy->__thunkpos;  if (!yymatchString(yy, "in")) goto l62;  goto l61;
   l62:;	  yy->__pos= yypos61; yy->__thunkpos= yythunkpos61;  if (!yymatchString(yy, "ni")) goto l63;  goto l61;
-  l63:;	  yy->__pos= yypos61; yy->__thunkpos= yythunkpos61;  if (!yymatchString(yy, "re")) goto l58;
+  l63:;	  yy->__pos= yypos61; yy->__thunkpos= yythunkpos61;  if (!yymatchString(yy, "re")) goto l246;  goto l61;
+  l246:;	  yy->__pos= yypos61; yy->__thunkpos= yythunkpos61;  if (!yymatchString(yy, "text")) goto l249;  goto l61;
+  l249:;	  yy->__pos= yypos61; yy->__thunkpos= yythunkpos61;  if (!yymatchString(yy, "iin")) goto l58;
   }
   l61:;	  yyText(yy, yy->__begin, yy->__end);  {
 #define yytext yy->__text
@@ -2283,7 +2285,9 @@ if (!(YY_BEGIN)) goto l70;
   }
   {  int yypos73= yy->__pos, yythunkpos73= yy->__thunkpos;  if (!yymatchChar(yy, '=')) goto l74;  goto l73;
   l74:;	  yy->__pos= yypos73; yy->__thunkpos= yythunkpos73;  if (!yymatchString(yy, "eq")) goto l75;  goto l73;
-  l75:;	  yy->__pos= yypos73; yy->__thunkpos= yythunkpos73;  if (!yymatchChar(yy, '~')) goto l70;
+  l75:;	  yy->__pos= yypos73; yy->__thunkpos= yythunkpos73;  if (!yymatchString(yy, "ieq")) goto l247;  goto l73;
+  l247:;	  yy->__pos= yypos73; yy->__thunkpos= yythunkpos73;  if (!yymatchString(yy, "i~")) goto l248;  goto l73;
+  l248:;	  yy->__pos= yypos73; yy->__thunkpos= yythunkpos73;  if (!yymatchChar(yy, '~')) goto l70;
   }
   l73:;	  yyText(yy, yy->__begin, yy->__end);  {
 #define yytext yy->__text
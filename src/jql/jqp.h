@@ -97,6 +97,10 @@ typedef enum {
   JQP_OP_NI,
   JQP_OP_RE,
   JQP_OP_PREFIX,
+  JQP_OP_TEXT,
+  JQP_OP_IEQ,
+  JQP_OP_IIN,
+  JQP_OP_IPREFIX,
 } jqp_op_t;
 
 struct JQP_AUX;
@@ -1,5 +1,6 @@
 #include "ejdb_test.h"
 #include <CUnit/Basic.h>
+#include <pthread.h>
 
 int init_suite() {
   int rc = ejdb_init();
@@ -332,6 +333,50 @@ static void ejdb_test3_1() {
   ejdb_list_destroy(&list);
   iwxstr_clear(log);
 
+  // Q: /f/[b >= 3] | count
+  JQL q;
+  rc = jql_create(&q, "c1", "/f/[b >= 3] | count");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  EJDB_EXEC ux = {
+    .db  = db,
+    .q   = q,
+    .log = log
+  };
+  rc = ejdb_exec(&ux);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] COUNT"));
+  CU_ASSERT_EQUAL(ux.cnt, 8);
+  jql_destroy(&q);
+  iwxstr_clear(log);
+
+  // Q: /f/[b in [2,1112,4,6]] | count
+  rc = jql_create(&q, "c1", "/f/[b in [2,1112,4,6]] | count");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  memset(&ux, 0, sizeof(ux));
+  ux.db = db;
+  ux.q = q;
+  ux.log = log;
+  rc = ejdb_exec(&ux);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] COUNT"));
+  CU_ASSERT_EQUAL(ux.cnt, 3);
+  jql_destroy(&q);
+  iwxstr_clear(log);
+
+  // Q: /f/[b >= 3 and b < 5] | count (index doesn't decide filter)
+  rc = jql_create(&q, "c1", "/f/[b >= 3 and b < 5] | count");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  memset(&ux, 0, sizeof(ux));
+  ux.db = db;
+  ux.q = q;
+  ux.log = log;
+  rc = ejdb_exec(&ux);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] PLAIN"));
+  CU_ASSERT_EQUAL(ux.cnt, 2);
+  jql_destroy(&q);
+  iwxstr_clear(log);
+
   rc = ejdb_close(&db);
   CU_ASSERT_EQUAL_FATAL(rc, 0);
   iwxstr_destroy(log);
@@ -1119,6 +1164,2069 @@ void ejdb_test3_8(void) {
   iwpool_destroy(pool);
 }
 
+void ejdb_test3_9(void) {
+  EJDB_OPTS opts = {
+    .kv                = {
+      .path            = "ejdb_test3_9.db",
+      .oflags          = IWKV_TRUNC
+    },
+    .no_wal            = true,
+    .full_scan_threads = 4
+  };
+
+  EJDB db;
+  char dbuf[64];
+  int64_t cnt = 0;
+  EJDB_LIST list = 0;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < JB_PARALLEL_SCAN_MIN_RECORDS + 100; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'n':%d,'m':%d}", i, i % 7);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  rc = ejdb_list3(db, "c1", "/[m = 3]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[SCANNER] PARALLEL 4 ORDERED"));
+  int64_t prev_id = INT64_MAX;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    CU_ASSERT_TRUE(doc->id < prev_id);
+    prev_id = doc->id;
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, (JB_PARALLEL_SCAN_MIN_RECORDS + 100 + 3) / 7);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_list3(db, "c1", "/[m = 3] | skip 10 limit 5", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, 5);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_count2(db, "c1", "/[m = 3]", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, (JB_PARALLEL_SCAN_MIN_RECORDS + 100 + 3) / 7);
+
+  rc = ejdb_list3(db, "c1", "/[m = 3] | asc /n", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[SCANNER] PARALLEL 4 UNORDERED"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    JBL jbl;
+    int64_t n = 0;
+    rc = jbl_at(doc->raw, "/n", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    n = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(n, 3 + cnt * 7);
+    jbl_destroy(&jbl);
+  }
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_10(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_10.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  char dbuf[64];
+  int64_t cnt = 0;
+  EJDB_LIST list = 0;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'a':%d,'b':%d}", i % 2, i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_ensure_index(db, "c1", "/a", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/b", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Selective range index is preferred over low selectivity EQ index
+  rc = ejdb_list3(db, "c1", "/[a = 1] and /[b > 990]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, 5);
+  ejdb_list_destroy(&list);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|1000 /b EXPR1: 'b > 990' "
+                                "INIT: IWKV_CURSOR_GE STEP: IWKV_CURSOR_PREV EST: "));
+  iwxstr_clear(log);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Statistics is persisted
+  opts.kv.oflags &= ~IWKV_TRUNC;
+  rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_analyze(db, "c1");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_analyze(db, "c2");
+  CU_ASSERT_EQUAL(rc, IW_ERROR_NOT_EXISTS);
+
+  rc = ejdb_list3(db, "c1", "/[b < 10] and /[a = 0]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, 5);
+  ejdb_list_destroy(&list);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|1000 /b EXPR1: 'b < 10' "));
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_11(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_11.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  char dbuf[64];
+  int64_t cnt = 0, prev_id;
+  EJDB_LIST list = 0;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 2000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'a':%d,'b':%d}", i % 10, i % 7);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_ensure_index(db, "c1", "/a", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/b", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Intersection
+  rc = ejdb_list3(db, "c1", "/[a = 3] and /[b = 5]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED AND I64|2000 /a EXPR1: 'a = 3'"));
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED AND I64|2000 /b EXPR1: 'b = 5'"));
+  cnt = 0;
+  prev_id = INT64_MAX;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    CU_ASSERT_TRUE(doc->id < prev_id);
+    prev_id = doc->id;
+  }
+  CU_ASSERT_EQUAL(cnt, 29);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Intersection of conditions over different fields of the same node expression
+  rc = ejdb_list3(db, "c1", "/[a = 3 and b = 5]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED AND I64|2000 /a EXPR1: 'a = 3'"));
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED AND I64|2000 /b EXPR1: 'b = 5'"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) ;
+  CU_ASSERT_EQUAL(cnt, 29);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Range bounds are taken from conditions over the indexed field only
+  rc = ejdb_list3(db, "c1", "/[a > 7 and b < 1]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "EXPR2: 'b < 1'"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) ;
+  CU_ASSERT_EQUAL(cnt, 57);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Union
+  rc = ejdb_list3(db, "c1", "/[a = 3] or /[b = 5]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED OR I64|2000 /a EXPR1: 'a = 3'"));
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED OR I64|2000 /b EXPR1: 'b = 5'"));
+  cnt = 0;
+  prev_id = INT64_MAX;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    CU_ASSERT_TRUE(doc->id < prev_id);
+    prev_id = doc->id;
+  }
+  CU_ASSERT_EQUAL(cnt, 200 + 285 - 29);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_list3(db, "c1", "/[a = 3] or /[b = 5] | skip 10 limit 5", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) ;
+  CU_ASSERT_EQUAL(cnt, 5);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Union is not used if one of expressions is not indexed
+  rc = ejdb_list3(db, "c1", "/[a = 3] or /[c = 5]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] NO"));
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+// Cached index selection of prepared queries
+void ejdb_test3_12(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_12.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JQL q;
+  char dbuf[64];
+  int64_t cnt = 0;
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 100; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'a':%d}", i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_ensure_index(db, "c1", "/a", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = jql_create(&q, "c1", "/[a = 10]");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  q->cache_plan = true;
+
+  rc = ejdb_count(db, q, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(q->plan);
+  CU_ASSERT_PTR_NOT_NULL(((JBQPLAN) q->plan)->midx.idx);
+
+  // Cached plan is used
+  void *plan = q->plan;
+  rc = ejdb_count(db, q, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+  CU_ASSERT_PTR_EQUAL(q->plan, plan);
+
+  // Plan is invalidated by indexes change
+  rc = ejdb_remove_index(db, "c1", "/a", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_count(db, q, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(q->plan);
+  CU_ASSERT_PTR_NULL(((JBQPLAN) q->plan)->midx.idx);
+  jql_destroy(&q);
+
+  // Plan depending on placeholders is not cached
+  rc = jql_create(&q, "c1", "/[a = :v]");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  q->cache_plan = true;
+  rc = jql_set_i64(q, "v", 0, 10);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_count(db, q, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+  CU_ASSERT_PTR_NULL(q->plan);
+  jql_destroy(&q);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static iwrc ejdb_test3_13_step_visitor(struct _EJDB_EXEC *ux, const EJDB_DOC doc, int64_t *step) {
+  IWXSTR *xstr = ux->opaque;
+  JBL jbl;
+  iwrc rc = jbl_at(doc->raw, "/a", &jbl);
+  RCRET(rc);
+  iwxstr_printf(xstr, "%lld,", (long long) jbl_get_i64(jbl));
+  jbl_destroy(&jbl);
+  *step = 2;
+  return 0;
+}
+
+// Top-K sorting of order-by queries with limit
+void ejdb_test3_13(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_13.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL jbl;
+  EJDB_LIST list = 0;
+  char dbuf[64];
+  int64_t cnt, v;
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'a':%d}", (i * 37) % 1000);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  rc = ejdb_list3(db, "c1", "/* | asc /a skip 10 limit 5", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER TOPK: 15"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/a", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, 10 + cnt);
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 5);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_list3(db, "c1", "/[a > 100] | desc /a limit 3", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER TOPK: 3"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/a", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, 999 - cnt);
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 3);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Skip beyond the number of matched documents
+  rc = ejdb_list3(db, "c1", "/[a < 3] | asc /a skip 5 limit 5", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NULL(list->first);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Visitor stepping over documents is served by full sorter
+  JQL q;
+  IWXSTR *xstr = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(xstr);
+  rc = jql_create(&q, "c1", "/* | asc /a skip 10 limit 5");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  EJDB_EXEC ux = {
+    .db      = db,
+    .q       = q,
+    .visitor = ejdb_test3_13_step_visitor,
+    .opaque  = xstr,
+    .log     = log
+  };
+  rc = ejdb_exec(&ux);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER\n"));
+  CU_ASSERT_STRING_EQUAL(iwxstr_ptr(xstr), "10,12,14,16,18,");
+  jql_destroy(&q);
+  iwxstr_destroy(xstr);
+  iwxstr_clear(log);
+
+  // Full sorting without limit
+  rc = ejdb_list3(db, "c1", "/* | asc /a", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER\n"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) ;
+  CU_ASSERT_EQUAL(cnt, 1000);
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+// Sorting by pre-extracted sort keys
+void ejdb_test3_14(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_14.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL jbl;
+  EJDB_LIST list = 0;
+  char dbuf[128];
+  int64_t cnt, v, pv;
+  double f, pf;
+  const char *str;
+  char pstr[64];
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 2000; ++i) {
+    int k = (i * 7919) % 2000 - 1000;
+    snprintf(dbuf, sizeof(dbuf), "{'i':%d,'f':%d.5,'s':'k%d','g':%d}", k, k, k + 1000, k % 3);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  // Numeric keys (radix sort)
+  rc = ejdb_list3(db, "c1", "/* | desc /i", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  pv = INT64_MAX;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/i", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_TRUE(v < pv);
+    pv = v;
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 2000);
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_list3(db, "c1", "/* | asc /f", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  pf = -1e9;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/f", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    f = jbl_get_f64(jbl);
+    CU_ASSERT_TRUE(f > pf);
+    pf = f;
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 2000);
+  ejdb_list_destroy(&list);
+
+  // String keys
+  rc = ejdb_list3(db, "c1", "/* | desc /s", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  pstr[0] = '\0';
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/s", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    str = jbl_get_str(jbl);
+    if (cnt) {
+      CU_ASSERT_TRUE(strcmp(str, pstr) < 0);
+    }
+    snprintf(pstr, sizeof(pstr), "%s", str);
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 2000);
+  ejdb_list_destroy(&list);
+
+  // Compound keys
+  rc = ejdb_list3(db, "c1", "/* | asc /g desc /i", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  pv = INT64_MIN;
+  int64_t pg = INT64_MIN;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/g", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    int64_t g = jbl_get_i64(jbl);
+    jbl_destroy(&jbl);
+    rc = jbl_at(doc->raw, "/i", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    jbl_destroy(&jbl);
+    CU_ASSERT_TRUE(g > pg || (g == pg && v < pv));
+    pg = g;
+    pv = v;
+  }
+  CU_ASSERT_EQUAL(cnt, 2000);
+  ejdb_list_destroy(&list);
+
+  // Values of different types are ordered by type: numbers before strings
+  rc = put_json(db, "c1", "{'i':'zzz'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_list3(db, "c1", "/* | asc /i", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  EJDB_DOC last = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    last = doc;
+  }
+  CU_ASSERT_PTR_NOT_NULL_FATAL(last);
+  rc = jbl_at(last->raw, "/i", &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(jbl_type(jbl), JBV_STR);
+  jbl_destroy(&jbl);
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static iwrc ejdb_test3_15_back_visitor(struct _EJDB_EXEC *ux, const EJDB_DOC doc, int64_t *step) {
+  if (ux->cnt == 1) {
+    *step = -2;
+  }
+  return 0;
+}
+
+// External merge sort of results exceeding sort buffer
+void ejdb_test3_15(void) {
+  EJDB_OPTS opts = {
+    .kv             = {
+      .path         = "ejdb_test3_15.db",
+      .oflags       = IWKV_TRUNC
+    },
+    .no_wal         = true,
+    .sort_buffer_sz = 1024 * 1024, // 1M
+    .sort_threads   = 2
+  };
+
+  EJDB db;
+  JBL jbl;
+  EJDB_LIST list = 0;
+  char dbuf[1024];
+  char pad[513];
+  int64_t cnt, v, pv;
+
+  memset(pad, 'x', sizeof(pad) - 1);
+  pad[sizeof(pad) - 1] = '\0';
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 6000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'a':%d,'p':'%s'}", (i * 4999) % 6000, pad);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  rc = ejdb_list3(db, "c1", "/* | asc /a", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/a", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, cnt);
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 6000);
+  ejdb_list_destroy(&list);
+
+  // Skip and limit over merged runs
+  rc = ejdb_list3(db, "c1", "/[a >= 1000] | desc /a skip 100 limit 5000", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  pv = 6000 - 100;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/a", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, pv - 1);
+    pv = v;
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 4900);
+  ejdb_list_destroy(&list);
+
+  // Merged runs are streamed forward only
+  JQL q;
+  rc = jql_create(&q, "c1", "/* | asc /a");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  EJDB_EXEC ux = {
+    .db      = db,
+    .q       = q,
+    .visitor = ejdb_test3_15_back_visitor
+  };
+  rc = ejdb_exec(&ux);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_SORT_STEP_BACKWARD);
+  CU_ASSERT_EQUAL(ux.cnt, 2);
+  jql_destroy(&q);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Compound index over (/tenant, /ts)
+void ejdb_test3_16(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_16.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL jbl;
+  EJDB_LIST list = 0;
+  char dbuf[64];
+  int64_t cnt, v, pv;
+  EJDB_IDX_COL cols[] = {
+    { "/tenant", EJDB_IDX_STR },
+    { "/ts",     EJDB_IDX_I64 }
+  };
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 300; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'tenant':'t%d','ts':%d}", i % 3, i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_ensure_compound_index(db, "c1", cols, 2, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_list3(db, "c1", "/[tenant = \"t1\"] and /[ts > 100] and /[ts <= 200] | desc /ts", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR,I64|300 /tenant,/ts"));
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER"));
+  cnt = 0;
+  pv = 202;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/ts", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, pv - 3);
+    pv = v;
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 33);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Equality prefix with ascending order of the next column
+  rc = ejdb_list3(db, "c1", "/[tenant = \"t2\"] | asc /tenant asc /ts limit 5", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/ts", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, 2 + 3 * cnt);
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 5);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_count2(db, "c1", "/[tenant = \"t0\"] and /[ts < 30]", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 10);
+
+  rc = ejdb_ensure_compound_index(db, "c1", cols, 2, EJDB_IDX_UNIQUE);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_MISMATCHED_INDEX_UNIQUENESS_MODE);
+  rc = ejdb_remove_compound_index(db, "c1", cols, 2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_compound_index(db, "c1", cols, 2, EJDB_IDX_UNIQUE);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'tenant':'t1','ts':1}");
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+  rc = put_json(db, "c1", "{'tenant':'t1','ts':2}");
+  CU_ASSERT_EQUAL(rc, 0);
+
+  rc = ejdb_count2(db, "c1", "/[tenant = \"t1\"] and /[ts = 2]", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_17(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_17.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL_NODE n;
+  EJDB_LIST list = 0;
+  char dbuf[128];
+  int64_t id, cnt, pv;
+  const char *include[] = { "/name" };
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+  IWXSTR *xstr = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(xstr);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 100; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'email':'u%d@x','name':'n%d','age':%d,'bio':'b%d'}", i, i, i, i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_ensure_index2(db, "c1", "/email", EJDB_IDX_UNIQUE | EJDB_IDX_STR, include, 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index2(db, "c1", "/age", EJDB_IDX_I64, include, 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Projection of stored fields is answered by index entries
+  rc = ejdb_list3(db, "c1", "/[email = \"u7@x\"] | /{email,name}", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] COVERING"));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(list->first);
+  CU_ASSERT_PTR_NULL(list->first->next);
+  id = list->first->id;
+  rc = jbn_as_json(list->first->node, jbl_xstr_json_printer, xstr, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_STRING_EQUAL(iwxstr_ptr(xstr), "{\"email\":\"u7@x\",\"name\":\"n7\"}");
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+  iwxstr_clear(xstr);
+
+  // Not stored field is projected
+  rc = ejdb_list3(db, "c1", "/[email = \"u7@x\"] | /{email,bio}", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] COVERING"));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(list->first);
+  rc = jbn_at(list->first->node, "/bio", &n);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_NSTRING_EQUAL(n->vptr, "b7", n->vsize);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Index entry is updated along with stored field
+  rc = ejdb_patch(db, "c1", "[{\"op\":\"replace\", \"path\":\"/name\", \"value\":\"nn7\"}]", id);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_list3(db, "c1", "/[email = \"u7@x\"] | /name", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] COVERING"));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(list->first);
+  rc = jbn_at(list->first->node, "/name", &n);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_NSTRING_EQUAL(n->vptr, "nn7", n->vsize);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Sorted range scan of non unique covering index
+  rc = ejdb_list3(db, "c1", "/[age > 90] | /{age,name} | desc /age", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|100 /age"));
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] COVERING"));
+  cnt = 0;
+  pv = 100;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbn_at(doc->node, "/age", &n);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(n->vi64, pv - 1);
+    pv = n->vi64;
+    rc = jbn_at(doc->node, "/name", &n);
+    CU_ASSERT_EQUAL(rc, 0);
+  }
+  CU_ASSERT_EQUAL(cnt, 9);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(xstr);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_18(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_18.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL jbl;
+  EJDB_LIST list = 0;
+  char dbuf[64];
+  int64_t cnt;
+  double v, pv;
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = -50; i < 50; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'v':%.1f}", i / 10.0);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  // Values indistinguishable by 8 decimals
+  rc = put_json(db, "c1", "{'v':1.000000001}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'v':1.000000002}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_ensure_index(db, "c1", "/v", EJDB_IDX_UNIQUE | EJDB_IDX_F64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_count2(db, "c1", "/[v = 1.000000002]", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+
+  rc = ejdb_count2(db, "c1", "/[v > 1.0000000015]", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 40);
+
+  rc = ejdb_list3(db, "c1", "/[v >= -2.5] | asc /v", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|F64|"));
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[COLLECTOR] SORTER"));
+  cnt = 0;
+  pv = -3.0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/v", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_f64(jbl);
+    CU_ASSERT_TRUE(v > pv);
+    pv = v;
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, 77);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_rebuild_index(db, "c1", "/v", EJDB_IDX_UNIQUE | EJDB_IDX_F64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_count2(db, "c1", "/[v < -4.85]", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 2);
+  rc = ejdb_rebuild_index(db, "c1", "/w", EJDB_IDX_F64);
+  CU_ASSERT_EQUAL(rc, IW_ERROR_NOT_EXISTS);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_19(void) {
+  EJDB_OPTS opts = {
+    .kv             = {
+      .path         = "ejdb_test3_19.db",
+      .oflags       = IWKV_TRUNC
+    },
+    .no_wal         = true,
+    .sort_buffer_sz = 1024 * 1024,
+    .sort_threads   = 2
+  };
+
+  EJDB db;
+  JBL jbl;
+  EJDB_LIST list = 0;
+  char dbuf[256];
+  int64_t cnt, v, pv;
+  const int ndocs = 20000;
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // About 3Mb of documents, index is built from several runs
+  for (int i = 0; i < ndocs; ++i) {
+    snprintf(dbuf, sizeof(dbuf),
+             "{'n':%d, 'd':%d, 'tags':['t%d','x'], "
+             "'pad':'0123456789012345678901234567890123456789012345678901234567890123456789'}",
+             (i * 7919) % ndocs, i % 2, i % 10);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  rc = ejdb_ensure_index(db, "c1", "/n", EJDB_IDX_UNIQUE | EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/tags", EJDB_IDX_STR);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/d", EJDB_IDX_UNIQUE | EJDB_IDX_I64);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+
+  rc = ejdb_list3(db, "c1", "/[n >= 100] | asc /n", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|I64|20000 /n"));
+  cnt = 0;
+  pv = 99;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbl_at(doc->raw, "/n", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    v = jbl_get_i64(jbl);
+    CU_ASSERT_EQUAL(v, pv + 1);
+    pv = v;
+    jbl_destroy(&jbl);
+  }
+  CU_ASSERT_EQUAL(cnt, ndocs - 100);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  rc = ejdb_list3(db, "c1", "/tags/[** in [\"t3\"]]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|40000 /tags"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, ndocs / 10);
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+struct ejdb_test3_20_ctx {
+  EJDB db;
+  iwrc rc;
+};
+
+static void *ejdb_test3_20_build(void *op) {
+  struct ejdb_test3_20_ctx *bctx = op;
+  bctx->rc = ejdb_ensure_index_online(bctx->db, "c1", "/g", EJDB_IDX_I64);
+  return 0;
+}
+
+void ejdb_test3_20(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_20.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  pthread_t thr;
+  char dbuf[64];
+  int64_t id, cnt, cnt2;
+  struct ejdb_test3_20_ctx bctx;
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 20000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'n':%d, 'g':%d}", i, i % 100);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  bctx.rc = 0;
+  bctx.db = db;
+  CU_ASSERT_EQUAL_FATAL(pthread_create(&thr, 0, ejdb_test3_20_build, &bctx), 0);
+
+  // Collection is updated while index is being built
+  for (int i = 0; i < 1000; ++i) {
+    JBL jbl;
+    snprintf(dbuf, sizeof(dbuf), "{\"n\":%d, \"g\":7}", 20000 + i);
+    rc = jbl_from_json(&jbl, dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    rc = ejdb_put_new(db, "c1", jbl, &id);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    jbl_destroy(&jbl);
+    if (i < 500) {
+      rc = ejdb_del(db, "c1", i + 1);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  pthread_join(thr, 0);
+  CU_ASSERT_EQUAL_FATAL(bctx.rc, 0);
+
+  rc = ejdb_count2(db, "c1", "/[g = 7] | noidx", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1195);
+
+  EJDB_LIST list = 0;
+  rc = ejdb_list3(db, "c1", "/[g = 7]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|20500 /g"));
+  cnt2 = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt2;
+  }
+  CU_ASSERT_EQUAL(cnt2, cnt);
+  ejdb_list_destroy(&list);
+
+  // Index is persisted in active state
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  opts.kv.oflags = 0;
+  rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_clear(log);
+  rc = ejdb_list3(db, "c1", "/[g = 7]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|20500 /g"));
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_21(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_21.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  char dbuf[64];
+  int64_t cnt;
+  EJDB_LIST list = 0;
+
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'n':%d, 'status':'%s'}", i, (i % 10) ? "done" : "pending");
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  rc = ejdb_ensure_partial_index(db, "c1", "/n", EJDB_IDX_I64, "/[status = \"pending\"] or /[n = 1]");
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_FILTER);
+  rc = ejdb_ensure_partial_index(db, "c1", "/n", EJDB_IDX_I64, "/[status = \"pending\"]");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/n", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_MISMATCHED_INDEX_FILTER);
+
+  rc = ejdb_list3(db, "c1", "/[status = \"pending\"] and /[n > 500]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|100 /n"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, 49);
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Query does not imply index filter
+  rc = ejdb_list3(db, "c1", "/[n > 500]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+  ejdb_list_destroy(&list);
+  iwxstr_clear(log);
+
+  // Document becomes matched by filter
+  rc = ejdb_patch(db, "c1", "{\"status\":\"pending\"}", 2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  opts.kv.oflags = 0;
+  rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_list3(db, "c1", "/[n < 5] and /[status = \"pending\"]", 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED I64|101 /n"));
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(cnt, 2);
+  ejdb_list_destroy(&list);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+static int64_t ejdb_test3_22_count(EJDB db, const char *q, IWXSTR *log) {
+  int64_t cnt = 0;
+  EJDB_LIST list = 0;
+  iwxstr_clear(log);
+  iwrc rc = ejdb_list3(db, "c1", q, 0, log, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next) {
+    ++cnt;
+  }
+  ejdb_list_destroy(&list);
+  return cnt;
+}
+
+void ejdb_test3_22(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_22.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'t':'The Quick Brown Fox!'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'t':'quick, brown dogs and a fox'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'t':['Ärger im Büro', 'QUICK']}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'t':'ﬁne print'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'t':42}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_ensure_index(db, "c1", "/t", EJDB_IDX_TEXT | EJDB_IDX_UNIQUE);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_MODE);
+  rc = ejdb_ensure_index(db, "c1", "/t", EJDB_IDX_TEXT);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text \"quick brown\"]", log), 2);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TEXT|16 /t"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text \"brown fox\"]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text [\"fox\", \"QUICK\"]]", log), 2);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text ärger]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text fine]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text \"quick büro\"]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text [\"quick\", \"büro\"]]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text \"...\"]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t not text quick]", log), 2);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+
+  // Changed terms of updated document
+  rc = ejdb_patch(db, "c1", "{\"t\":\"Slow fox\"}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text quick]", log), 2);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TEXT|14 /t"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text fox]", log), 2);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[t text fox] | noidx", log), 2);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_23(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_23.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'email':'Ann@Mail.org'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'email':'bob@mail.org'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'email':'Éve@Mail.org'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  // Case folded key doesn't fit into number buffer
+  rc = put_json(db, "c1", "{'email':'Very.Long.Mailbox.Name.Exceeding.Number.Buffer@Example-Domain.org'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_ensure_index(db, "c1", "/email", EJDB_IDX_I64 | EJDB_IDX_NOCASE);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_MODE);
+  rc = ejdb_ensure_index(db, "c1", "/email", EJDB_IDX_UNIQUE | EJDB_IDX_STR | EJDB_IDX_NOCASE);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'email':'ANN@mail.ORG'}");
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email ieq \"ann@MAIL.org\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|STR|NOCASE|4 /email"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email ieq \"éVE@mail.org\"]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(
+                    db, "/[email ieq \"very.long.mailbox.name.exceeding.number.buffer@EXAMPLE-DOMAIN.ORG\"]",
+                    log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email iin [\"BOB@MAIL.ORG\", \"ann@mail.org\", \"x\"]]", log), 2);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|STR|NOCASE|4 /email"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email i~ \"VERY.long\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|STR|NOCASE|4 /email"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email ieq \"ann@mail.org\"] | noidx", log), 1);
+
+  // Case sensitive operators are not served by case insensitive index
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email = \"ann@mail.org\"]", log), 0);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email = \"Ann@Mail.org\"]", log), 1);
+
+  rc = ejdb_patch(db, "c1", "{\"email\":\"Bobby@Mail.org\"}", 2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email ieq \"bob@mail.org\"]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[email ieq \"BOBBY@mail.org\"]", log), 1);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_24(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_24.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  const char *include[] = { "/user" };
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'token':'7f3a9c1e5b2d4f6a8c0e1b3d5f7a9c1e5b2d4f6a8c0e1b3d5f7a9c1e5b2d4f6a8c0e','user':1}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'token':'Abc','user':2}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'token':'abc','user':3}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'token':42,'user':4}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_ensure_index(db, "c1", "/token", EJDB_IDX_UNIQUE | EJDB_IDX_STR | EJDB_IDX_HASH);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_MODE);
+  rc = ejdb_ensure_index(db, "c1", "/token", EJDB_IDX_I64 | EJDB_IDX_HASH);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_MODE);
+  rc = ejdb_ensure_index2(db, "c1", "/token", EJDB_IDX_STR | EJDB_IDX_HASH, include, 1);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_MODE);
+  rc = ejdb_ensure_index(db, "c1", "/token", EJDB_IDX_STR | EJDB_IDX_HASH);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(
+                    db, "/[token = "
+                    "\"7f3a9c1e5b2d4f6a8c0e1b3d5f7a9c1e5b2d4f6a8c0e1b3d5f7a9c1e5b2d4f6a8c0e\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|HASH|4 /token"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[token = abc]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[token = 42]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[token in [\"Abc\", \"abc\", \"abd\"]]", log), 2);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|HASH|4 /token"));
+
+  // Hash index keys are not ordered
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[token ~ ab]", log), 1);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+  ejdb_test3_22_count(db, "/[token > Abc]", log);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/* | asc /token", log), 4);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+
+  rc = ejdb_patch(db, "c1", "{\"token\":\"xyz\"}", 3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[token = abc]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[token = xyz]", log), 1);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_25(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_25.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/tags", EJDB_IDX_STR);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'tags':['a','b','c']}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'tags':['b']}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"b\"]]", log), 2);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|4 /tags"));
+
+  // Element `a` is removed, `d` is added, other elements are kept
+  rc = ejdb_patch(db, "c1", "{\"tags\":[\"c\",\"b\",\"d\",\"d\"]}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"a\"]]", log), 0);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|4 /tags"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"d\"]]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"b\", \"c\"]]", log), 2);
+
+  // Type converted elements with the same keys
+  rc = ejdb_patch(db, "c1", "{\"tags\":[1,\"1\",\"b\"]}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"1\"]]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|3 /tags"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"c\", \"d\"]]", log), 0);
+
+  rc = ejdb_patch(db, "c1", "{\"tags\":[]}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/tags/[** in [\"b\"]]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|1 /tags"));
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_26(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_26.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = put_json(db, "c1", "{'msg':'disk failure on sda'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'msg':'Disk FAILURE'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'msg':'network failure'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'msg':'disk ok'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'msg':['boot ok', 'fan failure']}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_ensure_index(db, "c1", "/msg", EJDB_IDX_TRIGRAM | EJDB_IDX_UNIQUE);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_INVALID_INDEX_MODE);
+  rc = ejdb_ensure_index(db, "c1", "/msg", EJDB_IDX_TRIGRAM);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"disk.*failure\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re fail]", log), 3);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"^network\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"fa[il]+ure\"]", log), 3);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"fail\"] | noidx", log), 3);
+
+  // No trigrams every matched string contains
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"disk|network\"]", log), 3);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"di?sk\"]", log), 2);
+  CU_ASSERT_PTR_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED"));
+
+  rc = ejdb_patch(db, "c1", "{\"msg\":\"disk failure again\"}", 4);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"disk.*failure\"]", log), 2);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \" ok\"]", log), 1);
+
+  // Numbers and booleans are matched by their string forms
+  rc = put_json(db, "c1", "{'msg':12345}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'msg':[1.5, true]}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"234\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"^123\"]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED TRIGRAM|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"234\"] | noidx", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[msg re \"rue\"]", log),
+                  ejdb_test3_22_count(db, "/[msg re \"rue\"] | noidx", log));
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_27(void) {
+  EJDB_OPTS opts = {
+    .kv         = {
+      .path     = "ejdb_test3_27.db",
+      .oflags   = IWKV_TRUNC
+    },
+    .no_wal     = true,
+    .bloom_bits = 10
+  };
+
+  EJDB db;
+  JBL jbl, meta;
+  int64_t id = 0;
+  char dbuf[64];
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/sku", EJDB_IDX_UNIQUE | EJDB_IDX_STR);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Filters grow beyond initial capacity
+  for (int i = 1; i <= 3000; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'sku':'s%d'}", i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = put_json(db, "c1", "{'sku':'s7'}");
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+
+  for (int i = 0; i < 2; ++i) {
+    rc = ejdb_get(db, "c1", 2999, &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    jbl_destroy(&jbl);
+    rc = ejdb_get(db, "c1", 3001, &jbl);
+    CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+    rc = ejdb_del(db, "c1", 5000);
+    CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+
+    CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/=[5, 4000, 3000]", log), 2);
+    CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/=4000", log), 0);
+    CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[sku = s2500]", log), 1);
+    CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|STR|"));
+    CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[sku = s4000]", log), 0);
+    CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[sku in [s1, s4000, s3000]]", log), 2);
+
+    rc = ejdb_get_meta(db, &meta);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    rc = jbl_at(meta, "/collections/0/bloom/keys", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE(jbl_get_i64(jbl) >= 3000);
+    jbl_destroy(&jbl);
+    rc = jbl_at(meta, "/collections/0/bloom/size", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE(jbl_get_i64(jbl) > 0);
+    jbl_destroy(&jbl);
+    rc = jbl_at(meta, "/collections/0/indexes/0/bloom/fpp", &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE(jbl_get_f64(jbl) < 0.05);
+    jbl_destroy(&jbl);
+    jbl_destroy(&meta);
+
+    // Filters are built on collection load
+    rc = ejdb_close(&db);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    opts.kv.oflags = 0;
+    rc = ejdb_open(&opts, &db);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  // Removed and replaced keys
+  rc = ejdb_del(db, "c1", 2999);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_get(db, "c1", 2999, &jbl);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  rc = ejdb_patch(db, "c1", "{\"sku\":\"x1\"}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[sku = s1]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[sku = x1]", log), 1);
+  rc = put_json2(db, "c1", "{'sku':'s1'}", &id);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(id, 3001);
+  rc = ejdb_merge_or_put(db, "c1", "{\"sku\":\"s5000\"}", 5000);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/=[3001, 5000]", log), 2);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_28(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_28.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL jbl, meta;
+  JBL jbls[100];
+  int64_t ids[100];
+  char dbuf[64];
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/n", EJDB_IDX_UNIQUE | EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/s", EJDB_IDX_STR);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 100; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{\"n\":%d,\"s\":\"%s\"}", 100 - i, (i % 2) ? "odd" : "even");
+    rc = jbl_from_json(&jbls[i], dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_put_new_batch(db, "c1", jbls, 100, ids);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ids[0], 1);
+  CU_ASSERT_EQUAL(ids[99], 100);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n > 90]", log), 10);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|I64|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = odd]", log), 50);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED STR|"));
+  rc = ejdb_get(db, "c1", 100, &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  jbl_destroy(&jbl);
+
+  // Batch violating unique index constraint is reverted
+  for (int i = 0; i < 3; ++i) {
+    jbl_destroy(&jbls[i]);
+    snprintf(dbuf, sizeof(dbuf), "{\"n\":%d,\"s\":\"new\"}", 200 + i * 100);
+    rc = jbl_from_json(&jbls[i], dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  jbl_destroy(&jbls[3]);
+  rc = jbl_from_json(&jbls[3], "{\"n\":50,\"s\":\"new\"}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_put_new_batch(db, "c1", jbls, 4, ids);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+  CU_ASSERT_EQUAL(ids[0], 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 100);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = new]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n >= 200]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n = 50]", log), 1);
+
+  // Replace existing documents and add new ones under given ids
+  int64_t pids[] = { 1, 2, 500 };
+  rc = ejdb_put_batch(db, "c1", jbls, pids, 3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 101);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = new]", log), 3);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n >= 99]", log), 3);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = even]", log), 49);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = odd]", log), 49);
+
+  int64_t dids[] = { 3, 3 };
+  rc = ejdb_put_batch(db, "c1", jbls, dids, 2);
+  CU_ASSERT_EQUAL(rc, IW_ERROR_INVALID_ARGS);
+
+  rc = ejdb_put_new_batch(db, "c1", jbls + 4, 1, ids);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+  rc = ejdb_put_new_batch(db, "c1", jbls, 1, ids);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+
+  // Replaced document is restored with its index entries
+  int64_t uids[] = { 3 };
+  rc = jbl_from_json(&jbl, "{\"n\":50,\"s\":\"upd\"}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_put_batch(db, "c1", &jbl, uids, 1);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+  jbl_destroy(&jbl);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n = 98]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|I64|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = upd]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[s = even]", log), 49);
+
+  rc = ejdb_get_meta(db, &meta);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_at(meta, "/collections/0/rnum", &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(jbl_get_i64(jbl), 101);
+  jbl_destroy(&jbl);
+  for (int i = 0; i < 2; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "/collections/0/indexes/%d/rnum", i);
+    rc = jbl_at(meta, dbuf, &jbl);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(jbl_get_i64(jbl), 101);
+    jbl_destroy(&jbl);
+  }
+  jbl_destroy(&meta);
+
+  for (int i = 0; i < 100; ++i) {
+    jbl_destroy(&jbls[i]);
+  }
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+void ejdb_test3_29(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_29.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  EJDB_TXN txn;
+  JBL jbl, jbl2;
+  int64_t cnt;
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'a':1}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'a':2}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/a", EJDB_IDX_UNIQUE | EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_from_json(&jbl, "{\"a\":3}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_from_json(&jbl2, "{\"b\":1}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_txn_begin(db, &txn);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_put(txn, "c1", jbl, 3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_patch(txn, "c1", "{\"a\":10}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_del(txn, "c1", 2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_put(txn, "c2", jbl2, 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 2); // Not applied yet
+  rc = ejdb_txn_commit(&txn);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NULL(txn);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 2);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[a = 10]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[a = 3]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[a = 2]", log), 0);
+  rc = ejdb_count2(db, "c2", "/*", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 1);
+
+  // Failed operation reverts all applied ones
+  rc = ejdb_txn_begin(db, &txn);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_del(txn, "c1", 3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_patch(txn, "c1", "{\"a\":20}", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_put(txn, "c1", jbl2, 4);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_put(txn, "c1", jbl, 5); // Unique key of removed document
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_patch(txn, "c1", "{\"a\":30}", 4);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_patch(txn, "c1", "{\"a\":20}", 5);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_commit(&txn);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+  CU_ASSERT_PTR_NULL(txn);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 2);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[a = 10]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[a = 3]", log), 1);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[a in [20, 30]]", log), 0);
+  rc = ejdb_get(db, "c1", 3, &jbl2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  jbl_destroy(&jbl2);
+  rc = ejdb_get(db, "c1", 4, &jbl2);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+
+  rc = ejdb_txn_begin(db, &txn);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_del(txn, "c1", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_del(txn, "c1", 100);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_commit(&txn);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 2);
+
+  rc = ejdb_txn_begin(db, &txn);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_del(txn, "c1", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_txn_patch(txn, "c1", "{\"a\":", 3);
+  CU_ASSERT_NOT_EQUAL(rc, 0);
+  ejdb_txn_abort(&txn);
+  CU_ASSERT_PTR_NULL(txn);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/*", log), 2);
+
+  jbl_destroy(&jbl);
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
+static void *ejdb_test3_30_writer(void *op) {
+  EJDB db = op;
+  iwrc rc = 0;
+  for (int i = 0; i < 50 && !rc; ++i) {
+    rc = put_json(db, "c1", "{'a':1}");
+  }
+  return (void*) (intptr_t) rc;
+}
+
+void ejdb_test3_30(void) {
+  EJDB_OPTS opts = {
+    .kv                  = {
+      .path              = "ejdb_test3_30.db",
+      .oflags            = IWKV_TRUNC
+    },
+    .wal_group_commit_us = 2000
+  };
+
+  EJDB db;
+  JBL meta, jbl;
+  int64_t cnt;
+  pthread_t thr[8];
+  void *ret;
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/a", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < 8; ++i) {
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&thr[i], 0, ejdb_test3_30_writer, db), 0);
+  }
+  for (int i = 0; i < 8; ++i) {
+    pthread_join(thr[i], &ret);
+    CU_ASSERT_EQUAL((iwrc) (intptr_t) ret, 0);
+  }
+  rc = ejdb_del(db, "c1", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_count2(db, "c1", "/*", &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 399);
+
+  // Every write is synced, concurrent writes share syncs
+  rc = ejdb_get_meta(db, &meta);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_at(meta, "/group_commit/writes", &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(jbl_get_i64(jbl), 401);
+  jbl_destroy(&jbl);
+  rc = jbl_at(meta, "/group_commit/groups", &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(jbl_get_i64(jbl) > 0);
+  CU_ASSERT_TRUE(jbl_get_i64(jbl) < 401);
+  jbl_destroy(&jbl);
+  rc = jbl_at(meta, "/group_commit/max_batch", &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(jbl_get_i64(jbl) > 1);
+  jbl_destroy(&jbl);
+  rc = jbl_at(meta, "/group_commit/wait_us", &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(jbl_get_i64(jbl) > 0);
+  jbl_destroy(&jbl);
+  jbl_destroy(&meta);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static int64_t ejdb_test3_31_rnum(EJDB db, const char *ptr) {
+  JBL meta, jbl;
+  int64_t ret = -1;
+  iwrc rc = ejdb_get_meta(db, &meta);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_at(meta, ptr, &jbl);
+  if (!rc) {
+    ret = jbl_get_i64(jbl);
+    jbl_destroy(&jbl);
+  }
+  jbl_destroy(&meta);
+  return ret;
+}
+
+void ejdb_test3_31(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_31.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  IWKV kv;
+  IWDB nrecdb;
+  char dbuf[64];
+  uint32_t dbid;
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/a", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < 100; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'a':%d}", i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = ejdb_del(db, "c1", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_31_rnum(db, "/collections/0/rnum"), 99);
+  CU_ASSERT_EQUAL(ejdb_test3_31_rnum(db, "/collections/0/indexes/0/rnum"), 99);
+  dbid = (uint32_t) ejdb_test3_31_rnum(db, "/collections/0/dbid");
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Counters are persisted on close
+  opts.kv.oflags = 0;
+  rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_31_rnum(db, "/collections/0/rnum"), 99);
+  CU_ASSERT_EQUAL(ejdb_test3_31_rnum(db, "/collections/0/indexes/0/rnum"), 99);
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Database not closed properly: stale counter without clean mark
+  IWKV_OPTS kvopts = {
+    .path = "ejdb_test3_31.db"
+  };
+  rc = iwkv_open(&kvopts, &kv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(kv, 2, IWDB_VNUM64_KEYS, &nrecdb);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  uint64_t llv = IW_HTOILL(((uint64_t) 2) << 32);
+  IWKV_val key = {
+    .data = &llv,
+    .size = sizeof(llv)
+  };
+  rc = iwkv_del(nrecdb, &key, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  int64_t stale = IW_HTOILL(10);
+  dbid = IW_HTOIL(dbid);
+  IWKV_val skey = {
+    .data = &dbid,
+    .size = sizeof(dbid)
+  };
+  IWKV_val sval = {
+    .data = &stale,
+    .size = sizeof(stale)
+  };
+  rc = iwkv_put(nrecdb, &skey, &sval, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_close(&kv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(ejdb_test3_31_rnum(db, "/collections/0/rnum"), 99);
+  CU_ASSERT_EQUAL(ejdb_test3_31_rnum(db, "/collections/0/indexes/0/rnum"), 99);
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void ejdb_test3_32_check(EJDB db, int64_t id, const char *json, IWXSTR *xstr) {
+  JBL jbl;
+  iwxstr_clear(xstr);
+  iwrc rc = ejdb_get(db, "c1", id, &jbl);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_as_json(jbl, jbl_xstr_json_printer, xstr, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_STRING_EQUAL(iwxstr_ptr(xstr), json);
+  jbl_destroy(&jbl);
+}
+
+void ejdb_test3_32(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_32.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JQL q;
+  JBL_NODE n;
+  int64_t cnt;
+  char dbuf[64];
+  EJDB_LIST list = 0;
+  IWXSTR *xstr = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(xstr);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/n", EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < 10; ++i) {
+    snprintf(dbuf, sizeof(dbuf), "{'n':%d,'s':'v','o':{'k':1}}", i);
+    rc = put_json(db, "c1", dbuf);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  // Patches applied in place
+  rc = ejdb_patch(db, "c1", "[{\"op\":\"increment\", \"path\":\"/n\", \"value\":100}]", 1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  ejdb_test3_32_check(db, 1, "{\"n\":100,\"s\":\"v\",\"o\":{\"k\":1}}", xstr);
+
+  rc = ejdb_patch(db, "c1", "{\"s\":null,\"o\":{\"k\":2,\"m\":\"x\"}}", 2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  ejdb_test3_32_check(db, 2, "{\"n\":1,\"o\":{\"k\":2,\"m\":\"x\"}}", xstr);
+
+  // Index is updated by patched document
+  rc = ejdb_list3(db, "c1", "/[n = 100]", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(list->first);
+  CU_ASSERT_EQUAL(list->first->id, 1);
+  CU_ASSERT_PTR_NULL(list->first->next);
+  ejdb_list_destroy(&list);
+
+  // Structural patch is applied on document tree
+  rc = ejdb_patch(db, "c1", "[{\"op\":\"add\", \"path\":\"/o/k\", \"value\":[1,2]},"
+                  "{\"op\":\"add\", \"path\":\"/o/k/1\", \"value\":3}]", 3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  ejdb_test3_32_check(db, 3, "{\"n\":2,\"s\":\"v\",\"o\":{\"k\":[1,3,2]}}", xstr);
+
+  rc = ejdb_patch(db, "c1", "[{\"op\":\"increment\", \"path\":\"/s\", \"value\":1}]", 4);
+  CU_ASSERT_EQUAL(rc, JBL_ERROR_PATCH_TARGET_INVALID);
+  ejdb_test3_32_check(db, 4, "{\"n\":3,\"s\":\"v\",\"o\":{\"k\":1}}", xstr);
+
+  // Query apply, visitor gets node of patched document
+  rc = ejdb_list3(db, "c1", "/[n < 5] | apply {\"t\":true}", 0, 0, &list);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  cnt = 0;
+  for (EJDB_DOC doc = list->first; doc; doc = doc->next, ++cnt) {
+    rc = jbn_at(doc->node, "/t", &n);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(n->type, JBV_BOOL);
+  }
+  CU_ASSERT_EQUAL(cnt, 4);
+  ejdb_list_destroy(&list);
+  ejdb_test3_32_check(db, 5, "{\"n\":4,\"s\":\"v\",\"o\":{\"k\":1},\"t\":true}", xstr);
+
+  rc = jql_create(&q, "c1", "/[n >= 5] | apply [{\"op\":\"increment\", \"path\":\"/o/k\", \"value\":10}]");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_update(db, q);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  jql_destroy(&q);
+  ejdb_test3_32_check(db, 10, "{\"n\":9,\"s\":\"v\",\"o\":{\"k\":11}}", xstr);
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(xstr);
+}
+
+void ejdb_test3_33(void) {
+  EJDB_OPTS opts = {
+    .kv       = {
+      .path   = "ejdb_test3_33.db",
+      .oflags = IWKV_TRUNC
+    },
+    .no_wal   = true
+  };
+
+  EJDB db;
+  JBL jbls[2];
+  IWXSTR *log = iwxstr_new();
+  CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+  iwrc rc = ejdb_open(&opts, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  // Index `/u` is updated after `/n` by batch put
+  rc = ejdb_ensure_index(db, "c1", "/u", EJDB_IDX_UNIQUE | EJDB_IDX_STR);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_ensure_index(db, "c1", "/n", EJDB_IDX_UNIQUE | EJDB_IDX_I64);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'n':3,'u':'a'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'n':5,'u':'b'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = put_json(db, "c1", "{'n':7,'u':'c'}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Unique keys are moved in chain: 3 -> 1 then 5 -> 3, update of `/u` fails
+  int64_t ids[] = { 1, 2 };
+  rc = jbl_from_json(&jbls[0], "{\"n\":1,\"u\":\"a\"}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = jbl_from_json(&jbls[1], "{\"n\":3,\"u\":\"c\"}");
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = ejdb_put_batch(db, "c1", jbls, ids, 2);
+  CU_ASSERT_EQUAL(rc, EJDB_ERROR_UNIQUE_INDEX_CONSTRAINT_VIOLATED);
+  jbl_destroy(&jbls[0]);
+  jbl_destroy(&jbls[1]);
+
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n = 3]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|I64|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n = 5]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|I64|"));
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[n = 1]", log), 0);
+  CU_ASSERT_EQUAL(ejdb_test3_22_count(db, "/[u = b]", log), 1);
+  CU_ASSERT_PTR_NOT_NULL(strstr(iwxstr_ptr(log), "[INDEX] SELECTED UNIQUE|STR|"));
+
+  rc = ejdb_close(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwxstr_destroy(log);
+}
+
 int main() {
   CU_pSuite pSuite = NULL;
   if (CUE_SUCCESS != CU_initialize_registry()) {
@@ -1136,7 +3244,32 @@ int main() {
      || (NULL == CU_add_test(pSuite, "ejdb_test3_5", ejdb_test3_5))
      || (NULL == CU_add_test(pSuite, "ejdb_test3_6", ejdb_test3_6))
      || (NULL == CU_add_test(pSuite, "ejdb_test3_7", ejdb_test3_7))
-     || (NULL == CU_add_test(pSuite, "ejdb_test3_8", ejdb_test3_8))) {
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_8", ejdb_test3_8))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_9", ejdb_test3_9))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_10", ejdb_test3_10))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_11", ejdb_test3_11))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_12", ejdb_test3_12))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_13", ejdb_test3_13))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_14", ejdb_test3_14))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_15", ejdb_test3_15))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_16", ejdb_test3_16))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_17", ejdb_test3_17))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_18", ejdb_test3_18))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_19", ejdb_test3_19))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_20", ejdb_test3_20))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_21", ejdb_test3_21))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_22", ejdb_test3_22))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_23", ejdb_test3_23))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_24", ejdb_test3_24))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_25", ejdb_test3_25))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_26", ejdb_test3_26))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_27", ejdb_test3_27))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_28", ejdb_test3_28))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_29", ejdb_test3_29))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_30", ejdb_test3_30))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_31", ejdb_test3_31))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_32", ejdb_test3_32))
+     || (NULL == CU_add_test(pSuite, "ejdb_test3_33", ejdb_test3_33))) {
     CU_cleanup_registry();
     return CU_get_error();
   }